@@ -1,4 +1,5 @@
 #include "args.h"
+#include <stdlib.h>
 #include <string.h>
 
 bool CheckArg(int argc, char **argv, const std::string &arg) {
@@ -9,3 +10,12 @@ bool CheckArg(int argc, char **argv, const std::string &arg) {
     }
     return false;
 }
+
+int IntArg(int argc, char **argv, const std::string &arg, int fallback) {
+    for (auto i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], arg.c_str()) == 0) {
+            return atoi(argv[i + 1]);
+        }
+    }
+    return fallback;
+}
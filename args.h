@@ -5,4 +5,7 @@
 
 bool CheckArg(int argc, char **argv, const std::string &arg);
 
+// The number following arg, or fallback when arg is not given.
+int IntArg(int argc, char **argv, const std::string &arg, int fallback);
+
 #endif //COMPILER_ARGS_H
\ No newline at end of file
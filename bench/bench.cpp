@@ -0,0 +1,37 @@
+#include "bencher.h"
+#include "../args.h"
+
+
+int main(int argc, char **argv) {
+    if (CheckArg(argc, argv, "-r")) {
+        BenchResolver(1000, 10, 10);
+    }
+    if (CheckArg(argc, argv, "-s")) {
+        BenchSemantic(1000, 40, 5);
+    }
+    if (CheckArg(argc, argv, "-i")) {
+        BenchIncremental(1000, 40, 5);
+    }
+    if (CheckArg(argc, argv, "-c")) {
+        BenchContexts(16, 200, 20);
+    }
+    if (CheckArg(argc, argv, "-v")) {
+        BenchExecution(200000, 5);
+    }
+    if (CheckArg(argc, argv, "-f")) {
+        BenchDataflow(4000, 5);
+    }
+    if (CheckArg(argc, argv, "-g")) {
+        BenchGvn(5);
+    }
+    if (CheckArg(argc, argv, "-t")) {
+        BenchStrength(20000, 5);
+    }
+    if (CheckArg(argc, argv, "-e")) {
+        BenchVector(20000, 5);
+    }
+    if (CheckArg(argc, argv, "-m")) {
+        BenchParallel(200000, 5);
+    }
+    return 0;
+}
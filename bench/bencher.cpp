@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "bencher.h"
+
+#include "../lexer/lexer.h"
+#include "../parser/parser.h"
+#include "../semantic/resolver.h"
+#include "../semantic/semantic.h"
+#include "../semantic/incremental.h"
+#include "../context/context.h"
+#include "../interpreter/interpreter.h"
+#include "../ir/builder.h"
+#include "../ir/dataflow.h"
+#include "../ir/optimizer.h"
+#include "../vm/compiler.h"
+#include "../vm/vm.h"
+#include "../codegen/assembly.h"
+#include "../jit/jit.h"
+
+std::ostream &operator<<(std::ostream &os, const BenchResult &res) {
+    os << res.name << ": " << res.total_ms / res.repeats << " ms (" << res.repeats << " runs)";
+    return os;
+}
+
+std::string GenerateProgram(int routines, int statements, int edited) {
+    std::stringstream ss;
+    ss << "var\n\tg0, g1, g2: integer;\n\tgd: double;\n";
+    for (int i = 0; i < routines; ++i) {
+        ss << "procedure p" << i << "(a: integer; var b: integer);\n"
+           << "var\n\tx, y: integer;\n\tr: record f, h: integer; end;\n\tarr: array[0..10] of integer;\n"
+           << "begin\n";
+        for (int j = 0; j < statements; ++j) {
+            ss << "\tx := a + g" << j % 3 << " * " << j << ";\n"
+               << "\tr.f := x - y;\n"
+               << "\tarr[" << j % 10 << "] := r.f + r.h;\n"
+               << "\tif x > y then y := arr[" << j % 10 << "] else b := x;\n"
+               << "\twhile y < " << j << " do y += 1;\n";
+        }
+        if (i == edited) {
+            ss << "\tx := x + 1;\n";
+        }
+        ss << "end;\n";
+    }
+    ss << "begin\n";
+    for (int i = 0; i < routines; ++i) {
+        ss << "\tp" << i << "(g0, g1);\n";
+    }
+    ss << "end.\n";
+    return ss.str();
+}
+
+std::string GenerateComputeProgram(int size) {
+    std::stringstream ss;
+    ss << "const\n\tn = " << size << ";\n"
+       << "var\n\tsieve: array[0..n] of boolean;\n\tdata: array[1..n] of integer;\n"
+       << "\ti, j, primes, total: integer;\n\tacc: double;\n"
+       << "function fib(k: integer): integer;\n"
+       << "begin\n\tif k < 2 then result := k else result := fib(k - 1) + fib(k - 2);\nend;\n"
+       << "begin\n"
+       << "\tfor i := 2 to n do sieve[i] := true;\n"
+       << "\tfor i := 2 to n do\n\t\tif sieve[i] then begin\n"
+       << "\t\t\tprimes += 1;\n\t\t\tj := i * i;\n"
+       << "\t\t\twhile j <= n do begin sieve[j] := false; j += i; end;\n\t\tend;\n"
+       << "\tfor i := 1 to n do data[i] := (i * 7919) mod 1000;\n"
+       << "\tfor i := 1 to n do begin\n"
+       << "\t\ttotal := total + data[i] * (i mod 7) - data[n + 1 - i];\n"
+       << "\t\tacc := acc + data[i] / 3;\n\tend;\n"
+       << "\twriteln(primes, ' ', total, ' ', acc, ' ', fib(20));\n"
+       << "end.\n";
+    return ss.str();
+}
+
+std::string GenerateDataflowProgram(int variables) {
+    std::stringstream ss;
+    ss << "procedure work(n: integer);\nvar\n";
+    for (int i = 0; i < variables; ++i) {
+        ss << "\tv" << i << ": integer;\n";
+    }
+    ss << "begin\n\tv0 := n;\n";
+    for (int i = 1; i < variables; ++i) {
+        if (i % 10 == 1) {
+            ss << "\tif v" << i - 1 << " > v" << i / 2 << " then begin\n";
+        }
+        ss << "\t\tv" << i << " := v" << i - 1 << " + v" << (i * 7) % i << " * 3;\n";
+        if (i % 10 == 0 || i + 1 == variables) {
+            ss << "\tend else\n\t\tv" << i << " := v" << i / 3 << ";\n";
+        }
+        if (i % 100 == 0) {
+            ss << "\twhile v" << i << " > 1000 do v" << i << " := v" << i << " div 2;\n";
+        }
+    }
+    ss << "\twriteln(v" << variables - 1 << ");\nend;\nbegin\n\twork(3);\nend.\n";
+    return ss.str();
+}
+
+std::string GenerateKernelProgram(int size) {
+    std::stringstream ss;
+    ss << "const\n\tn = " << size << ";\n"
+       << "type\n\tvec = record x, y: double; end;\n\tparticle = record pos, vel: vec; end;\n"
+       << "var\n\ta, b, c: array[0.." << size * size - 1 << "] of integer;\n"
+       << "\tp: array[0.." << size - 1 << "] of particle;\n\ti, j, k, step: integer;\n"
+       << "begin\n"
+       << "\tfor i := 0 to n - 1 do\n\t\tfor j := 0 to n - 1 do begin\n"
+       << "\t\t\ta[i * n + j] := i + j;\n\t\t\tb[i * n + j] := i - j;\n\t\tend;\n"
+       << "\tfor i := 0 to n - 1 do\n\t\tfor j := 0 to n - 1 do\n\t\t\tfor k := 0 to n - 1 do\n"
+       << "\t\t\t\tc[i * n + j] := c[i * n + j] + a[i * n + k] * b[k * n + j];\n"
+       << "\tfor step := 1 to n do\n\t\tfor i := 0 to n - 1 do begin\n"
+       << "\t\t\tp[i].vel.x := p[i].vel.x + 0.5;\n\t\t\tp[i].vel.y := p[i].vel.y - 0.25;\n"
+       << "\t\t\tp[i].pos.x := p[i].pos.x + p[i].vel.x;\n\t\t\tp[i].pos.y := p[i].pos.y + p[i].vel.y;\n"
+       << "\t\tend;\n"
+       << "\twriteln(c[n + 1], ' ', c[n * n - 1], ' ', p[n - 1].pos.x, ' ', p[0].pos.y);\n"
+       << "end.\n";
+    return ss.str();
+}
+
+std::string GenerateStrengthProgram(int size) {
+    std::stringstream ss;
+    ss << "const\n\tn = " << size << ";\n"
+       << "var\n\ta: array[0.." << size - 1 << "] of integer;\n\ti, j, h, s: integer;\n"
+       << "begin\n"
+       << "\tfor i := 0 to n - 1 do\n\t\ta[i] := (i * 7919) mod 1000 - 500;\n"
+       << "\ts := 0;\n"
+       << "\tfor j := 1 to 10 do\n\t\tfor i := 0 to n - 1 do begin\n"
+       << "\t\t\th := i + j;\n"
+       << "\t\t\ts := s + i div 8 + i mod 32 + h div 4 + h mod 16 + (i * 12) div 64;\n"
+       << "\t\t\ts := s + i div 7 + h mod 10 + a[i] div 8 + a[i] mod 4;\n"
+       << "\t\tend;\n"
+       << "\twriteln(s);\n"
+       << "end.\n";
+    return ss.str();
+}
+
+std::string GenerateVectorProgram(int size) {
+    std::stringstream ss;
+    ss << "type\n\tvec = array[1.." << size << "] of integer;\n\trvec = array[1.." << size << "] of double;\n"
+       << "var\n\ta, b, c: vec;\n\tx, y: rvec;\n\ti, j, k, s: integer;\n\th: double;\n"
+       << "procedure axpy(var u: rvec; var v: rvec; f: double);\nvar e: integer;\nbegin\n"
+       << "\tfor e := 1 to " << size << " do\n\t\tu[e] := u[e] + v[e] * f;\n"
+       << "end;\n"
+       << "begin\n"
+       << "\th := 0.0;\n"
+       << "\tfor i := 1 to " << size << " do begin\n"
+       << "\t\ta[i] := (i * 7919) mod 1000 - 500;\n\t\tb[i] := i mod 13;\n\t\tx[i] := h;\n\t\th := h + 0.5;\n"
+       << "\tend;\n"
+       << "\ts := 0;\n\tk := 3;\n"
+       << "\tfor j := 1 to 20 do begin\n"
+       << "\t\tfor i := 1 to " << size << " do\n\t\t\tc[i] := a[i] + b[i] * k;\n"
+       << "\t\tfor i := 1 to " << size << " do\n\t\t\ts := s + c[i] * a[i];\n"
+       << "\t\tfor i := 1 to " << size << " do\n\t\t\ty[i] := x[i] * 0.5 + y[i];\n"
+       << "\t\taxpy(y, x, 0.25);\n"
+       << "\tend;\n"
+       << "\twriteln(s, ' ', y[" << size << "]);\n"
+       << "end.\n";
+    return ss.str();
+}
+
+std::string WriteProgram(const std::string &name, const std::string &source) {
+    auto path = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream out(path);
+    out << source;
+    return path;
+}
+
+Node *ParseFile(const std::string &path, CompilationContext &context) {
+    auto stream = std::ifstream(path);
+    Lexer lexer(stream);
+    Parser parser(lexer, context);
+    return parser.Program();
+}
+
+void BenchResolver(int routines, int statements, int repeats) {
+    auto path = WriteProgram("bench_resolver.pas", GenerateProgram(routines, statements));
+    CompilationContext context;
+    auto program = ParseFile(path, context);
+    std::cout << "resolver: " << routines << " routines x " << statements << " statements\n";
+    std::cout << Measure("resolve", repeats, [&]() {
+        Resolver resolver(&context);
+        program->Accept(&resolver);
+    }) << "\n";
+    std::cout << Measure("resolve + check", repeats, [&]() {
+        Semantic semantic(&context, 1);
+        program->Accept(&semantic);
+    }) << "\n";
+}
+
+void BenchSemantic(int routines, int statements, int repeats) {
+    auto path = WriteProgram("bench_semantic.pas", GenerateProgram(routines, statements));
+    CompilationContext context;
+    auto program = ParseFile(path, context);
+    std::cout << "semantic: " << routines << " routines x " << statements << " statements\n";
+    for (int threads = 1; threads <= ThreadPool::DefaultThreads(); threads *= 2) {
+        std::cout << Measure("threads " + std::to_string(threads), repeats, [&]() {
+            Semantic semantic(&context, threads);
+            program->Accept(&semantic);
+        }) << "\n";
+    }
+}
+
+void BenchIncremental(int routines, int statements, int repeats) {
+    auto original = WriteProgram("bench_original.pas", GenerateProgram(routines, statements));
+    auto edited = WriteProgram("bench_edited.pas", GenerateProgram(routines, statements, routines / 2));
+    std::cout << "incremental: " << routines << " routines x " << statements << " statements, one routine edited\n";
+    std::cout << Measure("full check", repeats, [&]() {
+        CompilationContext context;
+        auto program = ParseFile(edited, context);
+        Semantic semantic(&context, 1);
+        program->Accept(&semantic);
+    }) << "\n";
+    CompilationContext context;
+    IncrementalSemantic semantic(&context);
+    semantic.Update(ParseFile(original, context));
+    bool is_original = false;
+    std::cout << Measure("incremental update", repeats, [&]() {
+        semantic.Update(ParseFile(is_original ? original : edited, context));
+        is_original = !is_original;
+    }) << " checked " << semantic.checked << ", reused " << semantic.reused << "\n";
+    std::cout << Measure("parse only", repeats, [&]() {
+        CompilationContext parse_context;
+        ParseFile(edited, parse_context);
+    }) << "\n";
+}
+
+void BenchContexts(int programs, int routines, int statements) {
+    auto path = WriteProgram("bench_contexts.pas", GenerateProgram(routines, statements));
+    auto compile = [&]() {
+        CompilationContext context;
+        auto program = ParseFile(path, context);
+        Semantic semantic(&context, 1);
+        program->Accept(&semantic);
+        return context.Allocated();
+    };
+    std::cout << "contexts: " << programs << " programs of " << routines << " routines x " << statements
+              << " statements, " << compile() / 1024 << " KiB arena each\n";
+    std::cout << Measure("sequential", 1, [&]() {
+        for (int i = 0; i < programs; ++i) compile();
+    }) << "\n";
+    std::cout << Measure("threads " + std::to_string(ThreadPool::DefaultThreads()), 1, [&]() {
+        ThreadPool pool;
+        for (int i = 0; i < programs; ++i) {
+            pool.Submit([&compile]() { compile(); });
+        }
+        pool.Wait();
+    }) << "\n";
+}
+
+void BenchExecution(int size, int repeats) {
+    auto path = WriteProgram("bench_execution.pas", GenerateComputeProgram(size));
+    CompilationContext context;
+    auto program = ParseFile(path, context);
+    Semantic semantic(&context, 1);
+    program->Accept(&semantic);
+    std::stringstream input;
+    std::stringstream output;
+    std::cout << "execution: sieve, array loops and fib(20) over " << size << " elements\n";
+    std::cout << Measure("ast interpreter", repeats, [&]() {
+        Interpreter(input, output).Run(program);
+    }) << "\n";
+    Program *bytecode = nullptr;
+    std::cout << Measure("bytecode compile", repeats, [&]() {
+        bytecode = BytecodeCompiler(&context).Compile(Optimize(BuildSsa(&context, program)));
+    }) << "\n";
+    VM vm(bytecode, input, output);
+    std::cout << Measure("register vm", repeats, [&]() {
+        vm.Run();
+    }) << "\n";
+    JIT jit(bytecode, input, output);
+    bool compiled = false;
+    std::cout << Measure("jit compile", repeats, [&]() {
+        compiled = jit.Compile();
+    }) << "\n";
+    if (compiled) {
+        std::cout << Measure("jit", repeats, [&]() {
+            jit.Run();
+        }) << "\n";
+    }
+    auto executable = (std::filesystem::temp_directory_path() / "bench_execution").string();
+    if (BuildExecutable(bytecode, executable) == 0) {
+        auto command = "'" + executable + "' > /dev/null";
+        std::cout << Measure("native x86-64", repeats, [&]() {
+            std::system(command.c_str());
+        }) << "\n";
+    }
+}
+
+static size_t CountInstructions(Module *module) {
+    size_t count = 0;
+    for (auto function: module->functions) {
+        for (auto block: function->blocks) {
+            count += block->insts.size();
+        }
+    }
+    return count;
+}
+
+// Instruction counts of a benchmark set optimized at levels 1 and 2 without
+// global value numbering and with it, and the vm time of the kernels
+// compiled both ways. Level 1 shows what value numbering removes itself;
+// at level 2 the loops it simplifies may be unrolled and vectorized too.
+void BenchGvn(int repeats) {
+    std::vector<std::pair<std::string, std::string>> programs = {
+            {"bench_gvn_kernels.pas", GenerateKernelProgram(60)},
+            {"bench_gvn_compute.pas", GenerateComputeProgram(2000)},
+            {"bench_gvn_routines.pas", GenerateProgram(100, 10)},
+            {"bench_gvn_dataflow.pas", GenerateDataflowProgram(400)},
+    };
+    std::cout << "value numbering: instructions without gvn and with it\n";
+    for (auto &[name, source]: programs) {
+        CompilationContext context;
+        auto program = ParseFile(WriteProgram(name, source), context);
+        Semantic semantic(&context, 1);
+        program->Accept(&semantic);
+        for (auto level: {1, 2}) {
+            OptimizerOptions options;
+            options.level = level;
+            options.number_values = false;
+            auto baseline = Optimize(BuildSsa(&context, program), nullptr, options);
+            options.number_values = true;
+            Statistics stats;
+            auto optimized = BuildSsa(&context, program);
+            auto label = name + " -O" + std::to_string(level);
+            std::cout << Measure(label, 1, [&]() { Optimize(optimized, &stats, options); }) << ": "
+                      << CountInstructions(baseline) << " -> " << CountInstructions(optimized) << " instructions, "
+                      << stats.Get("gvn.arithmetic") << " arithmetic, " << stats.Get("gvn.addresses")
+                      << " addresses, " << stats.Get("gvn.loads") << " loads removed\n";
+            if (name != programs[0].first) {
+                continue;
+            }
+            std::stringstream input, output;
+            VM without(BytecodeCompiler(&context).Compile(baseline), input, output);
+            std::cout << Measure("register vm without gvn", repeats, [&]() { without.Run(); }) << "\n";
+            VM with(BytecodeCompiler(&context).Compile(optimized), input, output);
+            std::cout << Measure("register vm with gvn", repeats, [&]() { with.Run(); }) << "\n";
+        }
+    }
+}
+
+static size_t CountArithmetic(Module *module) {
+    size_t count = 0;
+    for (auto function: module->functions) {
+        for (auto block: function->blocks) {
+            for (auto inst: block->insts) {
+                count += inst->op == IrOp::Mul || inst->op == IrOp::Div || inst->op == IrOp::Mod;
+            }
+        }
+    }
+    return count;
+}
+
+static size_t CountOpcodes(Program *program, std::initializer_list<Opcode> ops) {
+    return std::count_if(program->code.begin(), program->code.end(), [&](const Instruction &inst) {
+        return std::find(ops.begin(), ops.end(), inst.op) != ops.end();
+    });
+}
+
+// Divisions and modulos by powers of two and by other constants compiled
+// with every other pass and with strength reduction too: how many are left
+// to DIVKI and MODKI, the size of the bytecode and the run time.
+void BenchStrength(int size, int repeats) {
+    auto path = WriteProgram("bench_strength.pas", GenerateStrengthProgram(size));
+    CompilationContext context;
+    auto program = ParseFile(path, context);
+    Semantic semantic(&context, 1);
+    program->Accept(&semantic);
+    OptimizerOptions options;
+    options.reduce_strength = false;
+    auto baseline = Optimize(BuildSsa(&context, program), nullptr, options);
+    Statistics stats;
+    auto reduced = Optimize(BuildSsa(&context, program), &stats);
+    std::cout << "strength reduction: loops over " << size << " elements; " << stats.Get("strength.divisions")
+              << " divisions, " << stats.Get("strength.products") << " products, " << stats.Get("strength.tests")
+              << " exit tests replaced\n";
+    std::stringstream input, output;
+    for (auto [name, module]: {std::pair{"without", baseline}, std::pair{"with", reduced}}) {
+        auto bytecode = BytecodeCompiler(&context).Compile(module);
+        std::cout << name << ": " << CountInstructions(module) << " ir instructions, " << CountArithmetic(module)
+                  << " mul/div/mod; " << bytecode->code.size() << " bytecode instructions, "
+                  << CountOpcodes(bytecode, {Opcode::DIVKI, Opcode::MODKI}) << " DIVKI/MODKI, "
+                  << CountOpcodes(bytecode, {Opcode::DIVI, Opcode::MODI}) << " DIVI/MODI\n";
+        VM vm(bytecode, input, output);
+        std::cout << Measure(std::string("register vm ") + name, repeats, [&]() { vm.Run(); }) << "\n";
+        JIT jit(bytecode, input, output);
+        if (jit.Compile()) {
+            std::cout << Measure(std::string("jit ") + name, repeats, [&]() { jit.Run(); }) << "\n";
+        }
+    }
+}
+
+// Element-wise loops and a sum over arrays compiled with every pass but
+// vectorization and with it too.
+void BenchVector(int size, int repeats) {
+    auto path = WriteProgram("bench_vector.pas", GenerateVectorProgram(size));
+    CompilationContext context;
+    auto program = ParseFile(path, context);
+    Semantic semantic(&context, 1);
+    program->Accept(&semantic);
+    OptimizerOptions options;
+    options.vectorize = false;
+    auto scalar = Optimize(BuildSsa(&context, program), nullptr, options);
+    Statistics stats;
+    auto vectorized = Optimize(BuildSsa(&context, program), &stats);
+    std::cout << "vectorization: loops over " << size << " elements, " << stats.Get("vector.loops")
+              << " loops vectorized, " << stats.Get("vector.checks") << " with overlap checks\n";
+    std::stringstream input, output;
+    for (auto [name, module]: {std::pair{"scalar", scalar}, std::pair{"vectorized", vectorized}}) {
+        auto bytecode = BytecodeCompiler(&context).Compile(module);
+        VM vm(bytecode, input, output);
+        std::cout << Measure(std::string("register vm ") + name, repeats, [&]() { vm.Run(); }) << "\n";
+        JIT jit(bytecode, input, output);
+        if (jit.Compile()) {
+            std::cout << Measure(std::string("jit ") + name, repeats, [&]() { jit.Run(); }) << "\n";
+        }
+    }
+}
+
+// The loops of the vector benchmark split between more and more threads.
+void BenchParallel(int size, int repeats) {
+    auto path = WriteProgram("bench_parallel.pas", GenerateVectorProgram(size));
+    CompilationContext context;
+    auto program = ParseFile(path, context);
+    Semantic semantic(&context, 1);
+    program->Accept(&semantic);
+    OptimizerOptions options;
+    options.parallelize = true;
+    Statistics stats;
+    auto bytecode = BytecodeCompiler(&context).Compile(Optimize(BuildSsa(&context, program), &stats, options));
+    std::cout << "parallel loops: " << size << " elements, " << stats.Get("vector.parallel") << " loops parallelized\n";
+    std::stringstream input, output;
+    for (int threads = 1; threads <= ThreadPool::DefaultThreads(); threads *= 2) {
+        VM vm(bytecode, input, output);
+        vm.threads = threads;
+        std::cout << Measure("register vm threads " + std::to_string(threads), repeats, [&]() { vm.Run(); }) << "\n";
+        JIT jit(bytecode, input, output);
+        jit.threads = threads;
+        if (jit.Compile()) {
+            std::cout << Measure("jit threads " + std::to_string(threads), repeats, [&]() { jit.Run(); }) << "\n";
+        }
+    }
+}
+
+void BenchDataflow(int variables, int repeats) {
+    auto path = WriteProgram("bench_dataflow.pas", GenerateDataflowProgram(variables));
+    CompilationContext context;
+    auto program = ParseFile(path, context);
+    Semantic semantic(&context, 1);
+    program->Accept(&semantic);
+    auto memory = IrBuilder(&context).Build(program)->functions[0];
+    auto ssa = BuildSsa(&context, program)->functions[0];
+    std::cout << "dataflow: routine with " << variables << " variables, " << memory->blocks.size() << " blocks\n";
+    size_t definitions = 0, expressions = 0, values = 0;
+    std::cout << Measure("reaching definitions", repeats, [&]() {
+        Analyses analyses(memory);
+        definitions = analyses.Get<ReachingDefinitions>().Definitions().size();
+    }) << " (" << definitions << " definitions)\n";
+    std::cout << Measure("available expressions", repeats, [&]() {
+        Analyses analyses(memory);
+        expressions = analyses.Get<AvailableExpressions>().Count();
+    }) << " (" << expressions << " expressions)\n";
+    std::cout << Measure("liveness", repeats, [&]() {
+        Analyses analyses(ssa);
+        values = analyses.Get<Liveness>().Values().size();
+    }) << " (" << values << " ssa values)\n";
+}
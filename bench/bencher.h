@@ -0,0 +1,71 @@
+#ifndef COMPILER_BENCHER_H
+#define COMPILER_BENCHER_H
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <utility>
+
+class Node;
+
+class CompilationContext;
+
+class BenchResult {
+public:
+    BenchResult(std::string name, double total_ms, int repeats)
+            : name(std::move(name)), total_ms(total_ms), repeats(repeats) {}
+
+    friend std::ostream &operator<<(std::ostream &os, const BenchResult &res);
+
+    std::string name;
+    double total_ms;
+    int repeats;
+};
+
+template<class F>
+BenchResult Measure(const std::string &name, int repeats, F &&func) {
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i) {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return {name, std::chrono::duration<double, std::milli>(end - begin).count(), repeats};
+}
+
+std::string GenerateProgram(int routines, int statements, int edited = -1);
+
+std::string GenerateComputeProgram(int size);
+
+std::string GenerateDataflowProgram(int variables);
+
+std::string GenerateKernelProgram(int size);
+
+std::string GenerateStrengthProgram(int size);
+
+std::string GenerateVectorProgram(int size);
+
+std::string WriteProgram(const std::string &name, const std::string &source);
+
+Node *ParseFile(const std::string &path, CompilationContext &context);
+
+void BenchResolver(int routines, int statements, int repeats);
+
+void BenchSemantic(int routines, int statements, int repeats);
+
+void BenchIncremental(int routines, int statements, int repeats);
+
+void BenchContexts(int programs, int routines, int statements);
+
+void BenchExecution(int size, int repeats);
+
+void BenchDataflow(int variables, int repeats);
+
+void BenchGvn(int repeats);
+
+void BenchStrength(int size, int repeats);
+
+void BenchVector(int size, int repeats);
+
+void BenchParallel(int size, int repeats);
+
+#endif //COMPILER_BENCHER_H
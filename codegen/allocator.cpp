@@ -0,0 +1,808 @@
+#include "allocator.h"
+
+#include <algorithm>
+#include <climits>
+#include <numeric>
+#include <stdexcept>
+
+#include "../ir/dataflow.h"
+
+namespace {
+    // Instruction k reads its operands at 4k + 4, calls out at 4k + 5 and
+    // writes its result at 4k + 6. Intervals are split in the gap before an
+    // instruction, at 4k + 3.
+    int UsePos(int k) {
+        return 4 * k + 4;
+    }
+
+    int ClobberPos(int k) {
+        return 4 * k + 5;
+    }
+
+    int DefPos(int k) {
+        return 4 * k + 6;
+    }
+
+    int Gap(int k) {
+        return 4 * k + 3;
+    }
+
+    // The last gap at or before pos.
+    int GapBefore(int pos) {
+        return pos - (pos - 3) % 4;
+    }
+
+    // Caller-saved registers come first, so intervals not living across a
+    // call leave the callee-saved ones to those that do.
+    const Reg kGprs[] = {Reg::r8, Reg::r9, Reg::r10, Reg::r11, Reg::r14, Reg::r15, Reg::rbp};
+    const int kGprCount = 7;
+    const int kCallerSaved = 4;
+    // xmm1-xmm15; xmm0 is the scratch register of the generator.
+    const int kXmmCount = 15;
+
+    enum class Class {
+        Any, Int, Double
+    };
+
+    struct Access {
+        int reg;
+        Class kind;
+    };
+
+    // Instructions running library code or vector kernels, which may change
+    // every caller-saved register.
+    bool Clobbers(Opcode op) {
+        switch (op) {
+            case Opcode::CALL:
+            case Opcode::VECTOR:
+            case Opcode::CONCAT:
+            case Opcode::EQS:
+            case Opcode::NES:
+            case Opcode::LTS:
+            case Opcode::LES:
+            case Opcode::GTS:
+            case Opcode::GES:
+            case Opcode::WRITEI:
+            case Opcode::WRITED:
+            case Opcode::WRITEB:
+            case Opcode::WRITEC:
+            case Opcode::WRITES:
+            case Opcode::WRITELN:
+            case Opcode::READI:
+            case Opcode::READD:
+            case Opcode::READC:
+            case Opcode::READS:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // The registers an instruction reads and writes, and what as. Calls and
+    // kernels take theirs in memory and are not listed.
+    void Accesses(const Instruction &ins, std::vector<Access> &uses, std::vector<Access> &defs) {
+        uses.clear();
+        defs.clear();
+        auto binary = [&](Class result, Class operands) {
+            defs.push_back({ins.a, result});
+            uses.push_back({ins.b, operands});
+            uses.push_back({ins.c, operands});
+        };
+        auto unary = [&](Class result, Class operand) {
+            defs.push_back({ins.a, result});
+            uses.push_back({ins.b, operand});
+        };
+        switch (ins.op) {
+            case Opcode::MOVE:
+                unary(Class::Any, Class::Any);
+                break;
+            case Opcode::LOADK:
+            case Opcode::LOADG:
+            case Opcode::LOADL:
+                defs.push_back({ins.a, Class::Any});
+                break;
+            case Opcode::STOREG:
+            case Opcode::STOREL:
+                uses.push_back({ins.b, Class::Any});
+                break;
+            case Opcode::ADDRG:
+            case Opcode::ADDRL:
+                defs.push_back({ins.a, Class::Int});
+                break;
+            case Opcode::LOAD:
+                unary(Class::Any, Class::Int);
+                break;
+            case Opcode::STORE:
+                uses.push_back({ins.a, Class::Int});
+                uses.push_back({ins.c, Class::Any});
+                break;
+            case Opcode::COPY:
+                uses.push_back({ins.a, Class::Int});
+                uses.push_back({ins.b, Class::Int});
+                break;
+            case Opcode::ADDP:
+            case Opcode::NEGI:
+            case Opcode::NOTI:
+            case Opcode::ADDKI:
+            case Opcode::DIVKI:
+            case Opcode::MODKI:
+            case Opcode::NOTB:
+                unary(Class::Int, Class::Int);
+                break;
+            case Opcode::INDEX:
+            case Opcode::INDEXU:
+            case Opcode::ADDI:
+            case Opcode::SUBI:
+            case Opcode::MULI:
+            case Opcode::DIVI:
+            case Opcode::MODI:
+            case Opcode::SHLI:
+            case Opcode::SHRI:
+            case Opcode::ANDI:
+            case Opcode::ORI:
+            case Opcode::XORI:
+            case Opcode::CONCAT:
+            case Opcode::EQI:
+            case Opcode::NEI:
+            case Opcode::LTI:
+            case Opcode::LEI:
+            case Opcode::GTI:
+            case Opcode::GEI:
+            case Opcode::EQS:
+            case Opcode::NES:
+            case Opcode::LTS:
+            case Opcode::LES:
+            case Opcode::GTS:
+            case Opcode::GES:
+                binary(Class::Int, Class::Int);
+                break;
+            case Opcode::ADDD:
+            case Opcode::SUBD:
+            case Opcode::MULD:
+            case Opcode::DIVD:
+                binary(Class::Double, Class::Double);
+                break;
+            case Opcode::NEGD:
+                unary(Class::Double, Class::Double);
+                break;
+            case Opcode::ITOD:
+                unary(Class::Double, Class::Int);
+                break;
+            case Opcode::EQD:
+            case Opcode::NED:
+            case Opcode::LTD:
+            case Opcode::LED:
+            case Opcode::GTD:
+            case Opcode::GED:
+                binary(Class::Int, Class::Double);
+                break;
+            case Opcode::JZ:
+            case Opcode::JNZ:
+            case Opcode::WRITEI:
+            case Opcode::WRITEB:
+            case Opcode::WRITEC:
+            case Opcode::WRITES:
+                uses.push_back({ins.a, Class::Int});
+                break;
+            case Opcode::WRITED:
+                uses.push_back({ins.a, Class::Double});
+                break;
+            case Opcode::RET:
+                if (ins.a >= 0) {
+                    uses.push_back({ins.a, Class::Any});
+                }
+                break;
+            case Opcode::READI:
+            case Opcode::READC:
+            case Opcode::READS:
+                defs.push_back({ins.a, Class::Int});
+                break;
+            case Opcode::READD:
+                defs.push_back({ins.a, Class::Double});
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+bool Placement::operator==(const Placement &other) const {
+    if (kind != other.kind) {
+        return false;
+    }
+    switch (kind) {
+        case Gpr:
+            return gpr == other.gpr;
+        case Sse:
+            return xmm == other.xmm;
+        default:
+            return slot == other.slot;
+    }
+}
+
+bool LinearScan::Interval::Covers(int pos) const {
+    for (auto &range: ranges) {
+        if (pos < range.from) {
+            return false;
+        }
+        if (pos < range.to) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int LinearScan::Interval::NextUse(int from) const {
+    auto it = std::lower_bound(uses.begin(), uses.end(), from);
+    return it == uses.end() ? INT_MAX : *it;
+}
+
+LinearScan::LinearScan(const Program *program, int function, int begin, int end)
+        : program(program), function(&program->functions[function]), begin(begin), end(end) {
+    window = this->function->registers;
+    for (auto i = begin; i < end; ++i) {
+        auto &ins = program->code[i];
+        if (ins.op == Opcode::CALL || ins.op == Opcode::TAILCALL) {
+            window = std::min(window, ins.b);
+        } else if (ins.op == Opcode::VECTOR) {
+            window = std::min(window, ins.a);
+        }
+    }
+    BuildBlocks();
+    BuildIntervals();
+    Allocate(false);
+    Allocate(true);
+    AssignSlots();
+    ResolveSplits();
+}
+
+void LinearScan::BuildBlocks() {
+    auto size = end - begin;
+    std::vector<bool> leader(size + 1, false);
+    leader[0] = true;
+    for (int k = 0; k < size; ++k) {
+        auto &ins = program->code[begin + k];
+        switch (ins.op) {
+            case Opcode::JMP:
+                leader[ins.a - begin] = true;
+                leader[k + 1] = true;
+                break;
+            case Opcode::JZ:
+            case Opcode::JNZ:
+                leader[ins.b - begin] = true;
+                leader[k + 1] = true;
+                break;
+            case Opcode::TAILCALL:
+            case Opcode::RET:
+            case Opcode::HALT:
+                leader[k + 1] = true;
+                break;
+            default:
+                break;
+        }
+    }
+    block_of.resize(size);
+    for (int k = 0; k < size; ++k) {
+        if (leader[k]) {
+            blocks.push_back({k, k, {}});
+        }
+        blocks.back().last = k;
+        block_of[k] = (int) blocks.size() - 1;
+    }
+    for (auto &block: blocks) {
+        auto &ins = program->code[begin + block.last];
+        auto next = block.last + 1 < size ? block_of[block.last + 1] : -1;
+        switch (ins.op) {
+            case Opcode::JMP:
+                block.succs.push_back(block_of[ins.a - begin]);
+                break;
+            case Opcode::JZ:
+            case Opcode::JNZ:
+                block.succs.push_back(block_of[ins.b - begin]);
+                if (next >= 0) {
+                    block.succs.push_back(next);
+                }
+                break;
+            case Opcode::TAILCALL:
+            case Opcode::RET:
+            case Opcode::HALT:
+                break;
+            default:
+                if (next >= 0) {
+                    block.succs.push_back(next);
+                }
+        }
+    }
+}
+
+void LinearScan::BuildIntervals() {
+    auto size = end - begin;
+    std::vector<Access> uses, defs;
+    auto each = [&](int k) {
+        Accesses(program->code[begin + k], uses, defs);
+        auto pinned = [&](const Access &access) { return access.reg < 0 || access.reg >= window; };
+        uses.erase(std::remove_if(uses.begin(), uses.end(), pinned), uses.end());
+        defs.erase(std::remove_if(defs.begin(), defs.end(), pinned), defs.end());
+    };
+
+    // Registers moved into one another are kept in the same class; one read
+    // both as an integer and as a double stays in memory.
+    std::vector<int> parent(window);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](int reg) {
+        while (parent[reg] != reg) {
+            reg = parent[reg] = parent[parent[reg]];
+        }
+        return reg;
+    };
+    for (int k = 0; k < size; ++k) {
+        each(k);
+        if (program->code[begin + k].op == Opcode::MOVE && uses.size() == 1 && defs.size() == 1) {
+            parent[find(uses[0].reg)] = find(defs[0].reg);
+        }
+    }
+    std::vector<int> classes(window, 0);
+    for (int k = 0; k < size; ++k) {
+        each(k);
+        for (auto &access: uses) {
+            classes[find(access.reg)] |= 1 << (int) access.kind;
+        }
+        for (auto &access: defs) {
+            classes[find(access.reg)] |= 1 << (int) access.kind;
+        }
+    }
+
+    std::vector<BitVector> gen(blocks.size(), BitVector(window)), kill(blocks.size(), BitVector(window));
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        for (auto k = blocks[b].first; k <= blocks[b].last; ++k) {
+            each(k);
+            for (auto &access: uses) {
+                if (!kill[b].Test(access.reg)) {
+                    gen[b].Set(access.reg);
+                }
+            }
+            for (auto &access: defs) {
+                kill[b].Set(access.reg);
+            }
+        }
+    }
+    std::vector<BitVector> live_in(blocks.size(), BitVector(window)), live_out = live_in;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto b = (int) blocks.size() - 1; b >= 0; --b) {
+            for (auto succ: blocks[b].succs) {
+                live_out[b].Union(live_in[succ]);
+            }
+            auto in = live_out[b];
+            in.Subtract(kill[b]);
+            in.Union(gen[b]);
+            changed |= live_in[b].Union(in);
+        }
+    }
+    live.resize(blocks.size());
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        live_in[b].ForEach([&](size_t reg) { live[b].push_back((int) reg); });
+    }
+
+    // Blocks are walked backwards, so the first range of an interval is the
+    // last one in its vector until they are reversed.
+    intervals.resize(window);
+    for (int reg = 0; reg < window; ++reg) {
+        intervals[reg].reg = reg;
+        intervals[reg].sse = classes[find(reg)] == (1 << (int) Class::Double) ||
+                             classes[find(reg)] == (1 << (int) Class::Double | 1 << (int) Class::Any);
+        intervals[reg].memory_only = (classes[find(reg)] & 1 << (int) Class::Int) &&
+                                     (classes[find(reg)] & 1 << (int) Class::Double);
+    }
+    auto add = [&](int reg, int from, int to) {
+        auto &ranges = intervals[reg].ranges;
+        if (!ranges.empty() && ranges.back().from <= to) {
+            ranges.back().from = std::min(ranges.back().from, from);
+            ranges.back().to = std::max(ranges.back().to, to);
+        } else {
+            ranges.push_back({from, to});
+        }
+    };
+    for (auto b = (int) blocks.size() - 1; b >= 0; --b) {
+        auto from = Gap(blocks[b].first);
+        auto to = Gap(blocks[b].last + 1);
+        live_out[b].ForEach([&](size_t reg) { add((int) reg, from, to); });
+        for (auto k = blocks[b].last; k >= blocks[b].first; --k) {
+            if (Clobbers(program->code[begin + k].op)) {
+                clobbers.push_back(ClobberPos(k));
+            }
+            each(k);
+            for (auto &access: defs) {
+                auto &interval = intervals[access.reg];
+                auto &ranges = interval.ranges;
+                if (!ranges.empty() && ranges.back().from <= DefPos(k) && DefPos(k) < ranges.back().to) {
+                    ranges.back().from = DefPos(k);
+                } else {
+                    ranges.push_back({DefPos(k), DefPos(k) + 1});
+                }
+                interval.uses.push_back(DefPos(k));
+            }
+            for (auto &access: uses) {
+                add(access.reg, from, UsePos(k) + 1);
+                intervals[access.reg].uses.push_back(UsePos(k));
+            }
+        }
+    }
+    std::sort(clobbers.begin(), clobbers.end());
+    children.resize(window);
+    for (int reg = 0; reg < window; ++reg) {
+        auto &interval = intervals[reg];
+        std::reverse(interval.ranges.begin(), interval.ranges.end());
+        std::sort(interval.uses.begin(), interval.uses.end());
+    }
+}
+
+int LinearScan::Intersection(const Interval &a, const Interval &b) {
+    size_t i = 0, j = 0;
+    while (i < a.ranges.size() && j < b.ranges.size()) {
+        if (a.ranges[i].to <= b.ranges[j].from) {
+            ++i;
+        } else if (b.ranges[j].to <= a.ranges[i].from) {
+            ++j;
+        } else {
+            return std::max(a.ranges[i].from, b.ranges[j].from);
+        }
+    }
+    return INT_MAX;
+}
+
+int LinearScan::FirstClobber(const Interval &interval) const {
+    for (auto it = std::lower_bound(clobbers.begin(), clobbers.end(), interval.Start());
+         it != clobbers.end() && *it < interval.End(); ++it) {
+        if (interval.Covers(*it)) {
+            return *it;
+        }
+    }
+    return INT_MAX;
+}
+
+int LinearScan::Split(int index, int pos) {
+    Interval child;
+    child.reg = intervals[index].reg;
+    child.sse = intervals[index].sse;
+    std::vector<Range> kept;
+    for (auto &range: intervals[index].ranges) {
+        if (range.to <= pos) {
+            kept.push_back(range);
+        } else if (range.from >= pos) {
+            child.ranges.push_back(range);
+        } else {
+            kept.push_back({range.from, pos});
+            child.ranges.push_back({pos, range.to});
+        }
+    }
+    auto &uses = intervals[index].uses;
+    auto middle = std::lower_bound(uses.begin(), uses.end(), pos);
+    child.uses.assign(middle, uses.end());
+    uses.erase(middle, uses.end());
+    intervals[index].ranges = std::move(kept);
+    intervals.push_back(std::move(child));
+    return (int) intervals.size() - 1;
+}
+
+void LinearScan::Push(int interval) {
+    unhandled.push_back(interval);
+    std::push_heap(unhandled.begin(), unhandled.end(), [&](int a, int b) {
+        return intervals[a].Start() > intervals[b].Start();
+    });
+}
+
+void LinearScan::Allocate(bool sse) {
+    unhandled.clear();
+    for (int reg = 0; reg < window; ++reg) {
+        auto &interval = intervals[reg];
+        if (!interval.ranges.empty() && !interval.memory_only && interval.sse == sse) {
+            Push(reg);
+        }
+    }
+    std::vector<int> active, inactive;
+    while (!unhandled.empty()) {
+        std::pop_heap(unhandled.begin(), unhandled.end(), [&](int a, int b) {
+            return intervals[a].Start() > intervals[b].Start();
+        });
+        auto current = unhandled.back();
+        unhandled.pop_back();
+        auto pos = intervals[current].Start();
+        for (size_t i = 0; i < active.size();) {
+            auto &interval = intervals[active[i]];
+            if (interval.End() <= pos || !interval.Covers(pos)) {
+                if (interval.End() > pos) {
+                    inactive.push_back(active[i]);
+                }
+                active.erase(active.begin() + (long) i);
+            } else {
+                ++i;
+            }
+        }
+        for (size_t i = 0; i < inactive.size();) {
+            auto &interval = intervals[inactive[i]];
+            if (interval.End() <= pos || interval.Covers(pos)) {
+                if (interval.End() > pos) {
+                    active.push_back(inactive[i]);
+                }
+                inactive.erase(inactive.begin() + (long) i);
+            } else {
+                ++i;
+            }
+        }
+        if (!TryFree(current, sse, active, inactive)) {
+            AllocateBlocked(current, sse, active, inactive);
+        }
+        if (intervals[current].assigned >= 0) {
+            active.push_back(current);
+        }
+    }
+}
+
+// Takes a register free for the whole interval, the first caller-saved one
+// when several are, or else the one free the longest, splitting the interval
+// where that one is needed again.
+bool LinearScan::TryFree(int current, bool sse, std::vector<int> &active, std::vector<int> &inactive) {
+    auto count = sse ? kXmmCount : kGprCount;
+    std::vector<int> free(count, INT_MAX);
+    for (auto interval: active) {
+        free[intervals[interval].assigned] = 0;
+    }
+    for (auto interval: inactive) {
+        auto &assigned = free[intervals[interval].assigned];
+        assigned = std::min(assigned, Intersection(intervals[interval], intervals[current]));
+    }
+    auto clobber = FirstClobber(intervals[current]);
+    for (int n = 0; n < count; ++n) {
+        if (sse || n < kCallerSaved) {
+            free[n] = std::min(free[n], clobber);
+        }
+    }
+    auto start = intervals[current].Start();
+    auto finish = intervals[current].End();
+    int best = 0;
+    for (int n = 0; n < count; ++n) {
+        if (free[n] >= finish) {
+            best = n;
+            break;
+        }
+        if (free[n] > free[best]) {
+            best = n;
+        }
+    }
+    if (free[best] >= finish) {
+        intervals[current].assigned = best;
+        return true;
+    }
+    if (free[best] <= start || GapBefore(free[best]) <= start) {
+        return false;
+    }
+    intervals[current].assigned = best;
+    Push(Split(current, GapBefore(free[best])));
+    return true;
+}
+
+// No register is free: the interval goes to memory up to its next use when
+// every register is wanted sooner, or takes the register wanted the latest,
+// whose interval goes to memory until its own next use.
+void LinearScan::AllocateBlocked(int current, bool sse, std::vector<int> &active, std::vector<int> &inactive) {
+    auto count = sse ? kXmmCount : kGprCount;
+    auto start = intervals[current].Start();
+    std::vector<int> use(count, INT_MAX), blocked(count, INT_MAX);
+    auto clobber = FirstClobber(intervals[current]);
+    for (int n = 0; n < count; ++n) {
+        if (sse || n < kCallerSaved) {
+            blocked[n] = clobber;
+        }
+    }
+    for (auto interval: active) {
+        auto &next = use[intervals[interval].assigned];
+        next = std::min(next, intervals[interval].NextUse(start));
+    }
+    for (auto interval: inactive) {
+        auto &until = blocked[intervals[interval].assigned];
+        until = std::min(until, Intersection(intervals[interval], intervals[current]));
+    }
+    auto first = intervals[current].NextUse(start);
+    int best = -1;
+    for (int n = 0; n < count; ++n) {
+        if (blocked[n] > start && GapBefore(blocked[n]) > start && (best < 0 || use[n] > use[best])) {
+            best = n;
+        }
+    }
+
+    auto reload = [&](int interval) {
+        auto from = std::max(start, intervals[interval].Start());
+        for (auto position: intervals[interval].uses) {
+            if (GapBefore(position) > from) {
+                Push(Split(interval, GapBefore(position)));
+                return;
+            }
+        }
+    };
+    if (best < 0 || use[best] <= first) {
+        intervals[current].assigned = -1;
+        reload(current);
+        return;
+    }
+    auto gap = GapBefore(start);
+    for (size_t i = 0; i < active.size();) {
+        auto evicted = active[i];
+        if (intervals[evicted].assigned != best) {
+            ++i;
+            continue;
+        }
+        auto tail = evicted;
+        if (gap > intervals[evicted].Start()) {
+            tail = Split(evicted, gap);
+            ++i;
+        } else {
+            active.erase(active.begin() + (long) i);
+        }
+        intervals[tail].assigned = -1;
+        reload(tail);
+    }
+    intervals[current].assigned = best;
+    if (blocked[best] < intervals[current].End()) {
+        Push(Split(current, GapBefore(blocked[best])));
+    }
+}
+
+void LinearScan::AssignSlots() {
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        if (!intervals[i].ranges.empty()) {
+            children[intervals[i].reg].push_back((int) i);
+        }
+        if (intervals[i].assigned >= kCallerSaved && !intervals[i].sse && kGprs[intervals[i].assigned] != Reg::rbp) {
+            saves_extra = true;
+        }
+    }
+    struct Lifetime {
+        int reg;
+        int from;
+        int to;
+    };
+    std::vector<Lifetime> lifetimes;
+    slots.assign(window, -1);
+    for (int reg = 0; reg < window; ++reg) {
+        auto &list = children[reg];
+        std::sort(list.begin(), list.end(), [&](int a, int b) {
+            return intervals[a].Start() < intervals[b].Start();
+        });
+        if (reg < function->params) {
+            slots[reg] = reg;
+            continue;
+        }
+        Lifetime lifetime{reg, INT_MAX, 0};
+        bool spilled = false;
+        for (auto interval: list) {
+            spilled |= intervals[interval].assigned < 0;
+            lifetime.from = std::min(lifetime.from, intervals[interval].Start());
+            lifetime.to = std::max(lifetime.to, intervals[interval].End());
+        }
+        if (spilled) {
+            lifetimes.push_back(lifetime);
+        }
+    }
+    // A slot is reused once the lifetime of the register it held is over.
+    std::sort(lifetimes.begin(), lifetimes.end(), [](const Lifetime &a, const Lifetime &b) {
+        return a.from < b.from;
+    });
+    std::vector<int> free_from;
+    for (auto &lifetime: lifetimes) {
+        auto it = std::find_if(free_from.begin(), free_from.end(), [&](int to) { return to <= lifetime.from; });
+        if (it == free_from.end()) {
+            it = free_from.insert(free_from.end(), 0);
+        }
+        *it = lifetime.to;
+        slots[lifetime.reg] = function->params + (int) (it - free_from.begin());
+    }
+    spills = (int) free_from.size();
+    frame = std::max(1, function->params + spills + function->registers - window);
+}
+
+void LinearScan::ResolveSplits() {
+    auto size = end - begin;
+    before.resize(size);
+    for (int reg = 0; reg < window; ++reg) {
+        for (auto interval: children[reg]) {
+            auto start = intervals[interval].Start();
+            if (start % 4 != 3) {
+                continue;
+            }
+            auto k = (start - 3) / 4;
+            if (k >= size || blocks[block_of[k]].first == k) {
+                continue;
+            }
+            auto from = At(reg, start - 1);
+            auto to = Of(intervals[interval]);
+            if (from != to) {
+                before[k].push_back({from, to});
+            }
+        }
+    }
+}
+
+Placement LinearScan::Of(const Interval &interval) const {
+    Placement placement;
+    if (interval.assigned < 0) {
+        placement.slot = slots[interval.reg];
+    } else if (interval.sse) {
+        placement.kind = Placement::Sse;
+        placement.xmm = (Xmm) (interval.assigned + 1);
+    } else {
+        placement.kind = Placement::Gpr;
+        placement.gpr = kGprs[interval.assigned];
+    }
+    return placement;
+}
+
+Placement LinearScan::At(int reg, int pos) const {
+    if (reg >= window) {
+        Placement placement;
+        placement.slot = Slot(reg);
+        return placement;
+    }
+    for (auto interval: children[reg]) {
+        if (intervals[interval].Covers(pos)) {
+            return Of(intervals[interval]);
+        }
+    }
+    throw std::logic_error("register " + std::to_string(reg) + " is not live at " + std::to_string(pos));
+}
+
+Placement LinearScan::Use(int reg, int index) const {
+    return At(reg, UsePos(index - begin));
+}
+
+Placement LinearScan::Def(int reg, int index) const {
+    return At(reg, DefPos(index - begin));
+}
+
+int LinearScan::Slot(int reg) const {
+    return reg >= window ? function->params + spills + reg - window : slots[reg];
+}
+
+const std::vector<LinearScan::Move> &LinearScan::Before(int index) const {
+    return before[index - begin];
+}
+
+bool LinearScan::Starts(int index) const {
+    return blocks[block_of[index - begin]].first == index - begin;
+}
+
+std::vector<LinearScan::Move> LinearScan::Edge(int index, int target) const {
+    std::vector<Move> moves;
+    for (auto reg: live[block_of[target - begin]]) {
+        auto from = At(reg, DefPos(index - begin));
+        auto to = At(reg, Gap(target - begin));
+        if (from != to) {
+            moves.push_back({from, to});
+        }
+    }
+    return moves;
+}
+
+std::vector<LinearScan::Move> LinearScan::Entry() const {
+    std::vector<Move> moves;
+    for (auto reg: live[0]) {
+        auto to = At(reg, Gap(0));
+        if (reg < function->params && to.kind != Placement::Memory) {
+            Placement from;
+            from.slot = reg;
+            moves.push_back({from, to});
+        }
+    }
+    return moves;
+}
+
+std::vector<Placement> LinearScan::Cleared() const {
+    std::vector<Placement> cleared;
+    for (auto reg: live[0]) {
+        auto at = At(reg, Gap(0));
+        if (reg >= function->params && at.kind != Placement::Memory) {
+            cleared.push_back(at);
+        }
+    }
+    return cleared;
+}
@@ -0,0 +1,166 @@
+#ifndef COMPILER_ALLOCATOR_H
+#define COMPILER_ALLOCATOR_H
+
+#include <vector>
+
+#include "../vm/bytecode.h"
+#include "x86.h"
+
+// Where a bytecode register is kept over a stretch of code: a general or an
+// SSE register, or a slot of the native frame.
+struct Placement {
+    enum Kind {
+        Memory,
+        Gpr,
+        Sse
+    };
+
+    Kind kind = Memory;
+    Reg gpr = Reg::rax;
+    Xmm xmm = Xmm::xmm0;
+    int slot = 0;
+
+    bool operator==(const Placement &other) const;
+
+    bool operator!=(const Placement &other) const { return !(*this == other); }
+};
+
+// Linear-scan register allocation of one bytecode function for the native
+// backend, after Wimmer and Mössenböck, "Optimized Interval Splitting in a
+// Linear Scan Register Allocator". Live intervals come from liveness over the
+// blocks of the bytecode; registers read as integers and as doubles are
+// allocated separately from r8-r11, r14, r15 and rbp and from xmm1-xmm15.
+// An interval is split where it would need a register another interval has,
+// and spilled up to its next use when all of them are taken; calls and other
+// instructions running library code clobber the caller-saved registers, so
+// intervals living across them are split there or take rbp, r14 or r15.
+//
+// The native frame keeps the params in their slots, then the spill slots,
+// shared by registers whose lifetimes do not meet, then the registers passed
+// to calls and vector kernels.
+class LinearScan {
+public:
+    struct Move {
+        Placement from;
+        Placement to;
+    };
+
+    LinearScan(const Program *program, int function, int begin, int end);
+
+    // Placement of reg while instruction index reads its operands, and where
+    // the instruction writes it.
+    [[nodiscard]] Placement Use(int reg, int index) const;
+
+    [[nodiscard]] Placement Def(int reg, int index) const;
+
+    // Frame slot of a register only ever kept in memory, which registers
+    // passed to calls and kernels and the result are.
+    [[nodiscard]] int Slot(int reg) const;
+
+    // Moves to run before instruction index, where intervals were split.
+    [[nodiscard]] const std::vector<Move> &Before(int index) const;
+
+    // The instruction after the function.
+    [[nodiscard]] int End() const { return end; }
+
+    // Whether a block starts at instruction index.
+    [[nodiscard]] bool Starts(int index) const;
+
+    // Moves along the edge from instruction index to the block at target.
+    [[nodiscard]] std::vector<Move> Edge(int index, int target) const;
+
+    // Moves to run on entry, loading params kept in registers from their
+    // slots.
+    [[nodiscard]] std::vector<Move> Entry() const;
+
+    // Registers read before they are written, which start as zero like the
+    // slots of the frame.
+    [[nodiscard]] std::vector<Placement> Cleared() const;
+
+    // Whether values are kept in r14 or r15, which the function then saves;
+    // rbp is saved by every function.
+    [[nodiscard]] bool SavesExtra() const { return saves_extra; }
+
+    // Slots of the native frame.
+    int frame = 1;
+
+private:
+    struct Range {
+        int from;
+        int to;
+    };
+
+    struct Interval {
+        int reg;
+        bool sse = false;
+        bool memory_only = false;
+        std::vector<Range> ranges;
+        std::vector<int> uses;
+        int assigned = -1;
+
+        [[nodiscard]] int Start() const { return ranges.front().from; }
+
+        [[nodiscard]] int End() const { return ranges.back().to; }
+
+        [[nodiscard]] bool Covers(int pos) const;
+
+        [[nodiscard]] int NextUse(int from) const;
+    };
+
+    struct BlockInfo {
+        int first;
+        int last;
+        std::vector<int> succs;
+    };
+
+    void BuildBlocks();
+
+    void BuildIntervals();
+
+    void Allocate(bool sse);
+
+    bool TryFree(int current, bool sse, std::vector<int> &active, std::vector<int> &inactive);
+
+    void AllocateBlocked(int current, bool sse, std::vector<int> &active, std::vector<int> &inactive);
+
+    // Splits an interval at pos, returning the part from pos on.
+    int Split(int interval, int pos);
+
+    void Push(int interval);
+
+    void AssignSlots();
+
+    void ResolveSplits();
+
+    // The first clobbering instruction the interval lives across, as a
+    // position, or INT_MAX.
+    [[nodiscard]] int FirstClobber(const Interval &interval) const;
+
+    [[nodiscard]] static int Intersection(const Interval &a, const Interval &b);
+
+    [[nodiscard]] Placement At(int reg, int pos) const;
+
+    [[nodiscard]] Placement Of(const Interval &interval) const;
+
+    const Program *program;
+    const ::Function *function;
+    int begin;
+    int end;
+    // Registers from window on are passed to calls and kernels.
+    int window = 0;
+    std::vector<BlockInfo> blocks;
+    std::vector<int> block_of;
+    // The registers live into each block.
+    std::vector<std::vector<int>> live;
+    std::vector<Interval> intervals;
+    // The intervals of each register by start.
+    std::vector<std::vector<int>> children;
+    std::vector<int> unhandled;
+    std::vector<int> clobbers;
+    std::vector<int> slots;
+    int spills = 0;
+    std::vector<std::vector<Move>> before;
+    bool saves_extra = false;
+};
+
+#endif //COMPILER_ALLOCATOR_H
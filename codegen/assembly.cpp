@@ -0,0 +1,825 @@
+#include "assembly.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#include "../vm/bytecode.h"
+#include "generator.h"
+
+namespace {
+    const long long STACK_SLOTS = 1 << 20;
+
+    // Collections of strings wait for at least this many bytes of new ones.
+    const long long STRING_BYTES = 1 << 20;
+
+    const char *Name(Reg reg) {
+        static const char *names[] = {
+                "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+        };
+        return names[(int) reg];
+    }
+
+    const char *Name8(Reg reg) {
+        static const char *names[] = {
+                "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+                "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+        };
+        return names[(int) reg];
+    }
+
+    const char *Suffix(Cond cond) {
+        static const char *names[] = {
+                "o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g"
+        };
+        return names[(int) cond];
+    }
+
+    const char *Mnemonic(AluOp op) {
+        static const char *names[] = {"addq", "orq", "adcq", "sbbq", "andq", "subq", "xorq", "cmpq"};
+        return names[(int) op];
+    }
+
+    const char *Mnemonic(SseOp op) {
+        static const char *names[] = {"movsd", "addsd", "subsd", "mulsd", "divsd", "ucomisd", "cvtsi2sdq"};
+        return names[(int) op];
+    }
+
+    std::string Operand(Reg reg) {
+        return std::string("%") + Name(reg);
+    }
+
+    std::string Operand(Xmm reg) {
+        return "%xmm" + std::to_string((int) reg);
+    }
+
+    std::string Operand(Mem mem) {
+        return (mem.disp != 0 ? std::to_string(mem.disp) : "") + "(%" + Name(mem.base) + ")";
+    }
+
+    std::string Immediate(long long imm) {
+        return "$" + std::to_string(imm);
+    }
+
+    std::string LabelName(Label label) {
+        return ".L" + std::to_string(label);
+    }
+
+    std::string Quote(const std::string &text) {
+        std::string result = "\"";
+        for (unsigned char c: text) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+                result += (char) c;
+            } else if (c < 32 || c >= 127) {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\%03o", c);
+                result += buffer;
+            } else {
+                result += (char) c;
+            }
+        }
+        return result + "\"";
+    }
+}
+
+void AssemblyEmitter::Assemble(Program *program, std::ostream &os) {
+    AssemblyEmitter emitter(os);
+    os << "\t.text\n";
+    auto entry = NativeGenerator(program, emitter).Generate();
+    emitter.WriteRuntime(entry, program->globals);
+}
+
+int BuildExecutable(Program *program, const std::string &output) {
+    {
+        std::ofstream os(output + ".s");
+        AssemblyEmitter::Assemble(program, os);
+    }
+    auto command = "cc -pthread -o '" + output + "' '" + output + ".s'";
+    return std::system(command.c_str());
+}
+
+void AssemblyEmitter::Instruction(const std::string &mnemonic, const std::string &operands) {
+    os << "\t" << mnemonic;
+    if (!operands.empty()) {
+        os << "\t" << operands;
+    }
+    os << "\n";
+}
+
+Label AssemblyEmitter::NewLabel() {
+    return labels++;
+}
+
+void AssemblyEmitter::Bind(Label label) {
+    os << LabelName(label) << ":\n";
+}
+
+void AssemblyEmitter::Comment(const std::string &text) {
+    os << "\t# " << text << "\n";
+}
+
+void AssemblyEmitter::Mov(Reg dst, Mem src) {
+    Instruction("movq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Mov(Mem dst, Reg src) {
+    Instruction("movq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Mov(Reg dst, Reg src) {
+    Instruction("movq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::MovImm(Reg dst, long long imm) {
+    Instruction(FitsInt32(imm) ? "movq" : "movabsq", Immediate(imm) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::MovImm(Mem dst, int imm) {
+    Instruction("movq", Immediate(imm) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Lea(Reg dst, Mem src) {
+    Instruction("leaq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Lea(Reg dst, Label label) {
+    Instruction("leaq", LabelName(label) + "(%rip), " + Operand(dst));
+}
+
+void AssemblyEmitter::Alu(AluOp op, Reg dst, Mem src) {
+    Instruction(Mnemonic(op), Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Alu(AluOp op, Reg dst, Reg src) {
+    Instruction(Mnemonic(op), Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::AluImm(AluOp op, Reg dst, int imm) {
+    Instruction(Mnemonic(op), Immediate(imm) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::AluImm(AluOp op, Mem dst, int imm) {
+    Instruction(Mnemonic(op), Immediate(imm) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Imul(Reg dst, Mem src) {
+    Instruction("imulq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Imul(Reg dst, Reg src) {
+    Instruction("imulq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::ImulImm(Reg dst, Reg src, int imm) {
+    Instruction("imulq", Immediate(imm) + ", " + Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::ImulWide(Reg reg) {
+    Instruction("imulq", Operand(reg));
+}
+
+void AssemblyEmitter::Neg(Reg reg) {
+    Instruction("negq", Operand(reg));
+}
+
+void AssemblyEmitter::Not(Reg reg) {
+    Instruction("notq", Operand(reg));
+}
+
+static const char *ShiftName(ShiftOp op) {
+    switch (op) {
+        case ShiftOp::Shl:
+            return "shlq";
+        case ShiftOp::Shr:
+            return "shrq";
+        default:
+            return "sarq";
+    }
+}
+
+void AssemblyEmitter::Shift(ShiftOp op, Reg reg) {
+    Instruction(ShiftName(op), "%cl, " + Operand(reg));
+}
+
+void AssemblyEmitter::ShiftImm(ShiftOp op, Reg reg, int count) {
+    Instruction(ShiftName(op), Immediate(count) + ", " + Operand(reg));
+}
+
+void AssemblyEmitter::Cqo() {
+    Instruction("cqto");
+}
+
+void AssemblyEmitter::Idiv(Reg reg) {
+    Instruction("idivq", Operand(reg));
+}
+
+void AssemblyEmitter::Test(Reg a, Reg b) {
+    Instruction("testq", Operand(b) + ", " + Operand(a));
+}
+
+void AssemblyEmitter::Setcc(Cond cond, Reg reg) {
+    Instruction(std::string("set") + Suffix(cond), std::string("%") + Name8(reg));
+}
+
+void AssemblyEmitter::Movzx8(Reg dst, Reg src) {
+    Instruction("movzbq", std::string("%") + Name8(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Sse(SseOp op, Xmm dst, Mem src) {
+    Instruction(Mnemonic(op), Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Sse(SseOp op, Xmm dst, Xmm src) {
+    Instruction(op == SseOp::Movsd ? "movapd" : Mnemonic(op), Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Cvtsi2sd(Xmm dst, Reg src) {
+    Instruction("cvtsi2sdq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Movsd(Mem dst, Xmm src) {
+    Instruction("movsd", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Movq(Xmm dst, Reg src) {
+    Instruction("movq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Movq(Reg dst, Xmm src) {
+    Instruction("movq", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Packed(PackedOp op, Xmm dst, Xmm src) {
+    static const char *names[] = {"movdqa", "paddq", "psubq", "pmuludq", "pand", "por", "pxor", "addpd", "subpd",
+                                  "mulpd", "divpd"};
+    Instruction(names[(int) op], Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::PackedLoad(Xmm dst, Mem src) {
+    Instruction("movdqu", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::PackedStore(Mem dst, Xmm src) {
+    Instruction("movdqu", Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::PackedShift(ShiftOp op, Xmm reg, int count) {
+    Instruction(op == ShiftOp::Shl ? "psllq" : "psrlq", Immediate(count) + ", " + Operand(reg));
+}
+
+void AssemblyEmitter::Pshufd(Xmm dst, Xmm src, int order) {
+    Instruction("pshufd", Immediate(order) + ", " + Operand(src) + ", " + Operand(dst));
+}
+
+void AssemblyEmitter::Jmp(Label label) {
+    Instruction("jmp", LabelName(label));
+}
+
+void AssemblyEmitter::Jcc(Cond cond, Label label) {
+    Instruction(std::string("j") + Suffix(cond), LabelName(label));
+}
+
+void AssemblyEmitter::Call(Label label) {
+    Instruction("call", LabelName(label));
+}
+
+void AssemblyEmitter::Call(::Runtime function) {
+    Instruction("call", RuntimeName(function));
+}
+
+void AssemblyEmitter::Push(Reg reg) {
+    Instruction("pushq", Operand(reg));
+}
+
+void AssemblyEmitter::Pop(Reg reg) {
+    Instruction("popq", Operand(reg));
+}
+
+void AssemblyEmitter::Ret() {
+    Instruction("ret");
+}
+
+void AssemblyEmitter::RepStosq() {
+    Instruction("rep stosq");
+}
+
+void AssemblyEmitter::RepMovsq() {
+    Instruction("rep movsq");
+}
+
+void AssemblyEmitter::LoadString(Reg dst, int k, const std::string &text, Value) {
+    strings[k] = text;
+    Instruction("leaq", ".LK" + std::to_string(k) + "(%rip), " + Operand(dst));
+}
+
+void AssemblyEmitter::WriteRuntime(Label entry, int globals) {
+    auto stack_bytes = std::to_string(8 * STACK_SLOTS);
+    os << R"(
+	.globl	main
+main:
+	subq	$8, %rsp
+	leaq	rt_state(%rip), %rdi
+	leaq	rt_stack(%rip), %rax
+	movq	%rax, 0(%rdi)
+	leaq	rt_stack+)" << stack_bytes << R"((%rip), %rax
+	movq	%rax, 8(%rdi)
+	leaq	rt_memory(%rip), %rax
+	movq	%rax, 16(%rdi)
+	leaq	rt_memory+)" << stack_bytes << R"((%rip), %rax
+	movq	%rax, 24(%rdi)
+	call	)" << LabelName(entry) << R"(
+	xorl	%eax, %eax
+	addq	$8, %rsp
+	ret
+
+rt_write_int:
+	subq	$8, %rsp
+	movq	%rdi, %rsi
+	leaq	.Lformat_int(%rip), %rdi
+	xorl	%eax, %eax
+	call	printf@PLT
+	addq	$8, %rsp
+	ret
+
+rt_write_double:
+	subq	$8, %rsp
+	leaq	.Lformat_double(%rip), %rdi
+	movl	$1, %eax
+	call	printf@PLT
+	addq	$8, %rsp
+	ret
+
+rt_write_bool:
+	subq	$8, %rsp
+	leaq	.Lfalse(%rip), %rsi
+	leaq	.Ltrue(%rip), %rax
+	testq	%rdi, %rdi
+	cmovneq	%rax, %rsi
+	leaq	.Lformat_string(%rip), %rdi
+	xorl	%eax, %eax
+	call	printf@PLT
+	addq	$8, %rsp
+	ret
+
+rt_write_char:
+	subq	$8, %rsp
+	call	putchar@PLT
+	addq	$8, %rsp
+	ret
+
+rt_write_string:
+	subq	$8, %rsp
+	leaq	.Lempty(%rip), %rsi
+	testq	%rdi, %rdi
+	cmovneq	%rdi, %rsi
+	leaq	.Lformat_string(%rip), %rdi
+	xorl	%eax, %eax
+	call	printf@PLT
+	addq	$8, %rsp
+	ret
+
+rt_write_line:
+	subq	$8, %rsp
+	movl	$10, %edi
+	call	putchar@PLT
+	addq	$8, %rsp
+	ret
+
+rt_read_int:
+	leaq	.Lformat_int(%rip), %rdi
+	jmp	.Lread
+
+rt_read_double:
+	leaq	.Lformat_read_double(%rip), %rdi
+.Lread:
+	subq	$24, %rsp
+	movq	$0, (%rsp)
+	movq	%rsp, %rsi
+	xorl	%eax, %eax
+	call	scanf@PLT
+	movq	(%rsp), %rax
+	addq	$24, %rsp
+	ret
+
+rt_read_char:
+	subq	$24, %rsp
+	movq	$0, (%rsp)
+	movq	%rsp, %rsi
+	leaq	.Lformat_read_char(%rip), %rdi
+	xorl	%eax, %eax
+	call	scanf@PLT
+	movsbq	(%rsp), %rax
+	addq	$24, %rsp
+	ret
+
+# rt_read_string returns the next word of input as a new string, or null at
+# the end of input.
+rt_read_string:
+	pushq	%rbx
+	pushq	%r12
+	pushq	%r13
+	subq	$16, %rsp
+	movq	$0, (%rsp)
+	movq	%rsp, %rsi
+	leaq	.Lformat_read_string(%rip), %rdi
+	xorl	%eax, %eax
+	call	scanf@PLT
+	movq	(%rsp), %rbx
+	xorl	%eax, %eax
+	testq	%rbx, %rbx
+	je	.Lread_string_done
+	movq	%rbx, %rdi
+	call	strlen@PLT
+	movq	%rax, %r12
+	leaq	17(%rax), %rdi
+	call	malloc@PLT
+	movq	$0, (%rax)
+	movq	%r12, 8(%rax)
+	leaq	16(%rax), %r13
+	movq	%r13, %rdi
+	movq	%rbx, %rsi
+	leaq	1(%r12), %rdx
+	call	memcpy@PLT
+	movq	%rbx, %rdi
+	call	free@PLT
+	movq	%r13, %rdi
+	call	rt_keep
+	movq	%r13, %rax
+.Lread_string_done:
+	addq	$16, %rsp
+	popq	%r13
+	popq	%r12
+	popq	%rbx
+	ret
+
+# rt_concat(a, b) returns a new string holding a followed by b. Every string
+# keeps its length in the quadword before its chars; strings made at run
+# time keep the collector's mark in the quadword before that.
+rt_concat:
+	pushq	%rbx
+	pushq	%r12
+	pushq	%r13
+	pushq	%r14
+	pushq	%r15
+	leaq	.Lempty(%rip), %rax
+	testq	%rdi, %rdi
+	cmoveq	%rax, %rdi
+	testq	%rsi, %rsi
+	cmoveq	%rax, %rsi
+	movq	%rdi, %rbx
+	movq	%rsi, %r12
+	movq	-8(%rdi), %r13
+	movq	-8(%rsi), %r14
+	leaq	17(%r13,%r14), %rdi
+	call	malloc@PLT
+	movq	$0, (%rax)
+	leaq	(%r13,%r14), %rcx
+	movq	%rcx, 8(%rax)
+	leaq	16(%rax), %r15
+	movq	%r15, %rdi
+	movq	%rbx, %rsi
+	movq	%r13, %rdx
+	call	memcpy@PLT
+	leaq	(%r15,%r13), %rdi
+	movq	%r12, %rsi
+	leaq	1(%r14), %rdx
+	call	memcpy@PLT
+	movq	%r15, %rdi
+	call	rt_keep
+	movq	%r15, %rax
+	popq	%r15
+	popq	%r14
+	popq	%r13
+	popq	%r12
+	popq	%rbx
+	ret
+
+# rt_keep(s) adds a string just made to the table of rt_heap: its address,
+# count and capacity, then the bytes made since the last collection and the
+# bytes that one kept. A collection runs first once the bytes made outgrow
+# those kept.
+rt_keep:
+	pushq	%rbx
+	movq	%rdi, %rbx
+	movq	-8(%rdi), %rax
+	leaq	17(%rax), %rax
+	addq	rt_heap+24(%rip), %rax
+	movq	%rax, rt_heap+24(%rip)
+	movq	rt_heap+32(%rip), %rcx
+	movl	$)" << STRING_BYTES << R"(, %edx
+	cmpq	%rdx, %rcx
+	cmovbq	%rdx, %rcx
+	cmpq	%rcx, %rax
+	jbe	.Lkeep_add
+	call	rt_collect
+.Lkeep_add:
+	movq	rt_heap+8(%rip), %rax
+	cmpq	rt_heap+16(%rip), %rax
+	jb	.Lkeep_store
+	leaq	16(%rax,%rax), %rsi
+	movq	%rsi, rt_heap+16(%rip)
+	shlq	$3, %rsi
+	movq	rt_heap(%rip), %rdi
+	call	realloc@PLT
+	movq	%rax, rt_heap(%rip)
+	movq	rt_heap+8(%rip), %rax
+.Lkeep_store:
+	movq	rt_heap(%rip), %rcx
+	movq	%rbx, (%rcx,%rax,8)
+	incq	%rax
+	movq	%rax, rt_heap+8(%rip)
+	popq	%rbx
+	ret
+
+# rt_collect frees the strings nothing the program may still read points
+# to: the run-time state with the globals, the frames up to the tops
+# generated code recorded before calling in, and the native stack above the
+# stack pointer it recorded. The table is sorted for rt_mark to search.
+rt_collect:
+	pushq	%rbx
+	pushq	%r12
+	pushq	%r13
+	movq	rt_heap(%rip), %rdi
+	movq	rt_heap+8(%rip), %rsi
+	movl	$8, %edx
+	leaq	rt_order(%rip), %rcx
+	call	qsort@PLT
+	leaq	rt_state(%rip), %rdi
+	leaq	)" << 8 * (StateSlot::Globals + globals) << R"((%rdi), %rsi
+	call	rt_mark
+	leaq	rt_stack(%rip), %rdi
+	movq	rt_state+)" << 8 * StateSlot::StackTop << R"((%rip), %rsi
+	call	rt_mark
+	leaq	rt_memory(%rip), %rdi
+	movq	rt_state+)" << 8 * StateSlot::MemoryTop << R"((%rip), %rsi
+	call	rt_mark
+	movq	rt_state+)" << 8 * StateSlot::NativeTop << R"((%rip), %rdi
+	movq	rt_state+)" << 8 * StateSlot::StackLimit << R"((%rip), %rsi
+	addq	$)" << NATIVE_STACK_LIMIT << R"(, %rsi
+	call	rt_mark
+	movq	rt_heap(%rip), %rbx
+	xorl	%r12d, %r12d
+	xorl	%r13d, %r13d
+	movq	$0, rt_heap+32(%rip)
+.Lcollect_next:
+	cmpq	rt_heap+8(%rip), %r12
+	jae	.Lcollect_done
+	movq	(%rbx,%r12,8), %rdi
+	incq	%r12
+	cmpq	$0, -16(%rdi)
+	je	.Lcollect_free
+	movq	$0, -16(%rdi)
+	movq	%rdi, (%rbx,%r13,8)
+	incq	%r13
+	movq	-8(%rdi), %rax
+	leaq	17(%rax), %rax
+	addq	%rax, rt_heap+32(%rip)
+	jmp	.Lcollect_next
+.Lcollect_free:
+	subq	$16, %rdi
+	call	free@PLT
+	jmp	.Lcollect_next
+.Lcollect_done:
+	movq	%r13, rt_heap+8(%rip)
+	movq	$0, rt_heap+24(%rip)
+	popq	%r13
+	popq	%r12
+	popq	%rbx
+	ret
+
+# rt_mark(begin, end) marks the strings the quadwords from begin to end
+# point to.
+rt_mark:
+	pushq	%rbx
+	pushq	%r12
+	subq	$8, %rsp
+	movq	%rdi, %rbx
+	movq	%rsi, %r12
+.Lmark_next:
+	cmpq	%r12, %rbx
+	jae	.Lmark_done
+	movq	%rbx, %rdi
+	movq	rt_heap(%rip), %rsi
+	movq	rt_heap+8(%rip), %rdx
+	movl	$8, %ecx
+	leaq	rt_order(%rip), %r8
+	call	bsearch@PLT
+	testq	%rax, %rax
+	je	.Lmark_skip
+	movq	(%rax), %rax
+	movq	$1, -16(%rax)
+.Lmark_skip:
+	addq	$8, %rbx
+	jmp	.Lmark_next
+.Lmark_done:
+	addq	$8, %rsp
+	popq	%r12
+	popq	%rbx
+	ret
+
+# rt_order(a, b) orders the addresses a and b point to, for qsort and
+# bsearch.
+rt_order:
+	movq	(%rdi), %rdx
+	cmpq	(%rsi), %rdx
+	seta	%al
+	setb	%cl
+	movzbl	%al, %eax
+	movzbl	%cl, %ecx
+	subl	%ecx, %eax
+	ret
+
+rt_compare:
+	subq	$8, %rsp
+	leaq	.Lempty(%rip), %rax
+	testq	%rdi, %rdi
+	cmoveq	%rax, %rdi
+	testq	%rsi, %rsi
+	cmoveq	%rax, %rsi
+	call	strcmp@PLT
+	cltq
+	addq	$8, %rsp
+	ret
+
+# rt_parallel(kernel, operands, reduce) runs kernel(operands, begin, end)
+# over the count the operands start with, on up to 8 threads that take
+# chunks of elements in turn, and returns their results combined.
+rt_parallel:
+	pushq	%rbx
+	pushq	%r12
+	pushq	%r13
+	pushq	%r14
+	subq	$72, %rsp
+	movq	%rdi, rt_job(%rip)
+	movq	%rsi, rt_job+8(%rip)
+	movq	(%rsi), %rax
+	movq	%rax, rt_job+16(%rip)
+	movq	$0, rt_job+24(%rip)
+	movq	%rdx, rt_job+32(%rip)
+	cmpq	$)" << Kernel::kChunk << R"(, %rax
+	jg	.Lparallel_start
+	movq	%rax, %rdx
+	xorl	%esi, %esi
+	movq	rt_job+8(%rip), %rdi
+	call	*rt_job(%rip)
+	jmp	.Lparallel_done
+.Lparallel_start:
+	call	get_nprocs@PLT
+	cmpl	$8, %eax
+	movl	$8, %ecx
+	cmovgl	%ecx, %eax
+	leal	-1(%rax), %r12d
+	xorl	%r13d, %r13d
+.Lparallel_create:
+	cmpl	%r12d, %r13d
+	jge	.Lparallel_work
+	leaq	(%rsp,%r13,8), %rdi
+	xorl	%esi, %esi
+	leaq	rt_parallel_worker(%rip), %rdx
+	xorl	%ecx, %ecx
+	call	pthread_create@PLT
+	testl	%eax, %eax
+	jne	.Lparallel_work
+	incl	%r13d
+	jmp	.Lparallel_create
+.Lparallel_work:
+	call	rt_parallel_worker
+	movq	%rax, %rbx
+	xorl	%r14d, %r14d
+.Lparallel_join:
+	cmpl	%r13d, %r14d
+	jge	.Lparallel_joined
+	movq	(%rsp,%r14,8), %rdi
+	leaq	64(%rsp), %rsi
+	call	pthread_join@PLT
+	movq	%rbx, %rdi
+	movq	64(%rsp), %rsi
+	movq	rt_job+32(%rip), %rdx
+	call	rt_combine
+	movq	%rax, %rbx
+	incl	%r14d
+	jmp	.Lparallel_join
+.Lparallel_joined:
+	movq	%rbx, %rax
+.Lparallel_done:
+	addq	$72, %rsp
+	popq	%r14
+	popq	%r13
+	popq	%r12
+	popq	%rbx
+	ret
+
+rt_parallel_worker:
+	pushq	%rbx
+	pushq	%r12
+	subq	$8, %rsp
+	movq	$)" << Kernel::Identity(Kernel::Op::Add) << R"(, %rbx
+	movq	rt_job+32(%rip), %rax
+	cmpq	$)" << (int) Kernel::Op::Mul << R"(, %rax
+	movq	$)" << Kernel::Identity(Kernel::Op::Mul) << R"(, %rcx
+	cmoveq	%rcx, %rbx
+	cmpq	$)" << (int) Kernel::Op::And << R"(, %rax
+	movq	$)" << Kernel::Identity(Kernel::Op::And) << R"(, %rcx
+	cmoveq	%rcx, %rbx
+.Lparallel_next:
+	movl	$)" << Kernel::kChunk << R"(, %r12d
+	lock xaddq	%r12, rt_job+24(%rip)
+	movq	rt_job+16(%rip), %rdx
+	cmpq	%rdx, %r12
+	jge	.Lparallel_finished
+	leaq	)" << Kernel::kChunk << R"((%r12), %rax
+	cmpq	%rdx, %rax
+	cmovlq	%rax, %rdx
+	movq	%r12, %rsi
+	movq	rt_job+8(%rip), %rdi
+	call	*rt_job(%rip)
+	movq	%rbx, %rdi
+	movq	%rax, %rsi
+	movq	rt_job+32(%rip), %rdx
+	call	rt_combine
+	movq	%rax, %rbx
+	jmp	.Lparallel_next
+.Lparallel_finished:
+	movq	%rbx, %rax
+	addq	$8, %rsp
+	popq	%r12
+	popq	%rbx
+	ret
+
+rt_combine:
+	movq	%rdi, %rax
+	cmpq	$)" << (int) Kernel::Op::Mul << R"(, %rdx
+	je	.Lcombine_mul
+	cmpq	$)" << (int) Kernel::Op::And << R"(, %rdx
+	je	.Lcombine_and
+	cmpq	$)" << (int) Kernel::Op::Or << R"(, %rdx
+	je	.Lcombine_or
+	addq	%rsi, %rax
+	ret
+.Lcombine_mul:
+	imulq	%rsi, %rax
+	ret
+.Lcombine_and:
+	andq	%rsi, %rax
+	ret
+.Lcombine_or:
+	orq	%rsi, %rax
+	ret
+
+rt_error:
+	subq	$8, %rsp
+	leaq	.Lerrors(%rip), %rax
+	movq	(%rax,%rdx,8), %rcx
+	movl	%esi, %edx
+	movl	%edi, %esi
+	leaq	.Lformat_error(%rip), %rdi
+	xorl	%eax, %eax
+	call	printf@PLT
+	movl	$1, %edi
+	call	exit@PLT
+
+	.section	.rodata
+.Lformat_int:
+	.string	"%lld"
+.Lformat_double:
+	.string	"%g"
+.Lformat_string:
+	.string	"%s"
+.Lformat_read_double:
+	.string	"%lf"
+.Lformat_read_char:
+	.string	" %c"
+.Lformat_read_string:
+	.string	"%ms"
+.Lformat_error:
+	.string	"(%d, %d) %s\n"
+.Ltrue:
+	.string	"TRUE"
+.Lfalse:
+	.string	"FALSE"
+	.align	8
+	.quad	0, 0
+.Lempty:
+	.string	""
+)";
+    for (auto error: {RuntimeError::IndexOutOfRange, RuntimeError::DivisionByZero, RuntimeError::StackOverflow}) {
+        os << ".Lerror" << (int) error << ":\n\t.string\t" << Quote(RuntimeErrorMessage(error)) << "\n";
+    }
+    for (auto &[k, text]: strings) {
+        os << "\t.align\t8\n\t.quad\t0, " << text.size() << "\n"
+           << ".LK" << k << ":\n\t.string\t" << Quote(text) << "\n";
+    }
+    os << "\n\t.section\t.data.rel.ro\n\t.align\t8\n.Lerrors:\n";
+    for (auto error: {RuntimeError::IndexOutOfRange, RuntimeError::DivisionByZero, RuntimeError::StackOverflow}) {
+        os << "\t.quad\t.Lerror" << (int) error << "\n";
+    }
+    os << "\n\t.bss\n\t.align\t16\n"
+       << "rt_state:\n\t.zero\t" << 8 * (StateSlot::Globals + globals) << "\n"
+       << "rt_stack:\n\t.zero\t" << stack_bytes << "\n"
+       << "rt_memory:\n\t.zero\t" << stack_bytes << "\n"
+       << "rt_job:\n\t.zero\t40\n"
+       << "rt_heap:\n\t.zero\t40\n"
+       << "\n\t.section\t.note.GNU-stack,\"\",@progbits\n";
+}
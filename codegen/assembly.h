@@ -0,0 +1,133 @@
+#ifndef COMPILER_ASSEMBLY_H
+#define COMPILER_ASSEMBLY_H
+
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "x86.h"
+
+class Program;
+
+// Writes GNU assembler (AT&T syntax) for x86-64 System V. The output of
+// Assemble is a complete program: the generated code, a small run-time
+// library over libc and POSIX threads and a C main, ready for the system
+// compiler driver.
+class AssemblyEmitter : public X86Emitter {
+public:
+    explicit AssemblyEmitter(std::ostream &os) : os(os) {}
+
+    Label NewLabel() override;
+
+    void Bind(Label label) override;
+
+    void Comment(const std::string &text) override;
+
+    void Mov(Reg dst, Mem src) override;
+
+    void Mov(Mem dst, Reg src) override;
+
+    void Mov(Reg dst, Reg src) override;
+
+    void MovImm(Reg dst, long long imm) override;
+
+    void MovImm(Mem dst, int imm) override;
+
+    void Lea(Reg dst, Mem src) override;
+
+    void Lea(Reg dst, Label label) override;
+
+    void Alu(AluOp op, Reg dst, Mem src) override;
+
+    void Alu(AluOp op, Reg dst, Reg src) override;
+
+    void AluImm(AluOp op, Reg dst, int imm) override;
+
+    void AluImm(AluOp op, Mem dst, int imm) override;
+
+    void Imul(Reg dst, Mem src) override;
+
+    void Imul(Reg dst, Reg src) override;
+
+    void ImulImm(Reg dst, Reg src, int imm) override;
+
+    void ImulWide(Reg reg) override;
+
+    void Neg(Reg reg) override;
+
+    void Not(Reg reg) override;
+
+    void Shift(ShiftOp op, Reg reg) override;
+
+    void ShiftImm(ShiftOp op, Reg reg, int count) override;
+
+    void Cqo() override;
+
+    void Idiv(Reg reg) override;
+
+    void Test(Reg a, Reg b) override;
+
+    void Setcc(Cond cond, Reg reg) override;
+
+    void Movzx8(Reg dst, Reg src) override;
+
+    void Sse(SseOp op, Xmm dst, Mem src) override;
+
+    void Sse(SseOp op, Xmm dst, Xmm src) override;
+
+    void Cvtsi2sd(Xmm dst, Reg src) override;
+
+    void Movsd(Mem dst, Xmm src) override;
+
+    void Movq(Xmm dst, Reg src) override;
+
+    void Movq(Reg dst, Xmm src) override;
+
+    void Packed(PackedOp op, Xmm dst, Xmm src) override;
+
+    void PackedLoad(Xmm dst, Mem src) override;
+
+    void PackedStore(Mem dst, Xmm src) override;
+
+    void PackedShift(ShiftOp op, Xmm reg, int count) override;
+
+    void Pshufd(Xmm dst, Xmm src, int order) override;
+
+    void Jmp(Label label) override;
+
+    void Jcc(Cond cond, Label label) override;
+
+    void Call(Label label) override;
+
+    void Call(Runtime function) override;
+
+    void Push(Reg reg) override;
+
+    void Pop(Reg reg) override;
+
+    void Ret() override;
+
+    void RepStosq() override;
+
+    void RepMovsq() override;
+
+    void LoadString(Reg dst, int k, const std::string &text, Value value) override;
+
+    // Writes the whole program for the given bytecode.
+    static void Assemble(Program *program, std::ostream &os);
+
+private:
+    void Instruction(const std::string &mnemonic, const std::string &operands = "");
+
+    void WriteRuntime(Label entry, int globals);
+
+    std::ostream &os;
+    int labels = 0;
+    std::map<int, std::string> strings;
+};
+
+// Writes output.s and links it into the executable output with the system
+// C compiler. Returns the exit status of the compiler.
+int BuildExecutable(Program *program, const std::string &output);
+
+#endif //COMPILER_ASSEMBLY_H
@@ -0,0 +1,384 @@
+#include "encoder.h"
+
+#include <cstring>
+#include <stdexcept>
+
+void X86Encoder::Byte(int byte) {
+    code.push_back((uint8_t) byte);
+}
+
+void X86Encoder::Int32(int value) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    code.insert(code.end(), bytes, bytes + sizeof(bytes));
+}
+
+void X86Encoder::Int64(long long value) {
+    uint8_t bytes[8];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    code.insert(code.end(), bytes, bytes + sizeof(bytes));
+}
+
+void X86Encoder::Rex(bool w, int reg, int rm, bool force) {
+    int rex = 0x40 | (w ? 8 : 0) | ((reg >> 3) << 2) | (rm >> 3);
+    if (rex != 0x40 || force) {
+        Byte(rex);
+    }
+}
+
+void X86Encoder::ModRM(int reg, int rm) {
+    Byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// rsp and r12 as a base need a SIB byte, rbp and r13 cannot be encoded
+// without a displacement.
+void X86Encoder::ModRM(int reg, Mem mem) {
+    auto base = (int) mem.base & 7;
+    int mod = 2;
+    if (mem.disp == 0 && base != 5) {
+        mod = 0;
+    } else if (mem.disp >= -128 && mem.disp <= 127) {
+        mod = 1;
+    }
+    Byte(mod << 6 | (reg & 7) << 3 | base);
+    if (base == 4) {
+        Byte(0x24);
+    }
+    if (mod == 1) {
+        Byte(mem.disp);
+    } else if (mod == 2) {
+        Int32(mem.disp);
+    }
+}
+
+void X86Encoder::Op(int opcode, int reg, Mem mem) {
+    Rex(true, reg, (int) mem.base);
+    if (opcode > 0xFF) {
+        Byte(opcode >> 8);
+    }
+    Byte(opcode & 0xFF);
+    ModRM(reg, mem);
+}
+
+void X86Encoder::Op(int opcode, int reg, Reg rm) {
+    Rex(true, reg, (int) rm);
+    if (opcode > 0xFF) {
+        Byte(opcode >> 8);
+    }
+    Byte(opcode & 0xFF);
+    ModRM(reg, (int) rm);
+}
+
+void X86Encoder::Relative(Label label) {
+    relocations.push_back({code.size(), label});
+    Int32(0);
+}
+
+Label X86Encoder::NewLabel() {
+    labels.push_back(-1);
+    return (Label) labels.size() - 1;
+}
+
+void X86Encoder::Bind(Label label) {
+    labels[label] = (long long) code.size();
+}
+
+size_t X86Encoder::Offset(Label label) const {
+    return labels[label];
+}
+
+void X86Encoder::Mov(Reg dst, Mem src) {
+    Op(0x8B, (int) dst, src);
+}
+
+void X86Encoder::Mov(Mem dst, Reg src) {
+    Op(0x89, (int) src, dst);
+}
+
+void X86Encoder::Mov(Reg dst, Reg src) {
+    Op(0x89, (int) src, dst);
+}
+
+void X86Encoder::MovImm(Reg dst, long long imm) {
+    if (FitsInt32(imm)) {
+        Op(0xC7, 0, dst);
+        Int32((int) imm);
+    } else {
+        Rex(true, 0, (int) dst);
+        Byte(0xB8 + ((int) dst & 7));
+        Int64(imm);
+    }
+}
+
+void X86Encoder::MovImm(Mem dst, int imm) {
+    Op(0xC7, 0, dst);
+    Int32(imm);
+}
+
+void X86Encoder::Lea(Reg dst, Mem src) {
+    Op(0x8D, (int) dst, src);
+}
+
+void X86Encoder::Lea(Reg dst, Label label) {
+    Rex(true, (int) dst, 0);
+    Byte(0x8D);
+    Byte(0x05 | ((int) dst & 7) << 3);
+    Relative(label);
+}
+
+void X86Encoder::Alu(AluOp op, Reg dst, Mem src) {
+    Op((int) op * 8 + 3, (int) dst, src);
+}
+
+void X86Encoder::Alu(AluOp op, Reg dst, Reg src) {
+    Op((int) op * 8 + 1, (int) src, dst);
+}
+
+void X86Encoder::AluImm(AluOp op, Reg dst, int imm) {
+    if (imm >= -128 && imm <= 127) {
+        Op(0x83, (int) op, dst);
+        Byte(imm);
+    } else {
+        Op(0x81, (int) op, dst);
+        Int32(imm);
+    }
+}
+
+void X86Encoder::AluImm(AluOp op, Mem dst, int imm) {
+    if (imm >= -128 && imm <= 127) {
+        Op(0x83, (int) op, dst);
+        Byte(imm);
+    } else {
+        Op(0x81, (int) op, dst);
+        Int32(imm);
+    }
+}
+
+void X86Encoder::Imul(Reg dst, Mem src) {
+    Op(0x0FAF, (int) dst, src);
+}
+
+void X86Encoder::Imul(Reg dst, Reg src) {
+    Op(0x0FAF, (int) dst, src);
+}
+
+void X86Encoder::ImulImm(Reg dst, Reg src, int imm) {
+    if (imm >= -128 && imm <= 127) {
+        Op(0x6B, (int) dst, src);
+        Byte(imm);
+    } else {
+        Op(0x69, (int) dst, src);
+        Int32(imm);
+    }
+}
+
+void X86Encoder::ImulWide(Reg reg) {
+    Op(0xF7, 5, reg);
+}
+
+void X86Encoder::Neg(Reg reg) {
+    Op(0xF7, 3, reg);
+}
+
+void X86Encoder::Not(Reg reg) {
+    Op(0xF7, 2, reg);
+}
+
+void X86Encoder::Shift(ShiftOp op, Reg reg) {
+    Op(0xD3, (int) op, reg);
+}
+
+void X86Encoder::ShiftImm(ShiftOp op, Reg reg, int count) {
+    Op(0xC1, (int) op, reg);
+    Byte(count);
+}
+
+void X86Encoder::Cqo() {
+    Byte(0x48);
+    Byte(0x99);
+}
+
+void X86Encoder::Idiv(Reg reg) {
+    Op(0xF7, 7, reg);
+}
+
+void X86Encoder::Test(Reg a, Reg b) {
+    Op(0x85, (int) b, a);
+}
+
+// Without a REX prefix register numbers 4-7 name ah..bh instead of spl..dil.
+void X86Encoder::Setcc(Cond cond, Reg reg) {
+    Rex(false, 0, (int) reg, (int) reg >= 4);
+    Byte(0x0F);
+    Byte(0x90 + (int) cond);
+    ModRM(0, (int) reg);
+}
+
+void X86Encoder::Movzx8(Reg dst, Reg src) {
+    Op(0x0FB6, (int) dst, src);
+}
+
+void X86Encoder::Sse(SseOp op, Xmm dst, Mem src) {
+    static const int opcodes[] = {0x10, 0x58, 0x5C, 0x59, 0x5E, 0x2E, 0x2A};
+    Byte(op == SseOp::Ucomisd ? 0x66 : 0xF2);
+    Rex(op == SseOp::Cvtsi2sd, (int) dst, (int) src.base);
+    Byte(0x0F);
+    Byte(opcodes[(int) op]);
+    ModRM((int) dst, src);
+}
+
+void X86Encoder::Sse(SseOp op, Xmm dst, Xmm src) {
+    static const int opcodes[] = {0x28, 0x58, 0x5C, 0x59, 0x5E, 0x2E, 0x2A};
+    Byte(op == SseOp::Movsd || op == SseOp::Ucomisd ? 0x66 : 0xF2);
+    Rex(false, (int) dst, (int) src);
+    Byte(0x0F);
+    Byte(opcodes[(int) op]);
+    ModRM((int) dst, (int) src);
+}
+
+void X86Encoder::Cvtsi2sd(Xmm dst, Reg src) {
+    Byte(0xF2);
+    Rex(true, (int) dst, (int) src);
+    Byte(0x0F);
+    Byte(0x2A);
+    ModRM((int) dst, (int) src);
+}
+
+void X86Encoder::Movq(Xmm dst, Reg src) {
+    Byte(0x66);
+    Rex(true, (int) dst, (int) src);
+    Byte(0x0F);
+    Byte(0x6E);
+    ModRM((int) dst, (int) src);
+}
+
+void X86Encoder::Movq(Reg dst, Xmm src) {
+    Byte(0x66);
+    Rex(true, (int) src, (int) dst);
+    Byte(0x0F);
+    Byte(0x7E);
+    ModRM((int) src, (int) dst);
+}
+
+void X86Encoder::Movsd(Mem dst, Xmm src) {
+    Byte(0xF2);
+    Rex(false, (int) src, (int) dst.base);
+    Byte(0x0F);
+    Byte(0x11);
+    ModRM((int) src, dst);
+}
+
+void X86Encoder::Packed(PackedOp op, Xmm dst, Xmm src) {
+    static const int opcodes[] = {0x6F, 0xD4, 0xFB, 0xF4, 0xDB, 0xEB, 0xEF, 0x58, 0x5C, 0x59, 0x5E};
+    Byte(0x66);
+    Rex(false, (int) dst, (int) src);
+    Byte(0x0F);
+    Byte(opcodes[(int) op]);
+    ModRM((int) dst, (int) src);
+}
+
+void X86Encoder::PackedLoad(Xmm dst, Mem src) {
+    Byte(0xF3);
+    Rex(false, (int) dst, (int) src.base);
+    Byte(0x0F);
+    Byte(0x6F);
+    ModRM((int) dst, src);
+}
+
+void X86Encoder::PackedStore(Mem dst, Xmm src) {
+    Byte(0xF3);
+    Rex(false, (int) src, (int) dst.base);
+    Byte(0x0F);
+    Byte(0x7F);
+    ModRM((int) src, dst);
+}
+
+void X86Encoder::PackedShift(ShiftOp op, Xmm reg, int count) {
+    Byte(0x66);
+    Rex(false, 0, (int) reg);
+    Byte(0x0F);
+    Byte(0x73);
+    ModRM(op == ShiftOp::Shl ? 6 : 2, (int) reg);
+    Byte(count);
+}
+
+void X86Encoder::Pshufd(Xmm dst, Xmm src, int order) {
+    Byte(0x66);
+    Rex(false, (int) dst, (int) src);
+    Byte(0x0F);
+    Byte(0x70);
+    ModRM((int) dst, (int) src);
+    Byte(order);
+}
+
+void X86Encoder::Jmp(Label label) {
+    Byte(0xE9);
+    Relative(label);
+}
+
+void X86Encoder::Jcc(Cond cond, Label label) {
+    Byte(0x0F);
+    Byte(0x80 + (int) cond);
+    Relative(label);
+}
+
+void X86Encoder::Call(Label label) {
+    Byte(0xE8);
+    Relative(label);
+}
+
+void X86Encoder::Call(Runtime function) {
+    auto it = stubs.find(function);
+    if (it == stubs.end()) {
+        it = stubs.emplace(function, NewLabel()).first;
+    }
+    Call(it->second);
+}
+
+void X86Encoder::Push(Reg reg) {
+    Rex(false, 0, (int) reg);
+    Byte(0x50 + ((int) reg & 7));
+}
+
+void X86Encoder::Pop(Reg reg) {
+    Rex(false, 0, (int) reg);
+    Byte(0x58 + ((int) reg & 7));
+}
+
+void X86Encoder::Ret() {
+    Byte(0xC3);
+}
+
+void X86Encoder::RepStosq() {
+    Byte(0xF3);
+    Byte(0x48);
+    Byte(0xAB);
+}
+
+void X86Encoder::RepMovsq() {
+    Byte(0xF3);
+    Byte(0x48);
+    Byte(0xA5);
+}
+
+void X86Encoder::LoadString(Reg dst, int, const std::string &, Value value) {
+    MovImm(dst, value.i);
+}
+
+void X86Encoder::Link() {
+    for (auto &[function, label]: stubs) {
+        Bind(label);
+        // jmp *0(%rip) followed by the absolute address
+        Byte(0xFF);
+        Byte(0x25);
+        Int32(0);
+        Int64((long long) runtime[(int) function]);
+    }
+    for (auto &relocation: relocations) {
+        if (labels[relocation.label] < 0) {
+            throw std::logic_error("unbound label");
+        }
+        int relative = (int) (labels[relocation.label] - (long long) (relocation.offset + 4));
+        std::memcpy(code.data() + relocation.offset, &relative, sizeof(relative));
+    }
+}
@@ -0,0 +1,152 @@
+#ifndef COMPILER_ENCODER_H
+#define COMPILER_ENCODER_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "x86.h"
+
+// Encodes x86-64 machine code into a buffer. Jumps and calls between
+// routines are rel32 relocations resolved by Link; run-time functions are
+// reached through a table of indirect jumps appended to the code, so the
+// buffer can be placed anywhere.
+class X86Encoder : public X86Emitter {
+public:
+    explicit X86Encoder(const void *const *runtime) : runtime(runtime) {}
+
+    Label NewLabel() override;
+
+    void Bind(Label label) override;
+
+    void Comment(const std::string &) override {}
+
+    void Mov(Reg dst, Mem src) override;
+
+    void Mov(Mem dst, Reg src) override;
+
+    void Mov(Reg dst, Reg src) override;
+
+    void MovImm(Reg dst, long long imm) override;
+
+    void MovImm(Mem dst, int imm) override;
+
+    void Lea(Reg dst, Mem src) override;
+
+    void Lea(Reg dst, Label label) override;
+
+    void Alu(AluOp op, Reg dst, Mem src) override;
+
+    void Alu(AluOp op, Reg dst, Reg src) override;
+
+    void AluImm(AluOp op, Reg dst, int imm) override;
+
+    void AluImm(AluOp op, Mem dst, int imm) override;
+
+    void Imul(Reg dst, Mem src) override;
+
+    void Imul(Reg dst, Reg src) override;
+
+    void ImulImm(Reg dst, Reg src, int imm) override;
+
+    void ImulWide(Reg reg) override;
+
+    void Neg(Reg reg) override;
+
+    void Not(Reg reg) override;
+
+    void Shift(ShiftOp op, Reg reg) override;
+
+    void ShiftImm(ShiftOp op, Reg reg, int count) override;
+
+    void Cqo() override;
+
+    void Idiv(Reg reg) override;
+
+    void Test(Reg a, Reg b) override;
+
+    void Setcc(Cond cond, Reg reg) override;
+
+    void Movzx8(Reg dst, Reg src) override;
+
+    void Sse(SseOp op, Xmm dst, Mem src) override;
+
+    void Sse(SseOp op, Xmm dst, Xmm src) override;
+
+    void Cvtsi2sd(Xmm dst, Reg src) override;
+
+    void Movsd(Mem dst, Xmm src) override;
+
+    void Movq(Xmm dst, Reg src) override;
+
+    void Movq(Reg dst, Xmm src) override;
+
+    void Packed(PackedOp op, Xmm dst, Xmm src) override;
+
+    void PackedLoad(Xmm dst, Mem src) override;
+
+    void PackedStore(Mem dst, Xmm src) override;
+
+    void PackedShift(ShiftOp op, Xmm reg, int count) override;
+
+    void Pshufd(Xmm dst, Xmm src, int order) override;
+
+    void Jmp(Label label) override;
+
+    void Jcc(Cond cond, Label label) override;
+
+    void Call(Label label) override;
+
+    void Call(Runtime function) override;
+
+    void Push(Reg reg) override;
+
+    void Pop(Reg reg) override;
+
+    void Ret() override;
+
+    void RepStosq() override;
+
+    void RepMovsq() override;
+
+    void LoadString(Reg dst, int k, const std::string &text, Value value) override;
+
+    // Appends the run-time jump table and patches every relocation.
+    void Link();
+
+    [[nodiscard]] size_t Offset(Label label) const;
+
+    [[nodiscard]] const std::vector<uint8_t> &Code() const { return code; }
+
+private:
+    struct Relocation {
+        size_t offset;
+        Label label;
+    };
+
+    void Byte(int byte);
+
+    void Int32(int value);
+
+    void Int64(long long value);
+
+    void Rex(bool w, int reg, int rm, bool force = false);
+
+    void ModRM(int reg, int rm);
+
+    void ModRM(int reg, Mem mem);
+
+    void Op(int opcode, int reg, Mem mem);
+
+    void Op(int opcode, int reg, Reg rm);
+
+    void Relative(Label label);
+
+    const void *const *runtime;
+    std::vector<uint8_t> code;
+    std::vector<long long> labels;
+    std::vector<Relocation> relocations;
+    std::map<Runtime, Label> stubs;
+};
+
+#endif //COMPILER_ENCODER_H
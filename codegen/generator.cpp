@@ -0,0 +1,1098 @@
+#include "generator.h"
+
+#include <algorithm>
+
+Mem NativeGenerator::Slot(int slot) {
+    return {Reg::rbx, 8 * slot};
+}
+
+Mem NativeGenerator::Global(int index) {
+    return {Reg::r13, 8 * (StateSlot::Globals + index)};
+}
+
+Mem NativeGenerator::Home(int reg) const {
+    return Slot(allocation->Slot(reg));
+}
+
+Placement NativeGenerator::Use(int reg) const {
+    return allocation->Use(reg, current);
+}
+
+Placement NativeGenerator::Def(int reg) const {
+    return allocation->Def(reg, current);
+}
+
+Label NativeGenerator::Generate() {
+    for (auto &string: program->strings) {
+        strings.insert(&string);
+    }
+    for (auto &ins: program->code) {
+        if (ins.op == Opcode::JMP) {
+            Target(ins.a);
+        } else if (ins.op == Opcode::JZ || ins.op == Opcode::JNZ) {
+            Target(ins.b);
+        }
+    }
+    std::vector<int> order(program->functions.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = (int) i;
+        functions.push_back(emitter.NewLabel());
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return program->functions[a].entry < program->functions[b].entry;
+    });
+    std::vector<int> ends(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        ends[order[i]] = i + 1 < order.size() ? program->functions[order[i + 1]].entry : (int) program->code.size();
+    }
+    // Calls check the frame of the callee, so every function is allocated
+    // before any is emitted.
+    for (size_t i = 0; i < order.size(); ++i) {
+        allocations.emplace_back(program, (int) i, program->functions[i].entry, ends[i]);
+    }
+    for (size_t i = 0; i < program->kernels.size(); ++i) {
+        kernels.push_back(emitter.NewLabel());
+    }
+    for (auto index: order) {
+        Function(index, program->functions[index].entry, ends[index]);
+    }
+    for (size_t i = 0; i < program->kernels.size(); ++i) {
+        if (program->kernels[i].parallel) {
+            KernelFunction((int) i);
+        }
+    }
+
+    auto entry = emitter.NewLabel();
+    emitter.Comment("entry");
+    emitter.Bind(entry);
+    emitter.Push(Reg::rbx);
+    emitter.Push(Reg::r12);
+    emitter.Push(Reg::r13);
+    emitter.Mov(Reg::r13, Reg::rdi);
+    emitter.Lea(Reg::rax, {Reg::rsp, -NATIVE_STACK_LIMIT});
+    emitter.Mov({Reg::r13, 8 * StateSlot::StackLimit}, Reg::rax);
+    emitter.Mov(Reg::rdi, {Reg::r13, 8 * StateSlot::StackBase});
+    emitter.Mov(Reg::rsi, {Reg::r13, 8 * StateSlot::MemoryBase});
+    emitter.Call(functions[program->main]);
+    emitter.Pop(Reg::r13);
+    emitter.Pop(Reg::r12);
+    emitter.Pop(Reg::rbx);
+    emitter.Ret();
+    return entry;
+}
+
+// r14 and r15 are saved in pairs, which keeps the stack aligned for calls.
+void NativeGenerator::Function(int index, int begin, int end) {
+    function = &program->functions[index];
+    allocation = &allocations[index];
+    errors.clear();
+    edges.clear();
+    emitter.Comment("function " + function->name);
+    emitter.Bind(functions[index]);
+    emitter.Push(Reg::rbx);
+    emitter.Push(Reg::r12);
+    emitter.Push(Reg::rbp);
+    if (allocation->SavesExtra()) {
+        emitter.Push(Reg::r14);
+        emitter.Push(Reg::r15);
+    }
+    emitter.Mov(Reg::rbx, Reg::rdi);
+    emitter.Mov(Reg::r12, Reg::rsi);
+
+    auto zero = [&](Reg base, int from, int count) {
+        if (count <= 8) {
+            for (int i = 0; i < count; ++i) {
+                emitter.MovImm(Mem{base, 8 * (from + i)}, 0);
+            }
+            return;
+        }
+        emitter.Lea(Reg::rdi, {base, 8 * from});
+        emitter.MovImm(Reg::rcx, count);
+        emitter.Alu(AluOp::Xor, Reg::rax, Reg::rax);
+        emitter.RepStosq();
+    };
+    zero(Reg::rbx, function->params, allocation->frame - function->params);
+    zero(Reg::r12, 0, function->memory);
+    for (auto &placement: allocation->Cleared()) {
+        if (placement.kind == Placement::Gpr) {
+            emitter.Alu(AluOp::Xor, placement.gpr, placement.gpr);
+        } else {
+            emitter.Packed(PackedOp::Pxor, placement.xmm, placement.xmm);
+        }
+    }
+    Moves(allocation->Entry());
+
+    for (auto i = begin; i < end; ++i) {
+        Instruction(i);
+    }
+    for (auto &stub: edges) {
+        emitter.Bind(stub.label);
+        Moves(stub.moves);
+        emitter.Jmp(stub.target);
+    }
+    for (auto &stub: errors) {
+        emitter.Bind(stub.label);
+        emitter.MovImm(Reg::rdi, stub.pos.GetLine());
+        emitter.MovImm(Reg::rsi, stub.pos.GetColumn());
+        emitter.MovImm(Reg::rdx, (int) stub.error);
+        emitter.Call(Runtime::Error);
+    }
+}
+
+// Callers' frames end below this one. Values in rbp, r14 and r15 may be the
+// callers' too, so all three are recorded whether or not the function uses
+// them.
+void NativeGenerator::SaveRoots() {
+    emitter.Lea(Reg::rax, Slot(allocation->frame));
+    emitter.Mov({Reg::r13, 8 * StateSlot::StackTop}, Reg::rax);
+    emitter.Lea(Reg::rax, {Reg::r12, 8 * function->memory});
+    emitter.Mov({Reg::r13, 8 * StateSlot::MemoryTop}, Reg::rax);
+    emitter.Mov({Reg::r13, 8 * StateSlot::NativeTop}, Reg::rsp);
+    emitter.Mov({Reg::r13, 8 * StateSlot::SavedRbp}, Reg::rbp);
+    emitter.Mov({Reg::r13, 8 * StateSlot::SavedR14}, Reg::r14);
+    emitter.Mov({Reg::r13, 8 * StateSlot::SavedR15}, Reg::r15);
+}
+
+void NativeGenerator::Restore() {
+    if (allocation->SavesExtra()) {
+        emitter.Pop(Reg::r15);
+        emitter.Pop(Reg::r14);
+    }
+    emitter.Pop(Reg::rbp);
+    emitter.Pop(Reg::r12);
+    emitter.Pop(Reg::rbx);
+}
+
+void NativeGenerator::Epilogue() {
+    Restore();
+    emitter.Ret();
+}
+
+Label NativeGenerator::Error(RuntimeError error, int index) {
+    auto label = emitter.NewLabel();
+    errors.push_back({label, error, program->positions[index]});
+    return label;
+}
+
+Label NativeGenerator::Target(int instruction) {
+    auto it = targets.find(instruction);
+    if (it != targets.end()) {
+        return it->second;
+    }
+    return targets[instruction] = emitter.NewLabel();
+}
+
+void NativeGenerator::Compare(Cond cond) {
+    emitter.Setcc(cond, Reg::rax);
+    emitter.Movzx8(Reg::rax, Reg::rax);
+}
+
+void NativeGenerator::Flag(Cond cond, Placement dst) {
+    if (dst.kind == Placement::Gpr) {
+        emitter.Setcc(cond, dst.gpr);
+        emitter.Movzx8(dst.gpr, dst.gpr);
+    } else {
+        Compare(cond);
+        Store(dst, Reg::rax);
+    }
+}
+
+void NativeGenerator::Load(Reg dst, Placement src) {
+    switch (src.kind) {
+        case Placement::Gpr:
+            if (src.gpr != dst) {
+                emitter.Mov(dst, src.gpr);
+            }
+            break;
+        case Placement::Sse:
+            emitter.Movq(dst, src.xmm);
+            break;
+        default:
+            emitter.Mov(dst, Slot(src.slot));
+    }
+}
+
+void NativeGenerator::Load(Xmm dst, Placement src) {
+    switch (src.kind) {
+        case Placement::Gpr:
+            emitter.Movq(dst, src.gpr);
+            break;
+        case Placement::Sse:
+            if (src.xmm != dst) {
+                emitter.Sse(SseOp::Movsd, dst, src.xmm);
+            }
+            break;
+        default:
+            emitter.Sse(SseOp::Movsd, dst, Slot(src.slot));
+    }
+}
+
+void NativeGenerator::Store(Placement dst, Reg src) {
+    switch (dst.kind) {
+        case Placement::Gpr:
+            if (dst.gpr != src) {
+                emitter.Mov(dst.gpr, src);
+            }
+            break;
+        case Placement::Sse:
+            emitter.Movq(dst.xmm, src);
+            break;
+        default:
+            emitter.Mov(Slot(dst.slot), src);
+    }
+}
+
+void NativeGenerator::Store(Placement dst, Xmm src) {
+    switch (dst.kind) {
+        case Placement::Gpr:
+            emitter.Movq(dst.gpr, src);
+            break;
+        case Placement::Sse:
+            if (dst.xmm != src) {
+                emitter.Sse(SseOp::Movsd, dst.xmm, src);
+            }
+            break;
+        default:
+            emitter.Movsd(Slot(dst.slot), src);
+    }
+}
+
+void NativeGenerator::LoadFrom(Placement dst, Mem src) {
+    switch (dst.kind) {
+        case Placement::Gpr:
+            emitter.Mov(dst.gpr, src);
+            break;
+        case Placement::Sse:
+            emitter.Sse(SseOp::Movsd, dst.xmm, src);
+            break;
+        default:
+            emitter.Mov(Reg::rax, src);
+            emitter.Mov(Slot(dst.slot), Reg::rax);
+    }
+}
+
+void NativeGenerator::StoreTo(Mem dst, Placement src) {
+    switch (src.kind) {
+        case Placement::Gpr:
+            emitter.Mov(dst, src.gpr);
+            break;
+        case Placement::Sse:
+            emitter.Movsd(dst, src.xmm);
+            break;
+        default:
+            emitter.Mov(Reg::rcx, Slot(src.slot));
+            emitter.Mov(dst, Reg::rcx);
+    }
+}
+
+void NativeGenerator::Move(Placement dst, Placement src) {
+    if (dst == src) {
+        return;
+    }
+    switch (dst.kind) {
+        case Placement::Gpr:
+            Load(dst.gpr, src);
+            break;
+        case Placement::Sse:
+            Load(dst.xmm, src);
+            break;
+        default:
+            if (src.kind == Placement::Memory) {
+                emitter.Mov(Reg::rax, Slot(src.slot));
+                emitter.Mov(Slot(dst.slot), Reg::rax);
+            } else {
+                StoreTo(Slot(dst.slot), src);
+            }
+    }
+}
+
+void NativeGenerator::Moves(std::vector<LinearScan::Move> moves) {
+    auto read = [&](const Placement &placement) {
+        return std::any_of(moves.begin(), moves.end(), [&](const LinearScan::Move &move) {
+            return move.from == placement;
+        });
+    };
+    while (!moves.empty()) {
+        auto ready = std::find_if(moves.begin(), moves.end(), [&](const LinearScan::Move &move) {
+            return !read(move.to);
+        });
+        if (ready != moves.end()) {
+            Move(ready->to, ready->from);
+            moves.erase(ready);
+            continue;
+        }
+        // Every destination is still to be read: the moves go round a cycle
+        // of registers of one class.
+        auto blocked = moves.front().to;
+        Placement scratch;
+        scratch.kind = blocked.kind == Placement::Sse ? Placement::Sse : Placement::Gpr;
+        Move(scratch, blocked);
+        for (auto &move: moves) {
+            if (move.from == blocked) {
+                move.from = scratch;
+            }
+        }
+    }
+}
+
+// Registers read by integer instructions are never kept in xmm registers,
+// nor those read by double instructions in general ones.
+void NativeGenerator::Alu(AluOp op, Reg dst, Placement src) {
+    if (src.kind == Placement::Gpr) {
+        emitter.Alu(op, dst, src.gpr);
+    } else {
+        emitter.Alu(op, dst, Slot(src.slot));
+    }
+}
+
+void NativeGenerator::Imul(Reg dst, Placement src) {
+    if (src.kind == Placement::Gpr) {
+        emitter.Imul(dst, src.gpr);
+    } else {
+        emitter.Imul(dst, Slot(src.slot));
+    }
+}
+
+void NativeGenerator::Sse(SseOp op, Xmm dst, Placement src) {
+    if (src.kind == Placement::Sse) {
+        emitter.Sse(op, dst, src.xmm);
+    } else {
+        emitter.Sse(op, dst, Slot(src.slot));
+    }
+}
+
+static const Reg kStreamRegs[] = {Reg::rsi, Reg::rdi, Reg::r8, Reg::r9, Reg::r10, Reg::r11};
+
+void NativeGenerator::Combine(Kernel::Op reduce, Mem operand) {
+    switch (reduce) {
+        case Kernel::Op::Mul:
+            emitter.Imul(Reg::rax, operand);
+            break;
+        case Kernel::Op::And:
+            emitter.Alu(AluOp::And, Reg::rax, operand);
+            break;
+        case Kernel::Op::Or:
+            emitter.Alu(AluOp::Or, Reg::rax, operand);
+            break;
+        default:
+            emitter.Alu(AluOp::Add, Reg::rax, operand);
+    }
+}
+
+// Runs the kernel on pairs of elements in the two lanes of the xmm
+// registers Kernel::Registers assigns, then on the last element of an odd
+// count in the low lanes alone. The streams advance in rsi, rdi and r8-r11
+// while rcx holds the count and rdx counts the pairs down; xmm5 reduces the
+// pairs, xmm6 and xmm7 hold temporaries. The reduction is left in rax, and
+// the lanes meet below the stack pointer, in the red zone.
+void NativeGenerator::KernelLoop(const Kernel &kernel, const std::function<Mem(int)> &param) {
+    std::vector<int> registers;
+    kernel.Registers(registers);
+    auto xmm = [&](int node) { return (Xmm) registers[node]; };
+
+    for (size_t i = 0; i < kernel.nodes.size(); ++i) {
+        if (kernel.nodes[i].op == Kernel::Op::Param) {
+            emitter.Sse(SseOp::Movsd, xmm((int) i), param(kernel.nodes[i].a));
+            emitter.Pshufd(xmm((int) i), xmm((int) i), 0x44);
+        }
+    }
+    if (kernel.reduction >= 0) {
+        emitter.MovImm(Mem{Reg::rsp, -8}, (int) Kernel::Identity(kernel.reduce));
+        emitter.Sse(SseOp::Movsd, Xmm::xmm5, {Reg::rsp, -8});
+        emitter.Pshufd(Xmm::xmm5, Xmm::xmm5, 0x44);
+    }
+
+    auto binary = [&](PackedOp op, bool commutative, Xmm d, Xmm a, Xmm b) {
+        if (d == b && d != a) {
+            if (commutative) {
+                emitter.Packed(op, d, a);
+                return;
+            }
+            emitter.Packed(PackedOp::Movdqa, Xmm::xmm7, b);
+            b = Xmm::xmm7;
+        }
+        if (d != a) {
+            emitter.Packed(PackedOp::Movdqa, d, a);
+        }
+        emitter.Packed(op, d, b);
+    };
+    // The low 64 bits of a * b from the 32-bit halves: lo * lo plus the
+    // cross products shifted up.
+    auto multiply = [&](Xmm d, Xmm a, Xmm b) {
+        emitter.Packed(PackedOp::Movdqa, Xmm::xmm6, a);
+        emitter.PackedShift(ShiftOp::Shr, Xmm::xmm6, 32);
+        emitter.Packed(PackedOp::Pmuludq, Xmm::xmm6, b);
+        emitter.Packed(PackedOp::Movdqa, Xmm::xmm7, b);
+        emitter.PackedShift(ShiftOp::Shr, Xmm::xmm7, 32);
+        emitter.Packed(PackedOp::Pmuludq, Xmm::xmm7, a);
+        emitter.Packed(PackedOp::Paddq, Xmm::xmm6, Xmm::xmm7);
+        emitter.PackedShift(ShiftOp::Shl, Xmm::xmm6, 32);
+        emitter.Packed(PackedOp::Movdqa, Xmm::xmm7, a);
+        emitter.Packed(PackedOp::Pmuludq, Xmm::xmm7, b);
+        emitter.Packed(PackedOp::Paddq, Xmm::xmm7, Xmm::xmm6);
+        emitter.Packed(PackedOp::Movdqa, d, Xmm::xmm7);
+    };
+    auto body = [&](bool pair) {
+        for (size_t i = 0; i < kernel.nodes.size(); ++i) {
+            auto &node = kernel.nodes[i];
+            auto d = xmm((int) i);
+            switch (node.op) {
+                case Kernel::Op::Load:
+                    if (pair) {
+                        emitter.PackedLoad(d, {kStreamRegs[node.a]});
+                    } else {
+                        emitter.Sse(SseOp::Movsd, d, {kStreamRegs[node.a]});
+                    }
+                    break;
+                case Kernel::Op::Store:
+                    if (pair) {
+                        emitter.PackedStore({kStreamRegs[node.a]}, xmm(node.b));
+                    } else {
+                        emitter.Movsd({kStreamRegs[node.a]}, xmm(node.b));
+                    }
+                    break;
+                case Kernel::Op::Param:
+                    break;
+                case Kernel::Op::Neg:
+                    emitter.Packed(PackedOp::Movdqa, Xmm::xmm7, xmm(node.a));
+                    emitter.Packed(PackedOp::Pxor, d, d);
+                    emitter.Packed(PackedOp::Psubq, d, Xmm::xmm7);
+                    break;
+                case Kernel::Op::Mul:
+                    multiply(d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::Add:
+                    binary(PackedOp::Paddq, true, d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::Sub:
+                    binary(PackedOp::Psubq, false, d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::And:
+                    binary(PackedOp::Pand, true, d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::Or:
+                    binary(PackedOp::Por, true, d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::Xor:
+                    binary(PackedOp::Pxor, true, d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::FAdd:
+                    binary(PackedOp::Addpd, true, d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::FSub:
+                    binary(PackedOp::Subpd, false, d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::FMul:
+                    binary(PackedOp::Mulpd, true, d, xmm(node.a), xmm(node.b));
+                    break;
+                case Kernel::Op::FDiv:
+                    binary(PackedOp::Divpd, false, d, xmm(node.a), xmm(node.b));
+                    break;
+            }
+        }
+        if (kernel.reduction < 0) {
+            return;
+        }
+        auto value = xmm(kernel.reduction);
+        if (!pair) {
+            emitter.Movsd({Reg::rsp, -8}, value);
+            Combine(kernel.reduce, {Reg::rsp, -8});
+        } else if (kernel.reduce == Kernel::Op::Mul) {
+            multiply(Xmm::xmm5, Xmm::xmm5, value);
+        } else {
+            auto op = kernel.reduce == Kernel::Op::And ? PackedOp::Pand
+                    : kernel.reduce == Kernel::Op::Or ? PackedOp::Por : PackedOp::Paddq;
+            emitter.Packed(op, Xmm::xmm5, value);
+        }
+    };
+
+    auto loop = emitter.NewLabel();
+    auto tail = emitter.NewLabel();
+    auto done = emitter.NewLabel();
+    emitter.Mov(Reg::rdx, Reg::rcx);
+    emitter.ShiftImm(ShiftOp::Shr, Reg::rdx, 1);
+    emitter.Test(Reg::rdx, Reg::rdx);
+    emitter.Jcc(Cond::E, tail);
+    emitter.Bind(loop);
+    body(true);
+    for (int i = 0; i < kernel.streams; ++i) {
+        emitter.AluImm(AluOp::Add, kStreamRegs[i], 16);
+    }
+    emitter.AluImm(AluOp::Sub, Reg::rdx, 1);
+    emitter.Jcc(Cond::NE, loop);
+    emitter.Bind(tail);
+    // The lanes are combined before the last element of an odd count joins
+    // them.
+    if (kernel.reduction >= 0) {
+        emitter.PackedStore({Reg::rsp, -16}, Xmm::xmm5);
+        emitter.Mov(Reg::rax, {Reg::rsp, -16});
+        Combine(kernel.reduce, {Reg::rsp, -8});
+    }
+    emitter.AluImm(AluOp::And, Reg::rcx, 1);
+    emitter.Jcc(Cond::E, done);
+    body(false);
+    emitter.Bind(done);
+}
+
+// Parallel kernels are functions of the operands in rdi and the elements
+// from rsi to rdx the run time calls on several threads.
+void NativeGenerator::Vector(int index) {
+    auto &ins = program->code[index];
+    auto &kernel = program->kernels[ins.b];
+    auto params = ins.a + 1 + kernel.streams;
+    if (kernel.parallel) {
+        emitter.Lea(Reg::rdi, kernels[ins.b]);
+        emitter.Lea(Reg::rsi, Home(ins.a));
+        emitter.MovImm(Reg::rdx, (int) kernel.reduce);
+        emitter.Call(Runtime::Parallel);
+    } else {
+        emitter.Mov(Reg::rcx, Home(ins.a));
+        for (int i = 0; i < kernel.streams; ++i) {
+            emitter.Mov(kStreamRegs[i], Home(ins.a + 1 + i));
+        }
+        KernelLoop(kernel, [&](int param) { return Home(params + param); });
+    }
+    if (kernel.reduction >= 0) {
+        Combine(kernel.reduce, Home(params + kernel.params));
+        emitter.Mov(Home(ins.a), Reg::rax);
+    }
+}
+
+void NativeGenerator::KernelFunction(int index) {
+    auto &kernel = program->kernels[index];
+    emitter.Comment("kernel " + std::to_string(index));
+    emitter.Bind(kernels[index]);
+    emitter.Mov(Reg::rax, Reg::rdi);
+    emitter.Mov(Reg::rcx, Reg::rdx);
+    emitter.Alu(AluOp::Sub, Reg::rcx, Reg::rsi);
+    emitter.Mov(Reg::rdx, Reg::rsi);
+    emitter.ShiftImm(ShiftOp::Shl, Reg::rdx, 3);
+    for (int i = 0; i < kernel.streams; ++i) {
+        emitter.Mov(kStreamRegs[i], {Reg::rax, 8 * (1 + i)});
+        emitter.Alu(AluOp::Add, kStreamRegs[i], Reg::rdx);
+    }
+    KernelLoop(kernel, [&](int param) { return Mem{Reg::rax, 8 * (1 + kernel.streams + param)}; });
+    emitter.Ret();
+}
+
+void NativeGenerator::Instruction(int index) {
+    auto &ins = program->code[index];
+    current = index;
+    if (targets.count(index)) {
+        emitter.Bind(targets[index]);
+    }
+    emitter.Comment(OpcodeName(ins.op));
+    Moves(allocation->Before(index));
+
+    // The general register a result is computed in: its own, or rax.
+    auto into = [&](Placement dst) {
+        return dst.kind == Placement::Gpr ? dst.gpr : Reg::rax;
+    };
+    // A result is computed in place unless that would overwrite the right
+    // operand before it is read.
+    auto binary = [&](AluOp op, bool commutative) {
+        auto dst = Def(ins.a), left = Use(ins.b), right = Use(ins.c);
+        if (dst.kind == Placement::Gpr && dst == right && commutative) {
+            Alu(op, dst.gpr, left);
+        } else if (dst.kind == Placement::Gpr && dst != right) {
+            Load(dst.gpr, left);
+            Alu(op, dst.gpr, right);
+        } else {
+            Load(Reg::rax, left);
+            Alu(op, Reg::rax, right);
+            Store(dst, Reg::rax);
+        }
+    };
+    auto binary_double = [&](SseOp op) {
+        auto dst = Def(ins.a), left = Use(ins.b), right = Use(ins.c);
+        auto result = dst.kind == Placement::Sse && dst != right ? dst.xmm : Xmm::xmm0;
+        Load(result, left);
+        Sse(op, result, right);
+        Store(dst, result);
+    };
+    auto compare = [&](Cond cond) {
+        auto left = Use(ins.b);
+        if (left.kind != Placement::Gpr) {
+            Load(Reg::rax, left);
+            left.kind = Placement::Gpr;
+            left.gpr = Reg::rax;
+        }
+        Alu(AluOp::Cmp, left.gpr, Use(ins.c));
+        Flag(cond, Def(ins.a));
+    };
+    // Unordered operands leave every ordered comparison false, so a < b is
+    // tested as b > a.
+    auto compare_double = [&](Cond cond, bool swap) {
+        Load(Xmm::xmm0, Use(swap ? ins.c : ins.b));
+        Sse(SseOp::Ucomisd, Xmm::xmm0, Use(swap ? ins.b : ins.c));
+        Flag(cond, Def(ins.a));
+    };
+    auto compare_string = [&](Cond cond) {
+        Load(Reg::rdi, Use(ins.b));
+        Load(Reg::rsi, Use(ins.c));
+        emitter.Call(Runtime::Compare);
+        emitter.AluImm(AluOp::Cmp, Reg::rax, 0);
+        Flag(cond, Def(ins.a));
+    };
+    auto immediate = [&](Reg reg, long long value, AluOp op) {
+        if (FitsInt32(value)) {
+            emitter.AluImm(op, reg, (int) value);
+        } else {
+            emitter.MovImm(Reg::rcx, value);
+            emitter.Alu(op, reg, Reg::rcx);
+        }
+    };
+    auto division = [&](bool remainder) {
+        auto divide = emitter.NewLabel();
+        auto done = emitter.NewLabel();
+        Load(Reg::rcx, Use(ins.c));
+        emitter.Test(Reg::rcx, Reg::rcx);
+        emitter.Jcc(Cond::E, Error(RuntimeError::DivisionByZero, index));
+        emitter.AluImm(AluOp::Cmp, Reg::rcx, -1);
+        emitter.Jcc(Cond::NE, divide);
+        if (remainder) {
+            emitter.Alu(AluOp::Xor, Reg::rax, Reg::rax);
+        } else {
+            Load(Reg::rax, Use(ins.b));
+            emitter.Neg(Reg::rax);
+        }
+        emitter.Jmp(done);
+        emitter.Bind(divide);
+        Load(Reg::rax, Use(ins.b));
+        emitter.Cqo();
+        emitter.Idiv(Reg::rcx);
+        if (remainder) {
+            emitter.Mov(Reg::rax, Reg::rdx);
+        }
+        emitter.Bind(done);
+        Store(Def(ins.a), Reg::rax);
+    };
+    // The sequence Quotient runs in the vm: the high half of the product
+    // with the magic multiplier, or a biased shift for a power of two, and
+    // one more for a negative dividend.
+    auto constant_division = [&](bool remainder) {
+        auto &divisor = program->divisors[ins.c];
+        Load(Reg::rsi, Use(ins.b));
+        emitter.Mov(Reg::rdx, Reg::rsi);
+        if (divisor.multiplier != 0) {
+            emitter.MovImm(Reg::rax, divisor.multiplier);
+            emitter.ImulWide(Reg::rsi);
+            if (divisor.multiplier < 0) {
+                emitter.Alu(AluOp::Add, Reg::rdx, Reg::rsi);
+            }
+            if (divisor.shift != 0) {
+                emitter.ShiftImm(ShiftOp::Sar, Reg::rdx, divisor.shift);
+            }
+            emitter.Mov(Reg::rax, Reg::rsi);
+            emitter.ShiftImm(ShiftOp::Shr, Reg::rax, 63);
+            emitter.Alu(AluOp::Add, Reg::rdx, Reg::rax);
+        } else if (divisor.shift != 0) {
+            emitter.Mov(Reg::rax, Reg::rsi);
+            emitter.ShiftImm(ShiftOp::Sar, Reg::rax, 63);
+            emitter.ShiftImm(ShiftOp::Shr, Reg::rax, 64 - divisor.shift);
+            emitter.Alu(AluOp::Add, Reg::rdx, Reg::rax);
+            emitter.ShiftImm(ShiftOp::Sar, Reg::rdx, divisor.shift);
+        }
+        if (divisor.divisor < 0) {
+            emitter.Neg(Reg::rdx);
+        }
+        if (remainder) {
+            emitter.MovImm(Reg::rax, divisor.divisor);
+            emitter.Imul(Reg::rdx, Reg::rax);
+            emitter.Mov(Reg::rax, Reg::rsi);
+            emitter.Alu(AluOp::Sub, Reg::rax, Reg::rdx);
+            Store(Def(ins.a), Reg::rax);
+        } else {
+            Store(Def(ins.a), Reg::rdx);
+        }
+    };
+    auto shift = [&](ShiftOp op) {
+        Load(Reg::rcx, Use(ins.c));
+        Load(Reg::rax, Use(ins.b));
+        emitter.Shift(op, Reg::rax);
+        Store(Def(ins.a), Reg::rax);
+    };
+    auto unary = [&](const std::function<void(Reg)> &op) {
+        auto dst = Def(ins.a);
+        auto result = into(dst);
+        Load(result, Use(ins.b));
+        op(result);
+        Store(dst, result);
+    };
+    // The base register of an address in register reg.
+    auto base = [&](int reg) {
+        auto pointer = Use(reg);
+        if (pointer.kind == Placement::Gpr) {
+            return pointer.gpr;
+        }
+        Load(Reg::rax, pointer);
+        return Reg::rax;
+    };
+    auto write = [&](Runtime runtime) {
+        Load(Reg::rdi, Use(ins.a));
+        emitter.Call(runtime);
+    };
+    auto read = [&](Runtime runtime) {
+        emitter.Call(runtime);
+        Store(Def(ins.a), Reg::rax);
+    };
+
+    switch (ins.op) {
+        case Opcode::MOVE:
+            Move(Def(ins.a), Use(ins.b));
+            break;
+        case Opcode::LOADK: {
+            auto constant = program->constants[ins.b];
+            auto dst = Def(ins.a);
+            if (strings.count(constant.s)) {
+                emitter.LoadString(into(dst), ins.b, *constant.s, constant);
+                Store(dst, into(dst));
+            } else if (dst.kind == Placement::Gpr) {
+                emitter.MovImm(dst.gpr, constant.i);
+            } else if (dst.kind == Placement::Sse && constant.i == 0) {
+                emitter.Packed(PackedOp::Pxor, dst.xmm, dst.xmm);
+            } else if (dst.kind == Placement::Memory && FitsInt32(constant.i)) {
+                emitter.MovImm(Slot(dst.slot), (int) constant.i);
+            } else {
+                emitter.MovImm(Reg::rax, constant.i);
+                Store(dst, Reg::rax);
+            }
+            break;
+        }
+        case Opcode::LOADG:
+            LoadFrom(Def(ins.a), Global(ins.b));
+            break;
+        case Opcode::STOREG:
+            StoreTo(Global(ins.a), Use(ins.b));
+            break;
+        case Opcode::LOADL:
+            LoadFrom(Def(ins.a), {Reg::r12, 8 * ins.b});
+            break;
+        case Opcode::STOREL:
+            StoreTo({Reg::r12, 8 * ins.a}, Use(ins.b));
+            break;
+        case Opcode::ADDRG: {
+            auto dst = Def(ins.a);
+            emitter.Lea(into(dst), Global(ins.b));
+            Store(dst, into(dst));
+            break;
+        }
+        case Opcode::ADDRL: {
+            auto dst = Def(ins.a);
+            emitter.Lea(into(dst), {Reg::r12, 8 * ins.b});
+            Store(dst, into(dst));
+            break;
+        }
+        case Opcode::LOAD:
+            LoadFrom(Def(ins.a), {base(ins.b), 8 * ins.c});
+            break;
+        case Opcode::STORE:
+            StoreTo({base(ins.a), 8 * ins.b}, Use(ins.c));
+            break;
+        case Opcode::ADDP:
+            unary([&](Reg reg) { emitter.AluImm(AluOp::Add, reg, 8 * ins.c); });
+            break;
+        case Opcode::INDEX:
+        case Opcode::INDEXU: {
+            auto &array = program->arrays[ins.d];
+            auto dst = Def(ins.a);
+            auto result = dst.kind == Placement::Gpr && dst != Use(ins.b) ? dst.gpr : Reg::rax;
+            Load(result, Use(ins.c));
+            if (array.low != 0) {
+                immediate(result, array.low, AluOp::Sub);
+            }
+            if (ins.op == Opcode::INDEX) {
+                immediate(result, array.count, AluOp::Cmp);
+                emitter.Jcc(Cond::AE, Error(RuntimeError::IndexOutOfRange, index));
+            }
+            if (FitsInt32(8 * array.stride)) {
+                emitter.ImulImm(result, result, (int) (8 * array.stride));
+            } else {
+                emitter.MovImm(Reg::rcx, 8 * array.stride);
+                emitter.Imul(result, Reg::rcx);
+            }
+            Alu(AluOp::Add, result, Use(ins.b));
+            Store(dst, result);
+            break;
+        }
+        case Opcode::COPY:
+            Load(Reg::rsi, Use(ins.b));
+            Load(Reg::rdi, Use(ins.a));
+            emitter.MovImm(Reg::rcx, ins.c);
+            emitter.RepMovsq();
+            break;
+        case Opcode::ADDI:
+            binary(AluOp::Add, true);
+            break;
+        case Opcode::SUBI:
+            binary(AluOp::Sub, false);
+            break;
+        case Opcode::MULI: {
+            auto dst = Def(ins.a), left = Use(ins.b), right = Use(ins.c);
+            auto result = dst.kind == Placement::Gpr && dst != right ? dst.gpr : Reg::rax;
+            Load(result, left);
+            Imul(result, right);
+            Store(dst, result);
+            break;
+        }
+        case Opcode::DIVI:
+            division(false);
+            break;
+        case Opcode::MODI:
+            division(true);
+            break;
+        case Opcode::SHLI:
+            shift(ShiftOp::Shl);
+            break;
+        case Opcode::SHRI:
+            shift(ShiftOp::Shr);
+            break;
+        case Opcode::ANDI:
+            binary(AluOp::And, true);
+            break;
+        case Opcode::ORI:
+            binary(AluOp::Or, true);
+            break;
+        case Opcode::XORI:
+            binary(AluOp::Xor, true);
+            break;
+        case Opcode::NEGI:
+            unary([&](Reg reg) { emitter.Neg(reg); });
+            break;
+        case Opcode::NOTI:
+            unary([&](Reg reg) { emitter.Not(reg); });
+            break;
+        case Opcode::DIVKI:
+            constant_division(false);
+            break;
+        case Opcode::MODKI:
+            constant_division(true);
+            break;
+        case Opcode::ADDKI: {
+            auto dst = Def(ins.a), src = Use(ins.b);
+            if (dst.kind == Placement::Gpr && src.kind == Placement::Gpr && dst != src) {
+                emitter.Lea(dst.gpr, {src.gpr, ins.c});
+            } else {
+                unary([&](Reg reg) { emitter.AluImm(AluOp::Add, reg, ins.c); });
+            }
+            break;
+        }
+        case Opcode::ADDD:
+            binary_double(SseOp::Addsd);
+            break;
+        case Opcode::SUBD:
+            binary_double(SseOp::Subsd);
+            break;
+        case Opcode::MULD:
+            binary_double(SseOp::Mulsd);
+            break;
+        case Opcode::DIVD:
+            binary_double(SseOp::Divsd);
+            break;
+        case Opcode::NEGD:
+            Load(Reg::rax, Use(ins.b));
+            emitter.MovImm(Reg::rcx, (long long) (1ULL << 63));
+            emitter.Alu(AluOp::Xor, Reg::rax, Reg::rcx);
+            Store(Def(ins.a), Reg::rax);
+            break;
+        case Opcode::ITOD: {
+            auto dst = Def(ins.a), src = Use(ins.b);
+            auto result = dst.kind == Placement::Sse ? dst.xmm : Xmm::xmm0;
+            if (src.kind == Placement::Gpr) {
+                emitter.Cvtsi2sd(result, src.gpr);
+            } else {
+                emitter.Sse(SseOp::Cvtsi2sd, result, Slot(src.slot));
+            }
+            Store(dst, result);
+            break;
+        }
+        case Opcode::NOTB: {
+            auto src = Use(ins.b);
+            if (src.kind == Placement::Gpr) {
+                emitter.Test(src.gpr, src.gpr);
+            } else {
+                emitter.AluImm(AluOp::Cmp, Slot(src.slot), 0);
+            }
+            Flag(Cond::E, Def(ins.a));
+            break;
+        }
+        case Opcode::CONCAT:
+            SaveRoots();
+            Load(Reg::rdi, Use(ins.b));
+            Load(Reg::rsi, Use(ins.c));
+            emitter.Call(Runtime::Concat);
+            Store(Def(ins.a), Reg::rax);
+            break;
+        case Opcode::EQI:
+            compare(Cond::E);
+            break;
+        case Opcode::NEI:
+            compare(Cond::NE);
+            break;
+        case Opcode::LTI:
+            compare(Cond::L);
+            break;
+        case Opcode::LEI:
+            compare(Cond::LE);
+            break;
+        case Opcode::GTI:
+            compare(Cond::G);
+            break;
+        case Opcode::GEI:
+            compare(Cond::GE);
+            break;
+        case Opcode::EQD:
+        case Opcode::NED: {
+            auto equal = ins.op == Opcode::EQD;
+            Load(Xmm::xmm0, Use(ins.b));
+            Sse(SseOp::Ucomisd, Xmm::xmm0, Use(ins.c));
+            Compare(equal ? Cond::E : Cond::NE);
+            emitter.Setcc(equal ? Cond::NP : Cond::P, Reg::rcx);
+            emitter.Movzx8(Reg::rcx, Reg::rcx);
+            emitter.Alu(equal ? AluOp::And : AluOp::Or, Reg::rax, Reg::rcx);
+            Store(Def(ins.a), Reg::rax);
+            break;
+        }
+        case Opcode::LTD:
+            compare_double(Cond::A, true);
+            break;
+        case Opcode::LED:
+            compare_double(Cond::AE, true);
+            break;
+        case Opcode::GTD:
+            compare_double(Cond::A, false);
+            break;
+        case Opcode::GED:
+            compare_double(Cond::AE, false);
+            break;
+        case Opcode::EQS:
+            compare_string(Cond::E);
+            break;
+        case Opcode::NES:
+            compare_string(Cond::NE);
+            break;
+        case Opcode::LTS:
+            compare_string(Cond::L);
+            break;
+        case Opcode::LES:
+            compare_string(Cond::LE);
+            break;
+        case Opcode::GTS:
+            compare_string(Cond::G);
+            break;
+        case Opcode::GES:
+            compare_string(Cond::GE);
+            break;
+        case Opcode::JMP:
+            Moves(allocation->Edge(index, ins.a));
+            emitter.Jmp(Target(ins.a));
+            break;
+        case Opcode::JZ:
+        case Opcode::JNZ: {
+            auto condition = Use(ins.a);
+            if (condition.kind == Placement::Gpr) {
+                emitter.Test(condition.gpr, condition.gpr);
+            } else {
+                emitter.AluImm(AluOp::Cmp, Slot(condition.slot), 0);
+            }
+            auto cond = ins.op == Opcode::JZ ? Cond::E : Cond::NE;
+            auto moves = allocation->Edge(index, ins.b);
+            if (moves.empty()) {
+                emitter.Jcc(cond, Target(ins.b));
+            } else {
+                auto stub = emitter.NewLabel();
+                emitter.Jcc(cond, stub);
+                edges.push_back({stub, std::move(moves), Target(ins.b)});
+            }
+            break;
+        }
+        case Opcode::CALL: {
+            auto overflow = Error(RuntimeError::StackOverflow, index);
+            emitter.Lea(Reg::rax, Slot(allocation->Slot(ins.b) + allocations[ins.a].frame));
+            emitter.Alu(AluOp::Cmp, Reg::rax, {Reg::r13, 8 * StateSlot::StackEnd});
+            emitter.Jcc(Cond::A, overflow);
+            emitter.Lea(Reg::rax, {Reg::r12, 8 * (function->memory + program->functions[ins.a].memory)});
+            emitter.Alu(AluOp::Cmp, Reg::rax, {Reg::r13, 8 * StateSlot::MemoryEnd});
+            emitter.Jcc(Cond::A, overflow);
+            emitter.Alu(AluOp::Cmp, Reg::rsp, {Reg::r13, 8 * StateSlot::StackLimit});
+            emitter.Jcc(Cond::B, overflow);
+            emitter.Lea(Reg::rdi, Home(ins.b));
+            emitter.Lea(Reg::rsi, {Reg::r12, 8 * function->memory});
+            emitter.Call(functions[ins.a]);
+            break;
+        }
+        // The callee takes over the frame and the saved registers of the
+        // function, and returns to its caller.
+        case Opcode::TAILCALL: {
+            auto overflow = Error(RuntimeError::StackOverflow, index);
+            emitter.Lea(Reg::rax, Slot(allocations[ins.a].frame));
+            emitter.Alu(AluOp::Cmp, Reg::rax, {Reg::r13, 8 * StateSlot::StackEnd});
+            emitter.Jcc(Cond::A, overflow);
+            emitter.Lea(Reg::rax, {Reg::r12, 8 * program->functions[ins.a].memory});
+            emitter.Alu(AluOp::Cmp, Reg::rax, {Reg::r13, 8 * StateSlot::MemoryEnd});
+            emitter.Jcc(Cond::A, overflow);
+            for (int i = 0; i < program->functions[ins.a].params; ++i) {
+                emitter.Mov(Reg::rax, Home(ins.b + i));
+                emitter.Mov(Slot(i), Reg::rax);
+            }
+            emitter.Mov(Reg::rdi, Reg::rbx);
+            emitter.Mov(Reg::rsi, Reg::r12);
+            Restore();
+            emitter.Jmp(functions[ins.a]);
+            break;
+        }
+        case Opcode::VECTOR:
+            Vector(index);
+            break;
+        case Opcode::RET:
+            if (ins.a >= 0) {
+                Load(Reg::rax, Use(ins.a));
+                emitter.Mov(Slot(0), Reg::rax);
+            }
+            Epilogue();
+            break;
+        case Opcode::HALT:
+            Epilogue();
+            break;
+        case Opcode::WRITEI:
+            write(Runtime::WriteInt);
+            break;
+        case Opcode::WRITED:
+            Load(Xmm::xmm0, Use(ins.a));
+            emitter.Call(Runtime::WriteDouble);
+            break;
+        case Opcode::WRITEB:
+            write(Runtime::WriteBool);
+            break;
+        case Opcode::WRITEC:
+            write(Runtime::WriteChar);
+            break;
+        case Opcode::WRITES:
+            write(Runtime::WriteString);
+            break;
+        case Opcode::WRITELN:
+            emitter.Call(Runtime::WriteLine);
+            break;
+        case Opcode::READI:
+            read(Runtime::ReadInt);
+            break;
+        case Opcode::READD:
+            read(Runtime::ReadDouble);
+            break;
+        case Opcode::READC:
+            read(Runtime::ReadChar);
+            break;
+        case Opcode::READS:
+            SaveRoots();
+            read(Runtime::ReadString);
+            break;
+        default:
+            throw UnsupportedInstruction(ins.op);
+    }
+
+    auto falls = ins.op != Opcode::JMP && ins.op != Opcode::TAILCALL && ins.op != Opcode::RET &&
+                 ins.op != Opcode::HALT;
+    if (falls && index + 1 < allocation->End() && allocation->Starts(index + 1)) {
+        Moves(allocation->Edge(index, index + 1));
+    }
+}
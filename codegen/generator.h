@@ -0,0 +1,136 @@
+#ifndef COMPILER_GENERATOR_H
+#define COMPILER_GENERATOR_H
+
+#include <exception>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "../vm/bytecode.h"
+#include "allocator.h"
+#include "x86.h"
+
+class UnsupportedInstruction : public std::exception {
+    std::string message;
+
+public:
+    [[nodiscard]] const char *what() const noexcept override {
+        return message.c_str();
+    }
+
+    explicit UnsupportedInstruction(Opcode op) : std::exception() {
+        message = std::string("no native code for ") + OpcodeName(op);
+    }
+};
+
+// Translates register bytecode to x86-64. LinearScan keeps registers of
+// each function in machine registers where it can and in the slots of the
+// native frame otherwise, addressed through rbx; frame memory is addressed
+// through r12 and the run-time state with the globals through r13. Calls pass
+// their registers in the frame as the VM does.
+class NativeGenerator {
+public:
+    NativeGenerator(Program *program, X86Emitter &emitter) : program(program), emitter(emitter) {}
+
+    // Emits every function and returns the entry stub, which takes the
+    // run-time state in rdi. Throws UnsupportedInstruction for bytecode it
+    // has no translation for.
+    Label Generate();
+
+private:
+    struct ErrorStub {
+        Label label;
+        RuntimeError error;
+        Position pos;
+    };
+
+    // Moves for a branch taken to target, run out of line.
+    struct EdgeStub {
+        Label label;
+        std::vector<LinearScan::Move> moves;
+        Label target;
+    };
+
+    void Function(int index, int begin, int end);
+
+    void Instruction(int index);
+
+    void Vector(int index);
+
+    void KernelLoop(const Kernel &kernel, const std::function<Mem(int)> &param);
+
+    void KernelFunction(int index);
+
+    // Combines rax with operand as reduce does.
+    void Combine(Kernel::Op reduce, Mem operand);
+
+    // Records in the run-time state what a call making a string leaves
+    // where the collector can find it.
+    void SaveRoots();
+
+    // Pops the registers the function saved.
+    void Restore();
+
+    void Epilogue();
+
+    Label Error(RuntimeError error, int index);
+
+    Label Target(int instruction);
+
+    void Compare(Cond cond);
+
+    // Sets dst to whether cond holds.
+    void Flag(Cond cond, Placement dst);
+
+    void Load(Reg dst, Placement src);
+
+    void Load(Xmm dst, Placement src);
+
+    void Store(Placement dst, Reg src);
+
+    void Store(Placement dst, Xmm src);
+
+    void LoadFrom(Placement dst, Mem src);
+
+    void StoreTo(Mem dst, Placement src);
+
+    void Move(Placement dst, Placement src);
+
+    // Runs moves as if at once, breaking cycles through rax or xmm0.
+    void Moves(std::vector<LinearScan::Move> moves);
+
+    void Alu(AluOp op, Reg dst, Placement src);
+
+    void Imul(Reg dst, Placement src);
+
+    void Sse(SseOp op, Xmm dst, Placement src);
+
+    // Where the current instruction reads and writes a register.
+    [[nodiscard]] Placement Use(int reg) const;
+
+    [[nodiscard]] Placement Def(int reg) const;
+
+    // The slot of a register kept in memory throughout.
+    [[nodiscard]] Mem Home(int reg) const;
+
+    static Mem Slot(int slot);
+
+    static Mem Global(int index);
+
+    Program *program;
+    X86Emitter &emitter;
+    std::vector<Label> functions;
+    std::vector<Label> kernels;
+    std::map<int, Label> targets;
+    std::vector<ErrorStub> errors;
+    std::vector<EdgeStub> edges;
+    std::unordered_set<const std::string *> strings;
+    std::vector<LinearScan> allocations;
+    const ::Function *function = nullptr;
+    const LinearScan *allocation = nullptr;
+    int current = 0;
+};
+
+#endif //COMPILER_GENERATOR_H
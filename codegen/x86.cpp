@@ -0,0 +1,28 @@
+#include "x86.h"
+
+#include <climits>
+
+const char *RuntimeName(Runtime function) {
+    static const char *names[] = {
+#define RUNTIME_NAME(name, symbol) #symbol,
+            RUNTIME_FUNCTIONS(RUNTIME_NAME)
+#undef RUNTIME_NAME
+    };
+    return names[(int) function];
+}
+
+const char *RuntimeErrorMessage(RuntimeError error) {
+    switch (error) {
+        case RuntimeError::IndexOutOfRange:
+            return "Index out of range";
+        case RuntimeError::DivisionByZero:
+            return "Division by zero";
+        case RuntimeError::StackOverflow:
+            return "Stack overflow";
+    }
+    return "";
+}
+
+bool FitsInt32(long long value) {
+    return value >= INT_MIN && value <= INT_MAX;
+}
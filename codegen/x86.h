@@ -0,0 +1,198 @@
+#ifndef COMPILER_X86_H
+#define COMPILER_X86_H
+
+#include <string>
+
+#include "../vm/value.h"
+
+enum class Reg {
+    rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+    r8, r9, r10, r11, r12, r13, r14, r15
+};
+
+enum class Xmm {
+    xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7,
+    xmm8, xmm9, xmm10, xmm11, xmm12, xmm13, xmm14, xmm15
+};
+
+struct Mem {
+    Reg base;
+    int disp = 0;
+};
+
+// Condition codes in their hardware encoding order.
+enum class Cond {
+    O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G
+};
+
+// Group 1 arithmetic in the order of its /digit encoding.
+enum class AluOp {
+    Add, Or, Adc, Sbb, And, Sub, Xor, Cmp
+};
+
+enum class ShiftOp {
+    Shl = 4, Shr = 5, Sar = 7
+};
+
+enum class SseOp {
+    Movsd, Addsd, Subsd, Mulsd, Divsd, Ucomisd, Cvtsi2sd
+};
+
+// SSE2 operations on both 64-bit lanes of two xmm registers.
+enum class PackedOp {
+    Movdqa, Paddq, Psubq, Pmuludq, Pand, Por, Pxor, Addpd, Subpd, Mulpd, Divpd
+};
+
+using Label = int;
+
+// Entry points of the native run-time library. Arguments and results follow
+// the System V convention; doubles read back from input are returned as bits.
+#define RUNTIME_FUNCTIONS(X) \
+    X(WriteInt, rt_write_int) X(WriteDouble, rt_write_double) X(WriteBool, rt_write_bool) \
+    X(WriteChar, rt_write_char) X(WriteString, rt_write_string) X(WriteLine, rt_write_line) \
+    X(ReadInt, rt_read_int) X(ReadDouble, rt_read_double) X(ReadChar, rt_read_char) \
+    X(ReadString, rt_read_string) X(Concat, rt_concat) X(Compare, rt_compare) X(Error, rt_error) \
+    X(Parallel, rt_parallel)
+
+enum class Runtime {
+#define RUNTIME_ENUM(name, symbol) name,
+    RUNTIME_FUNCTIONS(RUNTIME_ENUM)
+#undef RUNTIME_ENUM
+};
+
+const char *RuntimeName(Runtime function);
+
+enum class RuntimeError {
+    IndexOutOfRange, DivisionByZero, StackOverflow
+};
+
+const char *RuntimeErrorMessage(RuntimeError error);
+
+// Slots of the block r13 points to while generated code runs; globals
+// follow the header. Before a call into the library that makes a string,
+// generated code records where its frames end, its stack pointer and the
+// registers values stay in across calls, for the strings still in use to be
+// found.
+enum StateSlot {
+    StackBase, StackEnd, MemoryBase, MemoryEnd, StackLimit, StackTop, MemoryTop, NativeTop, SavedRbp, SavedR14,
+    SavedR15, Globals
+};
+
+// Native stack reserved for generated code below the entry frame.
+const int NATIVE_STACK_LIMIT = 4 << 20;
+
+// Instruction sink for x86-64 code. The same lowering drives a textual
+// GNU assembler writer and a binary encoder.
+class X86Emitter {
+public:
+    virtual ~X86Emitter() = default;
+
+    virtual Label NewLabel() = 0;
+
+    virtual void Bind(Label label) = 0;
+
+    virtual void Comment(const std::string &text) = 0;
+
+    virtual void Mov(Reg dst, Mem src) = 0;
+
+    virtual void Mov(Mem dst, Reg src) = 0;
+
+    virtual void Mov(Reg dst, Reg src) = 0;
+
+    virtual void MovImm(Reg dst, long long imm) = 0;
+
+    virtual void MovImm(Mem dst, int imm) = 0;
+
+    virtual void Lea(Reg dst, Mem src) = 0;
+
+    // The address of code at label.
+    virtual void Lea(Reg dst, Label label) = 0;
+
+    virtual void Alu(AluOp op, Reg dst, Mem src) = 0;
+
+    virtual void Alu(AluOp op, Reg dst, Reg src) = 0;
+
+    virtual void AluImm(AluOp op, Reg dst, int imm) = 0;
+
+    virtual void AluImm(AluOp op, Mem dst, int imm) = 0;
+
+    virtual void Imul(Reg dst, Mem src) = 0;
+
+    virtual void Imul(Reg dst, Reg src) = 0;
+
+    virtual void ImulImm(Reg dst, Reg src, int imm) = 0;
+
+    // rdx:rax = rax * reg, signed
+    virtual void ImulWide(Reg reg) = 0;
+
+    virtual void Neg(Reg reg) = 0;
+
+    virtual void Not(Reg reg) = 0;
+
+    virtual void Shift(ShiftOp op, Reg reg) = 0;
+
+    virtual void ShiftImm(ShiftOp op, Reg reg, int count) = 0;
+
+    virtual void Cqo() = 0;
+
+    virtual void Idiv(Reg reg) = 0;
+
+    virtual void Test(Reg a, Reg b) = 0;
+
+    virtual void Setcc(Cond cond, Reg reg) = 0;
+
+    virtual void Movzx8(Reg dst, Reg src) = 0;
+
+    virtual void Sse(SseOp op, Xmm dst, Mem src) = 0;
+
+    // Movsd between registers copies both lanes (movapd); Cvtsi2sd takes
+    // its operand from a general register instead.
+    virtual void Sse(SseOp op, Xmm dst, Xmm src) = 0;
+
+    virtual void Cvtsi2sd(Xmm dst, Reg src) = 0;
+
+    virtual void Movsd(Mem dst, Xmm src) = 0;
+
+    // The bits of a general register to the low lane of an xmm register and
+    // back.
+    virtual void Movq(Xmm dst, Reg src) = 0;
+
+    virtual void Movq(Reg dst, Xmm src) = 0;
+
+    virtual void Packed(PackedOp op, Xmm dst, Xmm src) = 0;
+
+    // Moves of two slots at once, aligned or not (movdqu).
+    virtual void PackedLoad(Xmm dst, Mem src) = 0;
+
+    virtual void PackedStore(Mem dst, Xmm src) = 0;
+
+    // Shifts both lanes left or right, Sar has no packed form.
+    virtual void PackedShift(ShiftOp op, Xmm reg, int count) = 0;
+
+    virtual void Pshufd(Xmm dst, Xmm src, int order) = 0;
+
+    virtual void Jmp(Label label) = 0;
+
+    virtual void Jcc(Cond cond, Label label) = 0;
+
+    virtual void Call(Label label) = 0;
+
+    virtual void Call(Runtime function) = 0;
+
+    virtual void Push(Reg reg) = 0;
+
+    virtual void Pop(Reg reg) = 0;
+
+    virtual void Ret() = 0;
+
+    virtual void RepStosq() = 0;
+
+    virtual void RepMovsq() = 0;
+
+    // Loads string constant k of the program into dst.
+    virtual void LoadString(Reg dst, int k, const std::string &text, Value value) = 0;
+};
+
+bool FitsInt32(long long value);
+
+#endif //COMPILER_X86_H
@@ -0,0 +1,30 @@
+#include "arena.h"
+
+#include <algorithm>
+
+Arena::~Arena() {
+    for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+        it->second(it->first);
+    }
+    for (auto &block: blocks) {
+        ::operator delete(block.first);
+    }
+}
+
+void *Arena::Allocate(size_t size, size_t align) {
+    std::lock_guard lock(mutex);
+    auto offset = (used + align - 1) & ~(align - 1);
+    if (blocks.empty() || offset + size > blocks.back().second) {
+        auto capacity = std::max(BLOCK_SIZE, size + align);
+        blocks.emplace_back(static_cast<char *>(::operator new(capacity)), capacity);
+        offset = 0;
+    }
+    used = offset + size;
+    allocated += size;
+    return blocks.back().first + offset;
+}
+
+size_t Arena::Allocated() const {
+    std::lock_guard lock(mutex);
+    return allocated;
+}
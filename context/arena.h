@@ -0,0 +1,48 @@
+#ifndef COMPILER_ARENA_H
+#define COMPILER_ARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator owning every object created through New(). Objects are
+// destroyed in reverse order of creation when the arena goes away, so nothing
+// allocated here may be deleted by hand. Allocation is thread-safe.
+class Arena {
+public:
+    Arena() = default;
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena();
+
+    template<class T, class... Args>
+    T *New(Args &&... args) {
+        auto object = new(Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            std::lock_guard lock(mutex);
+            destructors.emplace_back(object, [](void *ptr) { static_cast<T *>(ptr)->~T(); });
+        }
+        return object;
+    }
+
+    [[nodiscard]] size_t Allocated() const;
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    void *Allocate(size_t size, size_t align);
+
+    std::vector<std::pair<char *, size_t>> blocks;
+    std::vector<std::pair<void *, void (*)(void *)>> destructors;
+    size_t used = 0;
+    size_t allocated = 0;
+    mutable std::mutex mutex;
+};
+
+#endif //COMPILER_ARENA_H
@@ -0,0 +1,24 @@
+#include "context.h"
+
+CompilationContext::CompilationContext() {
+    sym_integer = New<SymbolInteger>();
+    sym_double = New<SymbolDouble>();
+    sym_boolean = New<SymbolBoolean>();
+    sym_char = New<SymbolChar>();
+    sym_string = New<SymbolString>();
+    builtins = New<SymbolTable>();
+    builtins->Push(sym_integer);
+    builtins->Push(sym_double);
+    builtins->Push(sym_boolean);
+    builtins->Push(sym_char);
+    builtins->Push(sym_string);
+}
+
+void CompilationContext::Report(const std::string &message) {
+    std::lock_guard lock(mutex);
+    diagnostics.push_back(message);
+}
+
+size_t CompilationContext::Allocated() const {
+    return arena.Allocated();
+}
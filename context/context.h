@@ -0,0 +1,45 @@
+#ifndef COMPILER_CONTEXT_H
+#define COMPILER_CONTEXT_H
+
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "../symbol/symbol.h"
+
+// Owns everything produced by one compile: tree nodes, symbols and symbol
+// tables live in the arena, the built-in types are created per context and
+// errors are collected as diagnostics. Contexts share no mutable state, so
+// independent compiles may run on different threads.
+class CompilationContext {
+public:
+    CompilationContext();
+
+    CompilationContext(const CompilationContext &) = delete;
+
+    CompilationContext &operator=(const CompilationContext &) = delete;
+
+    template<class T, class... Args>
+    T *New(Args &&... args) {
+        return arena.New<T>(std::forward<Args>(args)...);
+    }
+
+    void Report(const std::string &message);
+
+    [[nodiscard]] size_t Allocated() const;
+
+    SymbolInteger *sym_integer;
+    SymbolDouble *sym_double;
+    SymbolBoolean *sym_boolean;
+    SymbolChar *sym_char;
+    SymbolString *sym_string;
+    SymbolTable *builtins;
+
+    std::vector<std::string> diagnostics;
+
+private:
+    Arena arena;
+    std::mutex mutex;
+};
+
+#endif //COMPILER_CONTEXT_H
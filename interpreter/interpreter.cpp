@@ -0,0 +1,503 @@
+#include "interpreter.h"
+
+#include <algorithm>
+
+#include "../vm/slots.h"
+#include "../parser/parser.h"
+
+static const size_t MAX_DEPTH = 10000;
+
+Value Interpreter::FromConst(const ConstValue &constant) {
+    Value value{};
+    if (std::holds_alternative<long long>(constant)) {
+        value.i = std::get<long long>(constant);
+    } else if (std::holds_alternative<double>(constant)) {
+        value.d = std::get<double>(constant);
+    } else if (std::holds_alternative<bool>(constant)) {
+        value.i = std::get<bool>(constant);
+    } else {
+        auto &string = std::get<std::string>(constant);
+        if (!constants.contains(string)) {
+            strings.push_back(string);
+            constants[string] = &strings.back();
+        }
+        value.s = constants[string];
+    }
+    return value;
+}
+
+void Interpreter::Run(Node *program) {
+    program->Accept(this);
+}
+
+Value Interpreter::Evaluate(Node *node) {
+    if (node->value.has_value()) {
+        return FromConst(*node->value);
+    }
+    node->Accept(this);
+    return value;
+}
+
+Value *Interpreter::Find(Symbol *symbol) {
+    if (!frames.empty()) {
+        auto it = frames.back().vars.find(symbol);
+        if (it != frames.back().vars.end()) {
+            return it->second;
+        }
+    }
+    return globals.vars.at(symbol);
+}
+
+Value *Interpreter::Allocate(SymbolType *type) {
+    auto &frame = frames.empty() ? globals : frames.back();
+    frame.storage.emplace_back(new Value[SlotsOf(type)]());
+    return frame.storage.back().get();
+}
+
+void Interpreter::Declare(Symbol *symbol, SymbolType *type, Node *init) {
+    auto slot = Allocate(type);
+    (frames.empty() ? globals : frames.back()).vars[symbol] = slot;
+    if (init != nullptr) {
+        *slot = Evaluate(init);
+    }
+}
+
+Value *Interpreter::Address(Node *node) {
+    if (auto var = dynamic_cast<NodeVar *>(node)) {
+        return Find(var->symbol);
+    }
+    if (auto record_access = dynamic_cast<NodeRecordAccess *>(node)) {
+        auto record = dynamic_cast<SymbolRecord *>(record_access->rec->symbol_type->Resolve());
+        auto field = dynamic_cast<NodeVar *>(record_access->field);
+        return Address(record_access->rec) + FieldOffset(record, field->lexeme.GetValue<std::string>());
+    }
+    if (dynamic_cast<NodeArrayAccess *>(node) != nullptr) {
+        // a[i][j] and a[i, j] index the dimensions of a in turn, which add up
+        // to a single offset
+        std::vector<NodeArrayAccess *> chain;
+        auto array = node;
+        while (auto array_access = dynamic_cast<NodeArrayAccess *>(array)) {
+            chain.push_back(array_access);
+            array = array_access->arr;
+        }
+        std::reverse(chain.begin(), chain.end());
+        auto &layout = LayoutOf(array->symbol_type);
+        auto base = Address(array);
+        long long offset = 0;
+        for (size_t i = 0; i < chain.size(); ++i) {
+            auto &dimension = layout.dimensions[i];
+            auto index = Evaluate(chain[i]->params).i - dimension.low;
+            if (index < 0 || index >= dimension.count) {
+                throw RuntimeException(chain[i]->params->GetPos(), "Index out of range");
+            }
+            offset += index * dimension.stride;
+        }
+        return base + offset;
+    }
+    auto call = dynamic_cast<NodeCallAccess *>(node);
+    auto ret = dynamic_cast<SymbolFunction *>(dynamic_cast<NodeVar *>(call->callable)->symbol)->ret;
+    auto result = Call(call);
+    auto copy = Allocate(ret);
+    std::copy(result.p, result.p + SlotsOf(ret), copy);
+    return copy;
+}
+
+Value Interpreter::Call(NodeCallAccess *node) {
+    auto symbol = dynamic_cast<SymbolProcedure *>(dynamic_cast<NodeVar *>(node->callable)->symbol);
+    auto decl = routines.at(symbol);
+    auto params = symbol->GetParams();
+    if (frames.size() >= MAX_DEPTH) {
+        throw RuntimeException(node->GetPos(), "Stack overflow");
+    }
+
+    Frame frame;
+    for (size_t i = 0; i < params.size(); ++i) {
+        auto param = params[i];
+        auto arg = node->params[i];
+        if (dynamic_cast<SymbolVarParam *>(param) != nullptr ||
+            (!IsScalar(param->type) && dynamic_cast<SymbolConstParam *>(param) != nullptr)) {
+            frame.vars[param] = Address(arg);
+        } else if (!IsScalar(param->type)) {
+            auto source = Address(arg);
+            auto slots = SlotsOf(param->type);
+            frame.storage.emplace_back(new Value[slots]);
+            std::copy(source, source + slots, frame.storage.back().get());
+            frame.vars[param] = frame.storage.back().get();
+        } else {
+            frame.storage.emplace_back(new Value[1]{Evaluate(arg)});
+            frame.vars[param] = frame.storage.back().get();
+        }
+    }
+    frames.push_back(std::move(frame));
+
+    Symbol *result = nullptr;
+    if (auto func = dynamic_cast<SymbolFunction *>(symbol)) {
+        result = symbol->locals->Get("result");
+        Declare(result, func->ret, nullptr);
+    }
+    decl->block->Accept(this);
+
+    Value ret{};
+    if (result != nullptr) {
+        auto slot = frames.back().vars.at(result);
+        if (IsScalar(dynamic_cast<SymbolFunction *>(symbol)->ret)) {
+            ret = *slot;
+        } else {
+            // the frame goes away, keep the aggregate alive in the caller
+            auto slots = SlotsOf(dynamic_cast<SymbolFunction *>(symbol)->ret);
+            auto &caller = frames.size() > 1 ? frames[frames.size() - 2] : globals;
+            caller.storage.emplace_back(new Value[slots]);
+            std::copy(slot, slot + slots, caller.storage.back().get());
+            ret.p = caller.storage.back().get();
+        }
+    }
+    frames.pop_back();
+    return ret;
+}
+
+
+void Interpreter::Visit(NodeBinaryOperation *node) {
+    auto kind = KindOf(node->left->symbol_type);
+    auto left = Evaluate(node->left);
+    auto right = Evaluate(node->right);
+    Value result{};
+    if (node->lexeme == LexemeType::Operator) {
+        auto op = node->lexeme.GetValue<Operators>();
+        if (kind == ValueKind::Double || (op == Operators::DIVISION && kind == ValueKind::Integer)) {
+            double a = kind == ValueKind::Double ? left.d : (double) left.i;
+            double b = kind == ValueKind::Double ? right.d : (double) right.i;
+            switch (op) {
+                case Operators::ADD: result.d = a + b; break;
+                case Operators::SUBSTRACT: result.d = a - b; break;
+                case Operators::MULTIPLY: result.d = a * b; break;
+                case Operators::DIVISION: result.d = a / b; break;
+                case Operators::EQUAL: result.i = a == b; break;
+                case Operators::UNEQUAL: result.i = a != b; break;
+                case Operators::LESS: result.i = a < b; break;
+                case Operators::LESSEQUAL: result.i = a <= b; break;
+                case Operators::GREATER: result.i = a > b; break;
+                default: result.i = a >= b;
+            }
+        } else if (kind == ValueKind::String) {
+            auto &a = StringOf(left);
+            auto &b = StringOf(right);
+            switch (op) {
+                case Operators::ADD:
+                    strings.push_back(a + b);
+                    result.s = &strings.back();
+                    break;
+                case Operators::EQUAL: result.i = a == b; break;
+                case Operators::UNEQUAL: result.i = a != b; break;
+                case Operators::LESS: result.i = a < b; break;
+                case Operators::LESSEQUAL: result.i = a <= b; break;
+                case Operators::GREATER: result.i = a > b; break;
+                default: result.i = a >= b;
+            }
+        } else {
+            auto a = (unsigned long long) left.i;
+            auto b = (unsigned long long) right.i;
+            switch (op) {
+                case Operators::ADD: result.i = (long long) (a + b); break;
+                case Operators::SUBSTRACT: result.i = (long long) (a - b); break;
+                case Operators::MULTIPLY: result.i = (long long) (a * b); break;
+                case Operators::EQUAL: result.i = left.i == right.i; break;
+                case Operators::UNEQUAL: result.i = left.i != right.i; break;
+                case Operators::LESS: result.i = left.i < right.i; break;
+                case Operators::LESSEQUAL: result.i = left.i <= right.i; break;
+                case Operators::GREATER: result.i = left.i > right.i; break;
+                default: result.i = left.i >= right.i;
+            }
+        }
+    } else {
+        auto a = left.i;
+        auto b = right.i;
+        switch (node->lexeme.GetValue<AllKeywords>()) {
+            case AllKeywords::DIV:
+                if (b == 0) {
+                    throw RuntimeException(node->GetPos(), "Division by zero");
+                }
+                result.i = b == -1 ? (long long) (0 - (unsigned long long) a) : a / b;
+                break;
+            case AllKeywords::MOD:
+                if (b == 0) {
+                    throw RuntimeException(node->GetPos(), "Division by zero");
+                }
+                result.i = b == -1 ? 0 : a % b;
+                break;
+            case AllKeywords::SHL: result.i = (long long) ((unsigned long long) a << (b & 63)); break;
+            case AllKeywords::SHR: result.i = (long long) ((unsigned long long) a >> (b & 63)); break;
+            case AllKeywords::AND: result.i = a & b; break;
+            case AllKeywords::OR: result.i = a | b; break;
+            default: result.i = a ^ b;
+        }
+    }
+    value = result;
+}
+
+
+void Interpreter::Visit(NodeUnaryOperation *node) {
+    auto kind = KindOf(node->operand->symbol_type);
+    auto operand = Evaluate(node->operand);
+    if (node->op == Operators::ADD) {
+        value = operand;
+    } else if (node->op == Operators::SUBSTRACT) {
+        if (kind == ValueKind::Double) {
+            value.d = -operand.d;
+        } else {
+            value.i = (long long) (0 - (unsigned long long) operand.i);
+        }
+    } else if (kind == ValueKind::Boolean) {
+        value.i = operand.i == 0;
+    } else {
+        value.i = ~operand.i;
+    }
+}
+
+
+void Interpreter::Visit(NodeString *node) {
+    value = FromConst(node->lexeme.GetValue<std::string>());
+}
+
+
+void Interpreter::Visit(NodeNumber *node) {
+    if (node->lexeme == LexemeType::Double) {
+        value.d = node->lexeme.GetValue<double>();
+    } else {
+        value.i = node->lexeme.GetValue<int>();
+    }
+}
+
+
+void Interpreter::Visit(NodeBoolean *node) {
+    value.i = node->lexeme == AllKeywords::TRUE;
+}
+
+
+void Interpreter::Visit(NodeVar *node) {
+    value = *Address(node);
+}
+
+
+void Interpreter::Visit(NodeRecordAccess *node) {
+    value = *Address(node);
+}
+
+
+void Interpreter::Visit(NodeCallAccess *node) {
+    auto ret = dynamic_cast<SymbolFunction *>(dynamic_cast<NodeVar *>(node->callable)->symbol)->ret;
+    if (IsScalar(ret)) {
+        value = Call(node);
+    } else {
+        value.p = Address(node);
+    }
+}
+
+
+void Interpreter::Visit(NodeIOCallStatement *node) {
+    if (node->IsRead()) {
+        for (auto &param: node->params) {
+            auto slot = Address(param);
+            switch (KindOf(param->symbol_type)) {
+                case ValueKind::Double: {
+                    double d = 0;
+                    in >> d;
+                    slot->d = d;
+                    break;
+                }
+                case ValueKind::Char: {
+                    char c = 0;
+                    in >> c;
+                    slot->i = c;
+                    break;
+                }
+                case ValueKind::String: {
+                    std::string s;
+                    in >> s;
+                    strings.push_back(s);
+                    slot->s = &strings.back();
+                    break;
+                }
+                default: {
+                    long long i = 0;
+                    in >> i;
+                    slot->i = i;
+                }
+            }
+        }
+        return;
+    }
+    for (auto &param: node->params) {
+        auto result = Evaluate(param);
+        switch (KindOf(param->symbol_type)) {
+            case ValueKind::Double:
+                WriteDouble(out, result.d);
+                break;
+            case ValueKind::Boolean:
+                WriteBoolean(out, result.i);
+                break;
+            case ValueKind::Char:
+                out << (char) result.i;
+                break;
+            case ValueKind::String:
+                out << StringOf(result);
+                break;
+            default:
+                out << result.i;
+        }
+    }
+    if (node->GetName() == "writeln") {
+        out << "\n";
+    }
+}
+
+
+void Interpreter::Visit(NodeArrayAccess *node) {
+    value = *Address(node);
+}
+
+
+void Interpreter::Visit(NodeSimpleType *node) {
+}
+
+
+void Interpreter::Visit(NodeRange *node) {
+}
+
+
+void Interpreter::Visit(NodeArrayType *node) {
+}
+
+
+void Interpreter::Visit(NodeField *node) {
+}
+
+
+void Interpreter::Visit(NodeRecordType *node) {
+}
+
+
+void Interpreter::Visit(NodeCompoundStatement *node) {
+    for (auto &statement: node->statements) statement->Accept(this);
+}
+
+
+void Interpreter::Visit(NodeAssignmentStatement *node) {
+    auto slot = Address(node->left);
+    auto right = Evaluate(node->right);
+    auto op = node->lexeme.GetValue<Operators>();
+    if (op == Operators::ASSIGN) {
+        *slot = right;
+        return;
+    }
+    switch (KindOf(node->left->symbol_type)) {
+        case ValueKind::Double:
+            switch (op) {
+                case Operators::ADDASSIGN: slot->d += right.d; break;
+                case Operators::SUBSTRACTASSIGN: slot->d -= right.d; break;
+                case Operators::MULTIPLYASSIGN: slot->d *= right.d; break;
+                default: slot->d /= right.d;
+            }
+            break;
+        case ValueKind::String:
+            strings.push_back(StringOf(*slot) + StringOf(right));
+            slot->s = &strings.back();
+            break;
+        default: {
+            auto a = (unsigned long long) slot->i;
+            auto b = (unsigned long long) right.i;
+            switch (op) {
+                case Operators::ADDASSIGN: slot->i = (long long) (a + b); break;
+                case Operators::SUBSTRACTASSIGN: slot->i = (long long) (a - b); break;
+                case Operators::MULTIPLYASSIGN: slot->i = (long long) (a * b); break;
+                default:
+                    if (right.i == 0) {
+                        throw RuntimeException(node->NodeBinaryOperation::GetPos(), "Division by zero");
+                    }
+                    slot->i = right.i == -1 ? (long long) (0 - a) : slot->i / right.i;
+            }
+        }
+    }
+}
+
+
+void Interpreter::Visit(NodeUserCallStatement *node) {
+    Call(node);
+}
+
+
+void Interpreter::Visit(NodeIfStatement *node) {
+    if (Evaluate(node->exp).i != 0) {
+        node->statement->Accept(this);
+    } else if (node->else_statement != nullptr) {
+        node->else_statement->Accept(this);
+    }
+}
+
+
+void Interpreter::Visit(NodeWhileStatement *node) {
+    while (Evaluate(node->exp).i != 0) {
+        node->statement->Accept(this);
+    }
+}
+
+
+void Interpreter::Visit(NodeForStatement *node) {
+    auto slot = Address(node->var);
+    slot->i = Evaluate(node->exp_begin).i;
+    auto end = Evaluate(node->exp_end).i;
+    bool is_down = node->direction->lexeme == AllKeywords::DOWNTO;
+    if (is_down ? slot->i < end : slot->i > end) {
+        return;
+    }
+    while (true) {
+        node->statement->Accept(this);
+        if (slot->i == end) {
+            break;
+        }
+        slot->i += is_down ? -1 : 1;
+    }
+}
+
+
+void Interpreter::Visit(NodeBlock *node) {
+    for (auto &decl: node->decls) decl->Accept(this);
+    node->comp_stmt->Accept(this);
+}
+
+
+void Interpreter::Visit(NodeProgram *node) {
+    globals = Frame();
+    frames.clear();
+    node->block->Accept(this);
+}
+
+
+void Interpreter::Visit(NodeTypeDecl *node) {
+}
+
+
+void Interpreter::Visit(NodeVarDecl *node) {
+    for (auto &var: node->vars) {
+        Declare(var->symbol, node->type->symbol_type, node->exp);
+    }
+}
+
+
+void Interpreter::Visit(NodeConstDecl *node) {
+    auto symbol = dynamic_cast<SymbolConst *>(node->var->symbol);
+    Declare(symbol, symbol->type, node->exp);
+}
+
+
+void Interpreter::Visit(NodeParam *node) {
+}
+
+
+void Interpreter::Visit(NodeProcDecl *node) {
+    routines[dynamic_cast<NodeVar *>(node->var)->symbol] = node;
+}
+
+
+void Interpreter::Visit(NodeFuncDecl *node) {
+    routines[dynamic_cast<NodeVar *>(node->var)->symbol] = node;
+}
@@ -0,0 +1,116 @@
+#ifndef COMPILER_INTERPRETER_H
+#define COMPILER_INTERPRETER_H
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../visitor.h"
+#include "../symbol/symbol.h"
+#include "../vm/value.h"
+
+class Node;
+
+class NodeCallAccess;
+
+class NodeProcDecl;
+
+// Reference tree-walking interpreter over the checked tree. It shares the
+// storage model of the VM and serves as the baseline it is measured against.
+class Interpreter : public Visitor {
+public:
+    Interpreter(std::istream &in, std::ostream &out) : in(in), out(out) {}
+
+    void Run(Node *program);
+
+    void Visit(NodeBinaryOperation *node) override;
+
+    void Visit(NodeUnaryOperation *node) override;
+
+    void Visit(NodeString *node) override;
+
+    void Visit(NodeNumber *node) override;
+
+    void Visit(NodeBoolean *node) override;
+
+    void Visit(NodeVar *node) override;
+
+    void Visit(NodeRecordAccess *node) override;
+
+    void Visit(NodeCallAccess *node) override;
+
+    void Visit(NodeIOCallStatement *node) override;
+
+    void Visit(NodeArrayAccess *node) override;
+
+    void Visit(NodeSimpleType *node) override;
+
+    void Visit(NodeRange *node) override;
+
+    void Visit(NodeArrayType *node) override;
+
+    void Visit(NodeField *node) override;
+
+    void Visit(NodeRecordType *node) override;
+
+    void Visit(NodeCompoundStatement *node) override;
+
+    void Visit(NodeAssignmentStatement *node) override;
+
+    void Visit(NodeUserCallStatement *node) override;
+
+    void Visit(NodeIfStatement *node) override;
+
+    void Visit(NodeWhileStatement *node) override;
+
+    void Visit(NodeForStatement *node) override;
+
+    void Visit(NodeBlock *node) override;
+
+    void Visit(NodeProgram *node) override;
+
+    void Visit(NodeTypeDecl *node) override;
+
+    void Visit(NodeVarDecl *node) override;
+
+    void Visit(NodeConstDecl *node) override;
+
+    void Visit(NodeParam *node) override;
+
+    void Visit(NodeProcDecl *node) override;
+
+    void Visit(NodeFuncDecl *node) override;
+
+private:
+    struct Frame {
+        std::unordered_map<Symbol *, Value *> vars;
+        std::vector<std::unique_ptr<Value[]>> storage;
+    };
+
+    Value FromConst(const ConstValue &constant);
+
+    Value Evaluate(Node *node);
+
+    Value *Address(Node *node);
+
+    Value *Find(Symbol *symbol);
+
+    Value *Allocate(SymbolType *type);
+
+    void Declare(Symbol *symbol, SymbolType *type, Node *init);
+
+    Value Call(NodeCallAccess *node);
+
+    std::istream &in;
+    std::ostream &out;
+    Frame globals;
+    std::vector<Frame> frames;
+    std::unordered_map<Symbol *, NodeProcDecl *> routines;
+    std::deque<std::string> strings;
+    std::unordered_map<std::string, const std::string *> constants;
+    Value value{};
+};
+
+#endif //COMPILER_INTERPRETER_H
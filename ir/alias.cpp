@@ -0,0 +1,99 @@
+#include "alias.h"
+
+Location LocationOf(Inst *pointer) {
+    switch (pointer->op) {
+        case IrOp::Global:
+        case IrOp::Alloca:
+            return {pointer, 0, true};
+        case IrOp::Offset: {
+            auto location = LocationOf(pointer->Operand(0));
+            location.offset += pointer->imm;
+            location.field += pointer->imm;
+            return location;
+        }
+        case IrOp::Element: {
+            auto location = LocationOf(pointer->Operand(0));
+            location.exact = false;
+            location.element = pointer;
+            location.field = 0;
+            return location;
+        }
+        default:
+            return {pointer, 0, true};
+    }
+}
+
+Location LocationWritten(Inst *write) {
+    auto location = LocationOf(write->Operand(0));
+    if (write->op == IrOp::Copy) {
+        location.exact = false;
+        location.element = nullptr;
+    }
+    return location;
+}
+
+static bool IsKnownRoot(const Location &location) {
+    return location.root->op == IrOp::Global || location.root->op == IrOp::Alloca;
+}
+
+// Parameters point into the frames of callers or the globals, never into an
+// alloca of the routine itself.
+static bool IsOutside(const Location &a, const Location &b) {
+    return a.root->op == IrOp::Param && b.root->op == IrOp::Alloca;
+}
+
+bool MayAlias(const Location &a, const Location &b) {
+    if (IsOutside(a, b) || IsOutside(b, a)) {
+        return false;
+    }
+    if (a.element != nullptr && a.element == b.element) {
+        return a.field == b.field;
+    }
+    if (a.root == b.root) {
+        return !a.exact || !b.exact || a.offset == b.offset;
+    }
+    return !IsKnownRoot(a) || !IsKnownRoot(b);
+}
+
+// The slots from the pointer on.
+static Location Whole(Inst *pointer) {
+    auto location = LocationOf(pointer);
+    location.exact = false;
+    location.element = nullptr;
+    return location;
+}
+
+bool MayOverlap(Inst *a, Inst *b) {
+    return MayAlias(Whole(a), Whole(b));
+}
+
+bool MayClobber(Inst *inst, const Location &location) {
+    switch (inst->op) {
+        case IrOp::Store:
+        case IrOp::Copy:
+            return MayAlias(LocationWritten(inst), location);
+        case IrOp::Call:
+            if (location.root->op != IrOp::Alloca) {
+                return true;
+            }
+            for (auto argument: inst->operands) {
+                if (argument->type != IrType::Ptr) {
+                    continue;
+                }
+                auto passed = LocationOf(argument);
+                if (passed.root == location.root || (!IsKnownRoot(passed) && passed.root->op != IrOp::Param)) {
+                    return true;
+                }
+            }
+            return false;
+        case IrOp::Vector:
+            for (auto &node: inst->kernel->nodes) {
+                if (node.op == Kernel::Op::Store && MayAlias(Whole(inst->Operand(1 + node.a)), location)) {
+                    return true;
+                }
+            }
+            return false;
+        default:
+            return false;
+    }
+}
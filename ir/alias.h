@@ -0,0 +1,40 @@
+#ifndef COMPILER_ALIAS_H
+#define COMPILER_ALIAS_H
+
+#include "ir.h"
+
+// Where a pointer points: an offset from the global or alloca it is derived
+// from. Array elements have no exact offset; pointers from parameters, phis
+// or calls are their own root, which may be anything, though different
+// offsets from the same root are still different slots.
+struct Location {
+    Inst *root = nullptr;
+    long long offset = 0;
+    bool exact = false;
+    // The innermost array element the pointer lies in and its offset there,
+    // which tells apart the fields of one element.
+    Inst *element = nullptr;
+    long long field = 0;
+};
+
+Location LocationOf(Inst *pointer);
+
+// The slots a store or a copy writes. A copy covers more than the first
+// slot of its destination, so its location is never exact.
+Location LocationWritten(Inst *write);
+
+// Distinct globals and allocas never overlap, so only pointers with the same
+// root, or with an unknown one, may refer to the same slot.
+bool MayAlias(const Location &a, const Location &b);
+
+// Whether arrays at the two pointers may share a slot, however long they
+// are.
+bool MayOverlap(Inst *a, Inst *b);
+
+// Whether the instruction may change what is stored at the location. Stores
+// and copies write through their destination, a vector kernel through the
+// streams it stores to; a call may write anything outside the frame and the
+// allocas whose addresses it is passed.
+bool MayClobber(Inst *inst, const Location &location);
+
+#endif //COMPILER_ALIAS_H
@@ -0,0 +1,115 @@
+#ifndef COMPILER_ANALYSIS_H
+#define COMPILER_ANALYSIS_H
+
+#include <memory>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ir.h"
+
+// The analyses a transform leaves valid when it changes a function.
+class Preserved {
+public:
+    static Preserved All() {
+        Preserved preserved;
+        preserved.all = true;
+        return preserved;
+    }
+
+    template<class T>
+    Preserved &Keep() {
+        kept.insert(std::type_index(typeid(T)));
+        return *this;
+    }
+
+    [[nodiscard]] bool Keeps(std::type_index type) const { return all || kept.count(type) > 0; }
+
+private:
+    bool all = false;
+    std::unordered_set<std::type_index> kept;
+};
+
+// Analyses of one function, computed on first request and kept until a pass
+// invalidates them. An analysis is a class constructed either from the
+// function alone or from the function and this cache, through which it can
+// ask for the analyses it builds on; those are remembered, and dropping one
+// drops every analysis built on it.
+class Analyses {
+public:
+    explicit Analyses(IrFunction *function) : function(function) {}
+
+    template<class T>
+    T &Get() {
+        auto type = std::type_index(typeid(T));
+        if (!building.empty()) {
+            users[type].insert(building.back());
+        }
+        auto &slot = cache[type];
+        if (slot == nullptr) {
+            building.push_back(type);
+            if constexpr (std::is_constructible_v<T, IrFunction *, Analyses &>) {
+                slot = std::make_shared<T>(function, *this);
+            } else {
+                slot = std::make_shared<T>(function);
+            }
+            building.pop_back();
+        }
+        return *static_cast<T *>(slot.get());
+    }
+
+    template<class T>
+    [[nodiscard]] bool Has() const {
+        return cache.count(std::type_index(typeid(T))) > 0;
+    }
+
+    template<class T>
+    void Invalidate() {
+        Drop(std::type_index(typeid(T)));
+    }
+
+    // Drops what preserved does not keep.
+    void Invalidate(const Preserved &preserved) {
+        std::vector<std::type_index> dropped;
+        for (auto &[type, analysis]: cache) {
+            if (!preserved.Keeps(type)) {
+                dropped.push_back(type);
+            }
+        }
+        for (auto type: dropped) {
+            Drop(type);
+        }
+    }
+
+    void Invalidate() {
+        cache.clear();
+        users.clear();
+    }
+
+    IrFunction *function;
+
+private:
+    void Drop(std::type_index type) {
+        if (cache.erase(type) == 0) {
+            return;
+        }
+        auto it = users.find(type);
+        if (it == users.end()) {
+            return;
+        }
+        auto dependents = std::move(it->second);
+        users.erase(it);
+        for (auto dependent: dependents) {
+            Drop(dependent);
+        }
+    }
+
+    std::unordered_map<std::type_index, std::shared_ptr<void>> cache;
+    // The analyses built on each analysis.
+    std::unordered_map<std::type_index, std::unordered_set<std::type_index>> users;
+    std::vector<std::type_index> building;
+};
+
+#endif //COMPILER_ANALYSIS_H
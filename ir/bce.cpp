@@ -0,0 +1,128 @@
+#include "bce.h"
+
+static bool InBounds(const Range &range, Inst *element) {
+    return range.Within(element->imm, element->imm + element->imm2 - 1);
+}
+
+bool BoundsCheckElimination::CanHoist(const Loop *loop) const {
+    if (!RangeAnalysis::IsGuarded(loop) || loop->Preheader() == nullptr) {
+        return false;
+    }
+    for (auto block: loop->blocks) {
+        auto inner = loops.LoopOf(block);
+        if (inner != loop && !inner->IsCounted()) {
+            return false;
+        }
+        for (auto succ: block->succs) {
+            if (!loop->Contains(succ) && block != loop->exit_test->block) {
+                return false;
+            }
+        }
+        for (auto inst: block->insts) {
+            switch (inst->op) {
+                case IrOp::Call:
+                case IrOp::Read:
+                case IrOp::Write:
+                case IrOp::WriteLn:
+                    return false;
+                default:
+                    break;
+            }
+        }
+    }
+    return true;
+}
+
+void BoundsCheckElimination::Check(Block *preheader, Inst *element, Inst *bound, Inst *offset,
+                                   std::vector<Inst *> &checks) {
+    auto range = ranges.Of(bound);
+    if (offset != nullptr) {
+        range = range.Shifted(offset->imm);
+    }
+    if (InBounds(range, element)) {
+        return;
+    }
+    auto is_index = [&](Inst *index) {
+        if (offset == nullptr) {
+            return index == bound;
+        }
+        return index->op == IrOp::Add && index->Operand(0) == bound && index->Operand(1) == offset;
+    };
+    for (auto check: checks) {
+        if (check->imm == element->imm && check->imm2 == element->imm2 && is_index(check->Operand(1))) {
+            return;
+        }
+    }
+    auto index = bound;
+    if (offset != nullptr) {
+        index = function->New(IrOp::Add, IrType::Int);
+        index->AddOperand(bound);
+        index->AddOperand(offset);
+        preheader->Append(index);
+    }
+    auto check = function->New(IrOp::Element, IrType::Ptr);
+    check->AddOperand(element->Operand(0));
+    check->AddOperand(index);
+    check->imm = element->imm;
+    check->imm2 = element->imm2;
+    check->imm3 = element->imm3;
+    check->checked = true;
+    check->pos = element->pos;
+    preheader->Append(check);
+    checks.push_back(check);
+}
+
+void BoundsCheckElimination::Hoist(Loop *loop) {
+    auto preheader = loop->Preheader();
+    std::vector<Inst *> checks;
+    for (auto block: loop->blocks) {
+        if (!tree.Dominates(block, loop->exit_test->block)) {
+            continue;
+        }
+        for (auto element: block->insts) {
+            if (element->op != IrOp::Element || !element->checked || !loop->IsInvariant(element->Operand(0))) {
+                continue;
+            }
+            // The index is the induction variable plus a constant.
+            auto index = element->Operand(1);
+            Inst *constant = nullptr;
+            if (index->op == IrOp::Add && index->Operand(0) == loop->induction && index->Operand(1)->IsConstant()) {
+                constant = index->Operand(1);
+            } else if (index->op == IrOp::Add && index->Operand(1) == loop->induction &&
+                       index->Operand(0)->IsConstant()) {
+                constant = index->Operand(0);
+            } else if (index->op == IrOp::Sub && index->Operand(0) == loop->induction &&
+                       index->Operand(1)->IsConstant()) {
+                constant = function->Int(-index->Operand(1)->imm);
+            } else if (index != loop->induction) {
+                continue;
+            }
+            Check(preheader, element, loop->begin, constant, checks);
+            Check(preheader, element, loop->end, constant, checks);
+            element->checked = false;
+            ++hoisted;
+        }
+    }
+}
+
+bool BoundsCheckElimination::Run() {
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->op == IrOp::Element && inst->checked && InBounds(ranges.Of(inst->Operand(1)), inst)) {
+                inst->checked = false;
+                ++removed;
+            }
+        }
+    }
+    auto &all = loops.Loops();
+    for (auto it = all.rbegin(); it != all.rend(); ++it) {
+        if (CanHoist(*it)) {
+            Hoist(*it);
+        }
+    }
+    if (stats != nullptr) {
+        stats->Add("bce.removed", (long long) removed);
+        stats->Add("bce.hoisted", (long long) hoisted);
+    }
+    return removed + hoisted != 0;
+}
@@ -0,0 +1,45 @@
+#ifndef COMPILER_BCE_H
+#define COMPILER_BCE_H
+
+#include <vector>
+
+#include "analysis.h"
+#include "dominance.h"
+#include "ir.h"
+#include "loops.h"
+#include "range.h"
+#include "statistics.h"
+
+// Bounds-check elimination. A checked element whose index range lies within
+// the declared bounds of the array is unchecked. In a for loop that runs all
+// its iterations, with no output or calls that could tell when a check
+// fails, an element indexed by the induction variable plus a constant is
+// instead checked once in the preheader for the first and the last index.
+class BoundsCheckElimination {
+public:
+    BoundsCheckElimination(IrFunction *function, Analyses &analyses, Statistics *stats = nullptr)
+            : function(function), tree(analyses.Get<DominatorTree>()), loops(analyses.Get<LoopForest>()),
+              ranges(analyses.Get<RangeAnalysis>()), stats(stats) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    [[nodiscard]] bool CanHoist(const Loop *loop) const;
+
+    void Hoist(Loop *loop);
+
+    // Checks bound plus offset as an index of element in the preheader,
+    // unless its range already shows it in bounds.
+    void Check(Block *preheader, Inst *element, Inst *bound, Inst *offset, std::vector<Inst *> &checks);
+
+    IrFunction *function;
+    const DominatorTree &tree;
+    const LoopForest &loops;
+    RangeAnalysis &ranges;
+    Statistics *stats;
+    size_t removed = 0;
+    size_t hoisted = 0;
+};
+
+#endif //COMPILER_BCE_H
@@ -0,0 +1,579 @@
+#include "builder.h"
+
+#include <algorithm>
+
+#include "mem2reg.h"
+#include "../parser/parser.h"
+
+static IrOp Select(ValueKind kind, IrOp integer, IrOp real, IrOp string) {
+    switch (kind) {
+        case ValueKind::Double:
+            return real;
+        case ValueKind::String:
+            return string;
+        default:
+            return integer;
+    }
+}
+
+static Pred PredOf(Operators op) {
+    switch (op) {
+        case Operators::EQUAL:
+            return Pred::Eq;
+        case Operators::UNEQUAL:
+            return Pred::Ne;
+        case Operators::LESS:
+            return Pred::Lt;
+        case Operators::LESSEQUAL:
+            return Pred::Le;
+        case Operators::GREATER:
+            return Pred::Gt;
+        default:
+            return Pred::Ge;
+    }
+}
+
+IrType IrBuilder::TypeOf(SymbolType *type) {
+    switch (KindOf(type)) {
+        case ValueKind::Double:
+            return IrType::Double;
+        case ValueKind::String:
+            return IrType::String;
+        case ValueKind::Aggregate:
+            return IrType::Ptr;
+        default:
+            return IrType::Int;
+    }
+}
+
+Inst *IrBuilder::Emit(IrOp op, IrType type, std::vector<Inst *> operands, Position pos) {
+    auto inst = function->New(op, type);
+    for (auto operand: operands) {
+        inst->AddOperand(operand);
+    }
+    inst->pos = pos;
+    block->Append(inst);
+    return inst;
+}
+
+Inst *IrBuilder::Alloca(SymbolType *type) {
+    auto inst = function->New(IrOp::Alloca, IrType::Ptr);
+    inst->imm = SlotsOf(type);
+    if (IsScalar(type)) {
+        inst->element = TypeOf(type);
+    }
+    allocas.push_back(inst);
+    return inst;
+}
+
+Inst *IrBuilder::Expression(Node *node) {
+    if (node->value.has_value()) {
+        return Constant(*node->value);
+    }
+    node->Accept(this);
+    return value;
+}
+
+Inst *IrBuilder::Constant(const ConstValue &constant) {
+    if (std::holds_alternative<std::string>(constant)) {
+        return function->String(std::get<std::string>(constant));
+    }
+    if (std::holds_alternative<double>(constant)) {
+        return function->Double(std::get<double>(constant));
+    }
+    if (std::holds_alternative<bool>(constant)) {
+        return function->Int(std::get<bool>(constant));
+    }
+    return function->Int(std::get<long long>(constant));
+}
+
+Inst *IrBuilder::Designator(Node *node) {
+    if (auto var = dynamic_cast<NodeVar *>(node)) {
+        auto shared = program_vars.find(var->symbol);
+        if (shared != program_vars.end() && (function != module->main || globals.count(var->symbol))) {
+            return function->GlobalAddress(Slot(var->symbol, shared->second));
+        }
+        return places.at(var->symbol);
+    }
+    if (auto record_access = dynamic_cast<NodeRecordAccess *>(node)) {
+        auto base = Designator(record_access->rec);
+        auto record = dynamic_cast<SymbolRecord *>(record_access->rec->symbol_type->Resolve());
+        auto field = dynamic_cast<NodeVar *>(record_access->field);
+        auto offset = FieldOffset(record, field->lexeme.GetValue<std::string>());
+        if (offset == 0) {
+            return base;
+        }
+        auto address = Emit(IrOp::Offset, IrType::Ptr, {base});
+        address->imm = offset;
+        return address;
+    }
+    if (dynamic_cast<NodeArrayAccess *>(node) != nullptr) {
+        // One element per dimension indexed, with the strides of the
+        // row-major layout, so every index keeps its own range check.
+        std::vector<NodeArrayAccess *> chain;
+        auto array = node;
+        while (auto array_access = dynamic_cast<NodeArrayAccess *>(array)) {
+            chain.push_back(array_access);
+            array = array_access->arr;
+        }
+        std::reverse(chain.begin(), chain.end());
+        auto &layout = LayoutOf(array->symbol_type);
+        auto address = Designator(array);
+        for (size_t i = 0; i < chain.size(); ++i) {
+            auto index = Expression(chain[i]->params);
+            address = Emit(IrOp::Element, IrType::Ptr, {address, index}, chain[i]->params->GetPos());
+            address->imm = layout.dimensions[i].low;
+            address->imm2 = layout.dimensions[i].count;
+            address->imm3 = layout.dimensions[i].stride;
+            address->checked = true;
+        }
+        return address;
+    }
+    auto call = dynamic_cast<NodeCallAccess *>(node);
+    auto result = Call(call);
+    auto ret = dynamic_cast<SymbolFunction *>(dynamic_cast<NodeVar *>(call->callable)->symbol)->ret;
+    auto copy = Alloca(ret);
+    Emit(IrOp::Copy, IrType::Void, {copy, result})->imm = SlotsOf(ret);
+    return copy;
+}
+
+Inst *IrBuilder::Call(NodeCallAccess *node) {
+    auto callee = dynamic_cast<SymbolProcedure *>(dynamic_cast<NodeVar *>(node->callable)->symbol);
+    auto params = callee->GetParams();
+    std::vector<Inst *> args;
+    for (size_t i = 0; i < params.size(); ++i) {
+        auto arg = node->params[i];
+        if (dynamic_cast<SymbolVarParam *>(params[i]) != nullptr || !IsScalar(params[i]->type)) {
+            args.push_back(Designator(arg));
+        } else {
+            args.push_back(Expression(arg));
+        }
+    }
+    auto target = functions.at(callee);
+    auto call = Emit(IrOp::Call, target->ret, args, node->GetPos());
+    call->callee = target;
+    return call;
+}
+
+long long IrBuilder::Slot(Symbol *symbol, SymbolType *type) {
+    auto it = globals.find(symbol);
+    if (it != globals.end()) {
+        return it->second;
+    }
+    globals[symbol] = module->globals;
+    module->globals += SlotsOf(type);
+    return globals[symbol];
+}
+
+void IrBuilder::Declare(Symbol *symbol, SymbolType *type, Node *init, bool global) {
+    Inst *place;
+    if (global && globals.count(symbol)) {
+        place = function->GlobalAddress(globals.at(symbol));
+    } else {
+        place = Alloca(type);
+        places[symbol] = place;
+    }
+    if (init != nullptr) {
+        Emit(IrOp::Store, IrType::Void, {place, Expression(init)});
+    }
+}
+
+
+void IrBuilder::Visit(NodeBinaryOperation *node) {
+    auto kind = KindOf(node->left->symbol_type);
+    auto left = Expression(node->left);
+    auto right = Expression(node->right);
+    IrOp op;
+    auto type = IrType::Int;
+    auto pred = Pred::Eq;
+    if (node->lexeme == LexemeType::Operator) {
+        switch (node->lexeme.GetValue<Operators>()) {
+            case Operators::ADD:
+                op = Select(kind, IrOp::Add, IrOp::FAdd, IrOp::Concat);
+                type = left->type;
+                break;
+            case Operators::SUBSTRACT:
+                op = Select(kind, IrOp::Sub, IrOp::FSub, IrOp::Sub);
+                type = left->type;
+                break;
+            case Operators::MULTIPLY:
+                op = Select(kind, IrOp::Mul, IrOp::FMul, IrOp::Mul);
+                type = left->type;
+                break;
+            case Operators::DIVISION:
+                if (kind == ValueKind::Integer) {
+                    left = Emit(IrOp::IToF, IrType::Double, {left});
+                    right = Emit(IrOp::IToF, IrType::Double, {right});
+                }
+                op = IrOp::FDiv;
+                type = IrType::Double;
+                break;
+            default:
+                op = Select(kind, IrOp::Cmp, IrOp::FCmp, IrOp::SCmp);
+                pred = PredOf(node->lexeme.GetValue<Operators>());
+        }
+    } else {
+        switch (node->lexeme.GetValue<AllKeywords>()) {
+            case AllKeywords::DIV:
+                op = IrOp::Div;
+                break;
+            case AllKeywords::MOD:
+                op = IrOp::Mod;
+                break;
+            case AllKeywords::SHL:
+                op = IrOp::Shl;
+                break;
+            case AllKeywords::SHR:
+                op = IrOp::Shr;
+                break;
+            case AllKeywords::AND:
+                op = IrOp::And;
+                break;
+            case AllKeywords::OR:
+                op = IrOp::Or;
+                break;
+            default:
+                op = IrOp::Xor;
+        }
+    }
+    value = Emit(op, type, {left, right}, node->GetPos());
+    value->pred = pred;
+}
+
+
+void IrBuilder::Visit(NodeUnaryOperation *node) {
+    auto operand = Expression(node->operand);
+    if (node->op == Operators::ADD) {
+        value = operand;
+        return;
+    }
+    auto kind = KindOf(node->operand->symbol_type);
+    if (node->op == Operators::SUBSTRACT) {
+        value = Emit(kind == ValueKind::Double ? IrOp::FNeg : IrOp::Neg, operand->type, {operand});
+    } else {
+        value = Emit(kind == ValueKind::Boolean ? IrOp::LNot : IrOp::Not, IrType::Int, {operand});
+    }
+}
+
+
+void IrBuilder::Visit(NodeString *node) {
+    value = function->String(node->lexeme.GetValue<std::string>());
+}
+
+
+void IrBuilder::Visit(NodeNumber *node) {
+    if (node->lexeme == LexemeType::Double) {
+        value = function->Double(node->lexeme.GetValue<double>());
+    } else {
+        value = function->Int(node->lexeme.GetValue<int>());
+    }
+}
+
+
+void IrBuilder::Visit(NodeBoolean *node) {
+    value = function->Int(node->lexeme == AllKeywords::TRUE);
+}
+
+
+void IrBuilder::Visit(NodeVar *node) {
+    value = Emit(IrOp::Load, TypeOf(node->symbol_type), {Designator(node)});
+}
+
+
+void IrBuilder::Visit(NodeRecordAccess *node) {
+    value = Emit(IrOp::Load, TypeOf(node->symbol_type), {Designator(node)});
+}
+
+
+void IrBuilder::Visit(NodeCallAccess *node) {
+    auto ret = dynamic_cast<SymbolFunction *>(dynamic_cast<NodeVar *>(node->callable)->symbol)->ret;
+    value = IsScalar(ret) ? Call(node) : Designator(node);
+}
+
+
+void IrBuilder::Visit(NodeIOCallStatement *node) {
+    if (node->IsRead()) {
+        for (auto &param: node->params) {
+            auto place = Designator(param);
+            auto read = Emit(IrOp::Read, TypeOf(param->symbol_type));
+            read->kind = KindOf(param->symbol_type);
+            Emit(IrOp::Store, IrType::Void, {place, read});
+        }
+        return;
+    }
+    for (auto &param: node->params) {
+        Emit(IrOp::Write, IrType::Void, {Expression(param)})->kind = KindOf(param->symbol_type);
+    }
+    if (node->GetName() == "writeln") {
+        Emit(IrOp::WriteLn, IrType::Void);
+    }
+}
+
+
+void IrBuilder::Visit(NodeArrayAccess *node) {
+    value = Emit(IrOp::Load, TypeOf(node->symbol_type), {Designator(node)});
+}
+
+
+void IrBuilder::Visit(NodeSimpleType *node) {
+}
+
+
+void IrBuilder::Visit(NodeRange *node) {
+}
+
+
+void IrBuilder::Visit(NodeArrayType *node) {
+}
+
+
+void IrBuilder::Visit(NodeField *node) {
+}
+
+
+void IrBuilder::Visit(NodeRecordType *node) {
+}
+
+
+void IrBuilder::Visit(NodeCompoundStatement *node) {
+    for (auto &statement: node->statements) {
+        statement->Accept(this);
+    }
+}
+
+
+void IrBuilder::Visit(NodeAssignmentStatement *node) {
+    auto place = Designator(node->left);
+    auto kind = KindOf(node->left->symbol_type);
+    auto op = node->lexeme.GetValue<Operators>();
+    if (op == Operators::ASSIGN) {
+        Emit(IrOp::Store, IrType::Void, {place, Expression(node->right)});
+        return;
+    }
+    auto current = Emit(IrOp::Load, TypeOf(node->left->symbol_type), {place});
+    auto right = Expression(node->right);
+    Inst *result;
+    switch (op) {
+        case Operators::ADDASSIGN:
+            result = Emit(Select(kind, IrOp::Add, IrOp::FAdd, IrOp::Concat), current->type, {current, right});
+            break;
+        case Operators::SUBSTRACTASSIGN:
+            result = Emit(Select(kind, IrOp::Sub, IrOp::FSub, IrOp::Sub), current->type, {current, right});
+            break;
+        case Operators::MULTIPLYASSIGN:
+            result = Emit(Select(kind, IrOp::Mul, IrOp::FMul, IrOp::Mul), current->type, {current, right});
+            break;
+        default:
+            result = Emit(Select(kind, IrOp::Div, IrOp::FDiv, IrOp::Div), current->type, {current, right},
+                          node->NodeBinaryOperation::GetPos());
+    }
+    Emit(IrOp::Store, IrType::Void, {place, result});
+}
+
+
+void IrBuilder::Visit(NodeUserCallStatement *node) {
+    Call(node);
+}
+
+
+void IrBuilder::Visit(NodeIfStatement *node) {
+    auto condition = Expression(node->exp);
+    auto then_block = function->NewBlock();
+    auto end = function->NewBlock();
+    auto else_block = node->else_statement != nullptr ? function->NewBlock() : end;
+    function->Branch(block, condition, then_block, else_block);
+    block = then_block;
+    node->statement->Accept(this);
+    function->Jump(block, end);
+    if (node->else_statement != nullptr) {
+        block = else_block;
+        node->else_statement->Accept(this);
+        function->Jump(block, end);
+    }
+    block = end;
+}
+
+
+void IrBuilder::Visit(NodeWhileStatement *node) {
+    auto header = function->NewBlock();
+    auto body = function->NewBlock();
+    auto end = function->NewBlock();
+    function->Jump(block, header);
+    block = header;
+    function->Branch(block, Expression(node->exp), body, end);
+    block = body;
+    node->statement->Accept(this);
+    function->Jump(block, header);
+    block = end;
+}
+
+
+// The loop variable is compared with the end value before it is stepped, so
+// a loop up to the largest integer does not overflow.
+void IrBuilder::Visit(NodeForStatement *node) {
+    auto place = Designator(node->var);
+    Emit(IrOp::Store, IrType::Void, {place, Expression(node->exp_begin)});
+    auto end_value = Expression(node->exp_end);
+    bool is_down = node->direction->lexeme == AllKeywords::DOWNTO;
+    auto first = Emit(IrOp::Load, IrType::Int, {place});
+    auto skip = Emit(IrOp::Cmp, IrType::Int, {first, end_value}, node->direction->GetPos());
+    skip->pred = is_down ? Pred::Lt : Pred::Gt;
+    auto body = function->NewBlock();
+    auto latch = function->NewBlock();
+    auto end = function->NewBlock();
+    function->Branch(block, skip, end, body);
+    block = body;
+    node->statement->Accept(this);
+    auto current = Emit(IrOp::Load, IrType::Int, {place});
+    auto done = Emit(IrOp::Cmp, IrType::Int, {current, end_value}, node->direction->GetPos());
+    function->Branch(block, done, end, latch);
+    block = latch;
+    auto next = Emit(IrOp::Add, IrType::Int, {current, function->Int(is_down ? -1 : 1)});
+    Emit(IrOp::Store, IrType::Void, {place, next});
+    function->Jump(block, body);
+    block = end;
+}
+
+
+void IrBuilder::Visit(NodeBlock *node) {
+    for (auto &decl: node->decls) decl->Accept(this);
+    node->comp_stmt->Accept(this);
+}
+
+
+void IrBuilder::Visit(NodeProgram *node) {
+    auto program = dynamic_cast<NodeBlock *>(node->block);
+    for (auto &decl: program->decls) {
+        if (auto proc = dynamic_cast<NodeProcDecl *>(decl)) {
+            auto symbol = dynamic_cast<SymbolProcedure *>(dynamic_cast<NodeVar *>(proc->var)->symbol);
+            auto routine = module->NewFunction(symbol->GetName());
+            routine->is_inline = proc->is_inline;
+            if (auto func = dynamic_cast<SymbolFunction *>(symbol)) {
+                routine->ret = TypeOf(func->ret);
+            }
+            functions[symbol] = routine;
+        } else if (auto var_decl = dynamic_cast<NodeVarDecl *>(decl)) {
+            for (auto &var: var_decl->vars) {
+                program_vars[var->symbol] = var_decl->type->symbol_type;
+                if (!IsScalar(var_decl->type->symbol_type)) {
+                    Slot(var->symbol, var_decl->type->symbol_type);
+                }
+            }
+        } else if (auto const_decl = dynamic_cast<NodeConstDecl *>(decl)) {
+            auto symbol = dynamic_cast<SymbolConst *>(const_decl->var->symbol);
+            program_vars[symbol] = symbol->type;
+        }
+    }
+    module->main = module->NewFunction("main");
+    for (auto &decl: program->decls) {
+        if (dynamic_cast<NodeProcDecl *>(decl) != nullptr) {
+            decl->Accept(this);
+        }
+    }
+
+    function = module->main;
+    block = function->NewBlock();
+    for (auto &decl: program->decls) {
+        if (dynamic_cast<NodeProcDecl *>(decl) == nullptr) {
+            decl->Accept(this);
+        }
+    }
+    program->comp_stmt->Accept(this);
+    function->Ret(block, nullptr);
+    Finish();
+}
+
+
+void IrBuilder::Visit(NodeTypeDecl *node) {
+}
+
+
+void IrBuilder::Visit(NodeVarDecl *node) {
+    auto global = function == module->main;
+    for (auto &var: node->vars) {
+        Declare(var->symbol, node->type->symbol_type, node->exp, global);
+    }
+}
+
+
+void IrBuilder::Visit(NodeConstDecl *node) {
+    auto global = function == module->main;
+    auto symbol = dynamic_cast<SymbolConst *>(node->var->symbol);
+    Declare(symbol, symbol->type, node->exp, global);
+}
+
+
+void IrBuilder::Visit(NodeParam *node) {
+}
+
+
+void IrBuilder::Visit(NodeProcDecl *node) {
+    auto symbol = dynamic_cast<SymbolProcedure *>(dynamic_cast<NodeVar *>(node->var)->symbol);
+    function = functions.at(symbol);
+    block = function->NewBlock();
+    auto params = symbol->GetParams();
+    for (size_t i = 0; i < params.size(); ++i) {
+        auto param = params[i];
+        auto by_reference = dynamic_cast<SymbolVarParam *>(param) != nullptr ||
+                            (!IsScalar(param->type) && dynamic_cast<SymbolConstParam *>(param) != nullptr);
+        auto inst = function->New(IrOp::Param, by_reference ? IrType::Ptr : TypeOf(param->type));
+        inst->imm = (long long) i;
+        function->params.push_back(inst);
+        if (by_reference) {
+            places[param] = inst;
+            continue;
+        }
+        auto place = Alloca(param->type);
+        if (IsScalar(param->type)) {
+            Emit(IrOp::Store, IrType::Void, {place, inst});
+        } else {
+            Emit(IrOp::Copy, IrType::Void, {place, inst})->imm = SlotsOf(param->type);
+        }
+        places[param] = place;
+    }
+    auto func = dynamic_cast<SymbolFunction *>(symbol);
+    Inst *result = nullptr;
+    if (func != nullptr) {
+        Declare(symbol->locals->Get("result"), func->ret, nullptr, false);
+        result = places.at(symbol->locals->Get("result"));
+    }
+    node->block->Accept(this);
+    if (func == nullptr) {
+        function->Ret(block, nullptr);
+    } else if (IsScalar(func->ret)) {
+        function->Ret(block, Emit(IrOp::Load, function->ret, {result}));
+    } else {
+        function->Ret(block, result);
+    }
+    Finish();
+}
+
+
+void IrBuilder::Visit(NodeFuncDecl *node) {
+    Visit(static_cast<NodeProcDecl *>(node));
+}
+
+void IrBuilder::Finish() {
+    auto entry = function->Entry();
+    for (size_t i = 0; i < allocas.size(); ++i) {
+        entry->Insert(i, allocas[i]);
+    }
+    allocas.clear();
+    places.clear();
+    function->Cleanup();
+}
+
+Module *IrBuilder::Build(Node *program) {
+    module = context->New<Module>(context);
+    program->Accept(this);
+    return module;
+}
+
+Module *BuildSsa(CompilationContext *context, Node *program) {
+    auto module = IrBuilder(context).Build(program);
+    for (auto function: module->functions) {
+        Analyses analyses(function);
+        Mem2Reg(function, analyses).Run();
+    }
+    return module;
+}
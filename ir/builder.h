@@ -0,0 +1,124 @@
+#ifndef COMPILER_IR_BUILDER_H
+#define COMPILER_IR_BUILDER_H
+
+#include <map>
+#include <vector>
+
+#include "../visitor.h"
+#include "../symbol/symbol.h"
+#include "../context/context.h"
+#include "ir.h"
+
+class Node;
+
+class NodeCallAccess;
+
+class NodeProcDecl;
+
+// Builds IR from a checked tree. Every variable gets memory, so the result is
+// in SSA form only after mem2reg promotes the scalar allocas. Program-level
+// aggregates and the scalars some routine refers to live in the global area;
+// the other program-level scalars are locals of main.
+class IrBuilder : public Visitor {
+public:
+    explicit IrBuilder(CompilationContext *context) : context(context) {}
+
+    Module *Build(Node *program);
+
+    void Visit(NodeBinaryOperation *node) override;
+
+    void Visit(NodeUnaryOperation *node) override;
+
+    void Visit(NodeString *node) override;
+
+    void Visit(NodeNumber *node) override;
+
+    void Visit(NodeBoolean *node) override;
+
+    void Visit(NodeVar *node) override;
+
+    void Visit(NodeRecordAccess *node) override;
+
+    void Visit(NodeCallAccess *node) override;
+
+    void Visit(NodeIOCallStatement *node) override;
+
+    void Visit(NodeArrayAccess *node) override;
+
+    void Visit(NodeSimpleType *node) override;
+
+    void Visit(NodeRange *node) override;
+
+    void Visit(NodeArrayType *node) override;
+
+    void Visit(NodeField *node) override;
+
+    void Visit(NodeRecordType *node) override;
+
+    void Visit(NodeCompoundStatement *node) override;
+
+    void Visit(NodeAssignmentStatement *node) override;
+
+    void Visit(NodeUserCallStatement *node) override;
+
+    void Visit(NodeIfStatement *node) override;
+
+    void Visit(NodeWhileStatement *node) override;
+
+    void Visit(NodeForStatement *node) override;
+
+    void Visit(NodeBlock *node) override;
+
+    void Visit(NodeProgram *node) override;
+
+    void Visit(NodeTypeDecl *node) override;
+
+    void Visit(NodeVarDecl *node) override;
+
+    void Visit(NodeConstDecl *node) override;
+
+    void Visit(NodeParam *node) override;
+
+    void Visit(NodeProcDecl *node) override;
+
+    void Visit(NodeFuncDecl *node) override;
+
+private:
+    Inst *Emit(IrOp op, IrType type, std::vector<Inst *> operands = {}, Position pos = {});
+
+    Inst *Alloca(SymbolType *type);
+
+    Inst *Expression(Node *node);
+
+    Inst *Constant(const ConstValue &value);
+
+    Inst *Designator(Node *node);
+
+    Inst *Call(NodeCallAccess *node);
+
+    long long Slot(Symbol *symbol, SymbolType *type);
+
+    void Declare(Symbol *symbol, SymbolType *type, Node *init, bool global);
+
+    // Places the allocas at the start of the entry block and drops the
+    // blocks left unreachable after a routine is built.
+    void Finish();
+
+    static IrType TypeOf(SymbolType *type);
+
+    CompilationContext *context;
+    Module *module = nullptr;
+    IrFunction *function = nullptr;
+    Block *block = nullptr;
+    std::vector<Inst *> allocas;
+    std::map<Symbol *, Inst *> places;
+    std::map<Symbol *, SymbolType *> program_vars;
+    std::map<Symbol *, long long> globals;
+    std::map<Symbol *, IrFunction *> functions;
+    Inst *value = nullptr;
+};
+
+// Builds the module of a checked tree and promotes every routine to SSA.
+Module *BuildSsa(CompilationContext *context, Node *program);
+
+#endif //COMPILER_IR_BUILDER_H
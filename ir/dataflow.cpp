@@ -0,0 +1,438 @@
+#include "dataflow.h"
+
+#include <algorithm>
+#include <map>
+
+BitVector::BitVector(size_t size, bool value) : size(size), words((size + 63) / 64) {
+    Fill(value);
+}
+
+void BitVector::Fill(bool value) {
+    std::fill(words.begin(), words.end(), value ? ~uint64_t(0) : 0);
+    Trim();
+}
+
+void BitVector::Trim() {
+    if (size % 64 != 0) {
+        words.back() &= (uint64_t(1) << (size % 64)) - 1;
+    }
+}
+
+bool BitVector::Union(const BitVector &other) {
+    uint64_t changed = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        auto word = words[i] | other.words[i];
+        changed |= word ^ words[i];
+        words[i] = word;
+    }
+    return changed != 0;
+}
+
+bool BitVector::Intersect(const BitVector &other) {
+    uint64_t changed = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        auto word = words[i] & other.words[i];
+        changed |= word ^ words[i];
+        words[i] = word;
+    }
+    return changed != 0;
+}
+
+void BitVector::Subtract(const BitVector &other) {
+    for (size_t i = 0; i < words.size(); ++i) {
+        words[i] &= ~other.words[i];
+    }
+}
+
+size_t BitVector::Count() const {
+    size_t count = 0;
+    for (auto word: words) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+DataflowProblem::DataflowProblem(IrFunction *function, Direction direction, Meet meet)
+        : function(function), direction(direction), meet(meet) {
+    std::vector<std::pair<Block *, size_t>> stack{{function->Entry(), 0}};
+    std::unordered_map<Block *, bool> seen{{function->Entry(), true}};
+    while (!stack.empty()) {
+        auto &[block, next] = stack.back();
+        if (next < block->succs.size()) {
+            auto succ = block->succs[next++];
+            if (!seen[succ]) {
+                seen[succ] = true;
+                stack.emplace_back(succ, 0);
+            }
+            continue;
+        }
+        order.push_back(block);
+        stack.pop_back();
+    }
+    if (direction == Direction::Forward) {
+        std::reverse(order.begin(), order.end());
+    }
+    for (size_t i = 0; i < function->blocks.size(); ++i) {
+        index[function->blocks[i]] = i;
+    }
+}
+
+void DataflowProblem::Allocate(size_t bits) {
+    gen.assign(function->blocks.size(), BitVector(bits));
+    kill.assign(function->blocks.size(), BitVector(bits));
+    boundary = BitVector(bits);
+}
+
+void DataflowProblem::Solve() {
+    auto bits = boundary.Size();
+    auto count = function->blocks.size();
+    // For a backward problem the solver runs from out to in, so it fills
+    // the vectors the other way round.
+    auto &before = direction == Direction::Forward ? in : out;
+    auto &after = direction == Direction::Forward ? out : in;
+    before.assign(count, BitVector(bits, meet == Meet::Intersection));
+    after.assign(count, BitVector(bits, meet == Meet::Intersection));
+
+    std::vector<bool> queued(count, false);
+    std::vector<Block *> work(order.rbegin(), order.rend());
+    for (auto block: order) {
+        queued[index.at(block)] = true;
+    }
+    BitVector carried(bits);
+    while (!work.empty()) {
+        auto block = work.back();
+        work.pop_back();
+        auto i = index.at(block);
+        queued[i] = false;
+        ++visits;
+
+        auto &sources = direction == Direction::Forward ? block->preds : block->succs;
+        auto &value = before[i];
+        if (sources.empty()) {
+            value = boundary;
+        } else {
+            value.Fill(meet == Meet::Intersection);
+            for (auto source: sources) {
+                auto &flowing = after[index.at(source)];
+                const BitVector *incoming = &flowing;
+                if (edge) {
+                    carried = flowing;
+                    if (direction == Direction::Forward) {
+                        edge(source, block, carried);
+                    } else {
+                        edge(block, source, carried);
+                    }
+                    incoming = &carried;
+                }
+                if (meet == Meet::Union) {
+                    value.Union(*incoming);
+                } else {
+                    value.Intersect(*incoming);
+                }
+            }
+        }
+
+        BitVector result = value;
+        result.Subtract(kill[i]);
+        result.Union(gen[i]);
+        if (result == after[i]) {
+            continue;
+        }
+        after[i] = std::move(result);
+        auto &targets = direction == Direction::Forward ? block->succs : block->preds;
+        for (auto target: targets) {
+            auto j = index.at(target);
+            if (!queued[j]) {
+                queued[j] = true;
+                work.push_back(target);
+            }
+        }
+    }
+}
+
+Liveness::Liveness(IrFunction *function)
+        : problem(function, Direction::Backward, Meet::Union) {
+    for (auto param: function->params) {
+        index[param] = values.size();
+        values.push_back(param);
+    }
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->type != IrType::Void) {
+                index[inst] = values.size();
+                values.push_back(inst);
+            }
+        }
+    }
+    problem.Allocate(values.size());
+    for (auto block: function->blocks) {
+        auto i = problem.Index(block);
+        for (auto it = block->insts.rbegin(); it != block->insts.rend(); ++it) {
+            auto inst = *it;
+            if (IsTracked(inst)) {
+                problem.kill[i].Set(Index(inst));
+                problem.gen[i].Reset(Index(inst));
+            }
+            if (inst->op == IrOp::Phi) {
+                continue;
+            }
+            for (auto operand: inst->operands) {
+                if (IsTracked(operand)) {
+                    problem.gen[i].Set(Index(operand));
+                }
+            }
+        }
+    }
+    problem.edge = [this](Block *from, Block *to, BitVector &value) {
+        for (size_t i = 0; i < to->preds.size(); ++i) {
+            if (to->preds[i] != from) {
+                continue;
+            }
+            for (auto phi: to->Phis()) {
+                if (IsTracked(phi->Operand(i))) {
+                    value.Set(Index(phi->Operand(i)));
+                }
+            }
+        }
+    };
+    problem.Solve();
+}
+
+static bool IsDefinition(Inst *inst) {
+    return inst->op == IrOp::Store || inst->op == IrOp::Copy || inst->op == IrOp::Call || inst->op == IrOp::Vector;
+}
+
+// Calls and vector kernels are taken to define every location.
+static bool IsOpaque(Inst *definition) {
+    return definition->op == IrOp::Call || definition->op == IrOp::Vector;
+}
+
+ReachingDefinitions::ReachingDefinitions(IrFunction *function)
+        : problem(function, Direction::Forward, Meet::Union) {
+    std::map<std::pair<Inst *, long long>, std::vector<size_t>> exact;
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (!IsDefinition(inst)) {
+                continue;
+            }
+            Location location;
+            if (!IsOpaque(inst)) {
+                location = LocationWritten(inst);
+            }
+            index[inst] = definitions.size();
+            if (location.exact) {
+                exact[{location.root, location.offset}].push_back(definitions.size());
+            }
+            definitions.push_back(inst);
+            locations.push_back(location);
+        }
+    }
+    same_location.assign(definitions.size(), {});
+    for (auto &[location, group]: exact) {
+        for (auto definition: group) {
+            same_location[definition] = group;
+        }
+    }
+    problem.Allocate(definitions.size());
+    for (auto block: function->blocks) {
+        auto i = problem.Index(block);
+        for (auto inst: block->insts) {
+            if (IsDefinition(inst)) {
+                for (auto other: same_location[index.at(inst)]) {
+                    problem.kill[i].Set(other);
+                }
+                Transfer(inst, problem.gen[i]);
+            }
+        }
+    }
+    problem.Solve();
+}
+
+void ReachingDefinitions::Transfer(Inst *inst, BitVector &value) const {
+    auto definition = index.find(inst);
+    if (definition == index.end()) {
+        return;
+    }
+    for (auto other: same_location[definition->second]) {
+        value.Reset(other);
+    }
+    value.Set(definition->second);
+}
+
+std::vector<Inst *> ReachingDefinitions::Reaching(Inst *load) const {
+    auto value = In(load->block);
+    for (auto inst: load->block->insts) {
+        if (inst == load) {
+            break;
+        }
+        Transfer(inst, value);
+    }
+    auto location = LocationOf(load->Operand(0));
+    std::vector<Inst *> result;
+    value.ForEach([&](size_t i) {
+        if (IsOpaque(definitions[i]) || MayAlias(location, locations[i])) {
+            result.push_back(definitions[i]);
+        }
+    });
+    return result;
+}
+
+static bool IsExpression(Inst *inst) {
+    switch (inst->op) {
+        case IrOp::Const:
+        case IrOp::Param:
+        case IrOp::Global:
+        case IrOp::Alloca:
+        case IrOp::Store:
+        case IrOp::Copy:
+        case IrOp::Phi:
+        case IrOp::Call:
+        case IrOp::Vector:
+        case IrOp::Read:
+        case IrOp::Write:
+        case IrOp::WriteLn:
+            return false;
+        default:
+            return !inst->IsTerminator();
+    }
+}
+
+AvailableExpressions::AvailableExpressions(IrFunction *function)
+        : problem(function, Direction::Forward, Meet::Intersection) {
+    std::map<std::vector<long long>, size_t> keys;
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (!IsExpression(inst)) {
+                continue;
+            }
+            std::vector<long long> key{(long long) inst->op, (long long) inst->type, (long long) inst->pred,
+                                       inst->imm, inst->imm2, inst->imm3, inst->checked};
+            for (auto operand: inst->operands) {
+                key.push_back((long long) operand);
+            }
+            auto it = keys.find(key);
+            if (it == keys.end()) {
+                it = keys.emplace(key, representatives.size()).first;
+                representatives.push_back(inst);
+                if (inst->op == IrOp::Load) {
+                    auto location = LocationOf(inst->Operand(0));
+                    loads.push_back(it->second);
+                    load_locations[it->second] = location;
+                    if (location.root->op == IrOp::Global || location.root->op == IrOp::Alloca) {
+                        loads_by_root[location.root].push_back(it->second);
+                    } else {
+                        unknown_loads.push_back(it->second);
+                    }
+                }
+            }
+            expressions[inst] = it->second;
+        }
+    }
+    problem.Allocate(representatives.size());
+    std::vector<size_t> clobbered;
+    for (auto block: function->blocks) {
+        auto i = problem.Index(block);
+        for (auto inst: block->insts) {
+            Clobbered(inst, clobbered);
+            for (auto load: clobbered) {
+                problem.kill[i].Set(load);
+            }
+            Transfer(inst, problem.gen[i]);
+        }
+    }
+    problem.Solve();
+}
+
+void AvailableExpressions::Clobbered(Inst *inst, std::vector<size_t> &result) const {
+    result.clear();
+    if (!IsDefinition(inst)) {
+        return;
+    }
+    if (IsOpaque(inst)) {
+        for (auto load: loads) {
+            if (MayClobber(inst, load_locations.at(load))) {
+                result.push_back(load);
+            }
+        }
+        return;
+    }
+    auto written = LocationWritten(inst);
+    if (written.root->op != IrOp::Global && written.root->op != IrOp::Alloca) {
+        for (auto load: loads) {
+            if (MayAlias(written, load_locations.at(load))) {
+                result.push_back(load);
+            }
+        }
+        return;
+    }
+    auto same_root = loads_by_root.find(written.root);
+    if (same_root != loads_by_root.end()) {
+        for (auto load: same_root->second) {
+            if (MayAlias(written, load_locations.at(load))) {
+                result.push_back(load);
+            }
+        }
+    }
+    for (auto load: unknown_loads) {
+        if (MayAlias(written, load_locations.at(load))) {
+            result.push_back(load);
+        }
+    }
+}
+
+// Writes kill the loads they may clobber, anything else makes its own
+// expression available.
+void AvailableExpressions::Transfer(Inst *inst, BitVector &value) const {
+    std::vector<size_t> clobbered;
+    Clobbered(inst, clobbered);
+    for (auto load: clobbered) {
+        value.Reset(load);
+    }
+    auto expression = expressions.find(inst);
+    if (expression != expressions.end()) {
+        value.Set(expression->second);
+    }
+}
+
+int AvailableExpressions::ExpressionOf(Inst *inst) const {
+    auto it = expressions.find(inst);
+    return it == expressions.end() ? -1 : (int) it->second;
+}
+
+bool AvailableExpressions::IsAvailable(Inst *inst) const {
+    auto expression = ExpressionOf(inst);
+    if (expression < 0) {
+        return false;
+    }
+    auto value = In(inst->block);
+    for (auto other: inst->block->insts) {
+        if (other == inst) {
+            break;
+        }
+        Transfer(other, value);
+    }
+    return value.Test(expression);
+}
+
+void DumpDataflow(std::ostream &os, IrFunction *function, Analyses &analyses) {
+    IrPrinter printer(function);
+    auto &liveness = analyses.Get<Liveness>();
+    auto &reaching = analyses.Get<ReachingDefinitions>();
+    auto &available = analyses.Get<AvailableExpressions>();
+    os << "function " << function->name << "\n";
+    for (auto block: function->blocks) {
+        os << "b" << block->id << ":\n  live in:";
+        liveness.LiveIn(block).ForEach([&](size_t i) { os << " " << printer.Name(liveness.Values()[i]); });
+        os << "\n  live out:";
+        liveness.LiveOut(block).ForEach([&](size_t i) { os << " " << printer.Name(liveness.Values()[i]); });
+        os << "\n  reaching:";
+        reaching.In(block).ForEach([&](size_t i) {
+            auto definition = reaching.Definitions()[i];
+            os << " " << IrOpName(definition->op) << " "
+               << (definition->op == IrOp::Call ? definition->callee->name : printer.Name(definition->Operand(0)));
+        });
+        os << "\n  available:";
+        available.In(block).ForEach([&](size_t i) { os << " " << printer.Name(available.Representative(i)); });
+        os << "\n";
+    }
+}
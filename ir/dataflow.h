@@ -0,0 +1,193 @@
+#ifndef COMPILER_DATAFLOW_H
+#define COMPILER_DATAFLOW_H
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "alias.h"
+#include "analysis.h"
+#include "ir.h"
+
+// Dense bit set over a fixed universe. Set operations run a 64-bit word at
+// a time in loops the compiler can vectorize.
+class BitVector {
+public:
+    BitVector() = default;
+
+    explicit BitVector(size_t size, bool value = false);
+
+    void Set(size_t i) { words[i / 64] |= uint64_t(1) << (i % 64); }
+
+    void Reset(size_t i) { words[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+    [[nodiscard]] bool Test(size_t i) const { return words[i / 64] >> (i % 64) & 1; }
+
+    void Fill(bool value);
+
+    // Union and Intersect return whether the set changed.
+    bool Union(const BitVector &other);
+
+    bool Intersect(const BitVector &other);
+
+    void Subtract(const BitVector &other);
+
+    [[nodiscard]] size_t Count() const;
+
+    [[nodiscard]] size_t Size() const { return size; }
+
+    template<class F>
+    void ForEach(F &&f) const {
+        for (size_t w = 0; w < words.size(); ++w) {
+            for (auto word = words[w]; word != 0; word &= word - 1) {
+                f(w * 64 + __builtin_ctzll(word));
+            }
+        }
+    }
+
+    bool operator==(const BitVector &other) const { return words == other.words; }
+
+private:
+    void Trim();
+
+    size_t size = 0;
+    std::vector<uint64_t> words;
+};
+
+enum class Direction {
+    Forward, Backward
+};
+
+enum class Meet {
+    Union, Intersection
+};
+
+// A gen/kill problem over the blocks of a function, solved with a worklist
+// seeded in reverse post-order for forward problems and post-order for
+// backward ones. The transfer of a block is out = gen | (in & ~kill) in the
+// direction of the flow; edge, when set, adjusts the value carried along an
+// edge, as liveness does for phi operands.
+class DataflowProblem {
+public:
+    DataflowProblem(IrFunction *function, Direction direction, Meet meet);
+
+    // Sizes gen, kill and the boundary value, all empty, to the universe.
+    void Allocate(size_t bits);
+
+    void Solve();
+
+    [[nodiscard]] size_t Index(Block *block) const { return index.at(block); }
+
+    // Value at the start and at the end of a block, whatever the direction.
+    [[nodiscard]] const BitVector &In(Block *block) const { return in[Index(block)]; }
+
+    [[nodiscard]] const BitVector &Out(Block *block) const { return out[Index(block)]; }
+
+    IrFunction *function;
+    Direction direction;
+    Meet meet;
+    std::vector<BitVector> gen, kill;
+    BitVector boundary;
+    std::function<void(Block *from, Block *to, BitVector &value)> edge;
+
+    // Blocks counted through the worklist, for measurement.
+    size_t visits = 0;
+
+private:
+    std::vector<BitVector> in, out;
+    std::vector<Block *> order;
+    std::unordered_map<Block *, size_t> index;
+};
+
+// Live SSA values: a phi operand is live at the end of the predecessor it
+// comes from rather than at the start of the phi's block.
+class Liveness {
+public:
+    explicit Liveness(IrFunction *function);
+
+    [[nodiscard]] const std::vector<Inst *> &Values() const { return values; }
+
+    [[nodiscard]] size_t Index(Inst *value) const { return index.at(value); }
+
+    [[nodiscard]] bool IsTracked(Inst *value) const { return index.count(value) > 0; }
+
+    [[nodiscard]] const BitVector &LiveIn(Block *block) const { return problem.In(block); }
+
+    [[nodiscard]] const BitVector &LiveOut(Block *block) const { return problem.Out(block); }
+
+    DataflowProblem problem;
+
+private:
+    std::vector<Inst *> values;
+    std::unordered_map<Inst *, size_t> index;
+};
+
+// Memory definitions reaching each point. Stores and copies define the slots
+// they write; a store to an exact location kills the other stores to it.
+// Calls define whatever they may write and kill nothing.
+class ReachingDefinitions {
+public:
+    explicit ReachingDefinitions(IrFunction *function);
+
+    [[nodiscard]] const std::vector<Inst *> &Definitions() const { return definitions; }
+
+    [[nodiscard]] const BitVector &In(Block *block) const { return problem.In(block); }
+
+    // The definitions that may have written what the load reads.
+    [[nodiscard]] std::vector<Inst *> Reaching(Inst *load) const;
+
+    DataflowProblem problem;
+
+private:
+    void Transfer(Inst *inst, BitVector &value) const;
+
+    std::vector<Inst *> definitions;
+    std::vector<Location> locations;
+    std::unordered_map<Inst *, size_t> index;
+    std::vector<std::vector<size_t>> same_location;
+};
+
+// Expressions computed on every path to a point. Instructions with the same
+// operation and operands are one expression; loads are killed by anything
+// that may write their location.
+class AvailableExpressions {
+public:
+    explicit AvailableExpressions(IrFunction *function);
+
+    [[nodiscard]] size_t Count() const { return representatives.size(); }
+
+    // The expression the instruction computes, or -1.
+    [[nodiscard]] int ExpressionOf(Inst *inst) const;
+
+    // The first instruction computing an expression.
+    [[nodiscard]] Inst *Representative(size_t expression) const { return representatives[expression]; }
+
+    [[nodiscard]] const BitVector &In(Block *block) const { return problem.In(block); }
+
+    // Whether the value of the instruction was already computed on every path
+    // reaching it.
+    [[nodiscard]] bool IsAvailable(Inst *inst) const;
+
+    DataflowProblem problem;
+
+private:
+    // The loads a write may change.
+    void Clobbered(Inst *inst, std::vector<size_t> &result) const;
+
+    void Transfer(Inst *inst, BitVector &value) const;
+
+    std::unordered_map<Inst *, size_t> expressions;
+    std::vector<Inst *> representatives;
+    std::vector<size_t> loads;
+    std::unordered_map<size_t, Location> load_locations;
+    std::unordered_map<Inst *, std::vector<size_t>> loads_by_root;
+    std::vector<size_t> unknown_loads;
+};
+
+// Prints live values, reaching definitions and available expressions at the
+// start of every block.
+void DumpDataflow(std::ostream &os, IrFunction *function, Analyses &analyses);
+
+#endif //COMPILER_DATAFLOW_H
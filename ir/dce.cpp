@@ -0,0 +1,170 @@
+#include "dce.h"
+
+#include <algorithm>
+#include <vector>
+
+size_t DeadCodeElimination::RemoveTrivialPhis() {
+    size_t removed = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto block: function->blocks) {
+            for (auto phi: block->Phis()) {
+                Inst *same = nullptr;
+                bool trivial = true;
+                for (auto operand: phi->operands) {
+                    if (operand == phi || operand == same) {
+                        continue;
+                    }
+                    if (same != nullptr) {
+                        trivial = false;
+                        break;
+                    }
+                    same = operand;
+                }
+                if (!trivial || same == nullptr) {
+                    continue;
+                }
+                phi->ReplaceAllUsesWith(same);
+                phi->Erase();
+                ++removed;
+                changed = true;
+            }
+        }
+    }
+    return removed;
+}
+
+// An address is write-only when it is only stored to or copied into, either
+// directly or through offsets derived from it.
+bool DeadCodeElimination::IsWriteOnly(Inst *address) {
+    for (auto user: address->users) {
+        switch (user->op) {
+            case IrOp::Store:
+            case IrOp::Copy:
+                if (user->Operand(0) != address || user->Operand(1) == address) {
+                    return false;
+                }
+                break;
+            case IrOp::Offset:
+                if (!IsWriteOnly(user)) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+size_t DeadCodeElimination::RemoveDeadStores() {
+    size_t removed = 0;
+    std::vector<Inst *> allocas;
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->op == IrOp::Alloca && IsWriteOnly(inst)) {
+                allocas.push_back(inst);
+            }
+        }
+    }
+    for (auto alloca: allocas) {
+        std::vector<Inst *> work = {alloca};
+        while (!work.empty()) {
+            auto address = work.back();
+            work.pop_back();
+            for (auto user: std::vector<Inst *>(address->users)) {
+                if (user->op == IrOp::Offset) {
+                    work.push_back(user);
+                } else {
+                    user->Erase();
+                    ++removed;
+                }
+            }
+        }
+    }
+    return removed;
+}
+
+// Marks everything a side effect or a terminator depends on and erases the
+// rest, which also catches cycles of phis that only feed each other.
+size_t DeadCodeElimination::RemoveUnused() {
+    std::unordered_set<Inst *> live;
+    std::vector<Inst *> work;
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (!inst->IsPure() && live.insert(inst).second) {
+                work.push_back(inst);
+            }
+        }
+    }
+    while (!work.empty()) {
+        auto inst = work.back();
+        work.pop_back();
+        for (auto operand: inst->operands) {
+            if (operand->block != nullptr && live.insert(operand).second) {
+                work.push_back(operand);
+            }
+        }
+    }
+    size_t removed = 0;
+    for (auto block: function->blocks) {
+        for (auto inst: std::vector<Inst *>(block->insts)) {
+            if (!live.count(inst)) {
+                inst->Erase();
+                ++removed;
+            }
+        }
+    }
+    return removed;
+}
+
+size_t DeadCodeElimination::MergeBlocks() {
+    size_t merged = 0;
+    for (auto block: function->blocks) {
+        while (true) {
+            auto terminator = block->Terminator();
+            if (terminator == nullptr || terminator->op != IrOp::Jump) {
+                break;
+            }
+            auto succ = terminator->targets[0];
+            if (succ == block || succ == function->Entry() || succ->preds.size() != 1) {
+                break;
+            }
+            for (auto phi: succ->Phis()) {
+                phi->ReplaceAllUsesWith(phi->Operand(0));
+                phi->Erase();
+            }
+            terminator->Erase();
+            for (auto inst: succ->insts) {
+                inst->block = block;
+                block->insts.push_back(inst);
+            }
+            succ->insts.clear();
+            for (auto next: succ->succs) {
+                std::replace(next->preds.begin(), next->preds.end(), succ, block);
+            }
+            block->succs = succ->succs;
+            succ->preds.clear();
+            succ->succs.clear();
+            ++merged;
+        }
+    }
+    return merged;
+}
+
+bool DeadCodeElimination::Run() {
+    size_t instructions = 0, blocks = 0;
+    for (bool changed = true; changed;) {
+        auto removed = RemoveTrivialPhis() + RemoveDeadStores() + RemoveUnused();
+        auto merged = MergeBlocks();
+        instructions += removed;
+        blocks += merged;
+        changed = removed + merged != 0;
+    }
+    function->Cleanup();
+    if (stats != nullptr) {
+        stats->Add("dce.instructions", (long long) instructions);
+        stats->Add("dce.blocks", (long long) blocks);
+    }
+    return instructions + blocks != 0;
+}
@@ -0,0 +1,37 @@
+#ifndef COMPILER_DCE_H
+#define COMPILER_DCE_H
+
+#include <unordered_set>
+
+#include "analysis.h"
+#include "ir.h"
+#include "statistics.h"
+
+// Removes what the program cannot observe: instructions whose values are
+// never used on the way to a side effect, phis that select a single value,
+// stores to frame memory nobody reads, and jumps into blocks that have no
+// other predecessor, which are merged into the block jumping to them.
+class DeadCodeElimination {
+public:
+    DeadCodeElimination(IrFunction *function, Analyses &, Statistics *stats = nullptr)
+            : function(function), stats(stats) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    size_t RemoveTrivialPhis();
+
+    size_t RemoveDeadStores();
+
+    size_t RemoveUnused();
+
+    size_t MergeBlocks();
+
+    [[nodiscard]] static bool IsWriteOnly(Inst *address);
+
+    IrFunction *function;
+    Statistics *stats;
+};
+
+#endif //COMPILER_DCE_H
@@ -0,0 +1,130 @@
+#include "dominance.h"
+
+#include <algorithm>
+
+DominatorTree::DominatorTree(IrFunction *function) {
+    std::vector<std::pair<Block *, size_t>> stack{{function->Entry(), 0}};
+    index[function->Entry()] = -1;
+    while (!stack.empty()) {
+        auto &[block, next] = stack.back();
+        if (next < block->succs.size()) {
+            auto succ = block->succs[next++];
+            if (!index.count(succ)) {
+                index[succ] = -1;
+                stack.emplace_back(succ, 0);
+            }
+            continue;
+        }
+        order.push_back(block);
+        stack.pop_back();
+    }
+    std::reverse(order.begin(), order.end());
+    auto count = (int) order.size();
+    for (int i = 0; i < count; ++i) {
+        index[order[i]] = i;
+    }
+
+    idom.assign(count, -1);
+    idom[0] = 0;
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (a > b) a = idom[a];
+            while (b > a) b = idom[b];
+        }
+        return a;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int i = 1; i < count; ++i) {
+            int new_idom = -1;
+            for (auto pred: order[i]->preds) {
+                auto it = index.find(pred);
+                if (it == index.end() || idom[it->second] < 0) {
+                    continue;
+                }
+                new_idom = new_idom < 0 ? it->second : intersect(it->second, new_idom);
+            }
+            if (new_idom != idom[i]) {
+                idom[i] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    children.assign(count, {});
+    for (int i = 1; i < count; ++i) {
+        children[idom[i]].push_back(order[i]);
+    }
+    pre.assign(count, 0);
+    post.assign(count, 0);
+    int clock = 0;
+    std::vector<std::pair<int, size_t>> walk{{0, 0}};
+    pre[0] = clock++;
+    while (!walk.empty()) {
+        auto &[node, next] = walk.back();
+        if (next < children[node].size()) {
+            auto child = index[children[node][next++]];
+            pre[child] = clock++;
+            walk.emplace_back(child, 0);
+            continue;
+        }
+        post[node] = clock++;
+        walk.pop_back();
+    }
+
+    frontiers.assign(count, {});
+    for (int i = 0; i < count; ++i) {
+        std::vector<int> preds;
+        for (auto pred: order[i]->preds) {
+            auto it = index.find(pred);
+            if (it != index.end()) {
+                preds.push_back(it->second);
+            }
+        }
+        if (preds.size() < 2) {
+            continue;
+        }
+        for (auto runner: preds) {
+            while (runner != idom[i]) {
+                auto &frontier = frontiers[runner];
+                if (frontier.empty() || frontier.back() != order[i]) {
+                    frontier.push_back(order[i]);
+                }
+                runner = idom[runner];
+            }
+        }
+    }
+}
+
+Block *DominatorTree::Idom(Block *block) const {
+    auto i = index.at(block);
+    return i == 0 ? nullptr : order[idom[i]];
+}
+
+bool DominatorTree::Dominates(Block *a, Block *b) const {
+    auto i = index.at(a);
+    auto j = index.at(b);
+    return pre[i] <= pre[j] && post[j] <= post[i];
+}
+
+bool DominatorTree::Dominates(Inst *def, Inst *use, size_t operand) const {
+    if (def->block == nullptr) {
+        return true;
+    }
+    if (use->op == IrOp::Phi) {
+        return Dominates(def->block, use->block->preds[operand]);
+    }
+    if (def->block != use->block) {
+        return Dominates(def->block, use->block);
+    }
+    auto &insts = def->block->insts;
+    return std::find(insts.begin(), insts.end(), def) < std::find(insts.begin(), insts.end(), use);
+}
+
+const std::vector<Block *> &DominatorTree::Children(Block *block) const {
+    return children[index.at(block)];
+}
+
+const std::vector<Block *> &DominatorTree::Frontier(Block *block) const {
+    return frontiers[index.at(block)];
+}
@@ -0,0 +1,42 @@
+#ifndef COMPILER_DOMINANCE_H
+#define COMPILER_DOMINANCE_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "ir.h"
+
+// Dominator tree of a function by the iterative algorithm of Cooper, Harvey
+// and Kennedy over reverse post-order, with dominance frontiers. Blocks not
+// reachable from the entry are left out.
+class DominatorTree {
+public:
+    explicit DominatorTree(IrFunction *function);
+
+    [[nodiscard]] Block *Idom(Block *block) const;
+
+    [[nodiscard]] bool Dominates(Block *a, Block *b) const;
+
+    // Whether the definition dominates the use; phi uses count at the end of
+    // the incoming block.
+    [[nodiscard]] bool Dominates(Inst *def, Inst *use, size_t operand) const;
+
+    [[nodiscard]] bool IsReachable(Block *block) const { return index.count(block) > 0; }
+
+    [[nodiscard]] const std::vector<Block *> &Children(Block *block) const;
+
+    [[nodiscard]] const std::vector<Block *> &Frontier(Block *block) const;
+
+    // Blocks in reverse post-order, entry first.
+    [[nodiscard]] const std::vector<Block *> &Order() const { return order; }
+
+private:
+    std::vector<Block *> order;
+    std::unordered_map<Block *, int> index;
+    std::vector<int> idom;
+    std::vector<int> pre, post;
+    std::vector<std::vector<Block *>> children;
+    std::vector<std::vector<Block *>> frontiers;
+};
+
+#endif //COMPILER_DOMINANCE_H
@@ -0,0 +1,46 @@
+#include "escape.h"
+
+EscapeAnalysis::EscapeAnalysis(IrFunction *function) {
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->op == IrOp::Alloca) {
+                escapes[inst] = Walk(inst);
+            }
+        }
+    }
+}
+
+const char *EscapeAnalysis::Escapes(Inst *alloca) const {
+    auto it = escapes.find(alloca);
+    return it == escapes.end() ? nullptr : it->second;
+}
+
+const char *EscapeAnalysis::Walk(Inst *pointer) {
+    for (auto user: pointer->users) {
+        const char *reason = nullptr;
+        switch (user->op) {
+            case IrOp::Offset:
+            case IrOp::Element:
+                reason = user->Operand(0) == pointer ? Walk(user) : nullptr;
+                break;
+            case IrOp::Call:
+                reason = "passed to a call";
+                break;
+            case IrOp::Vector:
+                reason = "passed to a vector kernel";
+                break;
+            case IrOp::Store:
+                reason = user->Operand(1) == pointer ? "stored to memory" : nullptr;
+                break;
+            case IrOp::Phi:
+                reason = "merged by a phi";
+                break;
+            default:
+                break;
+        }
+        if (reason != nullptr) {
+            return reason;
+        }
+    }
+    return nullptr;
+}
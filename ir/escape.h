@@ -0,0 +1,26 @@
+#ifndef COMPILER_ESCAPE_H
+#define COMPILER_ESCAPE_H
+
+#include <unordered_map>
+
+#include "ir.h"
+
+// Escape analysis of the allocas of a function. The address of an alloca,
+// or of anything inside it, escapes when it is passed to a call, which is
+// how var and const params are passed, handed to a vector kernel, stored to
+// memory or merged with other pointers by a phi; the routine then no longer
+// sees every access to it.
+class EscapeAnalysis {
+public:
+    explicit EscapeAnalysis(IrFunction *function);
+
+    // How the address of alloca escapes, or nullptr when it does not.
+    [[nodiscard]] const char *Escapes(Inst *alloca) const;
+
+private:
+    const char *Walk(Inst *pointer);
+
+    std::unordered_map<Inst *, const char *> escapes;
+};
+
+#endif //COMPILER_ESCAPE_H
@@ -0,0 +1,87 @@
+#include "fold.h"
+
+template<class T>
+static bool Compare(Pred pred, const T &a, const T &b) {
+    switch (pred) {
+        case Pred::Eq:
+            return a == b;
+        case Pred::Ne:
+            return a != b;
+        case Pred::Lt:
+            return a < b;
+        case Pred::Le:
+            return a <= b;
+        case Pred::Gt:
+            return a > b;
+        default:
+            return a >= b;
+    }
+}
+
+Inst *Fold(IrFunction *function, Inst *inst, const std::vector<Inst *> &operands) {
+    for (auto operand: operands) {
+        if (!operand->IsConstant()) {
+            return nullptr;
+        }
+    }
+    auto a = operands.empty() ? 0 : (unsigned long long) operands[0]->imm;
+    auto b = operands.size() < 2 ? 0 : (unsigned long long) operands[1]->imm;
+    auto x = operands.empty() ? 0.0 : operands[0]->Double();
+    auto y = operands.size() < 2 ? 0.0 : operands[1]->Double();
+    switch (inst->op) {
+        case IrOp::Add:
+            return function->Int((long long) (a + b));
+        case IrOp::Sub:
+            return function->Int((long long) (a - b));
+        case IrOp::Mul:
+            return function->Int((long long) (a * b));
+        case IrOp::Div:
+            if (b == 0) {
+                return nullptr;
+            }
+            return function->Int((long long) b == -1 ? (long long) (0 - a) : (long long) a / (long long) b);
+        case IrOp::Mod:
+            if (b == 0) {
+                return nullptr;
+            }
+            return function->Int((long long) b == -1 ? 0 : (long long) a % (long long) b);
+        case IrOp::Shl:
+            return function->Int((long long) (a << (b & 63)));
+        case IrOp::Shr:
+            return function->Int((long long) (a >> (b & 63)));
+        case IrOp::And:
+            return function->Int((long long) (a & b));
+        case IrOp::Or:
+            return function->Int((long long) (a | b));
+        case IrOp::Xor:
+            return function->Int((long long) (a ^ b));
+        case IrOp::Neg:
+            return function->Int((long long) (0 - a));
+        case IrOp::Not:
+            return function->Int((long long) ~a);
+        case IrOp::LNot:
+            return function->Int(a == 0);
+        case IrOp::FAdd:
+            return function->Double(x + y);
+        case IrOp::FSub:
+            return function->Double(x - y);
+        case IrOp::FMul:
+            return function->Double(x * y);
+        case IrOp::FDiv:
+            return function->Double(x / y);
+        case IrOp::FNeg:
+            return function->Double(-x);
+        case IrOp::IToF:
+            return function->Double((double) (long long) a);
+        case IrOp::Cmp:
+            return function->Int(Compare(inst->pred, (long long) a, (long long) b));
+        case IrOp::FCmp:
+            return function->Int(Compare(inst->pred, x, y));
+        case IrOp::SCmp:
+            return function->Int(Compare(inst->pred, *operands[0]->text, *operands[1]->text));
+        case IrOp::Concat:
+            return function->String(*operands[0]->text + *operands[1]->text);
+        default:
+            return nullptr;
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef COMPILER_FOLD_H
+#define COMPILER_FOLD_H
+
+#include <vector>
+
+#include "ir.h"
+
+// Evaluates an operation on constant operands with the semantics of the VM:
+// integers wrap, shift counts are taken modulo 64 and dividing by -1 never
+// traps. Returns null for operations that are not foldable, such as a
+// division by zero, which has to trap at run time.
+Inst *Fold(IrFunction *function, Inst *inst, const std::vector<Inst *> &operands);
+
+#endif //COMPILER_FOLD_H
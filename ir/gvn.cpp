@@ -0,0 +1,175 @@
+#include "gvn.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "alias.h"
+
+static bool IsCommutative(Inst *inst) {
+    switch (inst->op) {
+        case IrOp::Add:
+        case IrOp::Mul:
+        case IrOp::And:
+        case IrOp::Or:
+        case IrOp::Xor:
+        case IrOp::FAdd:
+        case IrOp::FMul:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static Pred Swapped(Pred pred) {
+    switch (pred) {
+        case Pred::Lt:
+            return Pred::Gt;
+        case Pred::Le:
+            return Pred::Ge;
+        case Pred::Gt:
+            return Pred::Lt;
+        case Pred::Ge:
+            return Pred::Le;
+        default:
+            return pred;
+    }
+}
+
+bool Gvn::IsNumbered(Inst *inst) {
+    switch (inst->op) {
+        case IrOp::Alloca:
+        case IrOp::Load:
+        case IrOp::Call:
+        case IrOp::Vector:
+        case IrOp::Read:
+            return false;
+        default:
+            return inst->type != IrType::Void;
+    }
+}
+
+// Operands of commutative operations and comparisons are ordered so that
+// a + b and b + a, or a < b and b > a, get the same key. Phis are only
+// equal to phis of the same block.
+std::vector<long long> Gvn::Key(Inst *inst) {
+    std::vector<Inst *> operands = inst->operands;
+    auto pred = inst->pred;
+    bool is_compare = inst->op == IrOp::Cmp || inst->op == IrOp::FCmp || inst->op == IrOp::SCmp;
+    if ((IsCommutative(inst) || is_compare) && operands[0]->id > operands[1]->id) {
+        std::swap(operands[0], operands[1]);
+        pred = Swapped(pred);
+    }
+    std::vector<long long> key{(long long) inst->op, (long long) inst->type, is_compare ? (long long) pred : 0,
+                               inst->imm, inst->imm2, inst->imm3, inst->checked};
+    if (inst->op == IrOp::Phi) {
+        key.push_back(inst->block->id);
+    }
+    for (auto operand: operands) {
+        key.push_back((long long) operand);
+    }
+    return key;
+}
+
+bool Gvn::IsClobbered(Inst *point, Inst *load) const {
+    auto location = LocationOf(load->Operand(0));
+    auto clobbers = [&](Block *block, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (MayClobber(block->insts[i], location)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto position = [](Inst *inst) {
+        auto &insts = inst->block->insts;
+        return (size_t) (std::find(insts.begin(), insts.end(), inst) - insts.begin());
+    };
+    if (point->block == load->block) {
+        return clobbers(load->block, position(point) + 1, position(load));
+    }
+    if (clobbers(point->block, position(point) + 1, point->block->insts.size()) ||
+        clobbers(load->block, 0, position(load))) {
+        return true;
+    }
+    // Every path from point to load leaves the block of point once and never
+    // enters it again, so the blocks to check are those reaching the load
+    // without passing through it.
+    std::unordered_set<Block *> visited = {point->block};
+    std::vector<Block *> work(load->block->preds.begin(), load->block->preds.end());
+    while (!work.empty()) {
+        auto block = work.back();
+        work.pop_back();
+        if (!visited.insert(block).second) {
+            continue;
+        }
+        if (clobbers(block, 0, block->insts.size())) {
+            return true;
+        }
+        work.insert(work.end(), block->preds.begin(), block->preds.end());
+    }
+    return false;
+}
+
+void Gvn::Replace(Inst *inst, Inst *value) {
+    if (inst->op == IrOp::Load) {
+        ++loads;
+    } else if (inst->op == IrOp::Offset || inst->op == IrOp::Element) {
+        ++addresses;
+    } else {
+        ++arithmetic;
+    }
+    inst->ReplaceAllUsesWith(value);
+    inst->Erase();
+}
+
+void Gvn::Visit(Block *block) {
+    std::vector<std::vector<long long>> pushed;
+    for (auto inst: std::vector<Inst *>(block->insts)) {
+        if (inst->op == IrOp::Store) {
+            auto value = inst->Operand(1);
+            std::vector<long long> key{(long long) IrOp::Load, (long long) value->type,
+                                       (long long) inst->Operand(0)};
+            table[key].push_back({value, inst});
+            pushed.push_back(key);
+            continue;
+        }
+        if (inst->op == IrOp::Load) {
+            std::vector<long long> key{(long long) IrOp::Load, (long long) inst->type, (long long) inst->Operand(0)};
+            auto it = table.find(key);
+            if (it != table.end() && !it->second.empty() && !IsClobbered(it->second.back().point, inst)) {
+                Replace(inst, it->second.back().value);
+                continue;
+            }
+            table[key].push_back({inst, inst});
+            pushed.push_back(key);
+            continue;
+        }
+        if (!IsNumbered(inst)) {
+            continue;
+        }
+        auto key = Key(inst);
+        auto it = table.find(key);
+        if (it != table.end() && !it->second.empty()) {
+            Replace(inst, it->second.back().value);
+            continue;
+        }
+        table[key].push_back({inst, inst});
+        pushed.push_back(key);
+    }
+    for (auto child: tree.Children(block)) {
+        Visit(child);
+    }
+    for (auto &key: pushed) {
+        table[key].pop_back();
+    }
+}
+
+bool Gvn::Run() {
+    Visit(function->Entry());
+    if (stats != nullptr) {
+        stats->Add("gvn.arithmetic", (long long) arithmetic);
+        stats->Add("gvn.addresses", (long long) addresses);
+        stats->Add("gvn.loads", (long long) loads);
+    }
+    return arithmetic + addresses + loads != 0;
+}
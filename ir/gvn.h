@@ -0,0 +1,53 @@
+#ifndef COMPILER_GVN_H
+#define COMPILER_GVN_H
+
+#include <map>
+#include <vector>
+
+#include "analysis.h"
+#include "dominance.h"
+#include "ir.h"
+#include "statistics.h"
+
+// Global value numbering over the dominator tree. An instruction computing
+// the same operation on the same operands as one dominating it is replaced
+// by that one, which covers arithmetic, comparisons and the offset and
+// element addresses of record fields and array items. A load is replaced by
+// the value a dominating load or store of the same address left there when
+// nothing on the paths in between may write the location.
+class Gvn {
+public:
+    Gvn(IrFunction *function, Analyses &analyses, Statistics *stats = nullptr)
+            : function(function), tree(analyses.Get<DominatorTree>()), stats(stats) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    struct Available {
+        Inst *value;
+        Inst *point;
+    };
+
+    [[nodiscard]] static std::vector<long long> Key(Inst *inst);
+
+    [[nodiscard]] static bool IsNumbered(Inst *inst);
+
+    // Whether a write between point and load, which point dominates, may
+    // change the loaded location.
+    [[nodiscard]] bool IsClobbered(Inst *point, Inst *load) const;
+
+    void Visit(Block *block);
+
+    void Replace(Inst *inst, Inst *value);
+
+    IrFunction *function;
+    const DominatorTree &tree;
+    Statistics *stats;
+    std::map<std::vector<long long>, std::vector<Available>> table;
+    size_t arithmetic = 0;
+    size_t addresses = 0;
+    size_t loads = 0;
+};
+
+#endif //COMPILER_GVN_H
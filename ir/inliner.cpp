@@ -0,0 +1,246 @@
+#include "inliner.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "analysis.h"
+#include "loops.h"
+#include "mem2reg.h"
+
+// Instructions a callee may have beyond the call it replaces.
+static const long long kThreshold = 12;
+
+// Callers are not grown past this many instructions.
+static const size_t kCallerLimit = 2000;
+
+size_t Inliner::Size(IrFunction *function) {
+    size_t size = 0;
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            size += inst->op != IrOp::Jump && inst->op != IrOp::Phi;
+        }
+    }
+    return size;
+}
+
+bool Inliner::HasFrame(IrFunction *function) {
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->op == IrOp::Alloca) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Tarjan's algorithm over the call graph. Components come out callees
+// first; those with more than one routine, or one calling itself, are
+// recursive.
+void Inliner::FindRecursion() {
+    std::unordered_map<IrFunction *, int> index, low;
+    std::unordered_set<IrFunction *> on_stack;
+    std::vector<IrFunction *> stack;
+    std::function<void(IrFunction *)> visit = [&](IrFunction *function) {
+        index[function] = low[function] = (int) index.size();
+        stack.push_back(function);
+        on_stack.insert(function);
+        bool calls_itself = false;
+        for (auto block: function->blocks) {
+            for (auto inst: block->insts) {
+                if (inst->op != IrOp::Call) {
+                    continue;
+                }
+                auto callee = inst->callee;
+                calls_itself |= callee == function;
+                if (!index.count(callee)) {
+                    visit(callee);
+                    low[function] = std::min(low[function], low[callee]);
+                } else if (on_stack.count(callee)) {
+                    low[function] = std::min(low[function], index[callee]);
+                }
+            }
+        }
+        if (low[function] != index[function]) {
+            return;
+        }
+        auto first = std::find(stack.begin(), stack.end(), function);
+        if (calls_itself || stack.end() - first > 1) {
+            recursive.insert(first, stack.end());
+        }
+        for (auto it = first; it != stack.end(); ++it) {
+            on_stack.erase(*it);
+            order.push_back(*it);
+        }
+        stack.erase(first, stack.end());
+    };
+    for (auto function: module->functions) {
+        if (!index.count(function)) {
+            visit(function);
+        }
+    }
+}
+
+bool Inliner::ShouldInline(IrFunction *caller, Inst *call, bool in_loop) {
+    auto callee = call->callee;
+    if (recursive.count(callee)) {
+        ++refused;
+        return false;
+    }
+    if (in_loop && HasFrame(callee)) {
+        return false;
+    }
+    if (sizes[caller] + sizes[callee] > kCallerLimit) {
+        return false;
+    }
+    if (callee->is_inline) {
+        return true;
+    }
+    // The call, its arguments and the return go away; constant arguments
+    // are likely to fold what depends on them.
+    auto cost = (long long) sizes[callee] - 2 - (long long) call->operands.size();
+    for (auto arg: call->operands) {
+        cost -= arg->IsConstant() ? 2 : 0;
+    }
+    return cost <= kThreshold;
+}
+
+// Values without a block are shared by all instructions of a function, so
+// the callee's constants and globals are looked up again in the caller.
+Inst *Inliner::Map(IrFunction *caller, Inst *value) {
+    switch (value->op) {
+        case IrOp::Const:
+            switch (value->type) {
+                case IrType::Double:
+                    return caller->Double(value->Double());
+                case IrType::String:
+                    return caller->String(*value->text);
+                default:
+                    return caller->Int(value->imm);
+            }
+        case IrOp::Global:
+            return caller->GlobalAddress(value->imm);
+        default:
+            return values.at(value);
+    }
+}
+
+void Inliner::Inline(IrFunction *caller, Inst *call) {
+    auto callee = call->callee;
+    values.clear();
+    for (size_t i = 0; i < callee->params.size(); ++i) {
+        values[callee->params[i]] = call->Operand(i);
+    }
+
+    // Everything after the call continues in a block of its own.
+    auto block = call->block;
+    auto rest = caller->NewBlock();
+    auto position = std::find(block->insts.begin(), block->insts.end(), call);
+    for (auto it = position + 1; it != block->insts.end(); ++it) {
+        (*it)->block = rest;
+        rest->insts.push_back(*it);
+    }
+    block->insts.erase(position + 1, block->insts.end());
+    rest->succs = block->succs;
+    for (auto succ: rest->succs) {
+        std::replace(succ->preds.begin(), succ->preds.end(), block, rest);
+    }
+    block->succs.clear();
+
+    std::unordered_map<Block *, Block *> blocks;
+    for (auto original: callee->blocks) {
+        blocks[original] = caller->NewBlock();
+    }
+    // Instructions first, operands once every value has its copy.
+    std::vector<std::pair<Inst *, Inst *>> copies;
+    std::vector<std::pair<Block *, Inst *>> returns;
+    for (auto original: callee->blocks) {
+        auto copy = blocks.at(original);
+        for (auto pred: original->preds) {
+            copy->preds.push_back(blocks.at(pred));
+        }
+        for (auto succ: original->succs) {
+            copy->succs.push_back(blocks.at(succ));
+        }
+        for (auto inst: original->insts) {
+            if (inst->op == IrOp::Ret) {
+                returns.emplace_back(copy, inst->operands.empty() ? nullptr : inst->Operand(0));
+                continue;
+            }
+            auto clone = caller->Clone(inst);
+            for (auto &target: clone->targets) {
+                target = blocks.at(target);
+            }
+            clone->block = copy;
+            copy->insts.push_back(clone);
+            values[inst] = clone;
+            copies.emplace_back(inst, clone);
+        }
+    }
+    for (auto &[inst, clone]: copies) {
+        for (auto operand: inst->operands) {
+            clone->AddOperand(Map(caller, operand));
+        }
+    }
+
+    Inst *result = nullptr;
+    for (auto &[from, value]: returns) {
+        caller->Jump(from, rest);
+    }
+    if (call->type != IrType::Void) {
+        if (returns.size() == 1) {
+            result = Map(caller, returns.front().second);
+        } else {
+            result = caller->New(IrOp::Phi, call->type);
+            for (auto &[from, value]: returns) {
+                result->AddOperand(Map(caller, value));
+            }
+            rest->Insert(0, result);
+        }
+        call->ReplaceAllUsesWith(result);
+    }
+    call->Erase();
+    caller->Jump(block, blocks.at(callee->Entry()));
+    sizes[caller] += sizes[callee];
+}
+
+bool Inliner::Run() {
+    FindRecursion();
+    for (auto function: module->functions) {
+        sizes[function] = Size(function);
+    }
+    for (auto caller: order) {
+        std::vector<std::pair<Inst *, bool>> calls;
+        {
+            Analyses analyses(caller);
+            auto &loops = analyses.Get<LoopForest>();
+            for (auto block: caller->blocks) {
+                for (auto inst: block->insts) {
+                    if (inst->op == IrOp::Call) {
+                        calls.emplace_back(inst, loops.LoopOf(block) != nullptr);
+                    }
+                }
+            }
+        }
+        size_t before = inlined;
+        for (auto &[call, in_loop]: calls) {
+            if (ShouldInline(caller, call, in_loop)) {
+                Inline(caller, call);
+                ++inlined;
+            }
+        }
+        if (inlined == before) {
+            continue;
+        }
+        // Variables the caller passed by reference may now be promoted.
+        caller->Cleanup();
+        Analyses analyses(caller);
+        Mem2Reg(caller, analyses).Run();
+        sizes[caller] = Size(caller);
+    }
+    if (stats != nullptr) {
+        stats->Add("inline.calls", (long long) inlined);
+        stats->Add("inline.recursive", (long long) refused);
+    }
+    return inlined != 0;
+}
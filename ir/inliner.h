@@ -0,0 +1,52 @@
+#ifndef COMPILER_INLINER_H
+#define COMPILER_INLINER_H
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ir.h"
+#include "statistics.h"
+
+// Replaces calls of small routines by a copy of their body. Routines are
+// visited callees first, so what a callee inlined itself is part of its
+// size. A call is inlined when the callee, less the cost of the call it
+// saves, is under the threshold, or when it was declared inline; either
+// way the caller may not grow past a limit. Routines in a recursive cycle
+// are never inlined. Callees with frame memory of their own are only
+// inlined outside loops, where their memory is still fresh on every call.
+// By-reference parameters become the addresses the caller passed, so var
+// and const parameters keep their meaning; scalars passed through them are
+// promoted again afterwards.
+class Inliner {
+public:
+    explicit Inliner(Module *module, Statistics *stats = nullptr) : module(module), stats(stats) {}
+
+    // Returns whether any call was inlined.
+    bool Run();
+
+private:
+    void FindRecursion();
+
+    [[nodiscard]] bool ShouldInline(IrFunction *caller, Inst *call, bool in_loop);
+
+    void Inline(IrFunction *caller, Inst *call);
+
+    Inst *Map(IrFunction *caller, Inst *value);
+
+    static size_t Size(IrFunction *function);
+
+    static bool HasFrame(IrFunction *function);
+
+    Module *module;
+    Statistics *stats;
+    // Routines in reverse topological order of the call graph.
+    std::vector<IrFunction *> order;
+    std::unordered_set<IrFunction *> recursive;
+    std::unordered_map<IrFunction *, size_t> sizes;
+    std::unordered_map<Inst *, Inst *> values;
+    size_t inlined = 0;
+    size_t refused = 0;
+};
+
+#endif //COMPILER_INLINER_H
@@ -0,0 +1,496 @@
+#include "ir.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../context/context.h"
+
+const char *IrTypeName(IrType type) {
+    static const char *names[] = {"void", "int", "double", "string", "ptr"};
+    return names[(int) type];
+}
+
+const char *IrOpName(IrOp op) {
+    static const char *names[] = {
+#define IR_OPCODE_NAME(name, text) #text,
+            IR_OPCODES(IR_OPCODE_NAME)
+#undef IR_OPCODE_NAME
+    };
+    return names[(int) op];
+}
+
+const char *PredName(Pred pred) {
+    static const char *names[] = {"eq", "ne", "lt", "le", "gt", "ge"};
+    return names[(int) pred];
+}
+
+bool Inst::IsTerminator() const {
+    return op == IrOp::Jump || op == IrOp::Branch || op == IrOp::Ret;
+}
+
+bool Inst::IsPure() const {
+    switch (op) {
+        case IrOp::Store:
+        case IrOp::Copy:
+        case IrOp::Call:
+        case IrOp::Vector:
+        case IrOp::Read:
+        case IrOp::Write:
+        case IrOp::WriteLn:
+        case IrOp::Jump:
+        case IrOp::Branch:
+        case IrOp::Ret:
+            return false;
+        case IrOp::Element:
+            return !checked;
+        case IrOp::Div:
+        case IrOp::Mod:
+            return operands[1]->IsConstant() && operands[1]->imm != 0;
+        default:
+            return true;
+    }
+}
+
+static void RemoveUser(Inst *value, Inst *user) {
+    auto it = std::find(value->users.begin(), value->users.end(), user);
+    if (it != value->users.end()) {
+        value->users.erase(it);
+    }
+}
+
+void Inst::AddOperand(Inst *value) {
+    operands.push_back(value);
+    value->users.push_back(this);
+}
+
+void Inst::SetOperand(size_t i, Inst *value) {
+    RemoveUser(operands[i], this);
+    operands[i] = value;
+    value->users.push_back(this);
+}
+
+void Inst::RemoveOperand(size_t i) {
+    RemoveUser(operands[i], this);
+    operands.erase(operands.begin() + (long) i);
+}
+
+void Inst::DropOperands() {
+    for (auto operand: operands) {
+        RemoveUser(operand, this);
+    }
+    operands.clear();
+}
+
+void Inst::ReplaceAllUsesWith(Inst *value) {
+    auto old_users = users;
+    for (auto user: old_users) {
+        for (size_t i = 0; i < user->operands.size(); ++i) {
+            if (user->operands[i] == this) {
+                user->SetOperand(i, value);
+            }
+        }
+    }
+}
+
+void Inst::Erase() {
+    DropOperands();
+    if (block != nullptr) {
+        block->Remove(this);
+    }
+}
+
+double Inst::Double() const {
+    double value;
+    std::memcpy(&value, &imm, sizeof(value));
+    return value;
+}
+
+Inst *Block::Terminator() const {
+    if (insts.empty() || !insts.back()->IsTerminator()) {
+        return nullptr;
+    }
+    return insts.back();
+}
+
+void Block::Append(Inst *inst) {
+    inst->block = this;
+    if (Terminator() != nullptr) {
+        insts.insert(insts.end() - 1, inst);
+    } else {
+        insts.push_back(inst);
+    }
+}
+
+void Block::Insert(size_t index, Inst *inst) {
+    inst->block = this;
+    insts.insert(insts.begin() + (long) index, inst);
+}
+
+void Block::Remove(Inst *inst) {
+    auto it = std::find(insts.begin(), insts.end(), inst);
+    if (it != insts.end()) {
+        insts.erase(it);
+    }
+    inst->block = nullptr;
+}
+
+std::vector<Inst *> Block::Phis() const {
+    std::vector<Inst *> phis;
+    for (auto inst: insts) {
+        if (inst->op != IrOp::Phi) {
+            break;
+        }
+        phis.push_back(inst);
+    }
+    return phis;
+}
+
+Block *IrFunction::NewBlock() {
+    auto block = module->context->New<Block>(this, next_block++);
+    blocks.push_back(block);
+    return block;
+}
+
+Inst *IrFunction::New(IrOp op, IrType type) {
+    return module->context->New<Inst>(op, type, next_id++);
+}
+
+Inst *IrFunction::Clone(Inst *inst) {
+    auto clone = New(inst->op, inst->type);
+    clone->targets = inst->targets;
+    clone->imm = inst->imm;
+    clone->imm2 = inst->imm2;
+    clone->imm3 = inst->imm3;
+    clone->checked = inst->checked;
+    clone->tail = inst->tail;
+    clone->pred = inst->pred;
+    clone->kind = inst->kind;
+    clone->element = inst->element;
+    clone->text = inst->text;
+    clone->callee = inst->callee;
+    clone->kernel = inst->kernel;
+    clone->pos = inst->pos;
+    return clone;
+}
+
+Inst *IrFunction::Int(long long value) {
+    auto &constant = constants[{IrType::Int, value}];
+    if (constant == nullptr) {
+        constant = New(IrOp::Const, IrType::Int);
+        constant->imm = value;
+    }
+    return constant;
+}
+
+Inst *IrFunction::Double(double value) {
+    long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto &constant = constants[{IrType::Double, bits}];
+    if (constant == nullptr) {
+        constant = New(IrOp::Const, IrType::Double);
+        constant->imm = bits;
+    }
+    return constant;
+}
+
+Inst *IrFunction::String(const std::string &value) {
+    auto text = module->Intern(value);
+    auto &constant = constants[{IrType::String, (long long) text}];
+    if (constant == nullptr) {
+        constant = New(IrOp::Const, IrType::String);
+        constant->text = text;
+    }
+    return constant;
+}
+
+Inst *IrFunction::Zero(IrType type) {
+    switch (type) {
+        case IrType::Double:
+            return Double(0);
+        case IrType::String:
+            return String("");
+        default:
+            return Int(0);
+    }
+}
+
+Inst *IrFunction::GlobalAddress(long long slot) {
+    auto &global = globals[slot];
+    if (global == nullptr) {
+        global = New(IrOp::Global, IrType::Ptr);
+        global->imm = slot;
+    }
+    return global;
+}
+
+void IrFunction::Jump(Block *from, Block *to) {
+    auto inst = New(IrOp::Jump, IrType::Void);
+    inst->targets = {to};
+    from->Append(inst);
+    from->succs = {to};
+    to->preds.push_back(from);
+}
+
+void IrFunction::Branch(Block *from, Inst *condition, Block *then_block, Block *else_block) {
+    auto inst = New(IrOp::Branch, IrType::Void);
+    inst->AddOperand(condition);
+    inst->targets = {then_block, else_block};
+    from->Append(inst);
+    from->succs = {then_block, else_block};
+    then_block->preds.push_back(from);
+    else_block->preds.push_back(from);
+}
+
+void IrFunction::Ret(Block *from, Inst *value) {
+    auto inst = New(IrOp::Ret, IrType::Void);
+    if (value != nullptr) {
+        inst->AddOperand(value);
+    }
+    from->Append(inst);
+    from->succs.clear();
+}
+
+void IrFunction::RemoveEdge(Block *from, Block *to) {
+    auto pred = std::find(to->preds.begin(), to->preds.end(), from);
+    if (pred != to->preds.end()) {
+        auto index = pred - to->preds.begin();
+        to->preds.erase(pred);
+        for (auto phi: to->Phis()) {
+            phi->RemoveOperand(index);
+        }
+    }
+    auto succ = std::find(from->succs.begin(), from->succs.end(), to);
+    if (succ != from->succs.end()) {
+        from->succs.erase(succ);
+    }
+}
+
+void IrFunction::FoldBranch(Block *block, Block *taken) {
+    bool kept = false;
+    for (auto succ: std::vector<Block *>(block->succs)) {
+        if (succ == taken && !kept) {
+            kept = true;
+            continue;
+        }
+        RemoveEdge(block, succ);
+    }
+    block->Terminator()->Erase();
+    auto jump = New(IrOp::Jump, IrType::Void);
+    jump->targets = {taken};
+    block->Append(jump);
+    block->succs = {taken};
+}
+
+void IrFunction::Cleanup() {
+    std::vector<Block *> order;
+    std::unordered_set<Block *> visited;
+    std::function<void(Block *)> visit = [&](Block *block) {
+        visited.insert(block);
+        for (auto succ: block->succs) {
+            if (!visited.count(succ)) {
+                visit(succ);
+            }
+        }
+        order.push_back(block);
+    };
+    visit(Entry());
+    for (auto block: blocks) {
+        if (!visited.count(block)) {
+            for (auto succ: std::vector<Block *>(block->succs)) {
+                RemoveEdge(block, succ);
+            }
+        }
+    }
+    for (auto block: blocks) {
+        if (!visited.count(block)) {
+            for (auto inst: block->insts) {
+                inst->DropOperands();
+            }
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    blocks = order;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        blocks[i]->id = (int) i;
+    }
+    next_block = (int) blocks.size();
+}
+
+IrFunction *Module::NewFunction(const std::string &name) {
+    auto function = context->New<IrFunction>(this, name);
+    functions.push_back(function);
+    return function;
+}
+
+Kernel *Module::NewKernel() {
+    std::lock_guard lock(mutex);
+    return &kernels.emplace_back();
+}
+
+const std::string *Module::Intern(const std::string &text) {
+    std::lock_guard lock(mutex);
+    auto &interned_text = interned[text];
+    if (interned_text == nullptr) {
+        strings.push_back(text);
+        interned_text = &strings.back();
+    }
+    return interned_text;
+}
+
+void Module::Dump(std::ostream &os) const {
+    for (auto function: functions) {
+        DumpFunction(os, function);
+    }
+}
+
+static std::string Quote(const std::string &text) {
+    std::string result = "\"";
+    for (auto c: text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result + "\"";
+}
+
+IrPrinter::IrPrinter(IrFunction *function) : function(function) {
+    for (auto param: function->params) {
+        Number(param);
+    }
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->type != IrType::Void) {
+                Number(inst);
+            }
+        }
+    }
+}
+
+int IrPrinter::Number(Inst *inst) {
+    auto it = numbers.find(inst);
+    if (it != numbers.end()) {
+        return it->second;
+    }
+    auto next = (int) numbers.size();
+    return numbers[inst] = next;
+}
+
+std::string IrPrinter::Name(Inst *inst) {
+    switch (inst->op) {
+        case IrOp::Const:
+            if (inst->type == IrType::Double) {
+                char buffer[32];
+                std::snprintf(buffer, sizeof(buffer), "%.17g", inst->Double());
+                std::string text = buffer;
+                if (text.find_first_of(".en") == std::string::npos) {
+                    text += ".0";
+                }
+                return text;
+            }
+            if (inst->type == IrType::String) {
+                return Quote(*inst->text);
+            }
+            return std::to_string(inst->imm);
+        case IrOp::Global:
+            return "@" + std::to_string(inst->imm);
+        default:
+            return "%" + std::to_string(Number(inst));
+    }
+}
+
+void DumpFunction(std::ostream &os, IrFunction *function) {
+    IrPrinter(function).Print(os);
+}
+
+void IrPrinter::Print(std::ostream &os) {
+    os << "function " << function->name << "(";
+    for (size_t i = 0; i < function->params.size(); ++i) {
+        os << (i > 0 ? ", " : "") << IrTypeName(function->params[i]->type) << " " << Name(function->params[i]);
+    }
+    os << ") -> " << IrTypeName(function->ret) << "\n";
+    for (auto block: function->blocks) {
+        os << "b" << block->id << ":";
+        if (!block->preds.empty()) {
+            os << "  ; preds";
+            for (auto pred: block->preds) {
+                os << " b" << pred->id;
+            }
+        }
+        os << "\n";
+        for (auto inst: block->insts) {
+            os << "  ";
+            if (inst->type != IrType::Void) {
+                os << Name(inst) << " = ";
+            }
+            os << IrOpName(inst->op);
+            switch (inst->op) {
+                case IrOp::Cmp:
+                case IrOp::FCmp:
+                case IrOp::SCmp:
+                    os << " " << PredName(inst->pred);
+                    break;
+                case IrOp::Read:
+                case IrOp::Write: {
+                    static const char *kinds[] = {"int", "double", "bool", "char", "string"};
+                    os << " " << kinds[(int) inst->kind];
+                    break;
+                }
+                case IrOp::Alloca:
+                    if (inst->element != IrType::Void) {
+                        os << " " << IrTypeName(inst->element);
+                    } else {
+                        os << " " << inst->imm;
+                    }
+                    break;
+                case IrOp::Call:
+                    os << (inst->tail ? " tail " : " ") << inst->callee->name;
+                    break;
+                default:
+                    if (inst->type != IrType::Void && inst->type != IrType::Ptr && inst->op != IrOp::IToF &&
+                        inst->op != IrOp::Concat) {
+                        os << " " << IrTypeName(inst->type);
+                    }
+            }
+            if (inst->op == IrOp::Phi) {
+                for (size_t i = 0; i < inst->operands.size(); ++i) {
+                    os << (i > 0 ? "," : "") << " [" << Name(inst->operands[i]) << ", b"
+                       << block->preds[i]->id << "]";
+                }
+            } else {
+                for (size_t i = 0; i < inst->operands.size(); ++i) {
+                    os << (i > 0 ? ", " : " ") << Name(inst->operands[i]);
+                }
+            }
+            switch (inst->op) {
+                case IrOp::Offset:
+                case IrOp::Copy:
+                    os << ", " << inst->imm;
+                    break;
+                case IrOp::Element:
+                    os << ", [" << inst->imm << ".." << inst->imm + inst->imm2 - 1 << "] x " << inst->imm3;
+                    if (!inst->checked) {
+                        os << " unchecked";
+                    }
+                    break;
+                case IrOp::Vector:
+                    os << ", " << inst->kernel->ToString();
+                    break;
+                case IrOp::Jump:
+                    os << " b" << inst->targets[0]->id;
+                    break;
+                case IrOp::Branch:
+                    os << ", b" << inst->targets[0]->id << ", b" << inst->targets[1]->id;
+                    break;
+                default:
+                    break;
+            }
+            os << "\n";
+        }
+    }
+    os << "\n";
+}
@@ -0,0 +1,253 @@
+#ifndef COMPILER_IR_H
+#define COMPILER_IR_H
+
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kernel.h"
+#include "../lexer/lexeme.h"
+#include "../vm/slots.h"
+
+class CompilationContext;
+
+class Block;
+
+class IrFunction;
+
+class Module;
+
+// Value types of the IR. Booleans and chars are integers; aggregates are
+// only ever handled through pointers to their first slot.
+enum class IrType {
+    Void, Int, Double, String, Ptr
+};
+
+const char *IrTypeName(IrType type);
+
+// Operations of the IR:
+//   const                    integer, double or string constant (imm, text)
+//   param                    routine parameter number imm
+//   global                   address of global slot imm
+//   alloca                   imm slots of frame memory, element type for scalars
+//   offset p                 p + imm slots
+//   element p i              address of element i of an array at p: low imm,
+//                            count imm2, stride imm3 slots; checked traps
+//                            when i is out of range
+//   load p / store p v / copy d s (imm slots)
+//   add .. xor, neg, not     integer arithmetic, div and mod trap on zero
+//   fadd .. fdiv, fneg, itof double arithmetic
+//   lnot                     boolean negation
+//   concat                   string concatenation
+//   cmp / fcmp / scmp a b    comparison selected by pred, yields 0 or 1; cmp
+//                            also orders pointers
+//   phi                      one operand per predecessor, in preds order
+//   call                     calls callee with the operands as arguments; a
+//                            tail call returns what the callee does
+//   vector n p.. v.. [a]     runs kernel for n elements over the streams p and
+//                            params v, yields a plus its reduction
+//   read / write v / writeln console I/O of the given kind
+//   jump / branch c / ret    terminators
+#define IR_OPCODES(X) \
+    X(Const, const) X(Param, param) X(Global, global) X(Alloca, alloca) \
+    X(Offset, offset) X(Element, element) X(Load, load) X(Store, store) X(Copy, copy) \
+    X(Add, add) X(Sub, sub) X(Mul, mul) X(Div, div) X(Mod, mod) X(Shl, shl) X(Shr, shr) \
+    X(And, and) X(Or, or) X(Xor, xor) X(Neg, neg) X(Not, not) \
+    X(FAdd, fadd) X(FSub, fsub) X(FMul, fmul) X(FDiv, fdiv) X(FNeg, fneg) X(IToF, itof) \
+    X(LNot, lnot) X(Concat, concat) X(Cmp, cmp) X(FCmp, fcmp) X(SCmp, scmp) \
+    X(Phi, phi) X(Call, call) X(Vector, vector) X(Read, read) X(Write, write) X(WriteLn, writeln) \
+    X(Jump, jump) X(Branch, branch) X(Ret, ret)
+
+enum class IrOp {
+#define IR_OPCODE_ENUM(name, text) name,
+    IR_OPCODES(IR_OPCODE_ENUM)
+#undef IR_OPCODE_ENUM
+};
+
+const char *IrOpName(IrOp op);
+
+enum class Pred {
+    Eq, Ne, Lt, Le, Gt, Ge
+};
+
+const char *PredName(Pred pred);
+
+// An instruction and the value it defines. Constants, parameters and global
+// addresses belong to the function but to no block.
+class Inst {
+public:
+    Inst(IrOp op, IrType type, int id) : op(op), type(type), id(id) {}
+
+    [[nodiscard]] bool IsTerminator() const;
+
+    // True when the instruction may be removed if its value is unused.
+    [[nodiscard]] bool IsPure() const;
+
+    [[nodiscard]] bool IsConstant() const { return op == IrOp::Const; }
+
+    [[nodiscard]] Inst *Operand(size_t i) const { return operands[i]; }
+
+    void AddOperand(Inst *value);
+
+    void SetOperand(size_t i, Inst *value);
+
+    void RemoveOperand(size_t i);
+
+    void DropOperands();
+
+    void ReplaceAllUsesWith(Inst *value);
+
+    // Unlinks the instruction from its block and its operands.
+    void Erase();
+
+    [[nodiscard]] double Double() const;
+
+    IrOp op;
+    IrType type;
+    int id;
+    Block *block = nullptr;
+    std::vector<Inst *> operands;
+    std::vector<Inst *> users;
+    std::vector<Block *> targets;
+    long long imm = 0;
+    long long imm2 = 0;
+    long long imm3 = 0;
+    bool checked = false;
+    bool tail = false;
+    Pred pred = Pred::Eq;
+    ValueKind kind = ValueKind::Integer;
+    IrType element = IrType::Void;
+    const std::string *text = nullptr;
+    IrFunction *callee = nullptr;
+    const Kernel *kernel = nullptr;
+    Position pos;
+};
+
+class Block {
+public:
+    Block(IrFunction *function, int id) : function(function), id(id) {}
+
+    [[nodiscard]] Inst *Terminator() const;
+
+    // Inserts inst before the terminator, or at the end of an open block.
+    void Append(Inst *inst);
+
+    void Insert(size_t index, Inst *inst);
+
+    void Remove(Inst *inst);
+
+    [[nodiscard]] std::vector<Inst *> Phis() const;
+
+    IrFunction *function;
+    int id;
+    std::vector<Inst *> insts;
+    std::vector<Block *> preds;
+    std::vector<Block *> succs;
+};
+
+class IrFunction {
+public:
+    IrFunction(Module *module, std::string name) : module(module), name(std::move(name)) {}
+
+    Block *NewBlock();
+
+    Inst *New(IrOp op, IrType type);
+
+    // A copy of inst with its attributes and targets, but no operands and no
+    // block.
+    Inst *Clone(Inst *inst);
+
+    Inst *Int(long long value);
+
+    Inst *Double(double value);
+
+    Inst *String(const std::string &value);
+
+    Inst *Zero(IrType type);
+
+    Inst *GlobalAddress(long long slot);
+
+    // Sets the terminator of from and links the edges.
+    void Jump(Block *from, Block *to);
+
+    void Branch(Block *from, Inst *condition, Block *then_block, Block *else_block);
+
+    void Ret(Block *from, Inst *value);
+
+    // Removes blocks not reachable from the entry and renumbers the rest in
+    // reverse post-order.
+    void Cleanup();
+
+    void RemoveEdge(Block *from, Block *to);
+
+    // Replaces the terminator of block by a jump to taken, one of its
+    // successors, and drops the other edges.
+    void FoldBranch(Block *block, Block *taken);
+
+    [[nodiscard]] Block *Entry() const { return blocks.front(); }
+
+    Module *module;
+    std::string name;
+    std::vector<Inst *> params;
+    IrType ret = IrType::Void;
+    // The routine was declared with the inline directive.
+    bool is_inline = false;
+    std::vector<Block *> blocks;
+    int next_id = 0;
+    int next_block = 0;
+
+private:
+    std::map<std::pair<IrType, long long>, Inst *> constants;
+    std::map<long long, Inst *> globals;
+};
+
+class Module {
+public:
+    explicit Module(CompilationContext *context) : context(context) {}
+
+    IrFunction *NewFunction(const std::string &name);
+
+    // Interning and kernels are shared by the functions, which may be
+    // optimized concurrently.
+    const std::string *Intern(const std::string &text);
+
+    Kernel *NewKernel();
+
+    void Dump(std::ostream &os) const;
+
+    CompilationContext *context;
+    std::vector<IrFunction *> functions;
+    IrFunction *main = nullptr;
+    int globals = 0;
+
+private:
+    std::map<std::string, const std::string *> interned;
+    std::deque<std::string> strings;
+    std::deque<Kernel> kernels;
+    std::mutex mutex;
+};
+
+// Names values as the dump does: constants and globals by themselves,
+// everything else by number in order of appearance.
+class IrPrinter {
+public:
+    explicit IrPrinter(IrFunction *function);
+
+    std::string Name(Inst *inst);
+
+    void Print(std::ostream &os);
+
+private:
+    int Number(Inst *inst);
+
+    IrFunction *function;
+    std::unordered_map<Inst *, int> numbers;
+};
+
+void DumpFunction(std::ostream &os, IrFunction *function);
+
+#endif //COMPILER_IR_H
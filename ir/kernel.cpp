@@ -0,0 +1,120 @@
+#include "kernel.h"
+
+const char *KernelOpName(Kernel::Op op) {
+    static const char *names[] = {"load", "store", "param", "add", "sub", "mul", "and", "or", "xor", "neg",
+                                  "fadd", "fsub", "fmul", "fdiv"};
+    return names[(int) op];
+}
+
+static int Operands(Kernel::Op op) {
+    switch (op) {
+        case Kernel::Op::Load:
+        case Kernel::Op::Param:
+            return 0;
+        case Kernel::Op::Neg:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+int Kernel::Registers(std::vector<int> &assigned) const {
+    auto size = (int) nodes.size();
+    std::vector<int> last(size, -1);
+    for (int i = 0; i < size; ++i) {
+        auto &node = nodes[i];
+        if (node.op == Op::Store) {
+            last[node.b] = i;
+        } else if (Operands(node.op) != 0) {
+            last[node.a] = i;
+            last[Operands(node.op) == 2 ? node.b : node.a] = i;
+        }
+    }
+    for (int i = 0; i < size; ++i) {
+        if (nodes[i].op == Op::Param || i == reduction) {
+            last[i] = size;
+        }
+    }
+    // Params are set before the first element and take the first registers.
+    // A node takes the register of an operand it is the last use of, the
+    // first operand's when it can.
+    std::vector<int> free;
+    int count = 0;
+    assigned.assign(size, -1);
+    for (int i = 0; i < size; ++i) {
+        if (nodes[i].op == Op::Param) {
+            assigned[i] = count++;
+        }
+    }
+    for (int i = 0; i < size; ++i) {
+        auto &node = nodes[i];
+        if (node.op == Op::Param) {
+            continue;
+        }
+        auto operands = node.op == Op::Store ? 0 : Operands(node.op);
+        for (int j = operands - 1; j >= 0; --j) {
+            auto operand = j == 0 ? node.a : node.b;
+            if (last[operand] == i && (j == 0 || node.a != node.b)) {
+                free.push_back(assigned[operand]);
+            }
+        }
+        if (node.op == Op::Store) {
+            if (last[node.b] == i) {
+                free.push_back(assigned[node.b]);
+            }
+            continue;
+        }
+        if (free.empty()) {
+            free.push_back(count++);
+        }
+        assigned[i] = free.back();
+        free.pop_back();
+    }
+    return count;
+}
+
+long long Kernel::Identity(Op reduce) {
+    return reduce == Op::Mul ? 1 : reduce == Op::And ? -1 : 0;
+}
+
+long long Kernel::Combine(Op reduce, long long a, long long b) {
+    switch (reduce) {
+        case Op::Mul:
+            return (long long) ((unsigned long long) a * (unsigned long long) b);
+        case Op::And:
+            return a & b;
+        case Op::Or:
+            return a | b;
+        default:
+            return (long long) ((unsigned long long) a + (unsigned long long) b);
+    }
+}
+
+std::string Kernel::ToString() const {
+    std::string text = "{";
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        auto &node = nodes[i];
+        text += i == 0 ? "" : "; ";
+        switch (node.op) {
+            case Op::Load:
+                text += "n" + std::to_string(i) + " = load s" + std::to_string(node.a);
+                break;
+            case Op::Store:
+                text += "store s" + std::to_string(node.a) + ", n" + std::to_string(node.b);
+                break;
+            case Op::Param:
+                text += "n" + std::to_string(i) + " = param " + std::to_string(node.a);
+                break;
+            default:
+                text += "n" + std::to_string(i) + " = " + KernelOpName(node.op) + " n" + std::to_string(node.a);
+                if (Operands(node.op) == 2) {
+                    text += ", n" + std::to_string(node.b);
+                }
+        }
+    }
+    if (reduction >= 0) {
+        text += reduce == Op::Add ? "; sum" : std::string("; reduce ") + KernelOpName(reduce);
+        text += " n" + std::to_string(reduction);
+    }
+    return text + (parallel ? "; parallel}" : "}");
+}
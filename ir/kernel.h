@@ -0,0 +1,64 @@
+#ifndef COMPILER_KERNEL_H
+#define COMPILER_KERNEL_H
+
+#include <string>
+#include <vector>
+
+// The body of a vectorized loop, run for count elements in turn. Streams
+// are pointers advancing one slot per element and params are values that
+// stay the same. Every node computes one value per element from those
+// before it; stores write a node to a stream. The values of the reduction
+// node are combined into the accumulator with reduce. Elements are run in
+// order, a few at once: a load may read ahead of a store into the same
+// array, as long as it reads the element before it is overwritten. Only
+// kernels marked parallel, whose elements are independent, may split them
+// between threads and run them in any order.
+struct Kernel {
+    enum class Op {
+        Load, Store, Param, Add, Sub, Mul, And, Or, Xor, Neg, FAdd, FSub, FMul, FDiv
+    };
+
+    // Load a reads stream a, store a b writes node b to stream a, param a is
+    // param a; the arithmetic takes nodes a and b.
+    struct Node {
+        Op op;
+        int a = 0;
+        int b = 0;
+    };
+
+    // Registers kept for node values, with three more left for the
+    // accumulator and temporaries, as the x86 backend has them.
+    static const int kRegisters = 5;
+
+    static const int kStreams = 6;
+
+    static const int kNodes = 16;
+
+    // Elements a thread takes at a time; parallel kernels over fewer run on
+    // one thread.
+    static const int kChunk = 4096;
+
+    // Assigns each node a register, reusing those of nodes no longer needed,
+    // and returns how many there are. Params have theirs throughout, stores
+    // get -1.
+    int Registers(std::vector<int> &assigned) const;
+
+    [[nodiscard]] std::string ToString() const;
+
+    // The value reduce leaves its other operand as, and a combined with b.
+    static long long Identity(Op reduce);
+
+    static long long Combine(Op reduce, long long a, long long b);
+
+    int streams = 0;
+    int params = 0;
+    std::vector<Node> nodes;
+    int reduction = -1;
+    // Add, Mul, And or Or.
+    Op reduce = Op::Add;
+    bool parallel = false;
+};
+
+const char *KernelOpName(Kernel::Op op);
+
+#endif //COMPILER_KERNEL_H
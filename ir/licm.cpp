@@ -0,0 +1,102 @@
+#include "licm.h"
+
+#include "alias.h"
+
+static bool IsObservable(Inst *inst) {
+    switch (inst->op) {
+        case IrOp::Call:
+        case IrOp::Read:
+        case IrOp::Write:
+        case IrOp::WriteLn:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool MayTrap(Inst *inst) {
+    return (inst->op == IrOp::Element && inst->checked) || inst->op == IrOp::Div || inst->op == IrOp::Mod;
+}
+
+bool Licm::IsHoistable(Loop *loop, Inst *inst, const std::vector<Inst *> &writes, bool guaranteed) const {
+    switch (inst->op) {
+        case IrOp::Phi:
+        case IrOp::Alloca:
+            return false;
+        case IrOp::Load:
+            break;
+        default:
+            if (!inst->IsPure() && !(MayTrap(inst) && guaranteed)) {
+                return false;
+            }
+    }
+    if (inst->type == IrType::Void) {
+        return false;
+    }
+    for (auto operand: inst->operands) {
+        if (!loop->IsInvariant(operand)) {
+            return false;
+        }
+    }
+    if (inst->op == IrOp::Load) {
+        auto location = LocationOf(inst->Operand(0));
+        for (auto write: writes) {
+            if (MayClobber(write, location)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Licm::Hoist(Loop *loop) {
+    auto preheader = loop->Preheader();
+    std::vector<Inst *> writes;
+    for (auto block: loop->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->op == IrOp::Store || inst->op == IrOp::Copy || inst->op == IrOp::Call ||
+                inst->op == IrOp::Vector) {
+                writes.push_back(inst);
+            }
+        }
+    }
+    // Blocks are in reverse post-order, so operands defined in the loop are
+    // seen, and hoisted, before their users.
+    for (auto block: loop->blocks) {
+        bool guaranteed = block == loop->header;
+        for (auto inst: std::vector<Inst *>(block->insts)) {
+            if (IsObservable(inst)) {
+                guaranteed = false;
+            }
+            if (!IsHoistable(loop, inst, writes, guaranteed)) {
+                continue;
+            }
+            block->Remove(inst);
+            preheader->Append(inst);
+            ++(inst->op == IrOp::Load ? loads : hoisted);
+        }
+    }
+}
+
+bool Licm::Run() {
+    for (auto loop: analyses.Get<LoopForest>().Loops()) {
+        if (loop->Preheader() == nullptr) {
+            InsertPreheader(function, loop);
+            ++preheaders;
+        }
+    }
+    if (preheaders != 0) {
+        function->Cleanup();
+        analyses.Invalidate();
+    }
+    auto &loops = analyses.Get<LoopForest>().Loops();
+    for (auto it = loops.rbegin(); it != loops.rend(); ++it) {
+        Hoist(*it);
+    }
+    if (stats != nullptr) {
+        stats->Add("licm.preheaders", (long long) preheaders);
+        stats->Add("licm.hoisted", (long long) hoisted);
+        stats->Add("licm.loads", (long long) loads);
+    }
+    return preheaders + hoisted + loads != 0;
+}
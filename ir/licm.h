@@ -0,0 +1,39 @@
+#ifndef COMPILER_LICM_H
+#define COMPILER_LICM_H
+
+#include <vector>
+
+#include "analysis.h"
+#include "ir.h"
+#include "loops.h"
+#include "statistics.h"
+
+// Loop-invariant code motion. Every loop first gets a preheader; then,
+// innermost loops first, instructions whose operands are all computed
+// outside the loop move there. Loads move when nothing in the loop, no
+// store and no call, may write their location. Instructions that may trap,
+// checked elements and divisions, only move from the part of the header
+// before any output or call, which runs whenever the preheader does.
+class Licm {
+public:
+    Licm(IrFunction *function, Analyses &analyses, Statistics *stats = nullptr)
+            : function(function), analyses(analyses), stats(stats) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    void Hoist(Loop *loop);
+
+    [[nodiscard]] bool IsHoistable(Loop *loop, Inst *inst, const std::vector<Inst *> &writes,
+                                   bool guaranteed) const;
+
+    IrFunction *function;
+    Analyses &analyses;
+    Statistics *stats;
+    size_t preheaders = 0;
+    size_t hoisted = 0;
+    size_t loads = 0;
+};
+
+#endif //COMPILER_LICM_H
@@ -0,0 +1,222 @@
+#include "loops.h"
+
+#include <algorithm>
+#include <functional>
+
+bool Loop::Contains(const Loop *loop) const {
+    for (; loop != nullptr; loop = loop->parent) {
+        if (loop == this) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Loop::IsInvariant(Inst *value) const {
+    return value->block == nullptr || !Contains(value->block);
+}
+
+Block *Loop::Preheader() const {
+    Block *preheader = nullptr;
+    for (auto pred: header->preds) {
+        if (Contains(pred)) {
+            continue;
+        }
+        if (preheader != nullptr || pred->succs.size() != 1) {
+            return nullptr;
+        }
+        preheader = pred;
+    }
+    return preheader;
+}
+
+LoopForest::LoopForest(IrFunction *function, Analyses &analyses) : function(function) {
+    Build(analyses.Get<DominatorTree>());
+}
+
+LoopForest::LoopForest(IrFunction *function, const DominatorTree &tree) : function(function) {
+    Build(tree);
+}
+
+void LoopForest::Build(const DominatorTree &tree) {
+    for (auto header: tree.Order()) {
+        std::vector<Block *> latches;
+        for (auto pred: header->preds) {
+            if (tree.IsReachable(pred) && tree.Dominates(header, pred) &&
+                std::find(latches.begin(), latches.end(), pred) == latches.end()) {
+                latches.push_back(pred);
+            }
+        }
+        if (latches.empty()) {
+            continue;
+        }
+        storage.push_back(std::make_unique<Loop>());
+        auto loop = storage.back().get();
+        loop->header = header;
+        loop->latches = latches;
+        loop->members.insert(header);
+        std::vector<Block *> work;
+        for (auto latch: latches) {
+            if (loop->members.insert(latch).second) {
+                work.push_back(latch);
+            }
+        }
+        while (!work.empty()) {
+            auto block = work.back();
+            work.pop_back();
+            for (auto pred: block->preds) {
+                if (tree.IsReachable(pred) && loop->members.insert(pred).second) {
+                    work.push_back(pred);
+                }
+            }
+        }
+
+        // Headers come in reverse post-order, so every enclosing loop has
+        // already claimed the header.
+        auto outer = innermost.find(header);
+        if (outer != innermost.end()) {
+            loop->parent = outer->second;
+            loop->depth = outer->second->depth + 1;
+            outer->second->children.push_back(loop);
+        } else {
+            roots.push_back(loop);
+        }
+        for (auto block: tree.Order()) {
+            if (loop->Contains(block)) {
+                loop->blocks.push_back(block);
+                innermost[block] = loop;
+                for (auto succ: block->succs) {
+                    if (!loop->Contains(succ) &&
+                        std::find(loop->exits.begin(), loop->exits.end(), succ) == loop->exits.end()) {
+                        loop->exits.push_back(succ);
+                    }
+                }
+            }
+        }
+        FindInduction(loop);
+        loops.push_back(loop);
+    }
+}
+
+// Matches the shape for statements are built in: the latch steps the
+// induction phi by one after the block before it found it not yet equal to
+// the invariant end value.
+void LoopForest::FindInduction(Loop *loop) {
+    if (loop->latches.size() != 1 || loop->header->preds.size() != 2) {
+        return;
+    }
+    auto latch = loop->latches[0];
+    auto header = loop->header;
+    auto latch_index = header->preds[0] == latch ? 0 : 1;
+    if (latch->succs.size() != 1 || latch->preds.size() != 1 || latch == header) {
+        return;
+    }
+    auto test = latch->preds[0]->Terminator();
+    if (test == nullptr || test->op != IrOp::Branch || loop->Contains(test->targets[0]) ||
+        test->targets[1] != latch) {
+        return;
+    }
+    auto condition = test->Operand(0);
+    if (condition->op != IrOp::Cmp || condition->pred != Pred::Eq || !loop->IsInvariant(condition->Operand(1))) {
+        return;
+    }
+    auto phi = condition->Operand(0);
+    if (phi->op != IrOp::Phi || phi->block != header) {
+        return;
+    }
+    auto next = phi->Operand(latch_index);
+    if (next->op != IrOp::Add || next->Operand(0) != phi || !next->Operand(1)->IsConstant() ||
+        (next->Operand(1)->imm != 1 && next->Operand(1)->imm != -1)) {
+        return;
+    }
+    loop->induction = phi;
+    loop->begin = phi->Operand(1 - latch_index);
+    loop->end = condition->Operand(1);
+    loop->exit_test = condition;
+    loop->step = next->Operand(1)->imm;
+    if (loop->begin->IsConstant() && loop->end->IsConstant()) {
+        auto count = (loop->end->imm - loop->begin->imm) * loop->step + 1;
+        loop->trip_count = std::max(count, 0LL);
+    }
+}
+
+Loop *LoopForest::LoopOf(Block *block) const {
+    auto it = innermost.find(block);
+    return it == innermost.end() ? nullptr : it->second;
+}
+
+int LoopForest::Depth(Block *block) const {
+    auto loop = LoopOf(block);
+    return loop == nullptr ? 0 : loop->depth;
+}
+
+void LoopForest::Dump(std::ostream &os) const {
+    IrPrinter printer(function);
+    auto blocks = [&](const std::vector<Block *> &list) {
+        std::string text;
+        for (auto block: list) {
+            text += " b" + std::to_string(block->id);
+        }
+        return text;
+    };
+    std::function<void(Loop *)> dump = [&](Loop *loop) {
+        os << std::string(loop->depth * 2, ' ') << "loop b" << loop->header->id << ":" << blocks(loop->blocks)
+           << "; latches" << blocks(loop->latches) << "; exits" << blocks(loop->exits) << "\n";
+        if (loop->IsCounted()) {
+            os << std::string(loop->depth * 2 + 2, ' ') << printer.Name(loop->induction) << " from "
+               << printer.Name(loop->begin) << " to " << printer.Name(loop->end) << " step " << loop->step;
+            if (loop->trip_count >= 0) {
+                os << ", " << loop->trip_count << " iterations";
+            }
+            os << "\n";
+        }
+        for (auto child: loop->children) {
+            dump(child);
+        }
+    };
+    os << "function " << function->name << "\n";
+    for (auto root: roots) {
+        dump(root);
+    }
+}
+
+Block *InsertPreheader(IrFunction *function, Loop *loop) {
+    auto header = loop->header;
+    std::vector<Block *> inside;
+    std::vector<size_t> inside_index, outside_index;
+    for (size_t i = 0; i < header->preds.size(); ++i) {
+        if (loop->Contains(header->preds[i])) {
+            inside.push_back(header->preds[i]);
+            inside_index.push_back(i);
+        } else {
+            outside_index.push_back(i);
+        }
+    }
+    auto preheader = function->NewBlock();
+    for (auto i: outside_index) {
+        auto pred = header->preds[i];
+        preheader->preds.push_back(pred);
+        std::replace(pred->succs.begin(), pred->succs.end(), header, preheader);
+        auto &targets = pred->Terminator()->targets;
+        std::replace(targets.begin(), targets.end(), header, preheader);
+    }
+    for (auto phi: header->Phis()) {
+        auto operands = phi->operands;
+        auto entry = operands[outside_index[0]];
+        if (outside_index.size() > 1) {
+            entry = function->New(IrOp::Phi, phi->type);
+            for (auto i: outside_index) {
+                entry->AddOperand(operands[i]);
+            }
+            preheader->Append(entry);
+        }
+        phi->DropOperands();
+        for (auto i: inside_index) {
+            phi->AddOperand(operands[i]);
+        }
+        phi->AddOperand(entry);
+    }
+    header->preds = inside;
+    function->Jump(preheader, header);
+    return preheader;
+}
@@ -0,0 +1,92 @@
+#ifndef COMPILER_LOOPS_H
+#define COMPILER_LOOPS_H
+
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "analysis.h"
+#include "dominance.h"
+#include "ir.h"
+
+// A natural loop: the header and every block reaching one of its latches
+// without passing the header.
+class Loop {
+public:
+    [[nodiscard]] bool Contains(Block *block) const { return members.count(block) > 0; }
+
+    [[nodiscard]] bool Contains(const Loop *loop) const;
+
+    // Whether the value is computed outside the loop.
+    [[nodiscard]] bool IsInvariant(Inst *value) const;
+
+    // The block outside the loop all entries come from when it has no other
+    // successor, otherwise null.
+    [[nodiscard]] Block *Preheader() const;
+
+    [[nodiscard]] bool IsCounted() const { return induction != nullptr; }
+
+    Block *header = nullptr;
+    std::vector<Block *> blocks;
+    std::vector<Block *> latches;
+    std::vector<Block *> exits;
+    Loop *parent = nullptr;
+    std::vector<Loop *> children;
+    int depth = 1;
+
+    // A loop of a for statement: the induction phi starts at begin and steps
+    // by step until it has been equal to end. trip_count is the number of
+    // times the body runs when begin and end are constants, otherwise -1.
+    Inst *induction = nullptr;
+    Inst *begin = nullptr;
+    Inst *end = nullptr;
+    Inst *exit_test = nullptr;
+    long long step = 0;
+    long long trip_count = -1;
+
+private:
+    friend class LoopForest;
+
+    std::unordered_set<Block *> members;
+};
+
+// The loop nest of a function, outer loops first. Retreating edges to a
+// block that does not dominate their source belong to irreducible cycles
+// and are not loops here.
+class LoopForest {
+public:
+    LoopForest(IrFunction *function, Analyses &analyses);
+
+    LoopForest(IrFunction *function, const DominatorTree &tree);
+
+    [[nodiscard]] const std::vector<Loop *> &Roots() const { return roots; }
+
+    [[nodiscard]] const std::vector<Loop *> &Loops() const { return loops; }
+
+    // The innermost loop containing the block, or null.
+    [[nodiscard]] Loop *LoopOf(Block *block) const;
+
+    [[nodiscard]] int Depth(Block *block) const;
+
+    void Dump(std::ostream &os) const;
+
+private:
+    void Build(const DominatorTree &tree);
+
+    static void FindInduction(Loop *loop);
+
+    IrFunction *function;
+    std::vector<std::unique_ptr<Loop>> storage;
+    std::vector<Loop *> roots;
+    std::vector<Loop *> loops;
+    std::unordered_map<Block *, Loop *> innermost;
+};
+
+// Gives the loop a preheader: a new block all entries into the header go
+// through, with phis merging the values of the entries when there are
+// several. The loop forest and dominator tree have to be rebuilt afterwards.
+Block *InsertPreheader(IrFunction *function, Loop *loop);
+
+#endif //COMPILER_LOOPS_H
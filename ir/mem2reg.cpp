@@ -0,0 +1,153 @@
+#include "mem2reg.h"
+
+#include <unordered_set>
+
+bool Mem2Reg::IsPromotable(Inst *alloca) const {
+    if (alloca->op != IrOp::Alloca || alloca->element == IrType::Void) {
+        return false;
+    }
+    for (auto user: alloca->users) {
+        if (user->op == IrOp::Load) {
+            continue;
+        }
+        if (user->op != IrOp::Store || user->Operand(0) != alloca || user->Operand(1) == alloca) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Mem2Reg::InsertPhis() {
+    for (size_t variable = 0; variable < allocas.size(); ++variable) {
+        auto alloca = allocas[variable];
+        std::vector<Block *> work;
+        std::unordered_set<Block *> has_phi, queued;
+        for (auto user: alloca->users) {
+            if (user->op == IrOp::Store && queued.insert(user->block).second) {
+                work.push_back(user->block);
+            }
+        }
+        while (!work.empty()) {
+            auto block = work.back();
+            work.pop_back();
+            for (auto frontier: tree.Frontier(block)) {
+                if (!has_phi.insert(frontier).second) {
+                    continue;
+                }
+                auto phi = function->New(IrOp::Phi, alloca->element);
+                for (size_t i = 0; i < frontier->preds.size(); ++i) {
+                    phi->AddOperand(function->Zero(alloca->element));
+                }
+                frontier->Insert(0, phi);
+                phis[phi] = variable;
+                if (queued.insert(frontier).second) {
+                    work.push_back(frontier);
+                }
+            }
+        }
+    }
+}
+
+void Mem2Reg::Rename(Block *block) {
+    std::vector<size_t> pushed;
+    for (auto inst: std::vector<Inst *>(block->insts)) {
+        if (inst->op == IrOp::Phi) {
+            auto phi = phis.find(inst);
+            if (phi != phis.end()) {
+                stacks[phi->second].push_back(inst);
+                pushed.push_back(phi->second);
+            }
+            continue;
+        }
+        if (inst->op != IrOp::Load && inst->op != IrOp::Store) {
+            continue;
+        }
+        auto variable = variables.find(inst->Operand(0));
+        if (variable == variables.end()) {
+            continue;
+        }
+        if (inst->op == IrOp::Load) {
+            inst->ReplaceAllUsesWith(stacks[variable->second].back());
+        } else {
+            stacks[variable->second].push_back(inst->Operand(1));
+            pushed.push_back(variable->second);
+        }
+        inst->Erase();
+    }
+    for (auto succ: block->succs) {
+        for (size_t i = 0; i < succ->preds.size(); ++i) {
+            if (succ->preds[i] != block) {
+                continue;
+            }
+            for (auto inst: succ->Phis()) {
+                auto phi = phis.find(inst);
+                if (phi != phis.end()) {
+                    inst->SetOperand(i, stacks[phi->second].back());
+                }
+            }
+        }
+    }
+    for (auto child: tree.Children(block)) {
+        Rename(child);
+    }
+    for (auto variable: pushed) {
+        stacks[variable].pop_back();
+    }
+}
+
+// A phi is dead when nothing but itself uses it, and redundant when all its
+// other operands are the same value.
+void Mem2Reg::RemoveDeadPhis() {
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto it = phis.begin(); it != phis.end();) {
+            auto phi = it->first;
+            Inst *same = nullptr;
+            bool redundant = true;
+            for (auto operand: phi->operands) {
+                if (operand == phi || operand == same) {
+                    continue;
+                }
+                if (same != nullptr) {
+                    redundant = false;
+                    break;
+                }
+                same = operand;
+            }
+            bool used = false;
+            for (auto user: phi->users) {
+                used |= user != phi;
+            }
+            if (used && !(redundant && same != nullptr)) {
+                ++it;
+                continue;
+            }
+            if (used) {
+                phi->ReplaceAllUsesWith(same);
+            }
+            phi->Erase();
+            it = phis.erase(it);
+            changed = true;
+        }
+    }
+}
+
+size_t Mem2Reg::Run() {
+    for (auto inst: function->Entry()->insts) {
+        if (IsPromotable(inst)) {
+            variables[inst] = allocas.size();
+            allocas.push_back(inst);
+            stacks.push_back({function->Zero(inst->element)});
+        }
+    }
+    if (allocas.empty()) {
+        return 0;
+    }
+    InsertPhis();
+    Rename(function->Entry());
+    for (auto alloca: allocas) {
+        alloca->Erase();
+    }
+    RemoveDeadPhis();
+    return allocas.size();
+}
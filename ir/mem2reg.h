@@ -0,0 +1,37 @@
+#ifndef COMPILER_MEM2REG_H
+#define COMPILER_MEM2REG_H
+
+#include "analysis.h"
+#include "dominance.h"
+#include "ir.h"
+
+// Promotes scalar allocas whose address is only loaded from and stored to
+// into SSA values: phis go to the iterated dominance frontier of the stores
+// and loads are renamed along the dominator tree. Variables read before any
+// store get the zero value the VM initializes frames with.
+class Mem2Reg {
+public:
+    Mem2Reg(IrFunction *function, Analyses &analyses)
+            : function(function), tree(analyses.Get<DominatorTree>()) {}
+
+    // Returns the number of promoted allocas.
+    size_t Run();
+
+private:
+    [[nodiscard]] bool IsPromotable(Inst *alloca) const;
+
+    void InsertPhis();
+
+    void Rename(Block *block);
+
+    void RemoveDeadPhis();
+
+    IrFunction *function;
+    const DominatorTree &tree;
+    std::vector<Inst *> allocas;
+    std::unordered_map<Inst *, size_t> variables;
+    std::unordered_map<Inst *, size_t> phis;
+    std::vector<std::vector<Inst *>> stacks;
+};
+
+#endif //COMPILER_MEM2REG_H
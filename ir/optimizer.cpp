@@ -0,0 +1,98 @@
+#include "optimizer.h"
+
+#include "bce.h"
+#include "dce.h"
+#include "dominance.h"
+#include "gvn.h"
+#include "inliner.h"
+#include "licm.h"
+#include "loops.h"
+#include "passes.h"
+#include "sccp.h"
+#include "sroa.h"
+#include "strength.h"
+#include "tailcall.h"
+#include "unroll.h"
+#include "vectorize.h"
+
+Module *Optimize(Module *module, Statistics *stats, const OptimizerOptions &options) {
+    PassManager passes(module, options.threads, options.timings);
+    // Passes leaving the blocks alone keep the dominator tree; the loop
+    // forest also holds the induction variables, which only bounds check
+    // elimination is sure to leave.
+    auto blocks = Preserved().Keep<DominatorTree>();
+    auto loops = Preserved().Keep<DominatorTree>().Keep<LoopForest>();
+    auto sroa = [stats](PassContext &pass) {
+        return ScalarReplacement(pass.function, pass.analyses, stats).Run();
+    };
+    auto sccp = [stats](PassContext &pass) {
+        return Sccp(pass.function, pass.analyses, stats).Run();
+    };
+    auto gvn = [stats](PassContext &pass) {
+        return Gvn(pass.function, pass.analyses, stats).Run();
+    };
+    if (options.level >= 1) {
+        if (options.level >= 2) {
+            // Callees without records left in their frames may be inlined
+            // into loops.
+            passes.Add("sroa", blocks, sroa);
+            passes.AddModule("inline", [stats](Module *module) { return Inliner(module, stats).Run(); });
+        }
+        // Records the inlined callees took by reference are the caller's own
+        // again.
+        passes.Add("sroa", blocks, sroa);
+        if (options.eliminate_tail_calls) {
+            passes.Add("tailcall", Preserved(), [stats, report = options.tail_calls](PassContext &pass) {
+                return TailCallElimination(pass.function, pass.analyses, stats, pass.Out(report)).Run();
+            });
+        }
+        passes.Add("sccp", Preserved(), sccp);
+        if (options.number_values) {
+            passes.Add("gvn", blocks, gvn);
+            // Loads replaced by the values stored there expose new constants.
+            passes.Add("sccp", Preserved(), sccp);
+        }
+        passes.Add("licm", Preserved(), [stats](PassContext &pass) {
+            return Licm(pass.function, pass.analyses, stats).Run();
+        });
+        if (!options.checked) {
+            passes.Add("bce", loops, [stats](PassContext &pass) {
+                return BoundsCheckElimination(pass.function, pass.analyses, stats).Run();
+            });
+        }
+    }
+    if (options.level >= 2) {
+        if (options.vectorize || options.parallelize) {
+            passes.Add("vectorize", Preserved(), [stats, &options](PassContext &pass) {
+                return LoopVectorizer(pass.function, pass.analyses, stats, options.parallelize,
+                                      pass.Out(options.report)).Run();
+            });
+        }
+        if (options.reduce_strength) {
+            passes.Add("strength", blocks, [stats](PassContext &pass) {
+                return StrengthReduction(pass.function, pass.analyses, stats).RunDivisions();
+            });
+        }
+        passes.Add("unroll", Preserved(), [stats, unroll = options.unroll](PassContext &pass) {
+            return LoopUnroller(pass.function, pass.analyses, stats, unroll).Run();
+        });
+        // The copies load what the one before stored, and those of fully
+        // unrolled loops count with constants.
+        if (options.number_values) {
+            passes.AddFollowing("gvn", blocks, gvn);
+        }
+        passes.AddFollowing("sccp", Preserved(), sccp);
+        if (options.reduce_strength) {
+            passes.Add("strength", blocks, [stats](PassContext &pass) {
+                return StrengthReduction(pass.function, pass.analyses, stats).Run();
+            });
+        }
+    }
+    if (options.level >= 1) {
+        passes.Add("dce", Preserved(), [stats](PassContext &pass) {
+            return DeadCodeElimination(pass.function, pass.analyses, stats).Run();
+        });
+    }
+    passes.Run();
+    return module;
+}
@@ -0,0 +1,49 @@
+#ifndef COMPILER_OPTIMIZER_H
+#define COMPILER_OPTIMIZER_H
+
+#include <iostream>
+
+#include "ir.h"
+#include "statistics.h"
+#include "../parallel/thread_pool.h"
+
+struct OptimizerOptions {
+    // 0 leaves the IR as built, 1 runs the passes that do not grow it, 2
+    // also inlines and transforms loops.
+    int level = 2;
+    // Threads the functions are optimized on.
+    int threads = ThreadPool::DefaultThreads();
+    // Keeps every bounds check where the program makes it, for debugging.
+    bool checked = false;
+    // Leaves redundant arithmetic, addresses and loads in place, to measure
+    // what global value numbering gains.
+    bool number_values = true;
+    // Leaves multiplications and divisions as written, to measure what
+    // strength reduction gains.
+    bool reduce_strength = true;
+    // Copies of the body in partially unrolled loops, a power of two; below
+    // 2 no loop is unrolled.
+    int unroll = 4;
+    // Leaves loops over arrays scalar, to measure what vectorization gains.
+    bool vectorize = true;
+    // Keeps calls in tail position, to measure what turning them into jumps
+    // and loops gains.
+    bool eliminate_tail_calls = true;
+    // Lets vectorized loops run on several threads.
+    bool parallelize = false;
+    // Where to say which loops were vectorized or parallelized and why the
+    // others were not.
+    std::ostream *report = nullptr;
+    // Where to say which calls in tail position became jumps or loops.
+    std::ostream *tail_calls = nullptr;
+    // Where to print the time every pass took and how it changed the size
+    // of the IR.
+    std::ostream *timings = nullptr;
+};
+
+// Inlines small routines, then runs the optimization passes of the level
+// over every function of the module, adding what they changed to stats when
+// it is given. Returns the module.
+Module *Optimize(Module *module, Statistics *stats = nullptr, const OptimizerOptions &options = {});
+
+#endif //COMPILER_OPTIMIZER_H
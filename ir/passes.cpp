@@ -0,0 +1,166 @@
+#include "passes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <numeric>
+
+#include "../parallel/thread_pool.h"
+
+static long long Size(IrFunction *function) {
+    long long insts = 0;
+    for (auto block: function->blocks) {
+        insts += (long long) block->insts.size();
+    }
+    return insts;
+}
+
+std::ostream *PassContext::Out(std::ostream *stream) {
+    if (stream == nullptr) {
+        return nullptr;
+    }
+    for (auto &[target, buffer]: buffers) {
+        if (target == stream) {
+            return buffer.get();
+        }
+    }
+    buffers.emplace_back(stream, std::make_unique<std::stringstream>());
+    return buffers.back().second.get();
+}
+
+void PassManager::Add(const std::string &name, Preserved preserved, FunctionPass run) {
+    passes.push_back({name, std::move(preserved), std::move(run), nullptr});
+}
+
+void PassManager::AddFollowing(const std::string &name, Preserved preserved, FunctionPass run) {
+    Add(name, std::move(preserved), std::move(run));
+    passes.back().following = true;
+}
+
+void PassManager::AddModule(const std::string &name, ModulePass run) {
+    passes.push_back({name, Preserved(), nullptr, std::move(run)});
+}
+
+void PassManager::RunStage(IrFunction *function, size_t begin, size_t end, PassContext &context) {
+    bool changed = false;
+    for (auto i = begin; i < end; ++i) {
+        auto &pass = passes[i];
+        if (pass.following && !changed) {
+            continue;
+        }
+        auto blocks = function->blocks;
+        auto insts = Size(function);
+        auto start = std::chrono::steady_clock::now();
+        auto result = pass.run(context);
+        auto milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+        if (result) {
+            context.analyses.Invalidate(pass.preserved);
+        } else if (function->blocks != blocks) {
+            // Cleanup renumbers the blocks even when nothing else changed.
+            context.analyses.Invalidate();
+        }
+        if (!pass.following) {
+            changed = result;
+        }
+        std::lock_guard lock(mutex);
+        pass.milliseconds += milliseconds.count();
+        pass.insts += Size(function) - insts;
+        pass.blocks += (long long) function->blocks.size() - (long long) blocks.size();
+        ++pass.runs;
+        pass.changed += result;
+    }
+}
+
+void PassManager::RunModule(Pass &pass) {
+    long long insts = 0, blocks = 0;
+    for (auto function: module->functions) {
+        insts -= Size(function);
+        blocks -= (long long) function->blocks.size();
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto result = pass.run_module(module);
+    pass.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (auto function: module->functions) {
+        insts += Size(function);
+        blocks += (long long) function->blocks.size();
+    }
+    pass.insts += insts;
+    pass.blocks += blocks;
+    ++pass.runs;
+    pass.changed += result;
+}
+
+void PassManager::Run() {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<ThreadPool> pool;
+    for (size_t begin = 0; begin < passes.size();) {
+        if (passes[begin].run_module != nullptr) {
+            RunModule(passes[begin++]);
+            continue;
+        }
+        auto end = begin;
+        while (end < passes.size() && passes[end].run_module == nullptr) {
+            ++end;
+        }
+        auto &functions = module->functions;
+        std::vector<std::unique_ptr<Analyses>> analyses;
+        std::vector<std::unique_ptr<PassContext>> contexts;
+        for (auto function: functions) {
+            analyses.push_back(std::make_unique<Analyses>(function));
+            contexts.push_back(std::make_unique<PassContext>(function, *analyses.back()));
+        }
+        if (threads > 1 && functions.size() > 1) {
+            if (pool == nullptr) {
+                pool = std::make_unique<ThreadPool>(std::min(threads, (int) functions.size()));
+            }
+            // The largest functions first, so that no thread is left with
+            // one at the end.
+            std::vector<size_t> order(functions.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return Size(functions[a]) > Size(functions[b]);
+            });
+            for (auto i: order) {
+                pool->Submit([this, &functions, &contexts, begin, end, i] {
+                    RunStage(functions[i], begin, end, *contexts[i]);
+                });
+            }
+            pool->Wait();
+        } else {
+            for (size_t i = 0; i < functions.size(); ++i) {
+                RunStage(functions[i], begin, end, *contexts[i]);
+            }
+        }
+        for (auto &context: contexts) {
+            for (auto &[stream, buffer]: context->buffers) {
+                *stream << buffer->str();
+            }
+        }
+        begin = end;
+    }
+    if (timings != nullptr) {
+        PrintTimings(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+void PassManager::PrintTimings(double milliseconds) const {
+    auto &os = *timings;
+    auto flags = os.flags();
+    auto precision = os.precision();
+    os << std::left << std::setw(12) << "pass" << std::right << std::setw(10) << "changed" << std::setw(12)
+       << "time, ms" << std::setw(10) << "insts" << std::setw(10) << "blocks" << "\n" << std::fixed
+       << std::setprecision(3);
+    long long insts = 0, blocks = 0;
+    for (auto &pass: passes) {
+        os << std::left << std::setw(12) << pass.name << std::right
+           << std::setw(10) << (std::to_string(pass.changed) + "/" + std::to_string(pass.runs))
+           << std::setw(12) << pass.milliseconds
+           << std::setw(10) << std::showpos << pass.insts << std::setw(10) << pass.blocks << std::noshowpos << "\n";
+        insts += pass.insts;
+        blocks += pass.blocks;
+    }
+    os << std::left << std::setw(22) << "total" << std::right << std::setw(12) << milliseconds
+       << std::setw(10) << std::showpos << insts << std::setw(10) << blocks << std::noshowpos << "\n";
+    os.flags(flags);
+    os.precision(precision);
+}
@@ -0,0 +1,90 @@
+#ifndef COMPILER_PASSES_H
+#define COMPILER_PASSES_H
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "ir.h"
+
+// A function pass runs on one function with the analyses cached for it.
+// Lines for a report go through Out, so the reports of functions optimized
+// concurrently come out in the order of the functions.
+class PassContext {
+public:
+    PassContext(IrFunction *function, Analyses &analyses) : function(function), analyses(analyses) {}
+
+    // Where to write what is meant for stream, or null when stream is.
+    std::ostream *Out(std::ostream *stream);
+
+    IrFunction *function;
+    Analyses &analyses;
+
+private:
+    friend class PassManager;
+
+    std::vector<std::pair<std::ostream *, std::unique_ptr<std::stringstream>>> buffers;
+};
+
+// Runs a pipeline of passes over a module. Function passes in a row form a
+// stage, run for every function on a thread pool; a module pass runs alone
+// between stages. Analyses are cached per function across the passes of a
+// stage: a pass that changed the function drops the ones it does not
+// declare preserved, a pass that changed nothing keeps them all, and a
+// module pass drops them everywhere. With timings set, the time every pass
+// took and how much it grew or shrank the IR are printed there after the
+// run.
+class PassManager {
+public:
+    using FunctionPass = std::function<bool(PassContext &)>;
+    using ModulePass = std::function<bool(Module *)>;
+
+    explicit PassManager(Module *module, int threads = 1, std::ostream *timings = nullptr)
+            : module(module), threads(threads), timings(timings) {}
+
+    void Add(const std::string &name, Preserved preserved, FunctionPass run);
+
+    // A pass run only on the functions the pass added before it changed,
+    // following it like the passes it cleans up after.
+    void AddFollowing(const std::string &name, Preserved preserved, FunctionPass run);
+
+    void AddModule(const std::string &name, ModulePass run);
+
+    void Run();
+
+private:
+    struct Pass {
+        std::string name;
+        Preserved preserved;
+        FunctionPass run;
+        ModulePass run_module;
+        bool following = false;
+        // Summed over the functions.
+        double milliseconds = 0;
+        long long insts = 0;
+        long long blocks = 0;
+        int runs = 0;
+        int changed = 0;
+    };
+
+    // Runs the function passes from begin to end over function.
+    void RunStage(IrFunction *function, size_t begin, size_t end, PassContext &context);
+
+    void RunModule(Pass &pass);
+
+    void PrintTimings(double milliseconds) const;
+
+    Module *module;
+    int threads;
+    std::ostream *timings;
+    std::vector<Pass> passes;
+    std::mutex mutex;
+};
+
+#endif //COMPILER_PASSES_H
@@ -0,0 +1,163 @@
+#include "range.h"
+
+#include <algorithm>
+
+static const long long kMin = std::numeric_limits<long long>::min();
+static const long long kMax = std::numeric_limits<long long>::max();
+
+// Adds two ends of ranges, keeping an unbounded end unbounded and clamping
+// on overflow.
+static long long AddEnds(long long a, long long b, long long unbounded) {
+    if (a == kMin || a == kMax || b == kMin || b == kMax) {
+        return unbounded;
+    }
+    long long sum;
+    return __builtin_add_overflow(a, b, &sum) ? unbounded : sum;
+}
+
+static long long Negate(long long end) {
+    if (end == kMin) {
+        return kMax;
+    }
+    return end == kMax ? kMin : -end;
+}
+
+Range Range::Shifted(long long offset) const {
+    return {AddEnds(lo, offset, kMin), AddEnds(hi, offset, kMax)};
+}
+
+bool RangeAnalysis::IsGuarded(const Loop *loop) {
+    if (!loop->IsCounted()) {
+        return false;
+    }
+    if (loop->trip_count >= 0) {
+        return loop->trip_count > 0;
+    }
+    Block *to = loop->header;
+    Block *from = nullptr;
+    for (auto pred: to->preds) {
+        if (!loop->Contains(pred)) {
+            from = pred;
+        }
+    }
+    if (from == nullptr) {
+        return false;
+    }
+    while (from->Terminator()->op == IrOp::Jump && from->preds.size() == 1) {
+        to = from;
+        from = from->preds[0];
+    }
+    auto branch = from->Terminator();
+    if (branch->op != IrOp::Branch || branch->targets[1] != to || branch->targets[0] == to) {
+        return false;
+    }
+    auto skip = branch->Operand(0);
+    return skip->op == IrOp::Cmp && skip->Operand(0) == loop->begin && skip->Operand(1) == loop->end &&
+           skip->pred == (loop->step > 0 ? Pred::Gt : Pred::Lt);
+}
+
+Range RangeAnalysis::Of(Inst *value) {
+    auto it = ranges.find(value);
+    if (it != ranges.end()) {
+        return it->second;
+    }
+    if (!visiting.insert(value).second) {
+        return {};
+    }
+    auto range = Compute(value);
+    visiting.erase(value);
+    ranges[value] = range;
+    return range;
+}
+
+Range RangeAnalysis::Compute(Inst *value) {
+    if (value->type != IrType::Int) {
+        return {};
+    }
+    auto constant = [](Inst *inst) { return inst->IsConstant() ? inst->imm : 0; };
+    switch (value->op) {
+        case IrOp::Const:
+            return {value->imm, value->imm};
+        case IrOp::Cmp:
+        case IrOp::FCmp:
+        case IrOp::SCmp:
+        case IrOp::LNot:
+            return {0, 1};
+        case IrOp::Phi: {
+            auto loop = loops.LoopOf(value->block);
+            if (loop != nullptr && loop->induction == value) {
+                if (!IsGuarded(loop)) {
+                    return {};
+                }
+                auto begin = Of(loop->begin), end = Of(loop->end);
+                return loop->step > 0 ? Range{begin.lo, end.hi} : Range{end.lo, begin.hi};
+            }
+            Range result{kMax, kMin};
+            for (auto operand: value->operands) {
+                auto range = Of(operand);
+                result.lo = std::min(result.lo, range.lo);
+                result.hi = std::max(result.hi, range.hi);
+            }
+            return result;
+        }
+        case IrOp::Add: {
+            auto a = Of(value->Operand(0)), b = Of(value->Operand(1));
+            return {AddEnds(a.lo, b.lo, kMin), AddEnds(a.hi, b.hi, kMax)};
+        }
+        case IrOp::Sub: {
+            auto a = Of(value->Operand(0)), b = Of(value->Operand(1));
+            return {AddEnds(a.lo, Negate(b.hi), kMin), AddEnds(a.hi, Negate(b.lo), kMax)};
+        }
+        case IrOp::Neg: {
+            auto a = Of(value->Operand(0));
+            return {Negate(a.hi), Negate(a.lo)};
+        }
+        case IrOp::Mul: {
+            auto a = Of(value->Operand(0)), b = Of(value->Operand(1));
+            long long products[4];
+            if (a.lo == kMin || a.hi == kMax || b.lo == kMin || b.hi == kMax ||
+                __builtin_mul_overflow(a.lo, b.lo, &products[0]) || __builtin_mul_overflow(a.lo, b.hi, &products[1]) ||
+                __builtin_mul_overflow(a.hi, b.lo, &products[2]) || __builtin_mul_overflow(a.hi, b.hi, &products[3])) {
+                return {};
+            }
+            return {*std::min_element(products, products + 4), *std::max_element(products, products + 4)};
+        }
+        case IrOp::Div: {
+            auto divisor = value->Operand(1);
+            if (!divisor->IsConstant() || divisor->imm <= 0) {
+                return {};
+            }
+            auto a = Of(value->Operand(0));
+            return {a.lo / divisor->imm, a.hi / divisor->imm};
+        }
+        case IrOp::Mod: {
+            auto divisor = value->Operand(1);
+            if (!divisor->IsConstant() || divisor->imm == 0 || divisor->imm == kMin) {
+                return {};
+            }
+            auto limit = std::abs(divisor->imm) - 1;
+            auto a = Of(value->Operand(0));
+            return a.lo >= 0 ? Range{0, std::min(a.hi, limit)} : Range{-limit, limit};
+        }
+        case IrOp::And: {
+            auto a = Of(value->Operand(0)), b = Of(value->Operand(1));
+            if (a.lo >= 0 && b.lo >= 0) {
+                return {0, std::min(a.hi, b.hi)};
+            }
+            if (a.lo >= 0 || b.lo >= 0) {
+                return {0, a.lo >= 0 ? a.hi : b.hi};
+            }
+            return {};
+        }
+        case IrOp::Shr: {
+            auto count = constant(value->Operand(1)) & 63;
+            auto a = Of(value->Operand(0));
+            if (!value->Operand(1)->IsConstant() || count == 0 || a.lo < 0) {
+                return {};
+            }
+            return {a.lo >> count, a.hi >> count};
+        }
+        default:
+            return {};
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef COMPILER_RANGE_H
+#define COMPILER_RANGE_H
+
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "analysis.h"
+#include "ir.h"
+#include "loops.h"
+
+// An interval of integer values. An end at the limit of long long stands
+// for no bound on that side.
+struct Range {
+    long long lo = std::numeric_limits<long long>::min();
+    long long hi = std::numeric_limits<long long>::max();
+
+    [[nodiscard]] bool Within(long long low, long long high) const { return lo >= low && hi <= high; }
+
+    [[nodiscard]] Range Shifted(long long offset) const;
+};
+
+// Ranges of integer values from constants, arithmetic on them and the
+// induction variables of for loops, which stay between the bounds of a loop
+// that is only entered when the bounds are in order.
+class RangeAnalysis {
+public:
+    RangeAnalysis(IrFunction *, Analyses &analyses) : loops(analyses.Get<LoopForest>()) {}
+
+    Range Of(Inst *value);
+
+    // Whether the body of a counted loop only runs when its bounds are in the
+    // order of its step, as the check a for statement starts with ensures.
+    [[nodiscard]] static bool IsGuarded(const Loop *loop);
+
+private:
+    Range Compute(Inst *value);
+
+    const LoopForest &loops;
+    std::unordered_map<Inst *, Range> ranges;
+    std::unordered_set<Inst *> visiting;
+};
+
+#endif //COMPILER_RANGE_H
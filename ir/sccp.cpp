@@ -0,0 +1,181 @@
+#include "sccp.h"
+
+#include "fold.h"
+
+Sccp::Lattice Sccp::Get(Inst *value) {
+    if (value->IsConstant()) {
+        return {Lattice::Constant, value};
+    }
+    if (value->block == nullptr) {
+        return {Lattice::Overdefined};
+    }
+    return values[value];
+}
+
+void Sccp::Set(Inst *inst, Lattice lattice) {
+    auto &current = values[inst];
+    if (current.kind == Lattice::Overdefined || current == lattice) {
+        return;
+    }
+    if (current.kind == Lattice::Constant && lattice.kind == Lattice::Unknown) {
+        return;
+    }
+    current = lattice;
+    for (auto user: inst->users) {
+        ssa_work.push_back(user);
+    }
+}
+
+void Sccp::MarkEdge(Block *from, Block *to) {
+    if (!edges.insert({from, to}).second) {
+        return;
+    }
+    flow_work.emplace_back(from, to);
+}
+
+Sccp::Lattice Sccp::Evaluate(Inst *inst) {
+    switch (inst->op) {
+        case IrOp::Phi: {
+            Lattice result;
+            for (size_t i = 0; i < inst->operands.size(); ++i) {
+                if (!edges.count({inst->block->preds[i], inst->block})) {
+                    continue;
+                }
+                auto value = Get(inst->Operand(i));
+                if (value.kind == Lattice::Unknown) {
+                    continue;
+                }
+                if (value.kind == Lattice::Overdefined ||
+                    (result.kind == Lattice::Constant && result.constant != value.constant)) {
+                    return {Lattice::Overdefined};
+                }
+                result = value;
+            }
+            return result;
+        }
+        case IrOp::Alloca:
+        case IrOp::Offset:
+        case IrOp::Element:
+        case IrOp::Load:
+        case IrOp::Call:
+        case IrOp::Vector:
+        case IrOp::Read:
+            return {Lattice::Overdefined};
+        default:
+            break;
+    }
+    std::vector<Inst *> constants;
+    for (auto operand: inst->operands) {
+        auto value = Get(operand);
+        if (value.kind == Lattice::Overdefined) {
+            return value;
+        }
+        constants.push_back(value.constant);
+    }
+    for (auto constant: constants) {
+        if (constant == nullptr) {
+            return {};
+        }
+    }
+    auto folded = Fold(function, inst, constants);
+    if (folded == nullptr) {
+        return {Lattice::Overdefined};
+    }
+    return {Lattice::Constant, folded};
+}
+
+void Sccp::Visit(Inst *inst) {
+    if (!executable.count(inst->block)) {
+        return;
+    }
+    switch (inst->op) {
+        case IrOp::Jump:
+            MarkEdge(inst->block, inst->targets[0]);
+            return;
+        case IrOp::Branch: {
+            auto condition = Get(inst->Operand(0));
+            if (condition.kind == Lattice::Constant) {
+                MarkEdge(inst->block, inst->targets[condition.constant->imm != 0 ? 0 : 1]);
+            } else if (condition.kind == Lattice::Overdefined) {
+                MarkEdge(inst->block, inst->targets[0]);
+                MarkEdge(inst->block, inst->targets[1]);
+            }
+            return;
+        }
+        case IrOp::Store:
+        case IrOp::Copy:
+        case IrOp::Write:
+        case IrOp::WriteLn:
+        case IrOp::Ret:
+            return;
+        default:
+            Set(inst, Evaluate(inst));
+    }
+}
+
+bool Sccp::Rewrite() {
+    size_t constants = 0, branches = 0;
+    for (auto block: function->blocks) {
+        if (!executable.count(block)) {
+            continue;
+        }
+        for (auto inst: std::vector<Inst *>(block->insts)) {
+            auto it = values.find(inst);
+            if (it == values.end() || it->second.kind != Lattice::Constant) {
+                continue;
+            }
+            inst->ReplaceAllUsesWith(it->second.constant);
+            inst->Erase();
+            ++constants;
+        }
+        auto terminator = block->Terminator();
+        if (terminator->op != IrOp::Branch) {
+            continue;
+        }
+        Block *taken = nullptr;
+        size_t count = 0;
+        for (auto target: terminator->targets) {
+            if (edges.count({block, target})) {
+                taken = target;
+                ++count;
+            }
+        }
+        if (count == 1 || (count == 2 && terminator->targets[0] == terminator->targets[1])) {
+            function->FoldBranch(block, taken);
+            ++branches;
+        }
+    }
+    auto blocks = function->blocks.size();
+    function->Cleanup();
+    blocks -= function->blocks.size();
+    if (stats != nullptr) {
+        stats->Add("sccp.constants", (long long) constants);
+        stats->Add("sccp.branches", (long long) branches);
+        stats->Add("sccp.blocks", (long long) blocks);
+    }
+    return constants + branches + blocks != 0;
+}
+
+bool Sccp::Run() {
+    flow_work.emplace_back(nullptr, function->Entry());
+    while (!flow_work.empty() || !ssa_work.empty()) {
+        if (!flow_work.empty()) {
+            auto [from, to] = flow_work.back();
+            flow_work.pop_back();
+            if (executable.insert(to).second) {
+                for (auto inst: to->insts) {
+                    Visit(inst);
+                }
+            } else {
+                for (auto phi: to->Phis()) {
+                    Visit(phi);
+                }
+            }
+            continue;
+        }
+        auto inst = ssa_work.back();
+        ssa_work.pop_back();
+        Visit(inst);
+    }
+    return Rewrite();
+}
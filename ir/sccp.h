@@ -0,0 +1,60 @@
+#ifndef COMPILER_SCCP_H
+#define COMPILER_SCCP_H
+
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "analysis.h"
+#include "ir.h"
+#include "statistics.h"
+
+// Sparse conditional constant propagation (Wegman and Zadeck). Values start
+// unknown and only go down to a constant and then to overdefined; a block is
+// evaluated only once an edge into it is found executable, so constants
+// flowing around a loop and branches on constants are resolved together.
+// Afterwards constant values are substituted, branches on constants become
+// jumps and the blocks no executable edge reaches are removed.
+class Sccp {
+public:
+    Sccp(IrFunction *function, Analyses &, Statistics *stats = nullptr)
+            : function(function), stats(stats) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    struct Lattice {
+        enum Kind {
+            Unknown,
+            Constant,
+            Overdefined
+        } kind = Unknown;
+        Inst *constant = nullptr;
+
+        bool operator==(const Lattice &other) const { return kind == other.kind && constant == other.constant; }
+    };
+
+    Lattice Get(Inst *value);
+
+    void Set(Inst *inst, Lattice lattice);
+
+    void MarkEdge(Block *from, Block *to);
+
+    void Visit(Inst *inst);
+
+    Lattice Evaluate(Inst *inst);
+
+    bool Rewrite();
+
+    IrFunction *function;
+    Statistics *stats;
+    std::unordered_map<Inst *, Lattice> values;
+    std::unordered_set<Block *> executable;
+    std::set<std::pair<Block *, Block *>> edges;
+    std::vector<std::pair<Block *, Block *>> flow_work;
+    std::vector<Inst *> ssa_work;
+};
+
+#endif //COMPILER_SCCP_H
@@ -0,0 +1,137 @@
+#include "sroa.h"
+
+#include <algorithm>
+
+#include "alias.h"
+#include "escape.h"
+#include "mem2reg.h"
+
+bool ScalarReplacement::Fields(Inst *pointer, long long offset, std::map<long long, IrType> &fields) const {
+    for (auto user: pointer->users) {
+        IrType type;
+        switch (user->op) {
+            case IrOp::Offset:
+                if (!Fields(user, offset + user->imm, fields)) {
+                    return false;
+                }
+                continue;
+            case IrOp::Load:
+                type = user->type;
+                break;
+            // The fields a copy fills are loaded from its source one by one,
+            // unless that is the record itself.
+            case IrOp::Copy:
+                if (user->Operand(0) != pointer || LocationOf(user->Operand(1)).root == LocationOf(pointer).root) {
+                    return false;
+                }
+                continue;
+            case IrOp::Store:
+                if (user->Operand(0) != pointer) {
+                    return false;
+                }
+                type = user->Operand(1)->type;
+                break;
+            default:
+                return false;
+        }
+        auto field = fields.emplace(offset, type).first;
+        if (field->second != type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ScalarReplacement::Replace(Inst *pointer, long long offset, const std::map<long long, Inst *> &scalars) {
+    for (auto user: std::vector<Inst *>(pointer->users)) {
+        if (user->op == IrOp::Offset) {
+            Replace(user, offset + user->imm, scalars);
+            user->Erase();
+        } else if (user->op == IrOp::Copy) {
+            Copy(user, offset, scalars);
+        } else {
+            user->SetOperand(0, scalars.at(offset));
+        }
+    }
+}
+
+void ScalarReplacement::Copy(Inst *copy, long long offset, const std::map<long long, Inst *> &scalars) {
+    auto block = copy->block;
+    auto index = std::find(block->insts.begin(), block->insts.end(), copy) - block->insts.begin();
+    auto emit = [&](Inst *inst) {
+        inst->pos = copy->pos;
+        block->Insert(index++, inst);
+        return inst;
+    };
+    auto source = copy->Operand(1);
+    for (auto it = scalars.lower_bound(offset); it != scalars.end() && it->first < offset + copy->imm; ++it) {
+        auto from = source;
+        if (it->first != offset) {
+            from = function->New(IrOp::Offset, IrType::Ptr);
+            from->AddOperand(source);
+            from->imm = it->first - offset;
+            emit(from);
+        }
+        auto load = function->New(IrOp::Load, it->second->element);
+        load->AddOperand(from);
+        auto store = function->New(IrOp::Store, IrType::Void);
+        store->AddOperand(it->second);
+        store->AddOperand(emit(load));
+        emit(store);
+    }
+    copy->Erase();
+}
+
+bool ScalarReplacement::Run() {
+    std::vector<Inst *> records;
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->op == IrOp::Alloca && inst->element == IrType::Void) {
+                records.push_back(inst);
+            }
+        }
+    }
+    // Records are tried again after one they are copied into is split,
+    // which reads them field by field instead.
+    auto &escape = analyses.Get<EscapeAnalysis>();
+    size_t split = 0, fields = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto &record: records) {
+            std::map<long long, IrType> types;
+            if (record == nullptr || escape.Escapes(record) != nullptr || !Fields(record, 0, types)) {
+                continue;
+            }
+            Split(record, types);
+            fields += types.size();
+            ++split;
+            record = nullptr;
+            changed = true;
+        }
+    }
+    if (split == 0) {
+        return false;
+    }
+    // Splitting leaves the blocks as they are, so the dominator tree holds.
+    Mem2Reg(function, analyses).Run();
+    if (stats != nullptr) {
+        stats->Add("sroa.records", (long long) split);
+        stats->Add("sroa.fields", (long long) fields);
+    }
+    return true;
+}
+
+void ScalarReplacement::Split(Inst *record, const std::map<long long, IrType> &types) {
+    auto block = record->block;
+    auto index = std::find(block->insts.begin(), block->insts.end(), record) - block->insts.begin();
+    std::map<long long, Inst *> scalars;
+    for (auto [offset, type]: types) {
+        auto scalar = function->New(IrOp::Alloca, IrType::Ptr);
+        scalar->imm = 1;
+        scalar->element = type;
+        block->Insert(index++, scalar);
+        scalars[offset] = scalar;
+    }
+    Replace(record, 0, scalars);
+    record->Erase();
+}
@@ -0,0 +1,44 @@
+#ifndef COMPILER_SROA_H
+#define COMPILER_SROA_H
+
+#include <map>
+
+#include "analysis.h"
+#include "ir.h"
+#include "statistics.h"
+
+// Scalar replacement of aggregates. A record in the frame whose address
+// does not escape, and whose fields are only loaded and stored at constant
+// offsets, is split into a scalar alloca per field, which are then promoted
+// to SSA values like any other local. A copy into the record, as a by-value
+// param gets, loads the fields it fills from the source one by one. Records
+// copied out whole, or holding arrays indexed at run time, stay in memory.
+class ScalarReplacement {
+public:
+    ScalarReplacement(IrFunction *function, Analyses &analyses, Statistics *stats = nullptr)
+            : function(function), analyses(analyses), stats(stats) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    // Collects the type of every slot pointer, at offset from the alloca,
+    // is loaded or stored as, or returns false when some use is not such an
+    // access.
+    bool Fields(Inst *pointer, long long offset, std::map<long long, IrType> &fields) const;
+
+    void Split(Inst *record, const std::map<long long, IrType> &types);
+
+    // Points the accesses through pointer at the scalars of their slots.
+    void Replace(Inst *pointer, long long offset, const std::map<long long, Inst *> &scalars);
+
+    // Replaces a copy to offset in the record by stores of the fields it
+    // fills.
+    void Copy(Inst *copy, long long offset, const std::map<long long, Inst *> &scalars);
+
+    IrFunction *function;
+    Analyses &analyses;
+    Statistics *stats;
+};
+
+#endif //COMPILER_SROA_H
@@ -0,0 +1,21 @@
+#include "statistics.h"
+
+void Statistics::Add(const std::string &counter, long long amount) {
+    std::lock_guard lock(mutex);
+    counters[counter] += amount;
+}
+
+long long Statistics::Get(const std::string &counter) const {
+    std::lock_guard lock(mutex);
+    auto it = counters.find(counter);
+    return it == counters.end() ? 0 : it->second;
+}
+
+void Statistics::Print(std::ostream &os) const {
+    std::lock_guard lock(mutex);
+    for (auto &[counter, amount]: counters) {
+        if (amount != 0) {
+            os << counter << ": " << amount << "\n";
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef COMPILER_STATISTICS_H
+#define COMPILER_STATISTICS_H
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Counters the passes bump to report what they changed.
+class Statistics {
+public:
+    void Add(const std::string &counter, long long amount = 1);
+
+    [[nodiscard]] long long Get(const std::string &counter) const;
+
+    void Print(std::ostream &os) const;
+
+private:
+    std::map<std::string, long long> counters;
+    mutable std::mutex mutex;
+};
+
+#endif //COMPILER_STATISTICS_H
@@ -0,0 +1,192 @@
+#include "strength.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+static const long long kMin = std::numeric_limits<long long>::min();
+static const long long kMax = std::numeric_limits<long long>::max();
+
+static long long Wrap(long long a, long long b) {
+    return (long long) ((unsigned long long) a * (unsigned long long) b);
+}
+
+Inst *StrengthReduction::Emit(Block *block, Inst *at, IrOp op, Inst *a, Inst *b) {
+    auto inst = function->New(op, IrType::Int);
+    inst->AddOperand(a);
+    if (b != nullptr) {
+        inst->AddOperand(b);
+    }
+    if (at == nullptr) {
+        block->Append(inst);
+    } else {
+        inst->pos = at->pos;
+        block->Insert(std::find(block->insts.begin(), block->insts.end(), at) - block->insts.begin(), inst);
+    }
+    return inst;
+}
+
+void StrengthReduction::Replace(Inst *inst, Inst *value) {
+    inst->ReplaceAllUsesWith(value);
+    replaced[inst] = value;
+}
+
+Inst *StrengthReduction::Current(Inst *value) const {
+    for (auto it = replaced.find(value); it != replaced.end(); it = replaced.find(value)) {
+        value = it->second;
+    }
+    return value;
+}
+
+bool StrengthReduction::Divide(Inst *inst) {
+    if (replaced.count(inst) || (inst->op != IrOp::Div && inst->op != IrOp::Mod) || !inst->Operand(1)->IsConstant()) {
+        return false;
+    }
+    auto divisor = inst->Operand(1)->imm;
+    if (divisor == 0 || divisor == kMin) {
+        return false;
+    }
+    auto block = inst->block;
+    auto x = inst->Operand(0);
+    auto d = std::abs(divisor);
+    auto emit = [&](IrOp op, Inst *a, Inst *b) { return Emit(block, inst, op, a, b); };
+    Inst *result;
+    if (d == 1) {
+        result = inst->op == IrOp::Mod ? function->Int(0) : divisor < 0 ? emit(IrOp::Neg, x, nullptr) : x;
+    } else if ((d & (d - 1)) == 0 && ranges.Of(x).lo >= 0) {
+        // Without a negative dividend there is nothing to round towards
+        // zero, and the remainder takes the sign of the dividend.
+        if (inst->op == IrOp::Mod) {
+            result = emit(IrOp::And, x, function->Int(d - 1));
+        } else {
+            result = emit(IrOp::Shr, x, function->Int(__builtin_ctzll((unsigned long long) d)));
+            result = divisor < 0 ? emit(IrOp::Neg, result, nullptr) : result;
+        }
+    } else {
+        return false;
+    }
+    Replace(inst, result);
+    ++divisions;
+    return true;
+}
+
+void StrengthReduction::ReplaceTest(Loop *loop, Inst *reduced, Inst *factor) {
+    auto induction = loop->induction;
+    auto next = induction->Operand(loop->header->preds[0] == loop->latches[0] ? 0 : 1);
+    for (auto user: induction->users) {
+        if (user != next && user != loop->exit_test && !replaced.count(user)) {
+            return;
+        }
+    }
+    for (auto user: next->users) {
+        if (user != induction && !replaced.count(user)) {
+            return;
+        }
+    }
+    // The test stays exact only if no value the induction variable takes
+    // overflows when multiplied by the factor.
+    auto range = ranges.Of(induction);
+    long long lo, hi;
+    if (!RangeAnalysis::IsGuarded(loop) || range.lo == kMin || range.hi == kMax ||
+        __builtin_mul_overflow(range.lo, factor->imm, &lo) || __builtin_mul_overflow(range.hi, factor->imm, &hi)) {
+        return;
+    }
+    auto bound = Current(loop->end);
+    auto end = bound->IsConstant() ? function->Int(bound->imm * factor->imm)
+                                   : Emit(loop->Preheader(), nullptr, IrOp::Mul, bound, factor);
+    loop->exit_test->SetOperand(0, reduced);
+    loop->exit_test->SetOperand(1, end);
+    ++tests;
+}
+
+void StrengthReduction::Reduce(Loop *loop) {
+    auto preheader = loop->Preheader();
+    if (!loop->IsCounted() || preheader == nullptr) {
+        return;
+    }
+    auto header = loop->header;
+    auto latch = loop->latches[0];
+    auto induction = loop->induction;
+    std::vector<std::pair<Inst *, Inst *>> reduced;
+    for (auto block: loop->blocks) {
+        for (auto inst: std::vector<Inst *>(block->insts)) {
+            if (replaced.count(inst) || inst->op != IrOp::Mul ||
+                (inst->Operand(0) != induction && inst->Operand(1) != induction)) {
+                continue;
+            }
+            auto factor = inst->Operand(inst->Operand(0) == induction ? 1 : 0);
+            if (!loop->IsInvariant(factor)) {
+                continue;
+            }
+            // The product starts at begin * factor and steps by step * factor
+            // on the same edge as the induction variable.
+            auto it = std::find_if(reduced.begin(), reduced.end(), [&](auto &pair) { return pair.first == factor; });
+            Inst *phi = it != reduced.end() ? it->second : nullptr;
+            if (phi == nullptr) {
+                auto begin = Current(loop->begin);
+                Inst *init;
+                if (begin->IsConstant() && factor->IsConstant()) {
+                    init = function->Int(Wrap(begin->imm, factor->imm));
+                } else if (begin->IsConstant() && (begin->imm == 0 || begin->imm == 1)) {
+                    init = begin->imm == 0 ? begin : factor;
+                } else {
+                    init = Emit(preheader, nullptr, IrOp::Mul, begin, factor);
+                }
+                Inst *step = factor;
+                if (factor->IsConstant()) {
+                    step = function->Int(Wrap(loop->step, factor->imm));
+                } else if (loop->step < 0) {
+                    step = Emit(preheader, nullptr, IrOp::Neg, factor);
+                }
+                phi = function->New(IrOp::Phi, IrType::Int);
+                header->Insert(0, phi);
+                auto next = Emit(latch, nullptr, IrOp::Add, phi, step);
+                for (auto pred: header->preds) {
+                    phi->AddOperand(pred == latch ? next : init);
+                }
+                reduced.emplace_back(factor, phi);
+            }
+            Replace(inst, phi);
+            ++products;
+        }
+    }
+    for (auto &[factor, phi]: reduced) {
+        if (factor->IsConstant() && factor->imm != 0) {
+            ReplaceTest(loop, phi, factor);
+            break;
+        }
+    }
+}
+
+void StrengthReduction::DivideAll() {
+    for (auto block: function->blocks) {
+        for (auto inst: std::vector<Inst *>(block->insts)) {
+            Divide(inst);
+        }
+    }
+}
+
+bool StrengthReduction::Run() {
+    DivideAll();
+    for (auto loop: loops.Loops()) {
+        Reduce(loop);
+    }
+    return Finish();
+}
+
+bool StrengthReduction::RunDivisions() {
+    DivideAll();
+    return Finish();
+}
+
+bool StrengthReduction::Finish() {
+    for (auto &[inst, value]: replaced) {
+        inst->Erase();
+    }
+    if (stats != nullptr) {
+        stats->Add("strength.divisions", (long long) divisions);
+        stats->Add("strength.products", (long long) products);
+        stats->Add("strength.tests", (long long) tests);
+    }
+    return divisions + products + tests != 0;
+}
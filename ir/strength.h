@@ -0,0 +1,69 @@
+#ifndef COMPILER_STRENGTH_H
+#define COMPILER_STRENGTH_H
+
+#include <unordered_map>
+
+#include "analysis.h"
+#include "ir.h"
+#include "loops.h"
+#include "range.h"
+#include "statistics.h"
+
+// Strength reduction. Division and modulo of a dividend known not to be
+// negative by a power of two become a shift and a mask; other constant
+// divisors are left to the DIVKI and MODKI instructions of the vm. In a for
+// loop, counting up or down, a product of the induction variable and an
+// invariant becomes an induction variable of its own, stepped by an
+// addition in the latch. When the loop then only counts with the original
+// one, the exit test moves to the new variable and the old one dies.
+class StrengthReduction {
+public:
+    StrengthReduction(IrFunction *function, Analyses &analyses, Statistics *stats = nullptr)
+            : function(function), loops(analyses.Get<LoopForest>()), ranges(analyses.Get<RangeAnalysis>()),
+              stats(stats) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+    // Only replaces the divisions and modulos, before loops are unrolled:
+    // an unrolled loop counts in larger steps, and the range of what it
+    // divides is lost with its induction variable.
+    bool RunDivisions();
+
+private:
+    // Replaces a division or modulo by a constant, if it has one.
+    bool Divide(Inst *inst);
+
+    void DivideAll();
+
+    void Reduce(Loop *loop);
+
+    // Tests the exit of the loop on reduced, the induction variable times the
+    // constant factor, when nothing else needs the induction variable.
+    void ReplaceTest(Loop *loop, Inst *reduced, Inst *factor);
+
+    // Replaces the uses of inst by value. The loop forest still names the
+    // bounds of loops as they were, so inst is only erased at the end, and
+    // new code takes the bounds through Current.
+    void Replace(Inst *inst, Inst *value);
+
+    [[nodiscard]] Inst *Current(Inst *value) const;
+
+    // Emits op a, b before the instruction at, or at the end of the block
+    // when at is null.
+    Inst *Emit(Block *block, Inst *at, IrOp op, Inst *a, Inst *b = nullptr);
+
+    // Erases what was replaced and adds the counts to the statistics.
+    bool Finish();
+
+    IrFunction *function;
+    const LoopForest &loops;
+    RangeAnalysis &ranges;
+    Statistics *stats;
+    std::unordered_map<Inst *, Inst *> replaced;
+    size_t divisions = 0;
+    size_t products = 0;
+    size_t tests = 0;
+};
+
+#endif //COMPILER_STRENGTH_H
@@ -0,0 +1,151 @@
+#include "tailcall.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+bool TailCallElimination::InTailPosition(Inst *call) const {
+    auto block = call->block;
+    if (block->insts.size() < 2 || block->insts[block->insts.size() - 2] != call) {
+        return false;
+    }
+    // The values equal to what the call returns, following the jumps to
+    // the return.
+    std::unordered_set<Inst *> same = {call};
+    for (size_t steps = 0; steps <= function->blocks.size(); ++steps) {
+        auto terminator = block->Terminator();
+        if (terminator->op == IrOp::Ret) {
+            return function->ret == IrType::Void || same.count(terminator->Operand(0));
+        }
+        if (terminator->op != IrOp::Jump) {
+            return false;
+        }
+        auto next = block->succs[0];
+        if (next->Phis().size() + 1 != next->insts.size()) {
+            return false;
+        }
+        auto index = std::find(next->preds.begin(), next->preds.end(), block) - next->preds.begin();
+        for (auto phi: next->Phis()) {
+            if (same.count(phi->Operand(index))) {
+                same.insert(phi);
+            }
+        }
+        block = next;
+    }
+    return false;
+}
+
+void TailCallElimination::Loop(const std::vector<Inst *> &calls) {
+    auto entry = function->Entry();
+    auto start = function->NewBlock();
+    function->blocks.pop_back();
+    function->blocks.insert(function->blocks.begin(), start);
+    function->Jump(start, entry);
+
+    std::vector<Block *> blocks;
+    std::vector<std::vector<Inst *>> arguments;
+    for (auto call: calls) {
+        auto block = call->block;
+        blocks.push_back(block);
+        arguments.push_back(call->operands);
+        block->Terminator()->Erase();
+        for (auto succ: std::vector<Block *>(block->succs)) {
+            function->RemoveEdge(block, succ);
+        }
+        call->Erase();
+        function->Jump(block, entry);
+    }
+
+    std::vector<Inst *> phis;
+    for (size_t i = 0; i < function->params.size(); ++i) {
+        auto param = function->params[i];
+        auto phi = function->New(IrOp::Phi, param->type);
+        param->ReplaceAllUsesWith(phi);
+        entry->Insert(i, phi);
+        phis.push_back(phi);
+    }
+    // The params passed on unchanged are the phis themselves.
+    auto value = [&](Inst *argument) {
+        auto param = std::find(function->params.begin(), function->params.end(), argument);
+        return param == function->params.end() ? argument : phis[param - function->params.begin()];
+    };
+    for (auto pred: entry->preds) {
+        auto call = std::find(blocks.begin(), blocks.end(), pred) - blocks.begin();
+        for (size_t i = 0; i < phis.size(); ++i) {
+            if (pred == start) {
+                phis[i]->AddOperand(function->params[i]);
+            } else if (call < (long) blocks.size()) {
+                phis[i]->AddOperand(value(arguments[call][i]));
+            } else {
+                phis[i]->AddOperand(phis[i]);
+            }
+        }
+    }
+}
+
+void TailCallElimination::Return(Inst *call) {
+    auto block = call->block;
+    if (block->Terminator()->op == IrOp::Ret) {
+        return;
+    }
+    block->Terminator()->Erase();
+    for (auto succ: std::vector<Block *>(block->succs)) {
+        function->RemoveEdge(block, succ);
+    }
+    function->Ret(block, function->ret == IrType::Void ? nullptr : call);
+}
+
+void TailCallElimination::Report(Inst *call, const char *what) const {
+    if (report != nullptr) {
+        *report << function->name << ": call of " << call->callee->name << " at line " << call->pos.GetLine()
+                << ": " << what << "\n";
+    }
+}
+
+bool TailCallElimination::Run() {
+    if (function == function->module->main) {
+        return false;
+    }
+    std::vector<Inst *> calls;
+    bool frame = false;
+    for (auto block: function->blocks) {
+        for (auto inst: block->insts) {
+            frame |= inst->op == IrOp::Alloca;
+            if (inst->op == IrOp::Call && InTailPosition(inst)) {
+                calls.push_back(inst);
+            }
+        }
+    }
+    if (frame) {
+        for (auto call: calls) {
+            Report(call, "kept, the caller has frame memory");
+        }
+        return false;
+    }
+    if (calls.empty()) {
+        return false;
+    }
+
+    std::vector<Inst *> recursive;
+    size_t jumps = 0;
+    for (auto call: calls) {
+        if (call->callee == function) {
+            Report(call, "turned into a loop");
+            recursive.push_back(call);
+        } else {
+            Report(call, "turned into a jump");
+            Return(call);
+            call->tail = true;
+            ++jumps;
+        }
+    }
+    if (!recursive.empty()) {
+        Loop(recursive);
+    }
+    // Joins reached only from the calls are left unreachable.
+    function->Cleanup();
+    if (stats != nullptr) {
+        stats->Add("tail.loops", (long long) recursive.size());
+        stats->Add("tail.jumps", (long long) jumps);
+    }
+    return !calls.empty();
+}
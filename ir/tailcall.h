@@ -0,0 +1,45 @@
+#ifndef COMPILER_TAILCALL_H
+#define COMPILER_TAILCALL_H
+
+#include <iostream>
+#include <vector>
+
+#include "analysis.h"
+#include "ir.h"
+#include "statistics.h"
+
+// Tail call elimination. A call is in tail position when the routine returns
+// what it returns, through nothing but phis, with nothing left to do after
+// it. A routine calling itself that way jumps back to its entry instead,
+// with the arguments as the new params, so the recursion becomes a loop;
+// other tail calls are marked for the backends, which run the callee in the
+// frame of the caller. Routines with frame memory of their own keep their
+// calls, since the arguments may point into it. With report set, every call
+// in tail position gets a line saying what became of it.
+class TailCallElimination {
+public:
+    TailCallElimination(IrFunction *function, Analyses &, Statistics *stats = nullptr,
+                        std::ostream *report = nullptr)
+            : function(function), stats(stats), report(report) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    [[nodiscard]] bool InTailPosition(Inst *call) const;
+
+    // Replaces the calls of the function itself by jumps to its entry, which
+    // gets a phi for every param.
+    void Loop(const std::vector<Inst *> &calls);
+
+    // Makes the block of call return its value right after it.
+    void Return(Inst *call);
+
+    void Report(Inst *call, const char *what) const;
+
+    IrFunction *function;
+    Statistics *stats;
+    std::ostream *report;
+};
+
+#endif //COMPILER_TAILCALL_H
@@ -0,0 +1,333 @@
+#include "unroll.h"
+
+#include <algorithm>
+
+// Loops running at most this many times are unrolled fully.
+static const long long kFullTrips = 16;
+
+// Unrolled loops get at most this many instructions.
+static const long long kUnrolledSize = 128;
+
+static long long Size(const std::vector<Block *> &body) {
+    long long size = 0;
+    for (auto block: body) {
+        for (auto inst: block->insts) {
+            size += inst->op != IrOp::Jump && inst->op != IrOp::Phi;
+        }
+    }
+    return size;
+}
+
+static long long WrappingAdd(long long a, long long b) {
+    return (long long) ((unsigned long long) a + (unsigned long long) b);
+}
+
+Inst *LoopUnroller::Map(const Values &values, Inst *value) {
+    auto it = values.find(value);
+    return it == values.end() ? value : it->second;
+}
+
+Inst *LoopUnroller::Emit(Block *block, IrOp op, Inst *a, Inst *b) {
+    auto inst = function->New(op, IrType::Int);
+    inst->AddOperand(a);
+    inst->AddOperand(b);
+    block->Append(inst);
+    return inst;
+}
+
+void LoopUnroller::End(Block *block, Inst *condition, const std::vector<Block *> &targets) {
+    auto inst = function->New(condition == nullptr ? IrOp::Jump : IrOp::Branch, IrType::Void);
+    if (condition != nullptr) {
+        inst->AddOperand(condition);
+    }
+    inst->targets = targets;
+    block->Append(inst);
+    block->succs = targets;
+}
+
+std::vector<Block *> LoopUnroller::Body(Loop *loop) const {
+    if (!loop->IsCounted() || !loop->children.empty() || loop->Preheader() == nullptr) {
+        return {};
+    }
+    auto latch = loop->latches[0];
+    auto test = latch->preds[0];
+    if (latch->insts.size() != 2) {
+        return {};
+    }
+    std::vector<Block *> body;
+    for (auto block: loop->blocks) {
+        if (block == latch) {
+            continue;
+        }
+        for (auto succ: block->succs) {
+            if (block != test && !loop->Contains(succ)) {
+                return {};
+            }
+        }
+        for (auto inst: block->insts) {
+            if (inst->op == IrOp::Alloca) {
+                return {};
+            }
+        }
+        body.push_back(block);
+    }
+    return body;
+}
+
+std::vector<std::pair<Inst *, std::vector<Inst *>>> LoopUnroller::Escaping(
+        Loop *loop, const std::vector<Block *> &body) const {
+    std::vector<std::pair<Inst *, std::vector<Inst *>>> escaping;
+    for (auto block: body) {
+        for (auto inst: block->insts) {
+            std::vector<Inst *> users;
+            for (auto user: inst->users) {
+                if (!loop->Contains(user->block) && std::find(users.begin(), users.end(), user) == users.end()) {
+                    users.push_back(user);
+                }
+            }
+            if (!users.empty()) {
+                escaping.emplace_back(inst, users);
+            }
+        }
+    }
+    return escaping;
+}
+
+void LoopUnroller::CopyBody(Loop *loop, const std::vector<Block *> &body, Values &values, Blocks &blocks) {
+    auto test = loop->latches[0]->preds[0];
+    for (auto block: body) {
+        blocks[block] = function->NewBlock();
+    }
+    // Instructions first, operands once every value has its copy.
+    std::vector<std::pair<Inst *, Inst *>> copies;
+    for (auto block: body) {
+        auto copy = blocks.at(block);
+        if (block != loop->header) {
+            for (auto pred: block->preds) {
+                copy->preds.push_back(blocks.at(pred));
+            }
+        }
+        if (block != test) {
+            for (auto succ: block->succs) {
+                copy->succs.push_back(blocks.at(succ));
+            }
+        }
+        for (auto inst: block->insts) {
+            if ((block == loop->header && inst->op == IrOp::Phi) || (block == test && inst->IsTerminator())) {
+                continue;
+            }
+            auto clone = function->Clone(inst);
+            for (auto &target: clone->targets) {
+                target = blocks.at(target);
+            }
+            clone->block = copy;
+            copy->insts.push_back(clone);
+            values[inst] = clone;
+            copies.emplace_back(inst, clone);
+        }
+    }
+    for (auto &[inst, clone]: copies) {
+        for (auto operand: inst->operands) {
+            clone->AddOperand(Map(values, operand));
+        }
+    }
+}
+
+// The copies follow each other, each with the induction variable a constant
+// and the other header phis the values the copy before left for the latch.
+void LoopUnroller::Unroll(Loop *loop, const std::vector<Block *> &body) {
+    auto header = loop->header;
+    auto latch = loop->latches[0];
+    auto test = latch->preds[0];
+    auto exit = test->Terminator()->targets[0];
+    auto preheader = loop->Preheader();
+    auto latch_index = header->preds[0] == latch ? 0 : 1;
+    auto next = loop->induction->Operand(latch_index);
+    auto escaping = Escaping(loop, body);
+
+    Values values;
+    Block *last = preheader;
+    preheader->Terminator()->Erase();
+    for (long long i = 0; i < loop->trip_count; ++i) {
+        auto induction = function->Int(WrappingAdd(loop->begin->imm, i * loop->step));
+        Values copy;
+        for (auto phi: header->Phis()) {
+            auto incoming = phi->Operand(i == 0 ? 1 - latch_index : latch_index);
+            copy[phi] = phi == loop->induction || incoming == next ? induction
+                                                                   : i == 0 ? incoming : Map(values, incoming);
+        }
+        Blocks blocks;
+        CopyBody(loop, body, copy, blocks);
+        function->Jump(last, blocks.at(header));
+        values = std::move(copy);
+        last = blocks.at(test);
+    }
+    function->RemoveEdge(preheader, header);
+    End(last, nullptr, {exit});
+    std::replace(exit->preds.begin(), exit->preds.end(), test, last);
+    for (auto &[inst, users]: escaping) {
+        for (auto user: users) {
+            for (size_t i = 0; i < user->operands.size(); ++i) {
+                if (user->Operand(i) == inst) {
+                    user->SetOperand(i, Map(values, inst));
+                }
+            }
+        }
+    }
+    ++full;
+}
+
+// The preheader branches to the unrolled loop when the trip count is a
+// multiple of the factor, otherwise to the original loop, which now stops
+// after the remainder and then either leaves or enters the unrolled loop.
+// The copies in the unrolled loop count from one induction phi stepping by
+// the factor; only the last one tests for the exit.
+void LoopUnroller::UnrollPartially(Loop *loop, const std::vector<Block *> &body) {
+    auto header = loop->header;
+    auto latch = loop->latches[0];
+    auto test = latch->preds[0];
+    auto exit = test->Terminator()->targets[0];
+    auto preheader = loop->Preheader();
+    auto latch_index = header->preds[0] == latch ? 0 : 1;
+    auto induction = loop->induction;
+    auto next = induction->Operand(latch_index);
+    auto step = loop->step;
+    auto escaping = Escaping(loop, body);
+
+    // Each header phi gets one in the unrolled header, and one where the
+    // unrolled loop is entered from the preheader or the remainder loop.
+    auto entry = function->NewBlock();
+    auto unrolled_latch = function->NewBlock();
+    std::vector<std::pair<Inst *, Inst *>> entry_phis, phis;
+    Inst *first = nullptr;
+    for (auto phi: header->Phis()) {
+        entry_phis.emplace_back(phi, function->New(IrOp::Phi, phi->type));
+        phis.emplace_back(phi, function->New(IrOp::Phi, phi->type));
+        first = phi == induction ? phis.back().second : first;
+    }
+    std::vector<Values> copies(factor);
+    std::vector<Blocks> blocks(factor);
+    for (int i = 0; i < factor; ++i) {
+        auto value = first;
+        if (i != 0) {
+            value = function->New(IrOp::Add, IrType::Int);
+            value->AddOperand(first);
+            value->AddOperand(function->Int(i * step));
+        }
+        for (auto &[phi, unrolled]: phis) {
+            auto incoming = phi->Operand(latch_index);
+            copies[i][phi] = i == 0 ? unrolled : phi == induction || incoming == next ? value
+                                                                                      : Map(copies[i - 1], incoming);
+        }
+        CopyBody(loop, body, copies[i], blocks[i]);
+        auto copy_header = blocks[i].at(header);
+        if (i == 0) {
+            for (auto &[phi, unrolled]: phis) {
+                copy_header->Insert(copy_header->Phis().size(), unrolled);
+            }
+        } else {
+            copy_header->Insert(0, value);
+            function->Jump(blocks[i - 1].at(test), copy_header);
+        }
+    }
+    for (auto &[phi, entry_phi]: entry_phis) {
+        entry->Append(entry_phi);
+    }
+    function->Jump(entry, blocks[0].at(header));
+    auto round = Emit(unrolled_latch, IrOp::Add, first, function->Int(factor * step));
+    function->Jump(unrolled_latch, blocks[0].at(header));
+
+    // The trip count modulo the factor, and the value the induction variable
+    // takes in the last iteration of the remainder.
+    auto from = step > 0 ? loop->begin : loop->end;
+    auto to = step > 0 ? loop->end : loop->begin;
+    Inst *count;
+    if (from->IsConstant() && from->imm == 1) {
+        count = to;
+    } else if (from->IsConstant()) {
+        count = Emit(preheader, IrOp::Sub, to, function->Int(WrappingAdd(from->imm, -1)));
+    } else if (to->IsConstant()) {
+        count = Emit(preheader, IrOp::Sub, function->Int(WrappingAdd(to->imm, 1)), from);
+    } else {
+        count = Emit(preheader, IrOp::Add, Emit(preheader, IrOp::Sub, to, from), function->Int(1));
+    }
+    auto remainder = Emit(preheader, IrOp::And, count, function->Int(factor - 1));
+    Inst *last;
+    if (loop->begin->IsConstant()) {
+        auto before = function->Int(WrappingAdd(loop->begin->imm, -step));
+        last = Emit(preheader, step > 0 ? IrOp::Add : IrOp::Sub, before, remainder);
+    } else {
+        last = Emit(preheader, step > 0 ? IrOp::Add : IrOp::Sub, loop->begin,
+                    Emit(preheader, IrOp::Sub, remainder, function->Int(1)));
+    }
+    auto multiple = Emit(preheader, IrOp::Cmp, remainder, function->Int(0));
+    preheader->Terminator()->Erase();
+    End(preheader, multiple, {entry, header});
+    entry->preds.push_back(preheader);
+
+    // Leaving the remainder loop.
+    auto check = function->NewBlock();
+    auto merge = function->NewBlock();
+    auto test_branch = test->Terminator();
+    test_branch->targets[0] = check;
+    std::replace(test->succs.begin(), test->succs.end(), exit, check);
+    check->preds.push_back(test);
+    auto after = Emit(check, IrOp::Add, induction, function->Int(step));
+    auto done = Emit(check, IrOp::Cmp, induction, loop->end);
+    loop->exit_test->SetOperand(1, last);
+    function->Branch(check, done, merge, entry);
+    function->Branch(blocks[factor - 1].at(test), Map(copies[factor - 1], test_branch->Operand(0)), merge,
+                     unrolled_latch);
+    End(merge, nullptr, {exit});
+    std::replace(exit->preds.begin(), exit->preds.end(), test, merge);
+
+    for (size_t i = 0; i < phis.size(); ++i) {
+        auto [phi, unrolled] = phis[i];
+        auto entry_phi = entry_phis[i].second;
+        auto incoming = phi->Operand(latch_index);
+        entry_phi->AddOperand(phi->Operand(1 - latch_index));
+        entry_phi->AddOperand(incoming == next ? after : incoming);
+        unrolled->AddOperand(entry_phi);
+        unrolled->AddOperand(incoming == next ? round : Map(copies[factor - 1], incoming));
+    }
+    for (auto &[inst, users]: escaping) {
+        auto phi = function->New(IrOp::Phi, inst->type);
+        phi->AddOperand(inst);
+        phi->AddOperand(Map(copies[factor - 1], inst));
+        merge->Insert(0, phi);
+        for (auto user: users) {
+            for (size_t i = 0; i < user->operands.size(); ++i) {
+                if (user->Operand(i) == inst) {
+                    user->SetOperand(i, phi);
+                }
+            }
+        }
+    }
+    ++partial;
+}
+
+bool LoopUnroller::Run() {
+    if (factor < 2 || (factor & (factor - 1)) != 0) {
+        return false;
+    }
+    for (auto loop: loops.Loops()) {
+        auto body = Body(loop);
+        if (body.empty()) {
+            continue;
+        }
+        auto size = Size(body);
+        if (loop->trip_count > 0 && loop->trip_count <= kFullTrips && size * loop->trip_count <= kUnrolledSize) {
+            Unroll(loop, body);
+        } else if ((loop->trip_count < 0 || loop->trip_count >= factor) && size * factor <= kUnrolledSize) {
+            UnrollPartially(loop, body);
+        }
+    }
+    if (full != 0) {
+        function->Cleanup();
+    }
+    if (stats != nullptr) {
+        stats->Add("unroll.full", (long long) full);
+        stats->Add("unroll.partial", (long long) partial);
+    }
+    return full + partial != 0;
+}
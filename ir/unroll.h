@@ -0,0 +1,67 @@
+#ifndef COMPILER_UNROLL_H
+#define COMPILER_UNROLL_H
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "analysis.h"
+#include "ir.h"
+#include "loops.h"
+#include "statistics.h"
+
+// Unrolling of innermost for loops. A loop running a few times known in
+// advance becomes that many copies of its body. Otherwise the body is
+// copied factor times, a power of two, into a loop stepping by factor that
+// tests for the exit once per round; the original loop stays in front of it
+// as the remainder loop and first runs the trip count modulo factor
+// iterations. Trip counts are computed modulo 2^64, as the loop counts, so
+// nothing has to be known about the bounds.
+class LoopUnroller {
+public:
+    LoopUnroller(IrFunction *function, Analyses &analyses, Statistics *stats = nullptr, int factor = 4)
+            : function(function), loops(analyses.Get<LoopForest>()), stats(stats), factor(factor) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    using Values = std::unordered_map<Inst *, Inst *>;
+    using Blocks = std::unordered_map<Block *, Block *>;
+
+    // The blocks of the loop but its latch when the loop has the shape for
+    // statements are built in and nothing but its exit test leaves it,
+    // otherwise nothing.
+    [[nodiscard]] std::vector<Block *> Body(Loop *loop) const;
+
+    // Values of the loop used after it, with their users.
+    [[nodiscard]] std::vector<std::pair<Inst *, std::vector<Inst *>>> Escaping(
+            Loop *loop, const std::vector<Block *> &body) const;
+
+    void Unroll(Loop *loop, const std::vector<Block *> &body);
+
+    void UnrollPartially(Loop *loop, const std::vector<Block *> &body);
+
+    // Copies the body with values holding what the header phis stand for in
+    // the copy, and adds the copies of the rest to values and blocks. The
+    // copy of the header is left without predecessors, the copy of the exit
+    // test block without successors and terminator.
+    void CopyBody(Loop *loop, const std::vector<Block *> &body, Values &values, Blocks &blocks);
+
+    // Ends block with a jump, or a branch on condition, without adding it to
+    // the predecessors of the targets.
+    void End(Block *block, Inst *condition, const std::vector<Block *> &targets);
+
+    Inst *Emit(Block *block, IrOp op, Inst *a, Inst *b);
+
+    static Inst *Map(const Values &values, Inst *value);
+
+    IrFunction *function;
+    const LoopForest &loops;
+    Statistics *stats;
+    int factor;
+    size_t full = 0;
+    size_t partial = 0;
+};
+
+#endif //COMPILER_UNROLL_H
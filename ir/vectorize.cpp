@@ -0,0 +1,492 @@
+#include "vectorize.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+#include "alias.h"
+#include "range.h"
+
+static long long WrappingAdd(long long a, long long b) {
+    return (long long) ((unsigned long long) a + (unsigned long long) b);
+}
+
+// Whether index is the induction variable plus a constant, and which.
+static bool IsShifted(Inst *index, Inst *induction, long long &shift) {
+    if (index == induction) {
+        shift = 0;
+        return true;
+    }
+    if (index->op != IrOp::Add && index->op != IrOp::Sub) {
+        return false;
+    }
+    auto a = index->Operand(0), b = index->Operand(1);
+    if (index->op == IrOp::Add && b == induction) {
+        std::swap(a, b);
+    }
+    if (a != induction || !b->IsConstant() || b->imm == INT64_MIN) {
+        return false;
+    }
+    shift = index->op == IrOp::Sub ? -b->imm : b->imm;
+    return true;
+}
+
+static bool IsKernelOp(IrOp op, Kernel::Op &result) {
+    static const std::pair<IrOp, Kernel::Op> ops[] = {
+            {IrOp::Add,  Kernel::Op::Add},
+            {IrOp::Sub,  Kernel::Op::Sub},
+            {IrOp::Mul,  Kernel::Op::Mul},
+            {IrOp::And,  Kernel::Op::And},
+            {IrOp::Or,   Kernel::Op::Or},
+            {IrOp::Xor,  Kernel::Op::Xor},
+            {IrOp::Neg,  Kernel::Op::Neg},
+            {IrOp::FAdd, Kernel::Op::FAdd},
+            {IrOp::FSub, Kernel::Op::FSub},
+            {IrOp::FMul, Kernel::Op::FMul},
+            {IrOp::FDiv, Kernel::Op::FDiv}};
+    for (auto &[from, to]: ops) {
+        if (from == op) {
+            result = to;
+            return true;
+        }
+    }
+    return false;
+}
+
+Inst *LoopVectorizer::Emit(Block *block, IrOp op, Inst *a, Inst *b) {
+    auto inst = function->New(op, IrType::Int);
+    inst->AddOperand(a);
+    inst->AddOperand(b);
+    block->Append(inst);
+    return inst;
+}
+
+void LoopVectorizer::End(Block *block, Inst *condition, const std::vector<Block *> &targets) {
+    auto inst = function->New(condition == nullptr ? IrOp::Jump : IrOp::Branch, IrType::Void);
+    if (condition != nullptr) {
+        inst->AddOperand(condition);
+    }
+    inst->targets = targets;
+    block->Append(inst);
+    block->succs = targets;
+}
+
+Inst *LoopVectorizer::Address(Block *block, Inst *element, Inst *index, long long shift) {
+    Inst *at = index;
+    if (index->IsConstant()) {
+        at = function->Int(WrappingAdd(index->imm, shift));
+    } else if (shift != 0) {
+        at = Emit(block, IrOp::Add, index, function->Int(shift));
+    }
+    auto address = function->Clone(element);
+    address->AddOperand(element->Operand(0));
+    address->AddOperand(at);
+    block->Append(address);
+    return address;
+}
+
+bool LoopVectorizer::Build(Loop *loop, Candidate &candidate) const {
+    auto fail = [&](const char *reason) {
+        candidate.reason = reason;
+        return false;
+    };
+    auto header = loop->header;
+    if (!loop->IsCounted()) {
+        return fail("it is not a for loop over an unchanged variable");
+    }
+    if (loop->step != 1) {
+        return fail("it does not count up by one");
+    }
+    if (!loop->children.empty()) {
+        return fail("it contains another loop");
+    }
+    if (loop->blocks.size() != 2) {
+        return fail("its body branches");
+    }
+    if (loop->Preheader() == nullptr || loop->exit_test->block != header || loop->exit_test->users.size() != 1 ||
+        !RangeAnalysis::IsGuarded(loop)) {
+        return fail("its bounds are not tested before it");
+    }
+    // The step of the induction variable is in the latch, or in the header
+    // when an element uses the next value as well.
+    auto latch = loop->latches[0];
+    auto induction = loop->induction;
+    auto latch_index = header->preds[0] == latch ? 0 : 1;
+    auto next = induction->Operand(latch_index);
+    if (latch->insts.size() != (next->block == latch ? 2 : 1)) {
+        return fail("its body branches");
+    }
+    auto &kernel = candidate.kernel;
+    std::unordered_map<Inst *, int> nodes;
+    std::unordered_map<Inst *, int> streams;
+    auto add = [&](Kernel::Op op, int a, int b) {
+        kernel.nodes.push_back({op, a, b});
+        return (int) kernel.nodes.size() - 1;
+    };
+    // Values from outside the loop become params.
+    auto node = [&](Inst *value) {
+        auto it = nodes.find(value);
+        if (it != nodes.end()) {
+            return it->second;
+        }
+        if (!loop->IsInvariant(value) || (value->type != IrType::Int && value->type != IrType::Double)) {
+            return -1;
+        }
+        candidate.params.push_back(value);
+        return nodes[value] = add(Kernel::Op::Param, (int) candidate.params.size() - 1, 0);
+    };
+    // Why value cannot be a node.
+    auto unsupported = [&](Inst *value) {
+        if (!loop->IsInvariant(value)) {
+            return value == induction || value == next ? "it computes with the loop variable"
+                                                       : "an iteration uses a value the one before computed";
+        }
+        return "it computes with strings";
+    };
+    auto only_elements = [&](Inst *index) {
+        return std::all_of(index->users.begin(), index->users.end(), [&](Inst *user) {
+            return (user->op == IrOp::Element && user->Operand(1) == index) || (index == next && user == induction);
+        });
+    };
+    static const std::pair<IrOp, Kernel::Op> reductions[] = {
+            {IrOp::Add, Kernel::Op::Add},
+            {IrOp::Mul, Kernel::Op::Mul},
+            {IrOp::And, Kernel::Op::And},
+            {IrOp::Or,  Kernel::Op::Or}};
+
+    for (auto inst: header->insts) {
+        for (auto user: inst->users) {
+            if (!loop->Contains(user->block) && inst != induction && inst != candidate.update) {
+                return fail("a value it computes is used after it");
+            }
+        }
+        long long shift;
+        Kernel::Op op;
+        if (inst == induction || inst == loop->exit_test || inst->IsTerminator()) {
+            continue;
+        } else if (inst->op == IrOp::Phi) {
+            // An accumulator: the phi feeds nothing but the operation giving
+            // its next value.
+            auto update = inst->Operand(latch_index);
+            auto reduction = std::find_if(std::begin(reductions), std::end(reductions), [&](auto &pair) {
+                return pair.first == update->op;
+            });
+            bool reduces = inst->users.size() == 1 && inst->users[0] == update && update->block == header;
+            if (reduces && (update->op == IrOp::FAdd || update->op == IrOp::FMul)) {
+                return fail("it reduces doubles, which would round differently in another order");
+            }
+            if (!reduces || candidate.sum != nullptr || inst->type != IrType::Int ||
+                reduction == std::end(reductions)) {
+                return fail("an iteration uses a value the one before computed");
+            }
+            candidate.sum = inst;
+            candidate.update = update;
+            kernel.reduce = reduction->second;
+        } else if (inst == candidate.update) {
+            auto addend = inst->Operand(inst->Operand(0) == candidate.sum ? 1 : 0);
+            for (auto user: inst->users) {
+                if (loop->Contains(user->block) && user != candidate.sum) {
+                    return fail("an iteration uses a value the one before computed");
+                }
+            }
+            kernel.reduction = addend == candidate.sum ? -1 : node(addend);
+            if (kernel.reduction < 0) {
+                return fail(unsupported(addend));
+            }
+        } else if (IsShifted(inst, induction, shift) && only_elements(inst)) {
+            continue;
+        } else if (inst->op == IrOp::Element) {
+            if (inst->checked) {
+                return fail("it keeps a bounds check");
+            }
+            if (inst->imm3 != 1 || !loop->IsInvariant(inst->Operand(0))) {
+                return fail("it walks an array of arrays or records");
+            }
+            if (!IsShifted(inst->Operand(1), induction, shift)) {
+                return fail("it indexes an array other than by the loop variable plus a constant");
+            }
+            for (auto user: inst->users) {
+                if (user->op != IrOp::Load && (user->op != IrOp::Store || user->Operand(1) == inst)) {
+                    return fail("it passes an element on by reference");
+                }
+            }
+            auto base = inst->Operand(0);
+            auto offset = shift - inst->imm;
+            auto &list = candidate.streams;
+            auto it = std::find_if(list.begin(), list.end(), [&](const Stream &stream) {
+                return stream.base == base && stream.offset == offset;
+            });
+            if (it == list.end()) {
+                if ((int) list.size() == Kernel::kStreams) {
+                    return fail("it walks too many arrays");
+                }
+                list.push_back({inst, base, shift, offset});
+                it = list.end() - 1;
+            }
+            streams[inst] = (int) (it - list.begin());
+        } else if (inst->op == IrOp::Load) {
+            auto stream = streams.find(inst->Operand(0));
+            if (stream == streams.end()) {
+                return fail("it reads a variable, not an array element");
+            }
+            if (inst->type != IrType::Int && inst->type != IrType::Double) {
+                return fail("it reads strings");
+            }
+            nodes[inst] = add(Kernel::Op::Load, stream->second, 0);
+            candidate.streams[stream->second].last_load = nodes[inst];
+        } else if (inst->op == IrOp::Store) {
+            auto stream = streams.find(inst->Operand(0));
+            auto value = node(inst->Operand(1));
+            if (stream == streams.end()) {
+                return fail("it stores to a variable, not an array element");
+            }
+            if (value < 0) {
+                return fail(unsupported(inst->Operand(1)));
+            }
+            auto store = add(Kernel::Op::Store, stream->second, value);
+            auto &first = candidate.streams[stream->second].first_store;
+            first = first < 0 ? store : first;
+        } else if (IsKernelOp(inst->op, op)) {
+            auto a = node(inst->Operand(0));
+            auto b = inst->operands.size() == 2 ? node(inst->Operand(1)) : 0;
+            if (a < 0 || b < 0) {
+                return fail(unsupported(inst->Operand(a < 0 ? 0 : 1)));
+            }
+            nodes[inst] = add(op, a, b);
+        } else if (inst->op == IrOp::Call) {
+            return fail("it calls a routine");
+        } else if (inst->op == IrOp::Read || inst->op == IrOp::Write || inst->op == IrOp::WriteLn) {
+            return fail("it reads or writes the console");
+        } else {
+            return fail("it computes what the kernels cannot, such as a division or a comparison");
+        }
+        if ((int) kernel.nodes.size() > Kernel::kNodes) {
+            return fail("its body is too large");
+        }
+    }
+    bool stores = std::any_of(kernel.nodes.begin(), kernel.nodes.end(), [](const Kernel::Node &node) {
+        return node.op == Kernel::Op::Store;
+    });
+    kernel.streams = (int) candidate.streams.size();
+    kernel.params = (int) candidate.params.size();
+    std::vector<int> registers;
+    if (!stores && kernel.reduction < 0) {
+        return fail("it stores nothing to arrays");
+    }
+    if (candidate.sum != nullptr && kernel.reduction < 0) {
+        return fail("an iteration uses a value the one before computed");
+    }
+    if (kernel.Registers(registers) > Kernel::kRegisters) {
+        return fail("its body needs too many registers");
+    }
+    return true;
+}
+
+// Elements of one array are walked in step, so a store to it and a load
+// from it further ahead stay apart as long as every load of the element
+// comes before the store that overwrites it a few iterations later, which
+// keeps the loop in order. Stores elsewhere into the array, or loads behind
+// a store, depend on an earlier iteration.
+bool LoopVectorizer::Independent(Candidate &candidate) {
+    auto &streams = candidate.streams;
+    for (size_t i = 0; i < streams.size(); ++i) {
+        auto &store = streams[i];
+        if (store.first_store < 0) {
+            continue;
+        }
+        for (size_t j = 0; j < streams.size(); ++j) {
+            auto &other = streams[j];
+            if (i == j) {
+                continue;
+            }
+            if (store.base == other.base) {
+                if (other.first_store >= 0 || other.offset < store.offset || other.last_load > store.first_store) {
+                    candidate.reason = "an iteration uses an element another one stores";
+                    return false;
+                }
+                candidate.ordered |= other.offset != store.offset;
+            } else if (MayOverlap(store.base, other.base) && (other.first_store < 0 || i < j)) {
+                candidate.checks.emplace_back((int) i, (int) j);
+            }
+        }
+    }
+    return true;
+}
+
+// Without checks the preheader runs the kernel and continues after the
+// loop, which is left unreachable. With them it branches to a block that
+// does, or to the loop when two of the arrays overlap; both meet again in a
+// block with phis for the values used after the loop.
+void LoopVectorizer::Vectorize(Loop *loop, Candidate &candidate) {
+    auto header = loop->header;
+    auto preheader = loop->Preheader();
+    auto test = header->Terminator();
+    auto exit = test->targets[0];
+    auto begin = loop->begin, end = loop->end;
+    auto &streams = candidate.streams;
+
+    std::vector<std::pair<Inst *, std::vector<Inst *>>> escaping;
+    for (auto inst: {loop->induction, candidate.update}) {
+        if (inst == nullptr) {
+            continue;
+        }
+        std::vector<Inst *> users;
+        for (auto user: inst->users) {
+            if (!loop->Contains(user->block) && std::find(users.begin(), users.end(), user) == users.end()) {
+                users.push_back(user);
+            }
+        }
+        escaping.emplace_back(inst, users);
+    }
+
+    preheader->Terminator()->Erase();
+    std::vector<Inst *> starts;
+    for (auto &stream: streams) {
+        starts.push_back(Address(preheader, stream.element, begin, stream.shift));
+    }
+    Inst *count;
+    if (loop->trip_count >= 0) {
+        count = function->Int(loop->trip_count);
+    } else if (begin->IsConstant() && begin->imm == 1) {
+        count = end;
+    } else if (begin->IsConstant()) {
+        count = Emit(preheader, IrOp::Sub, end, function->Int(WrappingAdd(begin->imm, -1)));
+    } else if (end->IsConstant()) {
+        count = Emit(preheader, IrOp::Sub, function->Int(WrappingAdd(end->imm, 1)), begin);
+    } else {
+        count = Emit(preheader, IrOp::Add, Emit(preheader, IrOp::Sub, end, begin), function->Int(1));
+    }
+    // The arrays are apart when the last element of either lies before the
+    // first of the other.
+    Inst *disjoint = nullptr;
+    for (auto [i, j]: candidate.checks) {
+        auto last_i = Address(preheader, streams[i].element, end, streams[i].shift);
+        auto last_j = Address(preheader, streams[j].element, end, streams[j].shift);
+        auto before = Emit(preheader, IrOp::Cmp, last_i, starts[j]);
+        auto after = Emit(preheader, IrOp::Cmp, last_j, starts[i]);
+        before->pred = after->pred = Pred::Lt;
+        auto apart = Emit(preheader, IrOp::Or, before, after);
+        disjoint = disjoint == nullptr ? apart : Emit(preheader, IrOp::And, disjoint, apart);
+    }
+
+    auto kernel = function->module->NewKernel();
+    *kernel = candidate.kernel;
+    kernel->parallel = parallel && !candidate.ordered &&
+                       (loop->trip_count < 0 || loop->trip_count > Kernel::kChunk);
+    candidate.kernel.parallel = kernel->parallel;
+    auto vector = function->New(IrOp::Vector, candidate.sum != nullptr ? IrType::Int : IrType::Void);
+    vector->kernel = kernel;
+    vector->pos = loop->exit_test->pos;
+    vector->AddOperand(count);
+    for (auto start: starts) {
+        vector->AddOperand(start);
+    }
+    for (auto param: candidate.params) {
+        vector->AddOperand(param);
+    }
+    if (candidate.sum != nullptr) {
+        vector->AddOperand(candidate.sum->Operand(header->preds[0] == loop->latches[0] ? 1 : 0));
+    }
+    auto after = [&](Inst *inst) { return inst == loop->induction ? end : vector; };
+
+    if (disjoint == nullptr) {
+        function->RemoveEdge(preheader, header);
+        preheader->Append(vector);
+        End(preheader, nullptr, {exit});
+        std::replace(exit->preds.begin(), exit->preds.end(), header, preheader);
+        for (auto &[inst, users]: escaping) {
+            for (auto user: users) {
+                for (size_t i = 0; i < user->operands.size(); ++i) {
+                    if (user->Operand(i) == inst) {
+                        user->SetOperand(i, after(inst));
+                    }
+                }
+            }
+        }
+    } else {
+        auto block = function->NewBlock();
+        auto merge = function->NewBlock();
+        End(preheader, disjoint, {block, header});
+        block->preds.push_back(preheader);
+        block->Append(vector);
+        test->targets[0] = merge;
+        std::replace(header->succs.begin(), header->succs.end(), exit, merge);
+        merge->preds.push_back(header);
+        function->Jump(block, merge);
+        End(merge, nullptr, {exit});
+        std::replace(exit->preds.begin(), exit->preds.end(), header, merge);
+        for (auto &[inst, users]: escaping) {
+            if (users.empty()) {
+                continue;
+            }
+            auto phi = function->New(IrOp::Phi, inst->type);
+            phi->AddOperand(inst);
+            phi->AddOperand(after(inst));
+            merge->Insert(0, phi);
+            for (auto user: users) {
+                for (size_t i = 0; i < user->operands.size(); ++i) {
+                    if (user->Operand(i) == inst) {
+                        user->SetOperand(i, phi);
+                    }
+                }
+            }
+        }
+        ++checked;
+    }
+    ++vectorized;
+    threaded += kernel->parallel;
+}
+
+void LoopVectorizer::Report(Loop *loop, const Candidate &candidate, bool done) const {
+    auto test = loop->IsCounted() ? loop->exit_test : loop->header->Terminator();
+    if (report == nullptr || test->op == IrOp::Jump) {
+        return;
+    }
+    if (test->op == IrOp::Branch) {
+        test = test->Operand(0);
+    }
+    // Only for and while loops know where they are in the source.
+    if (test->pos.GetLine() == 0) {
+        return;
+    }
+    *report << function->name << ": loop at line " << test->pos.GetLine() << ": ";
+    if (!done) {
+        *report << "not " << (parallel ? "parallelized" : "vectorized") << ", " << candidate.reason << "\n";
+        return;
+    }
+    auto &kernel = candidate.kernel;
+    *report << (kernel.parallel ? "parallelized" : "vectorized");
+    if (kernel.reduction >= 0) {
+        auto reduce = kernel.reduce;
+        *report << ", reducing with "
+                << (reduce == Kernel::Op::Add ? "+" : reduce == Kernel::Op::Mul ? "*" : KernelOpName(reduce));
+    }
+    if (!candidate.checks.empty()) {
+        *report << ", when its arrays do not overlap";
+    }
+    if (parallel && !kernel.parallel) {
+        *report << (candidate.ordered ? "; it reads ahead of what it stores, so its iterations stay in order"
+                                      : "; it runs too few times to split between threads");
+    }
+    *report << "\n";
+}
+
+bool LoopVectorizer::Run() {
+    for (auto loop: loops.Loops()) {
+        Candidate candidate;
+        bool done = Build(loop, candidate) && Independent(candidate);
+        if (done) {
+            Vectorize(loop, candidate);
+        }
+        Report(loop, candidate, done);
+    }
+    if (vectorized != 0) {
+        function->Cleanup();
+    }
+    if (stats != nullptr) {
+        stats->Add("vector.loops", (long long) vectorized);
+        stats->Add("vector.checks", (long long) checked);
+        stats->Add("vector.parallel", (long long) threaded);
+    }
+    return vectorized != 0;
+}
@@ -0,0 +1,91 @@
+#ifndef COMPILER_VECTORIZE_H
+#define COMPILER_VECTORIZE_H
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "analysis.h"
+#include "ir.h"
+#include "loops.h"
+#include "statistics.h"
+
+// Vectorization of innermost for loops stepping by one whose body is a
+// single block of arithmetic on elements of arrays at the induction variable
+// plus a constant, optionally reducing one value into an integer with +, *,
+// and or or. The loop becomes a vector instruction in the preheader running
+// the body as a kernel over all the elements, which the backends run several
+// elements at a time. Arrays that may overlap are checked at run time, with
+// the original loop kept for when they do. With parallel set the kernels may
+// also be split between threads, and report gets a line for every for loop
+// saying whether it was vectorized or why not.
+class LoopVectorizer {
+public:
+    LoopVectorizer(IrFunction *function, Analyses &analyses, Statistics *stats = nullptr, bool parallel = false,
+                   std::ostream *report = nullptr)
+            : function(function), loops(analyses.Get<LoopForest>()), stats(stats), parallel(parallel),
+              report(report) {}
+
+    // Returns whether the function changed.
+    bool Run();
+
+private:
+    // The elements a kernel stream walks: base plus the induction variable
+    // plus shift, at offset slots from the start of the array.
+    struct Stream {
+        Inst *element = nullptr;
+        Inst *base = nullptr;
+        long long shift = 0;
+        long long offset = 0;
+        int last_load = -1;
+        int first_store = -1;
+    };
+
+    struct Candidate {
+        Kernel kernel;
+        std::vector<Stream> streams;
+        std::vector<Inst *> params;
+        // The accumulator phi and the operation updating it.
+        Inst *sum = nullptr;
+        Inst *update = nullptr;
+        // Pairs of streams that may overlap, with one of them stored to.
+        std::vector<std::pair<int, int>> checks;
+        // A load reads ahead of a store into the same array, so the elements
+        // have to run in order.
+        bool ordered = false;
+        // Why the loop is left as it is.
+        const char *reason = nullptr;
+    };
+
+    // Builds the kernel of the loop, or returns false with the reason set
+    // when the loop does not have the shape or the kernel does not fit.
+    bool Build(Loop *loop, Candidate &candidate) const;
+
+    // Whether the streams can be run in any order, adding the pairs only the
+    // running program can tell apart to the checks.
+    static bool Independent(Candidate &candidate);
+
+    void Report(Loop *loop, const Candidate &candidate, bool done) const;
+
+    void Vectorize(Loop *loop, Candidate &candidate);
+
+    // Ends block with a jump, or a branch on condition, without adding it to
+    // the predecessors of the targets.
+    void End(Block *block, Inst *condition, const std::vector<Block *> &targets);
+
+    // The address of element index plus shift of the array element walks.
+    Inst *Address(Block *block, Inst *element, Inst *index, long long shift);
+
+    Inst *Emit(Block *block, IrOp op, Inst *a, Inst *b);
+
+    IrFunction *function;
+    const LoopForest &loops;
+    Statistics *stats;
+    bool parallel;
+    std::ostream *report;
+    size_t vectorized = 0;
+    size_t checked = 0;
+    size_t threaded = 0;
+};
+
+#endif //COMPILER_VECTORIZE_H
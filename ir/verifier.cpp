@@ -0,0 +1,238 @@
+#include "verifier.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "dominance.h"
+
+static bool IsInteger(IrOp op) {
+    switch (op) {
+        case IrOp::Add:
+        case IrOp::Sub:
+        case IrOp::Mul:
+        case IrOp::Div:
+        case IrOp::Mod:
+        case IrOp::Shl:
+        case IrOp::Shr:
+        case IrOp::And:
+        case IrOp::Or:
+        case IrOp::Xor:
+        case IrOp::Neg:
+        case IrOp::Not:
+        case IrOp::LNot:
+        case IrOp::Cmp:
+        case IrOp::IToF:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool IsDouble(IrOp op) {
+    switch (op) {
+        case IrOp::FAdd:
+        case IrOp::FSub:
+        case IrOp::FMul:
+        case IrOp::FDiv:
+        case IrOp::FNeg:
+        case IrOp::FCmp:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::vector<std::string> Verify(IrFunction *function) {
+    std::vector<std::string> errors;
+    auto error = [&](Block *block, Inst *inst, const std::string &message) {
+        auto where = function->name + ", b" + std::to_string(block->id);
+        if (inst != nullptr) {
+            where += ", " + std::string(IrOpName(inst->op));
+        }
+        errors.push_back(where + ": " + message);
+    };
+    if (function->blocks.empty()) {
+        errors.push_back(function->name + ": no entry block");
+        return errors;
+    }
+    if (!function->Entry()->preds.empty()) {
+        error(function->Entry(), nullptr, "entry block has predecessors");
+    }
+
+    std::unordered_set<Block *> blocks(function->blocks.begin(), function->blocks.end());
+    for (auto block: function->blocks) {
+        auto terminator = block->Terminator();
+        if (terminator == nullptr) {
+            error(block, nullptr, "missing terminator");
+            continue;
+        }
+        if (terminator->targets != block->succs) {
+            error(block, terminator, "successors differ from the terminator targets");
+        }
+        for (auto succ: block->succs) {
+            if (!blocks.count(succ)) {
+                error(block, terminator, "target outside the function");
+            } else if (std::count(succ->preds.begin(), succ->preds.end(), block) !=
+                       std::count(block->succs.begin(), block->succs.end(), succ)) {
+                error(block, terminator, "edge missing from the predecessors of b" + std::to_string(succ->id));
+            }
+        }
+        for (auto pred: block->preds) {
+            if (!blocks.count(pred) || std::find(pred->succs.begin(), pred->succs.end(), block) == pred->succs.end()) {
+                error(block, nullptr, "predecessor without an edge");
+            }
+        }
+    }
+    if (!errors.empty()) {
+        return errors;
+    }
+
+    DominatorTree tree(function);
+    for (auto block: function->blocks) {
+        bool phis = true;
+        for (size_t i = 0; i < block->insts.size(); ++i) {
+            auto inst = block->insts[i];
+            if (inst->block != block) {
+                error(block, inst, "wrong parent block");
+            }
+            if (inst->IsTerminator() && i + 1 != block->insts.size()) {
+                error(block, inst, "terminator in the middle of a block");
+            }
+            if (inst->op == IrOp::Phi) {
+                if (!phis) {
+                    error(block, inst, "phi after other instructions");
+                }
+                if (inst->operands.size() != block->preds.size()) {
+                    error(block, inst, "operand count differs from the predecessor count");
+                    continue;
+                }
+            } else {
+                phis = false;
+            }
+            if (inst->op == IrOp::Const || inst->op == IrOp::Param || inst->op == IrOp::Global) {
+                error(block, inst, "function value placed in a block");
+            }
+            for (size_t j = 0; j < inst->operands.size(); ++j) {
+                auto operand = inst->operands[j];
+                if (std::find(operand->users.begin(), operand->users.end(), inst) == operand->users.end()) {
+                    error(block, inst, "missing from the users of an operand");
+                }
+                if (operand->type == IrType::Void) {
+                    error(block, inst, "operand without a value");
+                }
+                if (operand->block == nullptr && operand->op != IrOp::Const && operand->op != IrOp::Param &&
+                    operand->op != IrOp::Global) {
+                    error(block, inst, "operand was erased");
+                } else if (operand->block != nullptr && !blocks.count(operand->block)) {
+                    error(block, inst, "operand from another function");
+                } else if (!tree.Dominates(operand, inst, j)) {
+                    error(block, inst, "operand does not dominate its use");
+                }
+            }
+            for (auto user: inst->users) {
+                if (std::find(user->operands.begin(), user->operands.end(), inst) == user->operands.end()) {
+                    error(block, inst, "stale user");
+                }
+            }
+
+            auto operand_type = [&](size_t j, IrType type) {
+                if (j < inst->operands.size() && inst->operands[j]->type != type) {
+                    error(block, inst, "operand " + std::to_string(j) + " is not " + IrTypeName(type));
+                }
+            };
+            switch (inst->op) {
+                case IrOp::Load:
+                case IrOp::Offset:
+                    operand_type(0, IrType::Ptr);
+                    break;
+                case IrOp::Element:
+                    operand_type(0, IrType::Ptr);
+                    operand_type(1, IrType::Int);
+                    break;
+                case IrOp::Store:
+                case IrOp::Copy:
+                    operand_type(0, IrType::Ptr);
+                    break;
+                case IrOp::Branch:
+                    operand_type(0, IrType::Int);
+                    break;
+                case IrOp::Cmp:
+                    // Pointers are ordered too, to tell whether arrays overlap.
+                    if (inst->Operand(0)->type != IrType::Ptr || inst->Operand(1)->type != IrType::Ptr) {
+                        operand_type(0, IrType::Int);
+                        operand_type(1, IrType::Int);
+                    }
+                    break;
+                case IrOp::Concat:
+                case IrOp::SCmp:
+                    operand_type(0, IrType::String);
+                    operand_type(1, IrType::String);
+                    break;
+                case IrOp::Phi:
+                    for (size_t j = 0; j < inst->operands.size(); ++j) {
+                        operand_type(j, inst->type);
+                    }
+                    break;
+                case IrOp::Call:
+                    if (inst->callee == nullptr || inst->callee->params.size() != inst->operands.size()) {
+                        error(block, inst, "arguments differ from the callee parameters");
+                        break;
+                    }
+                    for (size_t j = 0; j < inst->operands.size(); ++j) {
+                        operand_type(j, inst->callee->params[j]->type);
+                    }
+                    if (inst->type != inst->callee->ret) {
+                        error(block, inst, "result type differs from the callee");
+                    }
+                    break;
+                case IrOp::Vector: {
+                    auto kernel = inst->kernel;
+                    auto reduction = kernel != nullptr && kernel->reduction >= 0;
+                    if (kernel == nullptr || inst->operands.size() !=
+                                             (size_t) (1 + kernel->streams + kernel->params + (reduction ? 1 : 0))) {
+                        error(block, inst, "operands differ from the kernel");
+                        break;
+                    }
+                    operand_type(0, IrType::Int);
+                    for (int j = 0; j < kernel->streams; ++j) {
+                        operand_type(1 + j, IrType::Ptr);
+                    }
+                    if (inst->type != (reduction ? IrType::Int : IrType::Void)) {
+                        error(block, inst, "result type differs from the kernel");
+                    } else if (reduction) {
+                        operand_type(inst->operands.size() - 1, IrType::Int);
+                    }
+                    break;
+                }
+                case IrOp::Ret:
+                    if (function->ret == IrType::Void ? !inst->operands.empty()
+                                                      : inst->operands.size() != 1) {
+                        error(block, inst, "return value differs from the function type");
+                    } else if (!inst->operands.empty()) {
+                        operand_type(0, function->ret);
+                    }
+                    break;
+                default:
+                    if (IsInteger(inst->op)) {
+                        for (size_t j = 0; j < inst->operands.size(); ++j) {
+                            operand_type(j, IrType::Int);
+                        }
+                    } else if (IsDouble(inst->op)) {
+                        for (size_t j = 0; j < inst->operands.size(); ++j) {
+                            operand_type(j, IrType::Double);
+                        }
+                    }
+            }
+        }
+    }
+    return errors;
+}
+
+std::vector<std::string> Verify(Module *module) {
+    std::vector<std::string> errors;
+    for (auto function: module->functions) {
+        auto function_errors = Verify(function);
+        errors.insert(errors.end(), function_errors.begin(), function_errors.end());
+    }
+    return errors;
+}
@@ -0,0 +1,17 @@
+#ifndef COMPILER_VERIFIER_H
+#define COMPILER_VERIFIER_H
+
+#include <string>
+#include <vector>
+
+#include "ir.h"
+
+// Checks the structural invariants every pass relies on: one terminator
+// closing each block, phis first with an operand per predecessor, edges
+// agreeing with terminators, definitions dominating their uses, consistent
+// use lists and operand types. Returns a message per violation.
+std::vector<std::string> Verify(IrFunction *function);
+
+std::vector<std::string> Verify(Module *module);
+
+#endif //COMPILER_VERIFIER_H
@@ -0,0 +1,168 @@
+#include "jit.h"
+
+#include <algorithm>
+
+#include "../codegen/encoder.h"
+#include "../codegen/generator.h"
+
+namespace {
+    thread_local JIT *current = nullptr;
+}
+
+// Run-time library called from generated code. Nothing here may throw:
+// there is no unwind information for generated frames.
+struct JitRuntime {
+    static void rt_write_int(long long value) {
+        current->out << value;
+    }
+
+    static void rt_write_double(double value) {
+        WriteDouble(current->out, value);
+    }
+
+    static void rt_write_bool(long long value) {
+        WriteBoolean(current->out, value);
+    }
+
+    static void rt_write_char(long long value) {
+        current->out << (char) value;
+    }
+
+    static void rt_write_string(Value value) {
+        current->out << StringOf(value);
+    }
+
+    static void rt_write_line() {
+        current->out << "\n";
+    }
+
+    static long long rt_read_int() {
+        long long value = 0;
+        current->in >> value;
+        return value;
+    }
+
+    static long long rt_read_double() {
+        Value value{};
+        value.d = 0;
+        current->in >> value.d;
+        return value.i;
+    }
+
+    static long long rt_read_char() {
+        char value = 0;
+        current->in >> value;
+        return value;
+    }
+
+    // Sweeps, when due, the slots generated code recorded before the call
+    // and the native frames above it besides the globals.
+    static const std::string *Make(std::string value) {
+        auto &strings = current->strings;
+        if (strings.Due()) {
+            auto &state = current->state;
+            auto native_end = (const char *) state[StateSlot::StackLimit].p + NATIVE_STACK_LIMIT;
+            strings.Sweep({{state.data(), state.data() + state.size()},
+                           {current->stack.data(), state[StateSlot::StackTop].p},
+                           {current->memory.data(), state[StateSlot::MemoryTop].p},
+                           {state[StateSlot::NativeTop].p, native_end}});
+        }
+        return strings.Make(std::move(value));
+    }
+
+    static const std::string *rt_read_string() {
+        std::string value;
+        current->in >> value;
+        return Make(std::move(value));
+    }
+
+    static const std::string *rt_concat(Value a, Value b) {
+        return Make(StringOf(a) + StringOf(b));
+    }
+
+    static long long rt_compare(Value a, Value b) {
+        return StringOf(a).compare(StringOf(b));
+    }
+
+    // Splits the elements of a parallel kernel between the threads of the
+    // pool, unless there are too few for more than one chunk.
+    static long long rt_parallel(long long (*kernel)(const Value *, long long, long long), const Value *operands,
+                                 long long reduce) {
+        auto op = (Kernel::Op) reduce;
+        auto count = operands[0].i;
+        if (count <= Kernel::kChunk || current->threads <= 1) {
+            return kernel(operands, 0, count);
+        }
+        if (current->pool == nullptr) {
+            current->pool = std::make_unique<ThreadPool>(current->threads);
+        }
+        std::vector<long long> chunks((count + Kernel::kChunk - 1) / Kernel::kChunk);
+        current->pool->For(count, Kernel::kChunk, [&](long long chunk, long long begin, long long end) {
+            chunks[chunk] = kernel(operands, begin, end);
+        });
+        auto result = Kernel::Identity(op);
+        for (auto chunk: chunks) {
+            result = Kernel::Combine(op, result, chunk);
+        }
+        return result;
+    }
+
+    [[noreturn]] static void rt_error(long long line, long long column, long long error) {
+        Position pos;
+        pos.Set((int) line, (int) column);
+        current->error = RuntimeException(pos, RuntimeErrorMessage((RuntimeError) error)).what();
+        std::longjmp(current->error_jump, 1);
+    }
+
+    static const void *const functions[];
+};
+
+const void *const JitRuntime::functions[] = {
+#define RUNTIME_ADDRESS(name, symbol) (const void *) &JitRuntime::symbol,
+        RUNTIME_FUNCTIONS(RUNTIME_ADDRESS)
+#undef RUNTIME_ADDRESS
+};
+
+JIT::JIT(Program *program, std::istream &in, std::ostream &out, size_t stack_size)
+        : program(program), in(in), out(out), state(StateSlot::Globals + program->globals),
+          stack(stack_size), memory(stack_size) {
+}
+
+bool JIT::Compile() {
+#if defined(__x86_64__) && defined(__unix__)
+    X86Encoder encoder(JitRuntime::functions);
+    Label start;
+    try {
+        start = NativeGenerator(program, encoder).Generate();
+    } catch (UnsupportedInstruction &err) {
+        reason = err.what();
+        return false;
+    }
+    encoder.Link();
+    if (!code.Load(encoder.Code())) {
+        reason = "cannot map executable memory";
+        return false;
+    }
+    entry = (void (*)(Value *)) (code.Data() + encoder.Offset(start));
+    return true;
+#else
+    reason = "the host is not x86-64";
+    return false;
+#endif
+}
+
+void JIT::Run() {
+    std::fill(state.begin(), state.end(), Value{});
+    state[StateSlot::StackBase].p = stack.data();
+    state[StateSlot::StackEnd].p = stack.data() + stack.size();
+    state[StateSlot::MemoryBase].p = memory.data();
+    state[StateSlot::MemoryEnd].p = memory.data() + memory.size();
+    auto previous = current;
+    current = this;
+    if (setjmp(error_jump) != 0) {
+        current = previous;
+        throw RuntimeException(error);
+    }
+    entry(state.data());
+    current = previous;
+}
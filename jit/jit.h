@@ -0,0 +1,52 @@
+#ifndef COMPILER_JIT_H
+#define COMPILER_JIT_H
+
+#include <csetjmp>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../parallel/thread_pool.h"
+#include "../vm/bytecode.h"
+#include "../vm/strings.h"
+#include "memory.h"
+
+// Compiles a whole program to x86-64 machine code in memory and runs it in
+// process, with no assembler or linker involved. Generated code shares the
+// VM's storage layout; run-time errors unwind back to Run with longjmp and
+// are rethrown as RuntimeException. Parallel kernels run on a thread pool
+// started the first time one does.
+class JIT {
+public:
+    JIT(Program *program, std::istream &in, std::ostream &out, size_t stack_size = 1 << 20);
+
+    // Returns false, with the reason set, when the program cannot be
+    // compiled on this host and has to run on the VM instead.
+    bool Compile();
+
+    void Run();
+
+    std::string reason;
+
+    // Threads parallel kernels are split between.
+    int threads = ThreadPool::DefaultThreads();
+
+private:
+    friend struct JitRuntime;
+
+    Program *program;
+    std::istream &in;
+    std::ostream &out;
+    std::vector<Value> state;
+    std::vector<Value> stack;
+    std::vector<Value> memory;
+    StringHeap strings;
+    ExecutableMemory code;
+    void (*entry)(Value *) = nullptr;
+    std::jmp_buf error_jump{};
+    std::string error;
+    std::unique_ptr<ThreadPool> pool;
+};
+
+#endif //COMPILER_JIT_H
@@ -0,0 +1,35 @@
+#include "memory.h"
+
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+ExecutableMemory::~ExecutableMemory() {
+    Release();
+}
+
+void ExecutableMemory::Release() {
+    if (data != nullptr) {
+        munmap(data, size);
+        data = nullptr;
+        size = 0;
+    }
+}
+
+bool ExecutableMemory::Load(const std::vector<uint8_t> &code) {
+    Release();
+    auto page = (size_t) sysconf(_SC_PAGESIZE);
+    auto bytes = (code.size() + page - 1) / page * page;
+    auto pages = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED) {
+        return false;
+    }
+    data = (uint8_t *) pages;
+    size = bytes;
+    std::memcpy(data, code.data(), code.size());
+    if (mprotect(data, size, PROT_READ | PROT_EXEC) != 0) {
+        Release();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef COMPILER_JIT_MEMORY_H
+#define COMPILER_JIT_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Page-aligned memory holding generated code. The pages are mapped writable,
+// filled and then switched to read+execute, so they are never writable and
+// executable at the same time.
+class ExecutableMemory {
+public:
+    ExecutableMemory() = default;
+
+    ExecutableMemory(const ExecutableMemory &) = delete;
+
+    ExecutableMemory &operator=(const ExecutableMemory &) = delete;
+
+    ~ExecutableMemory();
+
+    // Returns false when the pages could not be mapped or protected.
+    bool Load(const std::vector<uint8_t> &code);
+
+    [[nodiscard]] const uint8_t *Data() const { return data; }
+
+private:
+    void Release();
+
+    uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+#endif //COMPILER_JIT_MEMORY_H
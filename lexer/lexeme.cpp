@@ -4,8 +4,8 @@
 #include <magic_enum.hpp>
 
 Position::Position() {
-    this->line = line;
-    this->column = column;
+    this->line = 0;
+    this->column = 0;
 }
 
 int Position::GetLine() const { return line; }
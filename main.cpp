@@ -1,9 +1,23 @@
+#include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <thread>
 
 #include "lexer/lexer.h"
 #include "parser/parser.h"
 #include "args.h"
 #include "semantic/semantic.h"
+#include "semantic/incremental.h"
+#include "context/context.h"
+#include "ir/builder.h"
+#include "ir/dataflow.h"
+#include "ir/loops.h"
+#include "ir/optimizer.h"
+#include "ir/verifier.h"
+#include "vm/compiler.h"
+#include "vm/vm.h"
+#include "codegen/assembly.h"
+#include "jit/jit.h"
 
 
 int main(int argc, char **argv) {
@@ -16,6 +30,25 @@ int main(int argc, char **argv) {
     // -l - run lexer
     // -p - run parser
     // -s - run semantic
+    // -w - watch file and re-run semantic incrementally on every change
+    // -d - print the ssa ir
+    // -g - print the loop nest of every routine
+    // -f - print liveness, reaching definitions and available expressions
+    // -t - print what the optimizations removed
+    // -k - keep every bounds check
+    // -u n - unroll loops n times, 1 to keep them rolled
+    // -m - run independent loops on several threads, saying which loops were
+    //      parallelized and why the others were not
+    // -e - say which calls in tail position became jumps or loops
+    // -O0, -O1, -O2 - optimize nothing, only with the passes that do not grow
+    //      the code, or with all of them, the default
+    // -T - print the time every optimization pass took and how it changed
+    //      the size of the ir
+    // -b - print bytecode
+    // -r - run on the bytecode vm
+    // -a - print x86-64 assembly
+    // -n - build a native executable next to the source file
+    // -j - compile to machine code in memory and run it, falling back to the vm
 
     if (!reader.good()) {
         std::cout << "file doesnt exist";
@@ -44,7 +77,8 @@ int main(int argc, char **argv) {
     if (CheckArg(argc, argv, "-p")) {
         auto stream = std::ifstream(argv[1]);
         Lexer lexer(stream);
-        Parser parser(lexer);
+        CompilationContext context;
+        Parser parser(lexer, context);
 
         auto head = parser.Program();
         head->DrawTree(std::cout, 1);
@@ -53,14 +87,135 @@ int main(int argc, char **argv) {
     if (CheckArg(argc, argv, "-s")) {
         auto stream = std::ifstream(argv[1]);
         Lexer lexer(stream);
-        Parser parser(lexer);
+        CompilationContext context;
+        Parser parser(lexer, context);
 
         auto head = parser.Program();
-        auto semantic_visitor = new Semantic();
-        head->Accept(semantic_visitor);
+        Semantic semantic_visitor(&context);
+        head->Accept(&semantic_visitor);
         head->DrawTree(std::cout, 1);
         std::cout << "\n";
-        semantic_visitor->GetStack().Draw(std::cout);
+        semantic_visitor.GetStack().Draw(std::cout);
+    }
+
+    if (CheckArg(argc, argv, "-d") || CheckArg(argc, argv, "-g") || CheckArg(argc, argv, "-f") ||
+        CheckArg(argc, argv, "-t") || CheckArg(argc, argv, "-b") || CheckArg(argc, argv, "-r") ||
+        CheckArg(argc, argv, "-a") || CheckArg(argc, argv, "-n") || CheckArg(argc, argv, "-j") ||
+        CheckArg(argc, argv, "-e") || CheckArg(argc, argv, "-T")) {
+        auto stream = std::ifstream(argv[1]);
+        Lexer lexer(stream);
+        CompilationContext context;
+        Parser parser(lexer, context);
+
+        auto head = parser.Program();
+        Semantic semantic_visitor(&context);
+        head->Accept(&semantic_visitor);
+        auto module = BuildSsa(&context, head);
+        Statistics stats;
+        OptimizerOptions options;
+        options.checked = CheckArg(argc, argv, "-k");
+        options.unroll = IntArg(argc, argv, "-u", options.unroll);
+        options.parallelize = CheckArg(argc, argv, "-m");
+        if (options.parallelize) {
+            options.report = &std::cerr;
+        }
+        if (CheckArg(argc, argv, "-e")) {
+            options.tail_calls = &std::cerr;
+        }
+        for (int level = 0; level <= 2; ++level) {
+            if (CheckArg(argc, argv, "-O" + std::to_string(level))) {
+                options.level = level;
+            }
+        }
+        if (CheckArg(argc, argv, "-T")) {
+            options.timings = &std::cerr;
+        }
+        Optimize(module, &stats, options);
+        if (CheckArg(argc, argv, "-t")) {
+            stats.Print(std::cerr);
+        }
+        if (CheckArg(argc, argv, "-d")) {
+            module->Dump(std::cout);
+            for (auto &error: Verify(module)) {
+                std::cout << "verifier: " << error << "\n";
+            }
+        }
+        if (CheckArg(argc, argv, "-g")) {
+            for (auto function: module->functions) {
+                LoopForest(function, DominatorTree(function)).Dump(std::cout);
+            }
+        }
+        if (CheckArg(argc, argv, "-f")) {
+            for (auto function: module->functions) {
+                Analyses analyses(function);
+                DumpDataflow(std::cout, function, analyses);
+            }
+        }
+        auto program = BytecodeCompiler(&context).Compile(module);
+        if (CheckArg(argc, argv, "-b")) {
+            program->Dump(std::cout);
+        }
+        if (CheckArg(argc, argv, "-j")) {
+            try {
+                JIT jit(program, std::cin, std::cout);
+                if (jit.Compile()) {
+                    jit.Run();
+                } else {
+                    std::cerr << "jit: " << jit.reason << ", running on the vm\n";
+                    VM(program, std::cin, std::cout).Run();
+                }
+            } catch (RuntimeException &err) {
+                std::cout << err.what() << "\n";
+                return 1;
+            }
+        }
+        if (CheckArg(argc, argv, "-r")) {
+            try {
+                VM(program, std::cin, std::cout).Run();
+            } catch (RuntimeException &err) {
+                std::cout << err.what() << "\n";
+                return 1;
+            }
+        }
+        if (CheckArg(argc, argv, "-a")) {
+            AssemblyEmitter::Assemble(program, std::cout);
+        }
+        if (CheckArg(argc, argv, "-n")) {
+            auto output = std::filesystem::path(argv[1]).replace_extension().string();
+            if (BuildExecutable(program, output) != 0) {
+                return 1;
+            }
+        }
+    }
+
+    if (CheckArg(argc, argv, "-w")) {
+        CompilationContext context;
+        IncrementalSemantic semantic(&context);
+        std::filesystem::file_time_type last_write;
+        while (true) {
+            auto write_time = std::filesystem::last_write_time(argv[1]);
+            if (write_time != last_write) {
+                last_write = write_time;
+                auto stream = std::ifstream(argv[1]);
+                try {
+                    Lexer lexer(stream);
+                    Parser parser(lexer, context);
+                    auto begin = std::chrono::steady_clock::now();
+                    semantic.Update(parser.Program());
+                    auto end = std::chrono::steady_clock::now();
+                    std::cout << "revision " << semantic.revision << ": checked " << semantic.checked
+                              << ", reused " << semantic.reused << " ("
+                              << std::chrono::duration<double, std::milli>(end - begin).count() << " ms)\n";
+                } catch (LexerException &err) {
+                    std::cout << err.what() << "\n";
+                } catch (ParserException &err) {
+                    std::cout << err.what() << "\n";
+                } catch (SemanticException &err) {
+                    std::cout << err.what() << "\n";
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
     }
 
     return 0;
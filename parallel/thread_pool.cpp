@@ -0,0 +1,127 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local int current_index = -1;
+
+ThreadPool::ThreadPool(int threads) {
+    auto count = std::max(threads - 1, 0);
+    for (int i = 0; i < std::max(count, 1); ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 0; i < count; ++i) {
+        workers.emplace_back(&ThreadPool::Run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::DefaultThreads() {
+    return std::max((int) std::thread::hardware_concurrency(), 1);
+}
+
+int ThreadPool::Size() const {
+    return (int) workers.size() + 1;
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    auto index = (current_pool == this) ? current_index : (int) (next++ % queues.size());
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+        queued++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::TryPop(int index, std::function<void()> &task) {
+    auto &queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queued--;
+    return true;
+}
+
+bool ThreadPool::TrySteal(int index, std::function<void()> &task) {
+    for (size_t i = 1; i <= queues.size(); ++i) {
+        auto &queue = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Execute(std::function<void()> &task) {
+    task();
+    task = nullptr;
+    if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+    }
+}
+
+void ThreadPool::Run(int index) {
+    current_pool = this;
+    current_index = index;
+    std::function<void()> task;
+    while (true) {
+        if (TryPop(index, task) || TrySteal(index, task)) {
+            Execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stop) {
+            return;
+        }
+        wake.wait(lock, [&]() { return stop || queued > 0; });
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::Wait() {
+    std::function<void()> task;
+    auto index = (current_pool == this) ? current_index : 0;
+    while (pending > 0) {
+        if (TrySteal(index, task)) {
+            Execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait_for(lock, std::chrono::milliseconds(1), [&]() { return pending == 0; });
+    }
+}
+
+void ThreadPool::For(long long count, long long size,
+                     const std::function<void(long long, long long, long long)> &body) {
+    for (long long begin = 0; begin < count; begin += size) {
+        auto end = std::min(begin + size, count);
+        Submit([&body, begin, end, size]() { body(begin / size, begin, end); });
+    }
+    Wait();
+}
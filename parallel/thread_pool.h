@@ -0,0 +1,59 @@
+#ifndef COMPILER_THREAD_POOL_H
+#define COMPILER_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker owns a deque, takes its own tasks from the
+// back and steals from the front of the others. The thread calling Wait()
+// helps to drain the queues, so a pool of n threads starts n - 1 workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads = DefaultThreads());
+
+    ~ThreadPool();
+
+    void Submit(std::function<void()> task);
+
+    void Wait();
+
+    // Runs body(chunk, begin, end) for every chunk of size elements of
+    // [0, count), numbering them from 0, and waits for all of them.
+    void For(long long count, long long size, const std::function<void(long long, long long, long long)> &body);
+
+    [[nodiscard]] int Size() const;
+
+    static int DefaultThreads();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool TryPop(int index, std::function<void()> &task);
+
+    bool TrySteal(int index, std::function<void()> &task);
+
+    void Run(int index);
+
+    void Execute(std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::atomic<int> pending = 0;
+    std::atomic<int> queued = 0;
+    std::atomic<unsigned> next = 0;
+    bool stop = false;
+};
+
+#endif //COMPILER_THREAD_POOL_H
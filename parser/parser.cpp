@@ -1,6 +1,7 @@
 #include "parser.h"
 #include <magic_enum.hpp>
 #include "../symbol/symbol.h"
+#include "../context/context.h"
 
 void DrawIndent(std::ostream &os, int depth) {
     for (int i = 0; i < depth; ++i) {
@@ -22,7 +23,7 @@ Node *Parser::Program() {
         if (lexeme != LexemeType::Identifier) {
             throw ParserException(lexeme.GetPos(), "Identifier expected");
         }
-        name = new NodeVar(lexeme);
+        name = context.New<NodeVar>(lexeme);
         lexeme = lexer.GetLexeme();
         if (lexeme != Separators::SEMICOLON) {
             throw ParserException(lexeme.GetPos(), "';' expected");
@@ -33,7 +34,7 @@ Node *Parser::Program() {
     if (lexeme != Separators::PERIOD) {
         throw ParserException(lexeme.GetPos(), "'.' expected");
     }
-    return new NodeProgram(name, block);
+    return context.New<NodeProgram>(name, block);
 };
 
 Node *Parser::Block(bool parse_functions) {
@@ -64,14 +65,14 @@ Node *Parser::Block(bool parse_functions) {
     }
     lexeme = lexer.GetLexeme();
     auto stmts = CompoundStatement();
-    return new NodeBlock(decls, stmts);
+    return context.New<NodeBlock>(decls, stmts);
 }
 
 Node *Parser::Procedure() {
     if (lexeme != LexemeType::Identifier) {
         throw ParserException(lexeme.GetPos(), "Identifier expected");
     }
-    auto id = new NodeVar(lexeme);
+    auto id = context.New<NodeVar>(lexeme);
     lexeme = lexer.GetLexeme();
     if (lexeme != Separators::LPARENTHESIS) {
         throw ParserException(lexeme.GetPos(), "'(' expected");
@@ -86,19 +87,22 @@ Node *Parser::Procedure() {
         throw ParserException(lexeme.GetPos(), "';' expected");
     }
     lexeme = lexer.GetLexeme();
+    auto is_inline = Directives();
     auto block = Block(false);
     if (lexeme != Separators::SEMICOLON) {
         throw ParserException(lexeme.GetPos(), "';' expected");
     }
     lexeme = lexer.GetLexeme();
-    return new NodeProcDecl(id, params, block);
+    auto proc = context.New<NodeProcDecl>(id, params, block);
+    proc->is_inline = is_inline;
+    return proc;
 }
 
 Node *Parser::Function() {
     if (lexeme != LexemeType::Identifier) {
         throw ParserException(lexeme.GetPos(), "Identifier expected");
     }
-    auto id = new NodeVar(lexeme);
+    auto id = context.New<NodeVar>(lexeme);
     lexeme = lexer.GetLexeme();
     if (lexeme != Separators::LPARENTHESIS) {
         throw ParserException(lexeme.GetPos(), "'(' expected");
@@ -118,12 +122,30 @@ Node *Parser::Function() {
         throw ParserException(lexeme.GetPos(), "';' expected");
     }
     lexeme = lexer.GetLexeme();
+    auto is_inline = Directives();
     auto block = Block(false);
     if (lexeme != Separators::SEMICOLON) {
         throw ParserException(lexeme.GetPos(), "';' expected");;
     }
     lexeme = lexer.GetLexeme();
-    return new NodeFuncDecl(id, params, block, type);
+    auto func = context.New<NodeFuncDecl>(id, params, block, type);
+    func->is_inline = is_inline;
+    return func;
+}
+
+// Directives between the header of a routine and its block; inline is the
+// only one. Returns whether it was given.
+bool Parser::Directives() {
+    auto is_inline = false;
+    while (lexeme == AllKeywords::INLINE) {
+        is_inline = true;
+        lexeme = lexer.GetLexeme();
+        if (lexeme != Separators::SEMICOLON) {
+            throw ParserException(lexeme.GetPos(), "';' expected");
+        }
+        lexeme = lexer.GetLexeme();
+    }
+    return is_inline;
 }
 
 std::vector<Node *> Parser::FunctionParams(bool required) {
@@ -144,27 +166,27 @@ std::vector<Node *> Parser::FunctionParams(bool required) {
 Node *Parser::FunctionParam() {
     NodeKeyword *mod = nullptr;
     if (lexeme == AllKeywords::CONST or lexeme == AllKeywords::VAR) {
-        mod = new NodeKeyword(lexeme);
+        mod = context.New<NodeKeyword>(lexeme);
         lexeme = lexer.GetLexeme();
     }
     std::vector<NodeVar *> vars;
     if (lexeme != LexemeType::Identifier) {
         throw ParserException(lexeme.GetPos(), "Identifier expected");
     }
-    vars.push_back(new NodeVar(lexeme));
+    vars.push_back(context.New<NodeVar>(lexeme));
     lexeme = lexer.GetLexeme();
     while (lexeme == Separators::COMMA) {
         if (lexeme != LexemeType::Identifier) {
             throw ParserException(lexeme.GetPos(), "Identifier expected");
         }
-        vars.push_back(new NodeVar(lexeme));
+        vars.push_back(context.New<NodeVar>(lexeme));
         lexeme = lexer.GetLexeme();
     }
     if (lexeme != Separators::COLON) {
         throw ParserException(lexeme.GetPos(), "':' expected");
     }
     lexeme = lexer.GetLexeme();
-    return new NodeParam(mod, vars, Type());
+    return context.New<NodeParam>(mod, vars, Type());
 }
 
 Node *Parser::Expression() {
@@ -177,7 +199,7 @@ Node *Parser::Expression() {
            lex == Operators::LESS or
            lex == Operators::LESSEQUAL) {
         lexeme = lexer.GetLexeme();
-        left = new NodeBinaryOperation(lex, left, SimpleExpression());
+        left = context.New<NodeBinaryOperation>(lex, left, SimpleExpression());
         lex = lexeme;
     }
     return left;
@@ -191,7 +213,7 @@ Node *Parser::SimpleExpression() {
            lex == AllKeywords::OR or
            lex == AllKeywords::XOR) {
         lexeme = lexer.GetLexeme();
-        left = new NodeBinaryOperation(lex, left, Term());
+        left = context.New<NodeBinaryOperation>(lex, left, Term());
         lex = lexeme;
     }
     return left;
@@ -208,7 +230,7 @@ Node *Parser::Term() {
            lex == AllKeywords::SHR or
            lex == AllKeywords::SHL) {
         lexeme = lexer.GetLexeme();
-        left = new NodeBinaryOperation(lex, left, SimpleTerm());
+        left = context.New<NodeBinaryOperation>(lex, left, SimpleTerm());
         lex = lexeme;
     }
     return left;
@@ -221,7 +243,7 @@ Node *Parser::SimpleTerm() {
             ) {
         auto op = lexeme;
         lexeme = lexer.GetLexeme();
-        return new NodeUnaryOperation(op, SimpleTerm());
+        return context.New<NodeUnaryOperation>(op, SimpleTerm());
     }
     return Factor();
 }
@@ -230,18 +252,18 @@ Node *Parser::Factor() {
     auto lex = lexeme;
     if (lex == LexemeType::Integer or lex == LexemeType::Double) {
         lexeme = lexer.GetLexeme();
-        return new NodeNumber(lex);
+        return context.New<NodeNumber>(lex);
     }
     if (lex == AllKeywords::TRUE or lex == AllKeywords::FALSE) {
         lexeme = lexer.GetLexeme();
-        return new NodeBoolean(lex);
+        return context.New<NodeBoolean>(lex);
     }
     if (lex == LexemeType::String) {
         lexeme = lexer.GetLexeme();
-        return new NodeString(lex);
+        return context.New<NodeString>(lex);
     }
     if (lex == LexemeType::Identifier) {
-        Node *res = new NodeVar(lex);
+        Node *res = context.New<NodeVar>(lex);
         while (true) {
             lexeme = lexer.GetLexeme();
             if (lexeme == Separators::PERIOD) {
@@ -249,14 +271,14 @@ Node *Parser::Factor() {
                 if (lexeme != LexemeType::Identifier) {
                     throw ParserException(lexeme.GetPos(), " Identifier expected");
                 }
-                res = new NodeRecordAccess(res, new NodeVar(lexeme));
+                res = context.New<NodeRecordAccess>(res, context.New<NodeVar>(lexeme));
             } else if (lexeme == Separators::LPARENTHESIS) {
                 lexeme = lexer.GetLexeme();
                 auto params = ListExpressions(false);
                 if (lexeme != Separators::RPARENTHESIS) {
                     throw ParserException(lexeme.GetPos(), "')' expected");
                 }
-                res = new NodeCallAccess(res, params);
+                res = context.New<NodeCallAccess>(res, params);
             } else if (lexeme == Separators::LSBRACKET) {
                 lexeme = lexer.GetLexeme();
                 auto params = ListExpressions(true);
@@ -264,7 +286,7 @@ Node *Parser::Factor() {
                     throw ParserException(lexeme.GetPos(), "']' expected");
                 }
                 for (auto &param: params) {
-                    res = new NodeArrayAccess(res, param);
+                    res = context.New<NodeArrayAccess>(res, param);
                 }
             } else {
                 break;
@@ -307,7 +329,7 @@ NodeRange *Parser::IndexRange() {
     }
     lexeme = lexer.GetLexeme();
     auto exp_second = Expression();
-    return new NodeRange(exp_first, exp_second);
+    return context.New<NodeRange>(exp_first, exp_second);
 }
 
 std::vector<NodeRange *> Parser::IndexRanges() {
@@ -336,20 +358,20 @@ Node *Parser::ArrayType() {
     }
     lexeme = lexer.GetLexeme();
     auto type = Type();
-    return new NodeArrayType(type, ranges);
+    return context.New<NodeArrayType>(type, ranges);
 }
 
 Node *Parser::Type() {
     if (lexeme == Identifier) {
         auto id = lexeme;
         lexeme = lexer.GetLexeme();
-        return new NodeSimpleType(new NodeVar(id));
+        return context.New<NodeSimpleType>(context.New<NodeVar>(id));
     }
     if (lexeme == AllKeywords::STRING) {
         auto keyword = lexeme;
         lexeme = lexer.GetLexeme();
         keyword.ConvertToId();
-        return new NodeSimpleType(new NodeVar(keyword));
+        return context.New<NodeSimpleType>(context.New<NodeVar>(keyword));
     }
     if (lexeme == AllKeywords::ARRAY) {
         return ArrayType();
@@ -357,6 +379,20 @@ Node *Parser::Type() {
     if (lexeme == AllKeywords::RECORD) {
         return RecordType();
     }
+    if (lexeme == AllKeywords::PACKED) {
+        lexeme = lexer.GetLexeme();
+        if (lexeme == AllKeywords::ARRAY) {
+            auto type = dynamic_cast<NodeArrayType *>(ArrayType());
+            type->packed = true;
+            return type;
+        }
+        if (lexeme == AllKeywords::RECORD) {
+            auto type = dynamic_cast<NodeRecordType *>(RecordType());
+            type->packed = true;
+            return type;
+        }
+        throw ParserException(lexeme.GetPos(), "'array' or 'record' expected");
+    }
     throw ParserException(lexeme.GetPos(), "Illegal type");
 }
 
@@ -366,7 +402,7 @@ std::vector<Node *> Parser::ListIdent() {
         if (lexeme != Identifier) {
             throw ParserException(lexeme.GetPos(), "id expected");
         }
-        list.push_back(new NodeVar(lexeme));
+        list.push_back(context.New<NodeVar>(lexeme));
         lexeme = lexer.GetLexeme();
         if (lexeme != Separators::COMMA) {
             break;
@@ -382,7 +418,7 @@ Node *Parser::Field() {
         throw ParserException(lexeme.GetPos(), "':' expected");
     }
     lexeme = lexer.GetLexeme();
-    return new NodeField(ident_list, Type());
+    return context.New<NodeField>(ident_list, Type());
 }
 
 std::vector<Node *> Parser::Fields() {
@@ -404,7 +440,7 @@ std::vector<Node *> Parser::Fields() {
 Node *Parser::RecordType() {
     lexeme = lexer.GetLexeme();
     auto fields = Fields();
-    return new NodeRecordType(fields);
+    return context.New<NodeRecordType>(fields);
 }
 
 NodeStatement *Parser::SimpleStatement() {
@@ -422,11 +458,11 @@ NodeStatement *Parser::SimpleStatement() {
         }
         lexeme = lexer.GetLexeme();
         lex.ConvertToId();
-        return new NodeIOCallStatement(new NodeVar(lex), params);
+        return context.New<NodeIOCallStatement>(context.New<NodeVar>(lex), params);
     }
     auto exp1 = Expression();
     if (dynamic_cast<NodeCallAccess *>(exp1) != nullptr) {
-        return new NodeUserCallStatement(dynamic_cast<NodeCallAccess *>(exp1));
+        return context.New<NodeUserCallStatement>(dynamic_cast<NodeCallAccess *>(exp1));
     }
     if (lexeme != Operators::ASSIGN and
         lexeme != Operators::ADDASSIGN and
@@ -438,7 +474,7 @@ NodeStatement *Parser::SimpleStatement() {
     auto op = lexeme;
     lexeme = lexer.GetLexeme();
     auto exp2 = Expression();
-    return new NodeAssignmentStatement(op, exp1, exp2);
+    return context.New<NodeAssignmentStatement>(op, exp1, exp2);
 }
 
 NodeStatement *Parser::CompoundStatement() {
@@ -458,7 +494,7 @@ NodeStatement *Parser::CompoundStatement() {
         }
         statements.push_back(Statement());
     }
-    return new NodeCompoundStatement(statements);
+    return context.New<NodeCompoundStatement>(statements);
 }
 
 NodeStatement *Parser::Statement() {
@@ -493,7 +529,7 @@ NodeStatement *Parser::IfStatement() {
         lexeme = lexer.GetLexeme();
         else_stmt = Statement();
     }
-    return new NodeIfStatement(exp, stmt, else_stmt);
+    return context.New<NodeIfStatement>(exp, stmt, else_stmt);
 }
 
 NodeStatement *Parser::WhileStatement() {
@@ -504,7 +540,7 @@ NodeStatement *Parser::WhileStatement() {
     lexeme = lexer.GetLexeme();
     auto stmt = Statement();
 
-    return new NodeWhileStatement(exp, stmt);
+    return context.New<NodeWhileStatement>(exp, stmt);
 }
 
 NodeStatement *Parser::ForStatement() {
@@ -518,7 +554,7 @@ NodeStatement *Parser::ForStatement() {
         lexeme != AllKeywords::DOWNTO) {
         throw ParserException(lexeme.GetPos(), "'to' or 'downto' expected");
     }
-    auto dir = new NodeKeyword(lexeme);
+    auto dir = context.New<NodeKeyword>(lexeme);
     lexeme = lexer.GetLexeme();
     auto exp_end = Expression();
     if (lexeme != AllKeywords::DO) {
@@ -526,7 +562,7 @@ NodeStatement *Parser::ForStatement() {
     }
     lexeme = lexer.GetLexeme();
     auto stmt = Statement();
-    return new NodeForStatement(stmt, var, exp_begin, dir, exp_end);
+    return context.New<NodeForStatement>(stmt, var, exp_begin, dir, exp_end);
 
 }
 
@@ -543,7 +579,7 @@ NodeTypeDecl *Parser::TypeDecl() {
     if (lexeme != LexemeType::Identifier) {
         throw ParserException(lexeme.GetPos(), "Identifier expected");
     }
-    auto id = new NodeVar(lexeme);
+    auto id = context.New<NodeVar>(lexeme);
     lexeme = lexer.GetLexeme();
     if (lexeme != Operators::EQUAL) {
         throw ParserException(lexeme.GetPos(), "'=' expected");
@@ -554,14 +590,14 @@ NodeTypeDecl *Parser::TypeDecl() {
         throw ParserException(lexeme.GetPos(), "';' expected");
     }
     lexeme = lexer.GetLexeme();
-    return new NodeTypeDecl(id, type);
+    return context.New<NodeTypeDecl>(id, type);
 }
 
 NodeConstDecl *Parser::ConstDecl() {
     if (lexeme != LexemeType::Identifier) {
         throw ParserException(lexeme.GetPos(), "Identifier expected");
     }
-    auto var = new NodeVar(lexeme);
+    auto var = context.New<NodeVar>(lexeme);
     lexeme = lexer.GetLexeme();
     Node *type = nullptr;
     if (lexeme == Separators::COLON) {
@@ -577,7 +613,7 @@ NodeConstDecl *Parser::ConstDecl() {
         throw ParserException(lexeme.GetPos(), "';' expected");
     }
     lexeme = lexer.GetLexeme();
-    return new NodeConstDecl(var, type, exp);
+    return context.New<NodeConstDecl>(var, type, exp);
 }
 
 std::vector<NodeConstDecl *> Parser::ConstDeclPart() {
@@ -595,7 +631,7 @@ NodeVarDecl *Parser::VarDecl() {
         if (lexeme != LexemeType::Identifier) {
             throw ParserException(lexeme.GetPos(), "Identifier expected");
         }
-        vars.push_back(new NodeVar(lexeme));
+        vars.push_back(context.New<NodeVar>(lexeme));
         lexeme = lexer.GetLexeme();
         if (lexeme == Separators::COMMA) {
             lexeme = lexer.GetLexeme();
@@ -621,7 +657,7 @@ NodeVarDecl *Parser::VarDecl() {
         throw ParserException(lexeme.GetPos(), "';' expected");
     }
     lexeme = lexer.GetLexeme();
-    return new NodeVarDecl(vars, type, exp);
+    return context.New<NodeVarDecl>(vars, type, exp);
 }
 
 std::vector<NodeVarDecl *> Parser::VarDeclPart() {
@@ -701,7 +737,7 @@ void NodeRange::DrawTree(std::ostream &os, int depth) {
 }
 
 void NodeArrayType::DrawTree(std::ostream &os, int depth) {
-    os << "array" << "\n";
+    os << (packed ? "packed array" : "array") << "\n";
     DrawIndent(os, depth);
     type->DrawTree(os, depth + 1);
     for (int i = 0; i < ranges.size(); i++) {
@@ -721,7 +757,7 @@ void NodeField::DrawTree(std::ostream &os, int depth) {
 }
 
 void NodeRecordType::DrawTree(std::ostream &os, int depth) {
-    os << "record\n";
+    os << (packed ? "packed record" : "record") << "\n";
     for (auto &i: fields) {
         i->DrawTree(os, depth);
     }
@@ -843,7 +879,7 @@ void NodeParam::DrawTree(std::ostream &os, int depth) {
 }
 
 void NodeProcDecl::DrawTree(std::ostream &os, int depth) {
-    os << "procedure:\n";
+    os << (is_inline ? "procedure: inline\n" : "procedure:\n");
     DrawIndent(os, depth + 1);
     var->DrawTree(os, depth + 1);
     DrawIndent(os, depth + 1);
@@ -856,7 +892,7 @@ void NodeProcDecl::DrawTree(std::ostream &os, int depth) {
 }
 
 void NodeFuncDecl::DrawTree(std::ostream &os, int depth) {
-    os << "function:\n";
+    os << (is_inline ? "function: inline\n" : "function:\n");
     DrawIndent(os, depth + 1);
     var->DrawTree(os, depth + 1);
     DrawIndent(os, depth + 1);
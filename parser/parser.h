@@ -3,15 +3,21 @@
 
 #include <utility>
 #include <iostream>
+#include <optional>
 
 #include "../lexer/lexer.h"
 #include "../lexer/lexeme.h"
 #include "../visitor.h"
+#include "../symbol/value.h"
 
 class Visitor;
 
+class Symbol;
+
 class SymbolType;
 
+class CompilationContext;
+
 class Node {
 public:
     virtual void DrawTree(std::ostream &os, int depth) = 0;
@@ -22,6 +28,7 @@ public:
 
     SymbolType *symbol_type = nullptr;
     bool is_lvalue = false;
+    std::optional<ConstValue> value;
 
 protected:
     explicit Node() = default;
@@ -103,6 +110,7 @@ public:
 class NodeVar : public Node {
 public:
     Lexeme lexeme;
+    Symbol *symbol = nullptr;
 
     explicit NodeVar(Lexeme &lexeme) : Node(), lexeme(lexeme) {};
 
@@ -204,6 +212,7 @@ class NodeArrayType : public NodeType {
 public:
     Node *type;
     std::vector<NodeRange *> ranges;
+    bool packed = false;
 
     explicit NodeArrayType(Node *type, std::vector<NodeRange *> &ranges) : NodeType() {
         this->type = type;
@@ -237,6 +246,7 @@ public:
 class NodeRecordType : public NodeType {
 public:
     std::vector<Node *> fields;
+    bool packed = false;
 
     explicit NodeRecordType(std::vector<Node *> &field) {
         this->fields = field;
@@ -489,6 +499,8 @@ public:
     Node *var;
     std::vector<Node *> params;
     Node *block;
+    // Set by an inline directive after the header.
+    bool is_inline = false;
 
     explicit NodeProcDecl(Node *var, std::vector<Node *> params,
                           Node *block) : NodeDecl() {
@@ -520,9 +532,11 @@ public:
 class Parser {
     Lexer lexer;
     Lexeme lexeme;
+    CompilationContext &context;
 
 public:
-    explicit Parser(Lexer &lexer) : lexer(lexer), lexeme(this->lexer.GetLexeme()) {
+    Parser(Lexer &lexer, CompilationContext &context) : lexer(lexer), lexeme(this->lexer.GetLexeme()),
+                                                        context(context) {
     }
 
     Node *Program();
@@ -535,6 +549,8 @@ public:
 
     std::vector<Node *> FunctionParams(bool required);
 
+    bool Directives();
+
     Node *Block(bool parse_functions);
 
     Node *Expression();
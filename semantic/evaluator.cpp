@@ -0,0 +1,329 @@
+#include "evaluator.h"
+#include "../parser/parser.h"
+
+template<class T>
+static std::optional<ConstValue> Compare(Lexeme &lexeme, const T &a, const T &b) {
+    if (lexeme != LexemeType::Operator) {
+        return std::nullopt;
+    }
+    switch (lexeme.GetValue<Operators>()) {
+        case Operators::EQUAL:
+            return a == b;
+        case Operators::UNEQUAL:
+            return a != b;
+        case Operators::LESS:
+            return a < b;
+        case Operators::LESSEQUAL:
+            return a <= b;
+        case Operators::GREATER:
+            return a > b;
+        case Operators::GREATEREQUAL:
+            return a >= b;
+        default:
+            return std::nullopt;
+    }
+}
+
+static ConstValue FoldInteger(NodeBinaryOperation *node, long long a, long long b) {
+    auto ua = (unsigned long long) a;
+    auto ub = (unsigned long long) b;
+    if (node->lexeme == LexemeType::Operator) {
+        switch (node->lexeme.GetValue<Operators>()) {
+            case Operators::ADD:
+                return (long long) (ua + ub);
+            case Operators::SUBSTRACT:
+                return (long long) (ua - ub);
+            case Operators::MULTIPLY:
+                return (long long) (ua * ub);
+            case Operators::DIVISION:
+                // Real division, which gives an infinity or a NaN as at run time.
+                return (double) a / (double) b;
+            default:
+                return *Compare(node->lexeme, a, b);
+        }
+    }
+    switch (node->lexeme.GetValue<AllKeywords>()) {
+        case AllKeywords::DIV:
+            if (b == 0) {
+                throw SemanticException(node, "Division by zero");
+            }
+            return b == -1 ? (long long) (0 - ua) : a / b;
+        case AllKeywords::MOD:
+            if (b == 0) {
+                throw SemanticException(node, "Division by zero");
+            }
+            return b == -1 ? 0 : a % b;
+        case AllKeywords::SHL:
+            return (long long) (ua << (ub & 63));
+        case AllKeywords::SHR:
+            return (long long) (ua >> (ub & 63));
+        case AllKeywords::AND:
+            return a & b;
+        case AllKeywords::OR:
+            return a | b;
+        default:
+            return a ^ b;
+    }
+}
+
+ConstValue Evaluator::Fold(NodeBinaryOperation *node, const ConstValue &left, const ConstValue &right) {
+    if (std::holds_alternative<long long>(left)) {
+        return FoldInteger(node, std::get<long long>(left), std::get<long long>(right));
+    }
+    if (std::holds_alternative<double>(left)) {
+        auto a = std::get<double>(left);
+        auto b = std::get<double>(right);
+        switch (node->lexeme.GetValue<Operators>()) {
+            case Operators::ADD:
+                return a + b;
+            case Operators::SUBSTRACT:
+                return a - b;
+            case Operators::MULTIPLY:
+                return a * b;
+            case Operators::DIVISION:
+                return a / b;
+            default:
+                return *Compare(node->lexeme, a, b);
+        }
+    }
+    if (std::holds_alternative<bool>(left)) {
+        auto a = std::get<bool>(left);
+        auto b = std::get<bool>(right);
+        if (node->lexeme == LexemeType::Keyword) {
+            switch (node->lexeme.GetValue<AllKeywords>()) {
+                case AllKeywords::AND:
+                    return a && b;
+                case AllKeywords::OR:
+                    return a || b;
+                default:
+                    return a != b;
+            }
+        }
+        return *Compare(node->lexeme, a, b);
+    }
+    auto a = std::get<std::string>(left);
+    auto b = std::get<std::string>(right);
+    if (node->lexeme == Operators::ADD) {
+        return a + b;
+    }
+    return *Compare(node->lexeme, a, b);
+}
+
+ConstValue Evaluator::Fold(NodeUnaryOperation *node, const ConstValue &operand) {
+    if (node->op == Operators::ADD) {
+        return operand;
+    }
+    if (node->op == Operators::SUBSTRACT) {
+        if (std::holds_alternative<double>(operand)) {
+            return -std::get<double>(operand);
+        }
+        return (long long) (0 - (unsigned long long) std::get<long long>(operand));
+    }
+    if (std::holds_alternative<bool>(operand)) {
+        return !std::get<bool>(operand);
+    }
+    return ~std::get<long long>(operand);
+}
+
+long long Evaluator::EvaluateInteger(Node *node) {
+    node->Accept(this);
+    if (!node->value.has_value()) {
+        throw SemanticException(node, "Constant expression expected");
+    }
+    if (!std::holds_alternative<long long>(*node->value)) {
+        throw SemanticException(node, "Integer expected");
+    }
+    return std::get<long long>(*node->value);
+}
+
+
+void Evaluator::Visit(NodeBinaryOperation *node) {
+    node->left->Accept(this);
+    node->right->Accept(this);
+    if (node->left->value.has_value() && node->right->value.has_value()) {
+        node->value = Fold(node, *node->left->value, *node->right->value);
+    }
+}
+
+
+void Evaluator::Visit(NodeUnaryOperation *node) {
+    node->operand->Accept(this);
+    if (node->operand->value.has_value()) {
+        node->value = Fold(node, *node->operand->value);
+    }
+}
+
+
+void Evaluator::Visit(NodeString *node) {
+    node->value = node->lexeme.GetValue<std::string>();
+}
+
+
+void Evaluator::Visit(NodeNumber *node) {
+    if (node->lexeme == LexemeType::Double) {
+        node->value = node->lexeme.GetValue<double>();
+    } else {
+        node->value = (long long) node->lexeme.GetValue<int>();
+    }
+}
+
+
+void Evaluator::Visit(NodeBoolean *node) {
+    node->value = node->lexeme == AllKeywords::TRUE;
+}
+
+
+void Evaluator::Visit(NodeVar *node) {
+    auto sym_const = dynamic_cast<SymbolConst *>(node->symbol);
+    if (sym_const != nullptr && sym_const->value.has_value()) {
+        node->value = sym_const->value;
+    }
+}
+
+
+void Evaluator::Visit(NodeRecordAccess *node) {
+    node->rec->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeCallAccess *node) {
+    for (auto &param: node->params) param->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeIOCallStatement *node) {
+    for (auto &param: node->params) param->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeArrayAccess *node) {
+    node->arr->Accept(this);
+    node->params->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeSimpleType *node) {
+}
+
+
+void Evaluator::Visit(NodeRange *node) {
+    node->exp_first->Accept(this);
+    node->exp_second->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeArrayType *node) {
+    auto sym_array = dynamic_cast<SymbolArray *>(node->symbol_type);
+    for (auto &range: node->ranges) {
+        sym_array->low = EvaluateInteger(range->exp_first);
+        sym_array->high = EvaluateInteger(range->exp_second);
+        if (sym_array->low > sym_array->high) {
+            throw SemanticException(range->exp_first, "Invalid array range");
+        }
+        sym_array = dynamic_cast<SymbolArray *>(sym_array->type);
+    }
+    node->type->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeField *node) {
+    node->type->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeRecordType *node) {
+    for (auto &field: node->fields) field->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeCompoundStatement *node) {
+    for (auto &statement: node->statements) statement->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeAssignmentStatement *node) {
+    node->left->Accept(this);
+    node->right->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeUserCallStatement *node) {
+    for (auto &param: node->params) param->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeIfStatement *node) {
+    node->exp->Accept(this);
+    node->statement->Accept(this);
+    if (node->else_statement != nullptr) {
+        node->else_statement->Accept(this);
+    }
+}
+
+
+void Evaluator::Visit(NodeWhileStatement *node) {
+    node->exp->Accept(this);
+    node->statement->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeForStatement *node) {
+    node->var->Accept(this);
+    node->exp_begin->Accept(this);
+    node->exp_end->Accept(this);
+    node->statement->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeBlock *node) {
+    for (auto &decl: node->decls) decl->Accept(this);
+    node->comp_stmt->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeProgram *node) {
+    node->block->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeTypeDecl *node) {
+    node->type->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeVarDecl *node) {
+    node->type->Accept(this);
+    if (node->exp != nullptr) {
+        node->exp->Accept(this);
+    }
+}
+
+
+void Evaluator::Visit(NodeConstDecl *node) {
+    if (node->type != nullptr) {
+        node->type->Accept(this);
+    }
+    node->exp->Accept(this);
+    if (!node->exp->value.has_value()) {
+        throw SemanticException(node->exp, "Constant expression expected");
+    }
+    dynamic_cast<SymbolConst *>(node->var->symbol)->value = node->exp->value;
+}
+
+
+void Evaluator::Visit(NodeParam *node) {
+    node->type->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeProcDecl *node) {
+    for (auto &param: node->params) param->Accept(this);
+    node->block->Accept(this);
+}
+
+
+void Evaluator::Visit(NodeFuncDecl *node) {
+    for (auto &param: node->params) param->Accept(this);
+    node->type->Accept(this);
+    node->block->Accept(this);
+}
@@ -0,0 +1,79 @@
+#ifndef COMPILER_EVALUATOR_H
+#define COMPILER_EVALUATOR_H
+
+#include "../visitor.h"
+#include "../symbol/symbol.h"
+
+class Node;
+
+// Folds constant subexpressions of a checked tree into Node::value, records the
+// values of const declarations and computes the bounds of every array type.
+class Evaluator : public Visitor {
+public:
+    static ConstValue Fold(NodeBinaryOperation *node, const ConstValue &left, const ConstValue &right);
+
+    static ConstValue Fold(NodeUnaryOperation *node, const ConstValue &operand);
+
+    long long EvaluateInteger(Node *node);
+
+    void Visit(NodeBinaryOperation *node) override;
+
+    void Visit(NodeUnaryOperation *node) override;
+
+    void Visit(NodeString *node) override;
+
+    void Visit(NodeNumber *node) override;
+
+    void Visit(NodeBoolean *node) override;
+
+    void Visit(NodeVar *node) override;
+
+    void Visit(NodeRecordAccess *node) override;
+
+    void Visit(NodeCallAccess *node) override;
+
+    void Visit(NodeIOCallStatement *node) override;
+
+    void Visit(NodeArrayAccess *node) override;
+
+    void Visit(NodeSimpleType *node) override;
+
+    void Visit(NodeRange *node) override;
+
+    void Visit(NodeArrayType *node) override;
+
+    void Visit(NodeField *node) override;
+
+    void Visit(NodeRecordType *node) override;
+
+    void Visit(NodeCompoundStatement *node) override;
+
+    void Visit(NodeAssignmentStatement *node) override;
+
+    void Visit(NodeUserCallStatement *node) override;
+
+    void Visit(NodeIfStatement *node) override;
+
+    void Visit(NodeWhileStatement *node) override;
+
+    void Visit(NodeForStatement *node) override;
+
+    void Visit(NodeBlock *node) override;
+
+    void Visit(NodeProgram *node) override;
+
+    void Visit(NodeTypeDecl *node) override;
+
+    void Visit(NodeVarDecl *node) override;
+
+    void Visit(NodeConstDecl *node) override;
+
+    void Visit(NodeParam *node) override;
+
+    void Visit(NodeProcDecl *node) override;
+
+    void Visit(NodeFuncDecl *node) override;
+};
+
+
+#endif //COMPILER_EVALUATOR_H
@@ -0,0 +1,342 @@
+#include "incremental.h"
+#include "resolver.h"
+#include "semantic.h"
+#include "evaluator.h"
+#include "../parser/parser.h"
+
+#include <functional>
+
+class FingerprintVisitor : public Visitor {
+public:
+    size_t hash = 0;
+
+    void Mix(const std::string &value) {
+        hash ^= std::hash<std::string>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+
+    void Mix(Node *node) {
+        if (node == nullptr) {
+            Mix("null");
+        } else {
+            node->Accept(this);
+        }
+    }
+
+    template<class T>
+    void Mix(const std::vector<T *> &nodes) {
+        Mix(std::to_string(nodes.size()));
+        for (auto &node: nodes) Mix(node);
+    }
+
+    void Visit(NodeBinaryOperation *node) override {
+        Mix("binary " + node->lexeme.GetRaw());
+        Mix(node->left);
+        Mix(node->right);
+    }
+
+    void Visit(NodeUnaryOperation *node) override {
+        Mix("unary " + node->op.GetRaw());
+        Mix(node->operand);
+    }
+
+    void Visit(NodeString *node) override { Mix("string " + node->lexeme.GetRaw()); }
+
+    void Visit(NodeNumber *node) override { Mix("number " + node->lexeme.GetRaw()); }
+
+    void Visit(NodeBoolean *node) override { Mix("boolean " + node->lexeme.GetRaw()); }
+
+    void Visit(NodeVar *node) override { Mix("var " + node->lexeme.GetRaw()); }
+
+    void Visit(NodeRecordAccess *node) override {
+        Mix("record access");
+        Mix(node->rec);
+        Mix(node->field);
+    }
+
+    void Visit(NodeCallAccess *node) override {
+        Mix("call");
+        Mix(node->callable);
+        Mix(node->params);
+    }
+
+    void Visit(NodeIOCallStatement *node) override {
+        Mix("io " + node->GetName());
+        Mix(node->params);
+    }
+
+    void Visit(NodeArrayAccess *node) override {
+        Mix("array access");
+        Mix(node->arr);
+        Mix(node->params);
+    }
+
+    void Visit(NodeSimpleType *node) override {
+        Mix("simple type");
+        Mix(node->type);
+    }
+
+    void Visit(NodeRange *node) override {
+        Mix("range");
+        Mix(node->exp_first);
+        Mix(node->exp_second);
+    }
+
+    void Visit(NodeArrayType *node) override {
+        Mix(node->packed ? "packed array type" : "array type");
+        Mix(node->ranges);
+        Mix(node->type);
+    }
+
+    void Visit(NodeField *node) override {
+        Mix("field");
+        Mix(node->ids);
+        Mix(node->type);
+    }
+
+    void Visit(NodeRecordType *node) override {
+        Mix(node->packed ? "packed record type" : "record type");
+        Mix(node->fields);
+    }
+
+    void Visit(NodeCompoundStatement *node) override {
+        Mix("compound");
+        Mix(node->statements);
+    }
+
+    void Visit(NodeAssignmentStatement *node) override {
+        Mix("assignment " + node->lexeme.GetRaw());
+        Mix(node->left);
+        Mix(node->right);
+    }
+
+    void Visit(NodeUserCallStatement *node) override {
+        Mix("call statement");
+        Mix(node->callable);
+        Mix(node->params);
+    }
+
+    void Visit(NodeIfStatement *node) override {
+        Mix("if");
+        Mix(node->exp);
+        Mix(node->statement);
+        Mix(node->else_statement);
+    }
+
+    void Visit(NodeWhileStatement *node) override {
+        Mix("while");
+        Mix(node->exp);
+        Mix(node->statement);
+    }
+
+    void Visit(NodeForStatement *node) override {
+        Mix("for " + node->direction->lexeme.GetRaw());
+        Mix(node->var);
+        Mix(node->exp_begin);
+        Mix(node->exp_end);
+        Mix(node->statement);
+    }
+
+    void Visit(NodeBlock *node) override {
+        Mix("block");
+        Mix(node->decls);
+        Mix(node->comp_stmt);
+    }
+
+    void Visit(NodeProgram *node) override {
+        Mix("program");
+        Mix(node->block);
+    }
+
+    void Visit(NodeTypeDecl *node) override {
+        Mix("type decl");
+        Mix(node->var);
+        Mix(node->type);
+    }
+
+    void Visit(NodeVarDecl *node) override {
+        Mix("var decl");
+        Mix(node->vars);
+        Mix(node->type);
+        Mix(node->exp);
+    }
+
+    void Visit(NodeConstDecl *node) override {
+        Mix("const decl");
+        Mix(node->var);
+        Mix(node->type);
+        Mix(node->exp);
+    }
+
+    void Visit(NodeParam *node) override {
+        Mix("param");
+        Mix(node->modifier);
+        Mix(node->vars);
+        Mix(node->type);
+    }
+
+    void Visit(NodeProcDecl *node) override {
+        Mix("procedure");
+        Mix(node->var);
+        Mix(node->params);
+        Mix(node->block);
+    }
+
+    void Visit(NodeFuncDecl *node) override {
+        Mix("function");
+        Mix(node->var);
+        Mix(node->params);
+        Mix(node->type);
+        Mix(node->block);
+    }
+};
+
+typedef std::vector<std::pair<std::string, SymbolType *>> Signature;
+
+static Signature GetSignature(SymbolProcedure *proc) {
+    Signature signature;
+    for (auto &name: proc->locals->ordered) {
+        auto param = dynamic_cast<SymbolParam *>(proc->locals->Get(name));
+        if (param != nullptr) {
+            signature.emplace_back(param->GetClass(), param->type);
+        }
+    }
+    if (auto func = dynamic_cast<SymbolFunction *>(proc)) {
+        signature.emplace_back("result", func->ret);
+    }
+    return signature;
+}
+
+IncrementalSemantic::IncrementalSemantic(CompilationContext *context) : context(context) {
+    globals = context->New<SymbolTable>();
+}
+
+size_t IncrementalSemantic::Fingerprint(Node *node) {
+    FingerprintVisitor visitor;
+    visitor.Mix(node);
+    return visitor.hash;
+}
+
+bool IncrementalSemantic::IsValid(UnitQuery &query, SymbolTable *table) {
+    for (auto &dep: query.deps) {
+        auto owner = context->builtins->Contains(dep->GetName()) ? context->builtins : table;
+        if (!owner->Contains(dep->GetName()) || owner->Get(dep->GetName()) != dep) {
+            return false;
+        }
+        if (changed_at[dep] > query.verified_at) {
+            return false;
+        }
+    }
+    return true;
+}
+
+UnitQuery IncrementalSemantic::Compute(Node *node, size_t fingerprint, UnitQuery *previous, SymbolTable *table) {
+    UnitQuery query{node, fingerprint, {}, {}, {}, revision};
+    SymbolProcedure *old_symbol = nullptr;
+    Signature old_signature;
+    if (auto proc = dynamic_cast<NodeProcDecl *>(node)) {
+        auto var = dynamic_cast<NodeVar *>(proc->var);
+        query.name = var->lexeme.GetValue<std::string>();
+        if (previous != nullptr) {
+            old_symbol = dynamic_cast<SymbolProcedure *>(previous->declared.front());
+            old_signature = GetSignature(old_symbol);
+            var->symbol = old_symbol;
+        }
+    }
+
+    auto declared_from = table->ordered.size();
+    std::set<Symbol *> uses;
+    Resolver resolver(context);
+    resolver.uses = &uses;
+    resolver.stack.Push(context->builtins);
+    resolver.stack.Push(table);
+    node->Accept(&resolver);
+    Semantic checker(context, 1);
+    node->Accept(&checker);
+    Evaluator evaluator;
+    node->Accept(&evaluator);
+
+    for (auto i = declared_from; i < table->ordered.size(); ++i) {
+        query.declared.push_back(table->Get(table->ordered[i]));
+    }
+    for (auto &symbol: uses) {
+        auto owner = context->builtins->Contains(symbol->GetName()) ? context->builtins : table;
+        if (owner->Contains(symbol->GetName()) && owner->Get(symbol->GetName()) == symbol &&
+            std::find(query.declared.begin(), query.declared.end(), symbol) == query.declared.end()) {
+            query.deps.insert(symbol);
+        }
+    }
+    for (auto &symbol: query.declared) {
+        if (symbol == old_symbol && GetSignature(old_symbol) == old_signature) {
+            continue;
+        }
+        changed_at[symbol] = revision;
+    }
+    query.verified_at = revision;
+    return query;
+}
+
+void IncrementalSemantic::Update(Node *node) {
+    auto program = dynamic_cast<NodeProgram *>(node);
+    auto block = dynamic_cast<NodeBlock *>(program->block);
+    revision++;
+    checked = 0;
+    reused = 0;
+
+    std::multimap<size_t, UnitQuery *> by_fingerprint;
+    std::map<std::string, UnitQuery *> by_name;
+    for (auto &unit: units) {
+        by_fingerprint.emplace(unit.fingerprint, &unit);
+        if (!unit.name.empty()) {
+            by_name[unit.name] = &unit;
+        }
+    }
+
+    auto table = context->New<SymbolTable>();
+    std::vector<UnitQuery> next;
+    auto process = [&](Node *unit) {
+        auto fingerprint = Fingerprint(unit);
+        auto it = by_fingerprint.find(fingerprint);
+        if (it != by_fingerprint.end() && IsValid(*it->second, table)) {
+            auto &query = *it->second;
+            for (auto &symbol: query.declared) {
+                if (table->Contains(symbol->GetName())) {
+                    throw SemanticException("Id is already declared in scope");
+                }
+                table->Push(symbol);
+            }
+            query.verified_at = revision;
+            by_fingerprint.erase(it);
+            next.push_back(query);
+            reused++;
+            return query.node;
+        }
+        UnitQuery *previous = nullptr;
+        if (auto proc = dynamic_cast<NodeProcDecl *>(unit)) {
+            auto name = dynamic_cast<NodeVar *>(proc->var)->lexeme.GetValue<std::string>();
+            previous = by_name.contains(name) ? by_name[name] : nullptr;
+        }
+        next.push_back(Compute(unit, fingerprint, previous, table));
+        checked++;
+        return unit;
+    };
+
+    try {
+        for (auto &decl: block->decls) {
+            decl = process(decl);
+        }
+        block->comp_stmt = dynamic_cast<NodeStatement *>(process(block->comp_stmt));
+    } catch (SemanticException &err) {
+        units.clear();
+        changed_at.clear();
+        throw;
+    }
+    units = next;
+    globals = table;
+}
+
+SymbolTableStack IncrementalSemantic::GetStack() {
+    SymbolTableStack stack;
+    stack.Push(context->builtins);
+    stack.Push(globals);
+    return stack;
+}
@@ -0,0 +1,53 @@
+#ifndef COMPILER_INCREMENTAL_H
+#define COMPILER_INCREMENTAL_H
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "../symbol/symbol.h"
+#include "../context/context.h"
+
+class Node;
+
+// Memoized result of analysing one top-level unit (a declaration or the main
+// block): the symbols it declares and the global symbols it depends on.
+struct UnitQuery {
+    Node *node;
+    size_t fingerprint;
+    std::string name;
+    std::vector<Symbol *> declared;
+    std::set<Symbol *> deps;
+    int verified_at;
+};
+
+// Re-checks a new version of a program reusing every unit whose text and
+// dependencies did not change since the previous revision. A routine whose
+// body changed keeps its symbol when its signature is the same, so callers
+// are not re-checked.
+class IncrementalSemantic {
+public:
+    explicit IncrementalSemantic(CompilationContext *context);
+
+    void Update(Node *program);
+
+    SymbolTableStack GetStack();
+
+    static size_t Fingerprint(Node *node);
+
+    int revision = 0;
+    int checked = 0;
+    int reused = 0;
+
+private:
+    bool IsValid(UnitQuery &query, SymbolTable *table);
+
+    UnitQuery Compute(Node *node, size_t fingerprint, UnitQuery *previous, SymbolTable *table);
+
+    CompilationContext *context;
+    SymbolTable *globals;
+    std::vector<UnitQuery> units;
+    std::map<Symbol *, int> changed_at;
+};
+
+#endif //COMPILER_INCREMENTAL_H
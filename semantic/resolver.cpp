@@ -0,0 +1,315 @@
+#include "resolver.h"
+#include "../parser/parser.h"
+
+
+SymbolType *Resolver::GetSymType(NodeType *type) {
+    auto record_type = dynamic_cast<NodeRecordType *>(type);
+    if (record_type != nullptr) {
+        auto record_table = context->New<SymbolTable>();
+        for (auto &field: record_type->fields) {
+            auto casted_field = dynamic_cast<NodeField *>(field);
+            auto sym_type_field = GetSymType(dynamic_cast<NodeType *>(casted_field->type));
+            for (auto &id: casted_field->ids) {
+                auto id_field = dynamic_cast<NodeVar *>(id);
+                auto sym_field = context->New<SymbolVar>(id_field->lexeme.GetValue<std::string>(), sym_type_field);
+                record_table->Push(sym_field);
+                id_field->symbol = sym_field;
+            }
+        }
+        auto record = context->New<SymbolRecord>(record_table);
+        record->packed = record_type->packed;
+        type->symbol_type = record;
+        return record;
+    }
+    auto array_type = dynamic_cast<NodeArrayType *>(type);
+    if (array_type != nullptr) {
+        SymbolType *res = GetSymType(dynamic_cast<NodeType *>(array_type->type));
+        for (auto it = array_type->ranges.rbegin(); it != array_type->ranges.rend(); it++) {
+            auto range = *it;
+            range->Accept(this);
+            auto array = context->New<SymbolArray>(res, range->exp_first, range->exp_second);
+            array->packed = array_type->packed;
+            res = array;
+        }
+        type->symbol_type = res;
+        return res;
+    }
+    auto primitive_type = dynamic_cast<NodeSimpleType *>(type);
+    auto name_var = dynamic_cast<NodeVar *>(primitive_type->type);
+    auto symbol = Lookup(name_var->lexeme.GetValue<std::string>());
+    auto symbol_type = dynamic_cast<SymbolType *>(symbol);
+    if (symbol_type == nullptr) {
+        throw SemanticException(type, "Type is not found");
+    }
+    name_var->symbol = symbol_type;
+    type->symbol_type = symbol_type;
+    return symbol_type;
+}
+
+Symbol *Resolver::Lookup(const std::string &name) {
+    auto symbol = stack.get(name);
+    if (uses != nullptr) {
+        uses->insert(symbol);
+    }
+    return symbol;
+}
+
+SymbolType *Resolver::GetDesignatorType(Node *node) {
+    if (auto array_access = dynamic_cast<NodeArrayAccess *>(node)) {
+        auto arr_type = GetDesignatorType(array_access->arr);
+        auto sym_array = arr_type ? dynamic_cast<SymbolArray *>(arr_type->Resolve()) : nullptr;
+        return sym_array ? sym_array->type : nullptr;
+    }
+    if (auto record_access = dynamic_cast<NodeRecordAccess *>(node)) {
+        return GetDesignatorType(record_access->field);
+    }
+    if (auto call = dynamic_cast<NodeCallAccess *>(node)) {
+        auto callable = dynamic_cast<NodeVar *>(call->callable);
+        auto sym_func = callable ? dynamic_cast<SymbolFunction *>(callable->symbol) : nullptr;
+        return sym_func ? sym_func->ret : nullptr;
+    }
+    if (auto var = dynamic_cast<NodeVar *>(node)) {
+        auto sym_var = dynamic_cast<SymbolVar *>(var->symbol);
+        return sym_var ? sym_var->type : nullptr;
+    }
+    return nullptr;
+}
+
+
+void Resolver::Visit(NodeBinaryOperation *node) {
+    node->left->Accept(this);
+    node->right->Accept(this);
+}
+
+
+void Resolver::Visit(NodeUnaryOperation *node) {
+    node->operand->Accept(this);
+}
+
+
+void Resolver::Visit(NodeString *node) {
+}
+
+
+void Resolver::Visit(NodeNumber *node) {
+}
+
+
+void Resolver::Visit(NodeBoolean *node) {
+}
+
+
+void Resolver::Visit(NodeVar *node) {
+    node->symbol = Lookup(node->lexeme.GetValue<std::string>());
+}
+
+
+void Resolver::Visit(NodeRecordAccess *node) {
+    node->rec->Accept(this);
+    auto rec_type = GetDesignatorType(node->rec);
+    auto sym_record = rec_type ? dynamic_cast<SymbolRecord *>(rec_type->Resolve()) : nullptr;
+    if (sym_record != nullptr) {
+        auto field = dynamic_cast<NodeVar *>(node->field);
+        field->symbol = sym_record->fields->Get(field->lexeme.GetValue<std::string>());
+    }
+}
+
+
+void Resolver::Visit(NodeCallAccess *node) {
+    node->callable->Accept(this);
+    for (auto &param: node->params) param->Accept(this);
+}
+
+
+void Resolver::Visit(NodeIOCallStatement *node) {
+    for (auto &param: node->params) param->Accept(this);
+}
+
+
+void Resolver::Visit(NodeArrayAccess *node) {
+    node->arr->Accept(this);
+    node->params->Accept(this);
+}
+
+
+void Resolver::Visit(NodeSimpleType *node) {
+    GetSymType(node);
+}
+
+
+void Resolver::Visit(NodeRange *node) {
+    node->exp_first->Accept(this);
+    node->exp_second->Accept(this);
+}
+
+
+void Resolver::Visit(NodeArrayType *node) {
+    GetSymType(node);
+}
+
+
+void Resolver::Visit(NodeField *node) {
+}
+
+
+void Resolver::Visit(NodeRecordType *node) {
+    GetSymType(node);
+}
+
+
+void Resolver::Visit(NodeCompoundStatement *node) {
+    for (auto &statement: node->statements) statement->Accept(this);
+}
+
+
+void Resolver::Visit(NodeAssignmentStatement *node) {
+    node->left->Accept(this);
+    node->right->Accept(this);
+}
+
+
+void Resolver::Visit(NodeUserCallStatement *node) {
+    node->callable->Accept(this);
+    for (auto &param: node->params) param->Accept(this);
+}
+
+
+void Resolver::Visit(NodeIfStatement *node) {
+    node->exp->Accept(this);
+    node->statement->Accept(this);
+    if (node->else_statement != nullptr) {
+        node->else_statement->Accept(this);
+    }
+}
+
+
+void Resolver::Visit(NodeWhileStatement *node) {
+    node->exp->Accept(this);
+    node->statement->Accept(this);
+}
+
+
+void Resolver::Visit(NodeForStatement *node) {
+    node->var->Accept(this);
+    node->exp_begin->Accept(this);
+    node->exp_end->Accept(this);
+    node->statement->Accept(this);
+}
+
+
+void Resolver::Visit(NodeBlock *node) {
+    for (auto &decl: node->decls) decl->Accept(this);
+    node->comp_stmt->Accept(this);
+}
+
+
+void Resolver::Visit(NodeProgram *node) {
+    stack.Push(context->builtins);
+    stack.Push(context->New<SymbolTable>());
+    node->block->Accept(this);
+}
+
+
+void Resolver::Visit(NodeTypeDecl *node) {
+    auto sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
+    auto sym_alias = context->New<SymbolAlias>(node->var->lexeme.GetValue<std::string>(), sym_type);
+    stack.Push(sym_alias);
+    node->var->symbol = sym_alias;
+}
+
+
+void Resolver::Visit(NodeVarDecl *node) {
+    auto sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
+    for (auto &id: node->vars) {
+        if (node->exp != nullptr) {
+            node->exp->Accept(this);
+        }
+        auto sym_var = context->New<SymbolVar>(id->lexeme.GetValue<std::string>(), sym_type);
+        stack.Push(sym_var);
+        id->symbol = sym_var;
+    }
+}
+
+
+void Resolver::Visit(NodeConstDecl *node) {
+    SymbolType *sym_type = nullptr;
+    node->exp->Accept(this);
+    if (node->type != nullptr) {
+        sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
+    }
+    auto sym_const = context->New<SymbolConst>(node->var->lexeme.GetValue<std::string>(), sym_type);
+    stack.Push(sym_const);
+    node->var->symbol = sym_const;
+}
+
+
+void Resolver::Visit(NodeParam *node) {
+    auto sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
+    for (auto &id: node->vars) {
+        SymbolParam *sym_param = nullptr;
+        if (node->modifier == nullptr) {
+            sym_param = context->New<SymbolParam>(id->lexeme.GetValue<std::string>(), sym_type);
+        } else if (node->modifier->lexeme == AllKeywords::CONST) {
+            sym_param = context->New<SymbolConstParam>(id->lexeme.GetValue<std::string>(), sym_type);
+        } else if (node->modifier->lexeme == AllKeywords::VAR) {
+            sym_param = context->New<SymbolVarParam>(id->lexeme.GetValue<std::string>(), sym_type);
+        }
+        stack.Push(sym_param);
+        id->symbol = sym_param;
+    }
+}
+
+
+void Resolver::Visit(NodeProcDecl *node) {
+    auto local = context->New<SymbolTable>();
+    auto var_casted = dynamic_cast<NodeVar *>(node->var);
+    auto symbol_proc = dynamic_cast<SymbolProcedure *>(var_casted->symbol);
+    if (symbol_proc != nullptr && symbol_proc->GetClass() == "procedure") {
+        // keep the symbol of an earlier resolution so that existing references stay valid
+        symbol_proc->locals = local;
+    } else {
+        symbol_proc = context->New<SymbolProcedure>(
+                var_casted->lexeme.GetValue<std::string>(),
+                local,
+                dynamic_cast<NodeCompoundStatement *>(node->block)
+        );
+    }
+    stack.Push(local);
+    for (auto param: node->params) param->Accept(this);
+    node->block->Accept(this);
+    stack.Pop();
+    stack.Push(symbol_proc);
+    var_casted->symbol = symbol_proc;
+}
+
+
+void Resolver::Visit(NodeFuncDecl *node) {
+    auto local = context->New<SymbolTable>();
+    auto var_casted = dynamic_cast<NodeVar *>(node->var);
+    auto ret = GetSymType(dynamic_cast<NodeType *>(node->type));
+    auto symbol_func = dynamic_cast<SymbolFunction *>(var_casted->symbol);
+    if (symbol_func != nullptr) {
+        symbol_func->locals = local;
+        symbol_func->ret = ret;
+    } else {
+        symbol_func = context->New<SymbolFunction>(
+                var_casted->lexeme.GetValue<std::string>(),
+                local,
+                dynamic_cast<NodeCompoundStatement *>(node->block),
+                ret
+        );
+    }
+    local->Push(symbol_func);
+    local->Push(context->New<SymbolVar>("result", ret));
+    stack.Push(local);
+    for (auto param: node->params) param->Accept(this);
+    node->block->Accept(this);
+    stack.Pop();
+    local->Del(symbol_func->GetName());
+    stack.Push(symbol_func);
+    var_casted->symbol = symbol_func;
+}
+
+SymbolTableStack Resolver::GetStack() {
+    return stack;
+}
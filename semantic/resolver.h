@@ -0,0 +1,92 @@
+#ifndef COMPILER_RESOLVER_H
+#define COMPILER_RESOLVER_H
+
+#include "../visitor.h"
+#include "../symbol/symbol.h"
+#include "../context/context.h"
+
+#include <set>
+
+class Node;
+
+class NodeType;
+
+// Builds symbol tables and binds every name in the tree to its symbol, so that
+// later passes never have to look anything up in the scope stack.
+class Resolver : public Visitor {
+public:
+    explicit Resolver(CompilationContext *context) : context(context) {}
+
+    SymbolType *GetSymType(NodeType *type);
+
+    SymbolType *GetDesignatorType(Node *node);
+
+    Symbol *Lookup(const std::string &name);
+
+    void Visit(NodeBinaryOperation *node) override;
+
+    void Visit(NodeUnaryOperation *node) override;
+
+    void Visit(NodeString *node) override;
+
+    void Visit(NodeNumber *node) override;
+
+    void Visit(NodeBoolean *node) override;
+
+    void Visit(NodeVar *node) override;
+
+    void Visit(NodeRecordAccess *node) override;
+
+    void Visit(NodeCallAccess *node) override;
+
+    void Visit(NodeIOCallStatement *node) override;
+
+    void Visit(NodeArrayAccess *node) override;
+
+    void Visit(NodeSimpleType *node) override;
+
+    void Visit(NodeRange *node) override;
+
+    void Visit(NodeArrayType *node) override;
+
+    void Visit(NodeField *node) override;
+
+    void Visit(NodeRecordType *node) override;
+
+    void Visit(NodeCompoundStatement *node) override;
+
+    void Visit(NodeAssignmentStatement *node) override;
+
+    void Visit(NodeUserCallStatement *node) override;
+
+    void Visit(NodeIfStatement *node) override;
+
+    void Visit(NodeWhileStatement *node) override;
+
+    void Visit(NodeForStatement *node) override;
+
+    void Visit(NodeBlock *node) override;
+
+    void Visit(NodeProgram *node) override;
+
+    void Visit(NodeTypeDecl *node) override;
+
+    void Visit(NodeVarDecl *node) override;
+
+    void Visit(NodeConstDecl *node) override;
+
+    void Visit(NodeParam *node) override;
+
+    void Visit(NodeProcDecl *node) override;
+
+    void Visit(NodeFuncDecl *node) override;
+
+    SymbolTableStack GetStack();
+
+    CompilationContext *context;
+    SymbolTableStack stack;
+    std::set<Symbol *> *uses = nullptr;
+};
+
+
+#endif //COMPILER_RESOLVER_H
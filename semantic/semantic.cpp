@@ -1,42 +1,12 @@
 #include <sstream>
 #include "semantic.h"
+#include "resolver.h"
+#include "evaluator.h"
 #include "../parser/parser.h"
 
-#include <magic_enum.hpp>
-
+#include <optional>
 
-SymbolType *Semantic::GetSymType(NodeType *type) {
-    auto record_type = dynamic_cast<NodeRecordType *>(type);
-    if (record_type != nullptr) {
-        auto record_table = new SymbolTable();
-        for (auto &field: record_type->fields) {
-            auto casted_field = dynamic_cast<NodeField *>(field);
-            auto sym_type_field = GetSymType(dynamic_cast<NodeType *>(casted_field->type));
-            for (auto &id: casted_field->ids) {
-                auto id_field = dynamic_cast<NodeVar *>(id);
-                record_table->Push(new SymbolVar(id_field->lexeme.GetValue<std::string>(), sym_type_field));
-            }
-        }
-        return new SymbolRecord(record_table);
-    }
-    auto array_type = dynamic_cast<NodeArrayType *>(type);
-    if (array_type != nullptr) {
-        SymbolType *res = GetSymType(dynamic_cast<NodeType *>(array_type->type));
-        for (auto it = array_type->ranges.rbegin(); it != array_type->ranges.rend(); it++) {
-            auto range = *it;
-            res = new SymbolArray(res, range->exp_first, range->exp_second);
-        }
-        return res;
-    }
-    auto primitive_type = dynamic_cast<NodeSimpleType *>(type);
-    auto name = dynamic_cast<NodeVar *>(primitive_type->type)->lexeme.GetValue<std::string>();
-    auto symbol = stack.get(name);
-    auto symbol_type = dynamic_cast<SymbolType *>(symbol);
-    if (symbol_type == nullptr) {
-        throw SemanticException(type, "Type is not found");
-    }
-    return symbol_type;
-}
+#include <magic_enum.hpp>
 
 
 void Semantic::Visit(NodeBinaryOperation *node) {
@@ -59,21 +29,21 @@ void Semantic::Visit(NodeBinaryOperation *node) {
             case Operators::GREATEREQUAL:
             case Operators::GREATER:
                 if (!(
-                        (lst->is(rst) && lst->is(SYM_INTEGER)) ||
-                        (lst->is(rst) && lst->is(SYM_DOUBLE)) ||
-                        (lst->is(rst) && lst->is(SYM_BOOLEAN)) ||
-                        (lst->is(rst) && lst->is(SYM_CHAR)) ||
-                        (lst->is(rst) && lst->is(SYM_STRING))
+                        (lst->is(rst) && lst->is(context->sym_integer)) ||
+                        (lst->is(rst) && lst->is(context->sym_double)) ||
+                        (lst->is(rst) && lst->is(context->sym_boolean)) ||
+                        (lst->is(rst) && lst->is(context->sym_char)) ||
+                        (lst->is(rst) && lst->is(context->sym_string))
                 )) {
                     throw SemanticException(node, stream.str());
                 }
-                node->symbol_type = SYM_BOOLEAN;
+                node->symbol_type = context->sym_boolean;
                 break;
             case Operators::ADD:
                 if (!(
-                        (lst->is(rst) && lst->is(SYM_INTEGER)) ||
-                        (lst->is(rst) && lst->is(SYM_DOUBLE)) ||
-                        (lst->is(rst) && lst->is(SYM_STRING))
+                        (lst->is(rst) && lst->is(context->sym_integer)) ||
+                        (lst->is(rst) && lst->is(context->sym_double)) ||
+                        (lst->is(rst) && lst->is(context->sym_string))
                 )) {
                     throw SemanticException(node, stream.str());
                 }
@@ -82,8 +52,8 @@ void Semantic::Visit(NodeBinaryOperation *node) {
             case Operators::SUBSTRACT:
             case Operators::MULTIPLY:
                 if (!(
-                        (lst->is(rst) && lst->is(SYM_INTEGER)) ||
-                        (lst->is(rst) && lst->is(SYM_DOUBLE))
+                        (lst->is(rst) && lst->is(context->sym_integer)) ||
+                        (lst->is(rst) && lst->is(context->sym_double))
                 )) {
                     throw SemanticException(node, stream.str());
                 }
@@ -91,12 +61,12 @@ void Semantic::Visit(NodeBinaryOperation *node) {
                 break;
             case Operators::DIVISION:
                 if (!(
-                        (lst->is(rst) && lst->is(SYM_INTEGER)) ||
-                        (lst->is(rst) && lst->is(SYM_DOUBLE))
+                        (lst->is(rst) && lst->is(context->sym_integer)) ||
+                        (lst->is(rst) && lst->is(context->sym_double))
                 )) {
                     throw SemanticException(node, stream.str());
                 }
-                node->symbol_type = SYM_DOUBLE;
+                node->symbol_type = context->sym_double;
         }
     } else {
         std::stringstream stream;
@@ -108,19 +78,19 @@ void Semantic::Visit(NodeBinaryOperation *node) {
             case AllKeywords::XOR:
             case AllKeywords::AND:
                 if (!(
-                        (lst->is(rst) && lst->is(SYM_INTEGER)) ||
-                        (lst->is(rst) && lst->is(SYM_BOOLEAN))
+                        (lst->is(rst) && lst->is(context->sym_integer)) ||
+                        (lst->is(rst) && lst->is(context->sym_boolean))
                 )) {
                     throw SemanticException(node, stream.str());
                 }
-                node->symbol_type = SYM_BOOLEAN;
+                node->symbol_type = context->sym_boolean;
                 break;
             case AllKeywords::DIV:
             case AllKeywords::MOD:
             case AllKeywords::SHR:
             case AllKeywords::SHL:
                 if (!(
-                        (lst->is(rst) && lst->is(SYM_INTEGER))
+                        (lst->is(rst) && lst->is(context->sym_integer))
                 )) {
                     throw SemanticException(node, stream.str());
                 }
@@ -137,12 +107,12 @@ void Semantic::Visit(NodeUnaryOperation *node) {
 
     if (node->op == LexemeType::Operator) {
         if (node->op == Operators::ADD || node->op == Operators::SUBSTRACT) {
-            if (sym_type->is(SYM_INTEGER)) node->symbol_type = SYM_INTEGER;
-            if (sym_type->is(SYM_DOUBLE)) node->symbol_type = SYM_DOUBLE;
+            if (sym_type->is(context->sym_integer)) node->symbol_type = context->sym_integer;
+            if (sym_type->is(context->sym_double)) node->symbol_type = context->sym_double;
         }
     } else if (node->op == AllKeywords::NOT) {
-        if (sym_type->is(SYM_BOOLEAN)) node->symbol_type = SYM_BOOLEAN;
-        if (sym_type->is(SYM_INTEGER)) node->symbol_type = SYM_INTEGER;
+        if (sym_type->is(context->sym_boolean)) node->symbol_type = context->sym_boolean;
+        if (sym_type->is(context->sym_integer)) node->symbol_type = context->sym_integer;
     }
     if (node->symbol_type == nullptr) {
 
@@ -158,25 +128,25 @@ void Semantic::Visit(NodeUnaryOperation *node) {
 
 
 void Semantic::Visit(NodeString *node) {
-    node->symbol_type = SYM_STRING;
+    node->symbol_type = context->sym_string;
 }
 
 
 void Semantic::Visit(NodeNumber *node) {
     if (node->lexeme == LexemeType::Double)
-        node->symbol_type = SYM_DOUBLE;
+        node->symbol_type = context->sym_double;
     else
-        node->symbol_type = SYM_INTEGER;
+        node->symbol_type = context->sym_integer;
 }
 
 
 void Semantic::Visit(NodeBoolean *node) {
-    node->symbol_type = SYM_BOOLEAN;
+    node->symbol_type = context->sym_boolean;
 }
 
 
 void Semantic::Visit(NodeVar *node) {
-    auto id = stack.get(node->lexeme.GetValue<std::string>());
+    auto id = node->symbol;
     auto *id_var_casted = dynamic_cast<SymbolVar *>(id);
     if (id_var_casted != nullptr) {
         node->symbol_type = id_var_casted->type;
@@ -198,9 +168,11 @@ void Semantic::Visit(NodeRecordAccess *node) {
     if (sym_type_of_rec == nullptr) {
         throw SemanticException(node->rec, "It is not record");
     }
-    auto sym_field = sym_type_of_rec->fields->Get(
-            dynamic_cast<NodeVar *>(node->field)->lexeme.GetValue<std::string>());
-    auto sym_field_casted = dynamic_cast<SymbolVar *>(sym_field);
+    auto field = dynamic_cast<NodeVar *>(node->field);
+    if (field->symbol == nullptr) {
+        field->symbol = sym_type_of_rec->fields->Get(field->lexeme.GetValue<std::string>());
+    }
+    auto sym_field_casted = dynamic_cast<SymbolVar *>(field->symbol);
     node->is_lvalue = true;
     node->symbol_type = sym_field_casted->type;
 }
@@ -215,14 +187,18 @@ void Semantic::Visit(NodeCallAccess *node) {
     if (node->params.size() != sym_casted->GetCountOfArguments()) {
         throw SemanticException(node->callable, "Do not match count of params");
     }
+    auto sym_func = dynamic_cast<SymbolFunction *>(sym_casted);
+    if (sym_func == nullptr) {
+        throw SemanticException(node->callable, "It is not function");
+    }
     for (auto &param: node->params) {
         param->Accept(this);
     }
     for (auto i = 0; i < sym_casted->GetCountOfArguments(); ++i) {
-        auto name = sym_casted->locals->ordered[i];
+        auto name = sym_casted->locals->ordered[i + 1];
         auto sym_param = dynamic_cast<SymbolParam *>(sym_casted->locals->Get(name));
 
-        if (node->params[i]->symbol_type->is(sym_param->type)) {
+        if (!node->params[i]->symbol_type->is(sym_param->type)) {
             std::stringstream stream;
             stream
                     << "Expected "
@@ -232,6 +208,7 @@ void Semantic::Visit(NodeCallAccess *node) {
             throw SemanticException(node->params[i], stream.str());
         }
     }
+    node->symbol_type = sym_func->ret;
 }
 
 
@@ -239,7 +216,7 @@ void Semantic::Visit(NodeArrayAccess *node) {
     node->is_lvalue = true;
     node->arr->Accept(this);
     node->params->Accept(this);
-    if (!node->params->symbol_type->is(SYM_INTEGER)) {
+    if (!node->params->symbol_type->is(context->sym_integer)) {
         throw SemanticException(node->arr, "Integer expected in parameter");
     }
     auto symbol_type_casted = dynamic_cast<SymbolArray *>(node->arr->symbol_type->Resolve());
@@ -257,10 +234,10 @@ void Semantic::Visit(NodeSimpleType *node) {
 void Semantic::Visit(NodeRange *node) {
     node->exp_first->Accept(this);
     node->exp_second->Accept(this);
-    if (!node->exp_first->symbol_type->is(SYM_INTEGER)) {
+    if (!node->exp_first->symbol_type->is(context->sym_integer)) {
         throw SemanticException(node->exp_first, "Integer expected");
     }
-    if (!node->exp_second->symbol_type->is(SYM_INTEGER)) {
+    if (!node->exp_second->symbol_type->is(context->sym_integer)) {
         throw SemanticException(node->exp_second, "Integer expected");
     }
 }
@@ -272,21 +249,10 @@ void Semantic::Visit(NodeArrayType *node) {
 
 
 void Semantic::Visit(NodeField *node) {
-    auto sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
-    for (auto &id: node->ids) {
-        auto id_casted = dynamic_cast<NodeVar *>(id);
-        stack.Push(new SymbolVar(id_casted->lexeme.GetValue<std::string>(), sym_type));
-    }
 }
 
 
 void Semantic::Visit(NodeRecordType *node) {
-    auto table = new SymbolTable();
-    stack.Push(table);
-    for (auto &field: node->fields) {
-        field->Accept(this);
-    }
-    stack.Pop();
 }
 
 
@@ -310,20 +276,20 @@ void Semantic::Visit(NodeAssignmentStatement *node) {
     switch (node->lexeme.GetValue<Operators>()) {
         case Operators::ASSIGN:
             if (!(
-                    (lst->is(rst) && lst->is(SYM_INTEGER)) ||
-                    (lst->is(rst) && lst->is(SYM_DOUBLE)) ||
-                    (lst->is(rst) && lst->is(SYM_BOOLEAN)) ||
-                    (lst->is(rst) && lst->is(SYM_CHAR)) ||
-                    (lst->is(rst) && lst->is(SYM_STRING))
+                    (lst->is(rst) && lst->is(context->sym_integer)) ||
+                    (lst->is(rst) && lst->is(context->sym_double)) ||
+                    (lst->is(rst) && lst->is(context->sym_boolean)) ||
+                    (lst->is(rst) && lst->is(context->sym_char)) ||
+                    (lst->is(rst) && lst->is(context->sym_string))
             )) {
                 throw SemanticException(node->lexeme, stream.str());
             }
             break;
         case Operators::ADDASSIGN:
             if (!(
-                    (lst->is(rst) && lst->is(SYM_INTEGER)) ||
-                    (lst->is(rst) && lst->is(SYM_DOUBLE)) ||
-                    (lst->is(rst) && lst->is(SYM_STRING))
+                    (lst->is(rst) && lst->is(context->sym_integer)) ||
+                    (lst->is(rst) && lst->is(context->sym_double)) ||
+                    (lst->is(rst) && lst->is(context->sym_string))
             )) {
                 throw SemanticException(node->lexeme, stream.str());
             }
@@ -331,8 +297,8 @@ void Semantic::Visit(NodeAssignmentStatement *node) {
         case Operators::MULTIPLYASSIGN:
         case Operators::DIVISIONASSIGN:
             if (!(
-                    (lst->is(rst) && lst->is(SYM_INTEGER)) ||
-                    (lst->is(rst) && lst->is(SYM_DOUBLE))
+                    (lst->is(rst) && lst->is(context->sym_integer)) ||
+                    (lst->is(rst) && lst->is(context->sym_double))
             )) {
                 throw SemanticException(node->lexeme, stream.str());
             }
@@ -382,11 +348,11 @@ void Semantic::Visit(NodeIOCallStatement *node) {
     }
     for (auto &param: node->params) {
         param->Accept(this);
-        if ((!param->symbol_type->is(SYM_INTEGER) &&
-             !param->symbol_type->is(SYM_DOUBLE) &&
-             !param->symbol_type->is(SYM_BOOLEAN) &&
-             !param->symbol_type->is(SYM_STRING) &&
-             !param->symbol_type->is(SYM_CHAR))) {
+        if ((!param->symbol_type->is(context->sym_integer) &&
+             !param->symbol_type->is(context->sym_double) &&
+             !param->symbol_type->is(context->sym_boolean) &&
+             !param->symbol_type->is(context->sym_string) &&
+             !param->symbol_type->is(context->sym_char))) {
             throw SemanticException(param, "It can not be used in io procedures");
         }
     }
@@ -395,7 +361,7 @@ void Semantic::Visit(NodeIOCallStatement *node) {
 
 void Semantic::Visit(NodeIfStatement *node) {
     node->exp->Accept(this);
-    if (!node->exp->symbol_type->is(SYM_BOOLEAN)) {
+    if (!node->exp->symbol_type->is(context->sym_boolean)) {
         throw SemanticException(node->exp, "Boolean expected");
     }
     node->statement->Accept(this);
@@ -407,7 +373,7 @@ void Semantic::Visit(NodeIfStatement *node) {
 
 void Semantic::Visit(NodeWhileStatement *node) {
     node->exp->Accept(this);
-    if (!node->exp->symbol_type->is(SYM_BOOLEAN)) {
+    if (!node->exp->symbol_type->is(context->sym_boolean)) {
         throw SemanticException(node->exp, "Boolean expected");
     }
     node->statement->Accept(this);
@@ -418,13 +384,13 @@ void Semantic::Visit(NodeForStatement *node) {
     node->var->Accept(this);
     node->exp_begin->Accept(this);
     node->exp_end->Accept(this);
-    if (!node->var->symbol_type->is(SYM_INTEGER)) {
+    if (!node->var->symbol_type->is(context->sym_integer)) {
         throw SemanticException(node->var, "Ordinary expected in for");
     }
-    if (!node->exp_begin->symbol_type->is(SYM_INTEGER)) {
+    if (!node->exp_begin->symbol_type->is(context->sym_integer)) {
         throw SemanticException(node->exp_begin, "Integer expected");
     }
-    if (!node->exp_end->symbol_type->is(SYM_INTEGER)) {
+    if (!node->exp_end->symbol_type->is(context->sym_integer)) {
         throw SemanticException(node->exp_end, "Integer expected");
     }
     node->statement->Accept(this);
@@ -438,105 +404,123 @@ void Semantic::Visit(NodeBlock *node) {
 
 
 void Semantic::Visit(NodeProgram *node) {
-    stack.CreateTable();
-    stack.Push(SYM_INTEGER);
-    stack.Push(SYM_DOUBLE);
-    stack.Push(SYM_BOOLEAN);
-    stack.Push(SYM_CHAR);
-    stack.Push(SYM_STRING);
-    stack.CreateTable();
-    node->block->Accept(this);
+    Resolver resolver(context);
+    resolver.stack.Push(context->builtins);
+    resolver.stack.Push(context->New<SymbolTable>());
+
+    auto block = dynamic_cast<NodeBlock *>(node->block);
+    // Declarations are resolved and checked here in order and routine
+    // bodies checked afterwards; both record their errors by position, so
+    // that diagnostics come out in source order. Nothing after a failed
+    // declaration is checked.
+    std::vector<Node *> bodies;
+    std::vector<std::optional<SemanticException>> errors;
+    Evaluator evaluator;
+    auto units = block->decls;
+    units.push_back(block->comp_stmt);
+    for (auto unit: units) {
+        auto body = dynamic_cast<NodeProcDecl *>(unit) != nullptr || unit == block->comp_stmt;
+        try {
+            unit->Accept(&resolver);
+            if (!body) {
+                unit->Accept(this);
+                unit->Accept(&evaluator);
+            }
+        } catch (SemanticException &err) {
+            bodies.push_back(nullptr);
+            errors.emplace_back(err);
+            break;
+        }
+        bodies.push_back(body ? unit : nullptr);
+        errors.emplace_back();
+    }
+    stack = resolver.GetStack();
+    CheckBodies(bodies, errors);
+}
+
+void Semantic::CheckBodies(const std::vector<Node *> &bodies, std::vector<std::optional<SemanticException>> &errors) {
+    auto check = [&](size_t i) {
+        if (bodies[i] == nullptr) {
+            return;
+        }
+        try {
+            Semantic checker(context, 1);
+            bodies[i]->Accept(&checker);
+            Evaluator evaluator;
+            bodies[i]->Accept(&evaluator);
+        } catch (SemanticException &err) {
+            errors[i] = err;
+        }
+    };
+    if (threads <= 1 || bodies.size() <= 2) {
+        for (size_t i = 0; i < bodies.size(); ++i) check(i);
+    } else {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            pool.Submit([&check, i]() { check(i); });
+        }
+        pool.Wait();
+    }
+    std::optional<SemanticException> first;
+    for (auto &error: errors) {
+        if (error.has_value()) {
+            context->Report(error->what());
+            if (!first.has_value()) {
+                first = error;
+            }
+        }
+    }
+    if (first.has_value()) {
+        throw *first;
+    }
 }
 
 
 void Semantic::Visit(NodeTypeDecl *node) {
-    auto sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
-    stack.Push(new SymbolAlias(node->var->lexeme.GetValue<std::string>(), sym_type));
 }
 
 
 void Semantic::Visit(NodeVarDecl *node) {
-    for (auto &id: node->vars) {
-        auto sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
-        if (node->exp != nullptr) {
-            node->exp->Accept(this);
-            if (!sym_type->is(node->exp->symbol_type)) {
-                std::stringstream stream;
-                stream << "Expected " << sym_type->GetName() << ", but found " << node->exp->symbol_type->GetName();
-                throw SemanticException(node, stream.str());
-            }
-        }
-        stack.Push(
-                new SymbolVar(id->lexeme.GetValue<std::string>(), sym_type));
+    if (node->exp == nullptr) {
+        return;
+    }
+    auto sym_type = node->type->symbol_type;
+    node->exp->Accept(this);
+    if (!sym_type->is(node->exp->symbol_type)) {
+        std::stringstream stream;
+        stream << "Expected " << sym_type->GetName() << ", but found " << node->exp->symbol_type->GetName();
+        throw SemanticException(node, stream.str());
     }
 }
 
 
 void Semantic::Visit(NodeConstDecl *node) {
-    SymbolType *sym_type;
+    auto sym_const = dynamic_cast<SymbolVar *>(node->var->symbol);
     node->exp->Accept(this);
     if (node->type != nullptr) {
-        sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
+        auto sym_type = node->type->symbol_type;
         if (!sym_type->is(node->exp->symbol_type)) {
             std::stringstream stream;
             stream << "Expected " << sym_type->GetName() << ", but found " << node->exp->symbol_type->GetName();
             throw SemanticException(node, stream.str());
         }
     } else {
-        sym_type = node->exp->symbol_type;
+        sym_const->type = node->exp->symbol_type;
     }
-    stack.Push(new SymbolVar(node->var->lexeme.GetValue<std::string>(), sym_type));
-
 }
 
 
 void Semantic::Visit(NodeParam *node) {
-    auto sym_type = GetSymType(dynamic_cast<NodeType *>(node->type));
-    for (auto &id: node->vars) {
-        if (node->modifier == nullptr) {
-            stack.Push(new SymbolParam(id->lexeme.GetValue<std::string>(), sym_type));
-        } else if (node->modifier->lexeme == AllKeywords::CONST) {
-            stack.Push(new SymbolConstParam(id->lexeme.GetValue<std::string>(), sym_type));
-        } else if (node->modifier->lexeme == AllKeywords::VAR) {
-            stack.Push(new SymbolVarParam(id->lexeme.GetValue<std::string>(), sym_type));
-        }
-    }
 }
 
 
 void Semantic::Visit(NodeProcDecl *node) {
-    auto local = new SymbolTable();
-    auto var_casted = dynamic_cast<NodeVar *>(node->var);
-    auto symbol_proc = new SymbolProcedure(
-            var_casted->lexeme.GetValue<std::string>(),
-            local,
-            dynamic_cast<NodeCompoundStatement *>(node->block)
-    );
-    stack.Push(local);
-    for (auto param: node->params) param->Accept(this);
     node->block->Accept(this);
-    stack.Pop();
-    stack.Push(symbol_proc);
 }
 
 
 void Semantic::Visit(NodeFuncDecl *node) {
-    auto local = new SymbolTable();
-    auto var_casted = dynamic_cast<NodeVar *>(node->var);
-    auto symbol_func = new SymbolFunction(
-            var_casted->lexeme.GetValue<std::string>(),
-            local,
-            dynamic_cast<NodeCompoundStatement *>(node->block),
-            nullptr
-    );
-    local->Push(symbol_func);
-    local->Push(new SymbolVar("result", GetSymType(dynamic_cast<NodeType *>(node->type))));
-    stack.Push(local);
-    for (auto param: node->params) param->Accept(this);
     node->block->Accept(this);
-    stack.Pop();
-    local->Del(symbol_func->GetName());
-    stack.Push(symbol_func);
 }
 
 SymbolTableStack Semantic::GetStack() {
@@ -1,14 +1,23 @@
 #ifndef COMPILER_SEMANTIC_H
 #define COMPILER_SEMANTIC_H
 
+#include <optional>
+
 #include "../visitor.h"
 #include "../symbol/symbol.h"
+#include "../parallel/thread_pool.h"
+#include "../context/context.h"
 
-class NodeType;
+class Node;
 
 class Semantic : public Visitor {
 public:
-    SymbolType *GetSymType(NodeType *type);
+    explicit Semantic(CompilationContext *context, int threads = ThreadPool::DefaultThreads())
+            : context(context), threads(threads) {}
+
+    // Checks the bodies that are not null, each into the slot of errors at
+    // its index, and reports every error in that order.
+    void CheckBodies(const std::vector<Node *> &bodies, std::vector<std::optional<SemanticException>> &errors);
 
     void Visit(NodeBinaryOperation *node) override;
 
@@ -70,7 +79,9 @@ public:
 
     SymbolTableStack GetStack();
 
+    CompilationContext *context;
     SymbolTableStack stack;
+    int threads;
 };
 
 
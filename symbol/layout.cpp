@@ -0,0 +1,68 @@
+#include "layout.h"
+
+#include <sstream>
+
+static long long RoundUp(long long offset, long long align) {
+    return (offset + align - 1) / align * align;
+}
+
+static Layout Compute(SymbolType *type) {
+    Layout layout;
+    if (auto array = dynamic_cast<SymbolArray *>(type)) {
+        auto &element = LayoutOf(array->type);
+        layout.packed = array->packed;
+        layout.align = array->packed ? 1 : element.align;
+        auto stride = RoundUp(element.size, layout.align);
+        layout.dimensions.push_back({array->low, array->Count(), stride});
+        if (dynamic_cast<SymbolArray *>(array->type->Resolve()) != nullptr) {
+            layout.dimensions.insert(layout.dimensions.end(), element.dimensions.begin(), element.dimensions.end());
+            layout.element = element.element;
+        } else {
+            layout.element = array->type;
+        }
+        layout.size = array->Count() * stride;
+        return layout;
+    }
+    if (auto record = dynamic_cast<SymbolRecord *>(type)) {
+        layout.packed = record->packed;
+        long long offset = 0;
+        for (auto &name: record->fields->ordered) {
+            auto &field = LayoutOf(dynamic_cast<SymbolVar *>(record->fields->Get(name))->type);
+            if (!record->packed) {
+                offset = RoundUp(offset, field.align);
+                layout.align = std::max(layout.align, field.align);
+            }
+            layout.fields.emplace_back(name, offset);
+            layout.offsets[name] = offset;
+            offset += field.size;
+        }
+        layout.size = RoundUp(offset, layout.align);
+    }
+    return layout;
+}
+
+const Layout &LayoutOf(SymbolType *type) {
+    auto resolved = type->Resolve();
+    std::call_once(resolved->laid_out, [resolved] {
+        resolved->layout = std::make_shared<const Layout>(Compute(resolved));
+    });
+    return *resolved->layout;
+}
+
+std::string Layout::Describe() const {
+    std::stringstream ss;
+    ss << size << " slots aligned to " << align;
+    if (!dimensions.empty()) {
+        ss << ", strides";
+        for (auto &dimension: dimensions) {
+            ss << (&dimension == &dimensions.front() ? " " : ", ") << dimension.stride;
+        }
+    }
+    if (!fields.empty()) {
+        ss << ":";
+        for (auto &[name, offset]: fields) {
+            ss << (&fields.front().first == &name ? " " : ", ") << name << " at " << offset;
+        }
+    }
+    return ss.str();
+}
@@ -0,0 +1,45 @@
+#ifndef COMPILER_LAYOUT_H
+#define COMPILER_LAYOUT_H
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "symbol.h"
+
+// Storage layout of a type in Value slots, the unit of the storage model in
+// vm/slots.h. A scalar takes one slot and is aligned to one. A record is
+// aligned like its most aligned field, and each field is placed at the next
+// offset its alignment allows, unless the record is packed. An array is laid
+// out row-major over all of its dimensions, the nested arrays of
+// array [a..b, c..d] and of array of array alike, with the stride of every
+// dimension precomputed.
+struct Layout {
+    struct Dimension {
+        long long low;
+        long long count;
+        long long stride;
+    };
+
+    long long size = 1;
+    long long align = 1;
+    bool packed = false;
+    // Fields of a record with their offsets, in declaration order and by
+    // name.
+    std::vector<std::pair<std::string, long long>> fields;
+    std::unordered_map<std::string, long long> offsets;
+    // Dimensions of an array, outermost first, and the type of its elements.
+    std::vector<Dimension> dimensions;
+    SymbolType *element = nullptr;
+
+    [[nodiscard]] long long Offset(const std::string &field) const { return offsets.at(field); }
+
+    // Size, alignment and offsets or strides, as shown by -s.
+    [[nodiscard]] std::string Describe() const;
+};
+
+// The layout of type, computed on first use and kept with the type.
+const Layout &LayoutOf(SymbolType *type);
+
+#endif //COMPILER_LAYOUT_H
@@ -1,6 +1,8 @@
 #include "symbol.h"
+#include "layout.h"
 
 #include <iomanip>
+#include <sstream>
 
 std::string Symbol::GetName() { return name; }
 
@@ -8,7 +10,7 @@ Symbol *SymbolTable::Get(std::string name) {
     if (!data.contains(name)) {
         throw SemanticException("Id is undeclared");
     }
-    return data[name];
+    return data.at(name);
 }
 
 void SymbolTable::Push(std::string name, Symbol *symbol) {
@@ -47,7 +49,8 @@ void SymbolTable::Draw(std::ostream &os, int depth) {
         auto sym = data[name];
         os << std::setw(10) << std::left << depth
            << std::setw(30) << std::left << sym->GetName()
-           << std::setw(20) << std::left << sym->GetClass() << "\n";
+           << std::setw(20) << std::left << sym->GetClass()
+           << sym->GetDetails() << "\n";
         if (auto proc = dynamic_cast<SymbolProcedure *>(sym)) {
             proc->locals->Draw(os, depth + 1);
         }
@@ -79,10 +82,6 @@ void SymbolTableStack::Push(Symbol *symbol) {
     data.back()->Push(symbol->GetName(), symbol);
 }
 
-void SymbolTableStack::CreateTable() {
-    data.push_back(new SymbolTable());
-}
-
 bool SymbolTableStack::ContainsInScope(std::string name) {
     for (auto &it: data) {
         if (it->Contains(name)) {
@@ -126,8 +125,18 @@ int SymbolProcedure::GetCountOfArguments() {
     return answer;
 }
 
+std::vector<SymbolParam *> SymbolProcedure::GetParams() {
+    std::vector<SymbolParam *> params;
+    for (auto &name: locals->ordered) {
+        if (auto param = dynamic_cast<SymbolParam *>(locals->Get(name))) {
+            params.push_back(param);
+        }
+    }
+    return params;
+}
+
 SymbolType *SymbolAlias::Resolve() {
-    return original;
+    return original->Resolve();
 }
 
 bool SymbolRecord::is(SymbolType *b) {
@@ -147,3 +156,68 @@ bool SymbolArray::is(SymbolType *b) {
     if (b_casted == nullptr) { return false; }
     return type->is(b_casted);
 }
+
+long long SymbolArray::Count() const {
+    return high - low + 1;
+}
+
+long long SymbolArray::ElementCount() {
+    auto inner = dynamic_cast<SymbolArray *>(type->Resolve());
+    return Count() * (inner ? inner->ElementCount() : 1);
+}
+
+SymbolType *SymbolArray::ElementType() {
+    auto inner = dynamic_cast<SymbolArray *>(type->Resolve());
+    return inner ? inner->ElementType() : type;
+}
+
+std::string SymbolArray::GetDetails() {
+    std::stringstream ss;
+    ss << (packed ? "packed array[" : "array[");
+    SymbolType *current = this;
+    while (auto array = dynamic_cast<SymbolArray *>(current)) {
+        if (current != this) {
+            ss << ", ";
+        }
+        ss << array->low << ".." << array->high;
+        current = array->type;
+    }
+    ss << "] of " << current->GetName() << ", " << ElementCount() << " elements, " << LayoutOf(this).Describe();
+    return ss.str();
+}
+
+std::string SymbolRecord::GetDetails() {
+    return (packed ? "packed record, " : "record, ") + LayoutOf(this).Describe();
+}
+
+std::string SymbolAlias::GetDetails() {
+    return original->GetDetails();
+}
+
+std::string SymbolVar::GetDetails() {
+    if (dynamic_cast<SymbolArray *>(type) != nullptr || dynamic_cast<SymbolRecord *>(type) != nullptr) {
+        return type->GetDetails();
+    }
+    return "";
+}
+
+std::string SymbolConst::GetDetails() {
+    if (!value.has_value()) {
+        return "";
+    }
+    return "= " + ConstValueToString(*value);
+}
+
+std::string ConstValueToString(const ConstValue &value) {
+    std::stringstream ss;
+    if (std::holds_alternative<long long>(value)) {
+        ss << std::get<long long>(value);
+    } else if (std::holds_alternative<double>(value)) {
+        ss << std::get<double>(value);
+    } else if (std::holds_alternative<bool>(value)) {
+        ss << (std::get<bool>(value) ? "true" : "false");
+    } else {
+        ss << "'" << std::get<std::string>(value) << "'";
+    }
+    return ss.str();
+}
@@ -2,7 +2,11 @@
 #define COMPILER_SYMBOL_H
 
 #include "../lexer/lexeme.h"
+#include "value.h"
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -10,12 +14,14 @@ class Symbol {
 public:
     explicit Symbol(std::string name) : name(name) {}
 
-    ~Symbol() = default;
+    virtual ~Symbol() = default;
 
     virtual std::string GetName();
 
     virtual std::string GetClass() { return "symbol"; }
 
+    virtual std::string GetDetails() { return ""; }
+
     std::string name;
 };
 
@@ -57,8 +63,6 @@ public:
 
     void Push(SymbolTable *table);
 
-    void CreateTable();
-
     [[nodiscard]] bool ContainsInScope(std::string name);
 
     void Draw(std::ostream &os);
@@ -66,6 +70,8 @@ public:
     std::vector<SymbolTable *> data;
 };
 
+struct Layout;
+
 class SymbolType : public Symbol {
 public:
     explicit SymbolType(std::string name) : Symbol(name) {}
@@ -77,6 +83,10 @@ public:
     virtual std::string GetClass() { return "primitive type"; }
 
     ~SymbolType() = default;
+
+    // Set by LayoutOf, see layout.h.
+    std::shared_ptr<const Layout> layout;
+    std::once_flag laid_out;
 };
 
 class SymbolInteger : public SymbolType {
@@ -122,6 +132,8 @@ public:
 
     virtual std::string GetClass() { return "alias"; }
 
+    std::string GetDetails() override;
+
     SymbolType *Resolve() override;
 
     SymbolType *original;
@@ -135,9 +147,12 @@ public:
 
     virtual std::string GetClass() { return "record"; }
 
+    std::string GetDetails() override;
+
     bool is(SymbolType *b) override;
 
     SymbolTable *fields;
+    bool packed = false;
 };
 
 class Node;
@@ -150,11 +165,22 @@ public:
 
     virtual std::string GetClass() { return "array"; }
 
+    std::string GetDetails() override;
+
     bool is(SymbolType *b) override;
 
+    [[nodiscard]] long long Count() const;
+
+    long long ElementCount();
+
+    SymbolType *ElementType();
+
     SymbolType *type;
     Node *beg;
     Node *end;
+    long long low = 0;
+    long long high = -1;
+    bool packed = false;
 };
 
 class SymbolVar : public Symbol {
@@ -165,6 +191,8 @@ public:
 
     virtual std::string GetClass() { return "variable"; }
 
+    std::string GetDetails() override;
+
     SymbolType *type;
 };
 
@@ -202,10 +230,16 @@ public:
     ~SymbolConst() = default;
 
     virtual std::string GetClass() { return "const"; }
+
+    std::string GetDetails() override;
+
+    std::optional<ConstValue> value;
 };
 
 class NodeCompoundStatement;
 
+class SymbolParam;
+
 class SymbolProcedure : public SymbolType {
 public:
     SymbolProcedure(std::string name, SymbolTable *locals, NodeCompoundStatement *body) : SymbolType(name),
@@ -216,6 +250,8 @@ public:
 
     int GetCountOfArguments();
 
+    std::vector<SymbolParam *> GetParams();
+
     virtual std::string GetClass() { return "procedure"; }
 
     SymbolTable *locals;
@@ -267,11 +303,4 @@ public:
 
 };
 
-const auto SYM_INTEGER = new SymbolInteger();
-const auto SYM_DOUBLE = new SymbolDouble();
-const auto SYM_BOOLEAN = new SymbolBoolean();
-const auto SYM_CHAR = new SymbolChar();
-const auto SYM_STRING = new SymbolString();
-
-
 #endif // COMPILER_SYMBOL_H
@@ -0,0 +1,11 @@
+#ifndef COMPILER_VALUE_H
+#define COMPILER_VALUE_H
+
+#include <string>
+#include <variant>
+
+typedef std::variant<long long, double, bool, std::string> ConstValue;
+
+std::string ConstValueToString(const ConstValue &value);
+
+#endif //COMPILER_VALUE_H
@@ -14,6 +14,33 @@ int main(int argc, char **argv) {
     if (CheckArg(argc, argv, "-s")) {
         res += SemanticTester("../tests/semantic").RunTests();
     }
+    if (CheckArg(argc, argv, "-i")) {
+        res += IncrementalTester("../tests/incremental").RunTests();
+    }
+    if (CheckArg(argc, argv, "-d")) {
+        res += IrTester("../tests/ir").RunTests();
+    }
+    if (CheckArg(argc, argv, "-g")) {
+        res += LoopTester("../tests/loops").RunTests();
+    }
+    if (CheckArg(argc, argv, "-f")) {
+        res += DataflowTester("../tests/dataflow").RunTests();
+    }
+    if (CheckArg(argc, argv, "-o")) {
+        res += OptTester("../tests/opt").RunTests();
+    }
+    if (CheckArg(argc, argv, "-r")) {
+        res += RunTester("../tests/run").RunTests();
+    }
+    if (CheckArg(argc, argv, "-m")) {
+        res += ParallelTester("../tests/parallel").RunTests();
+    }
+    if (CheckArg(argc, argv, "-O")) {
+        res += LevelTester("../tests/levels").RunTests();
+    }
+    if (CheckArg(argc, argv, "-n")) {
+        res += NativeTester("../tests/run").RunTests();
+    }
     std::cout << res;
     return 0;
 }
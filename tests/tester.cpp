@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include "tester.h"
@@ -5,6 +6,18 @@
 #include "../lexer/lexer.h"
 #include "../parser/parser.h"
 #include "../semantic/semantic.h"
+#include "../semantic/incremental.h"
+#include "../context/context.h"
+#include "../ir/builder.h"
+#include "../ir/dataflow.h"
+#include "../ir/loops.h"
+#include "../ir/optimizer.h"
+#include "../ir/verifier.h"
+#include "../vm/compiler.h"
+#include "../vm/vm.h"
+#include "../interpreter/interpreter.h"
+#include "../codegen/assembly.h"
+#include "../jit/jit.h"
 
 TestResult &TestResult::operator+=(const TestResult &res) {
     counter_all += res.counter_all;
@@ -119,10 +132,31 @@ std::string ReadFile(const std::string &path) {
     return buffer.str();
 }
 
+bool GoldenTester::RunTest(const std::string &file) {
+    std::ifstream file_out(file + ".out");
+    if (!file_out.good()) {
+        std::ofstream(file + ".out") << Answer(file);
+        return true;
+    }
+    file_out.close();
+
+    auto out_file_content = ReadFile(file + ".out");
+    auto answer = Answer(file);
+    if (answer == out_file_content) {
+        std::cout << "OK\n";
+        return true;
+    }
+    std::cout << "FAILED\n";
+    std::cout << "Out file: \n" << out_file_content << "\n";
+    std::cout << label << ": \n" << answer << "\n";
+    return false;
+}
+
 bool ParserTester::RunTest(const std::string &file) {
     auto stream = std::ifstream(file + ".in");
     Lexer lexer(stream);
-    Parser parser(lexer);
+    CompilationContext context;
+    Parser parser(lexer, context);
 
     std::ifstream file_out(file + ".out");
 
@@ -172,8 +206,9 @@ bool ParserTester::RunTest(const std::string &file) {
 bool SemanticTester::RunTest(const std::string &file) {
     auto stream = std::ifstream(file + ".in");
     Lexer lexer(stream);
-    Parser parser(lexer);
-    Semantic *semantic_visitor = new Semantic();
+    CompilationContext context;
+    Parser parser(lexer, context);
+    Semantic semantic(&context);
 
     std::ifstream file_out(file + ".out");
 
@@ -185,10 +220,10 @@ bool SemanticTester::RunTest(const std::string &file) {
         try {
             std::stringstream parser_answer;
             auto program = parser.Program();
-            program->Accept(semantic_visitor);
+            program->Accept(&semantic);
             program->DrawTree(parser_answer, 1);
             parser_answer << "\n";
-            semantic_visitor->GetStack().Draw(parser_answer);
+            semantic.GetStack().Draw(parser_answer);
             file_out_new << parser_answer.str();
         } catch (SemanticException &err) {
             file_out_new << err.what();
@@ -201,10 +236,10 @@ bool SemanticTester::RunTest(const std::string &file) {
     try {
         std::stringstream parser_answer;
         auto program = parser.Program();
-        program->Accept(semantic_visitor);
+        program->Accept(&semantic);
         program->DrawTree(parser_answer, 1);
         parser_answer << "\n";
-        semantic_visitor->GetStack().Draw(parser_answer);
+        semantic.GetStack().Draw(parser_answer);
 
         if (parser_answer.str() == out_file_content) {
             std::cout << "OK\n";
@@ -227,3 +262,264 @@ bool SemanticTester::RunTest(const std::string &file) {
 
     return is_success;
 }
+
+std::string IncrementalTester::Answer(const std::string &file) {
+    std::vector<std::string> versions(1);
+    std::ifstream in(file + ".in");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line == "----") {
+            versions.emplace_back();
+        } else {
+            versions.back() += line + "\n";
+        }
+    }
+
+    CompilationContext context;
+    IncrementalSemantic semantic(&context);
+    std::stringstream answer;
+    auto version_path = (std::filesystem::temp_directory_path() / "incremental_version.in").string();
+    for (auto &version: versions) {
+        std::ofstream(version_path) << version;
+        auto stream = std::ifstream(version_path);
+        Lexer lexer(stream);
+        Parser parser(lexer, context);
+        try {
+            semantic.Update(parser.Program());
+            answer << "revision " << semantic.revision << ": checked " << semantic.checked
+                   << ", reused " << semantic.reused << "\n";
+            semantic.GetStack().Draw(answer);
+        } catch (SemanticException &err) {
+            answer << "revision " << semantic.revision << ": " << err.what() << "\n";
+        }
+    }
+    return answer.str();
+}
+
+std::string RunTester::Answer(const std::string &file, Engine engine) {
+    auto stream = std::ifstream(file + ".in");
+    Lexer lexer(stream);
+    CompilationContext context;
+    Parser parser(lexer, context);
+    std::stringstream input;
+    std::stringstream output;
+    try {
+        auto program = parser.Program();
+        Semantic semantic(&context);
+        program->Accept(&semantic);
+        if (engine == Engine::Interpreter) {
+            Interpreter(input, output).Run(program);
+        } else if (engine == Engine::VM) {
+            VM(BytecodeCompiler(&context).Compile(Optimize(BuildSsa(&context, program))), input, output).Run();
+        } else {
+            JIT jit(BytecodeCompiler(&context).Compile(Optimize(BuildSsa(&context, program))), input, output);
+            if (!jit.Compile()) {
+                output << "jit: " << jit.reason;
+                return output.str();
+            }
+            jit.Run();
+        }
+    } catch (ParserException &err) {
+        output << err.what();
+    } catch (SemanticException &err) {
+        output << err.what();
+    } catch (RuntimeException &err) {
+        output << err.what();
+    }
+    return output.str();
+}
+
+bool RunTester::RunTest(const std::string &file) {
+    std::ifstream file_out(file + ".out");
+    if (!file_out.good()) {
+        std::ofstream(file + ".out") << Answer(file, Engine::VM);
+        return true;
+    }
+    file_out.close();
+
+    auto out_file_content = ReadFile(file + ".out");
+    auto vm_answer = Answer(file, Engine::VM);
+    auto interpreter_answer = Answer(file, Engine::Interpreter);
+    auto jit_answer = Answer(file, Engine::JIT);
+    if (vm_answer == out_file_content && interpreter_answer == out_file_content && jit_answer == out_file_content) {
+        std::cout << "OK\n";
+        return true;
+    }
+    std::cout << "FAILED\n";
+    std::cout << "Out file: \n" << out_file_content << "\n";
+    std::cout << "VM: \n" << vm_answer << "\n";
+    std::cout << "Interpreter: \n" << interpreter_answer << "\n";
+    std::cout << "JIT: \n" << jit_answer << "\n";
+    return false;
+}
+
+std::string IrTester::Answer(const std::string &file) {
+    auto stream = std::ifstream(file + ".in");
+    Lexer lexer(stream);
+    CompilationContext context;
+    Parser parser(lexer, context);
+    std::stringstream output;
+    auto program = parser.Program();
+    Semantic semantic(&context);
+    program->Accept(&semantic);
+    auto module = BuildSsa(&context, program);
+    module->Dump(output);
+    for (auto &error: Verify(module)) {
+        output << "verifier: " << error << "\n";
+    }
+    return output.str();
+}
+
+std::string LoopTester::Answer(const std::string &file) {
+    auto stream = std::ifstream(file + ".in");
+    Lexer lexer(stream);
+    CompilationContext context;
+    Parser parser(lexer, context);
+    std::stringstream output;
+    auto program = parser.Program();
+    Semantic semantic(&context);
+    program->Accept(&semantic);
+    for (auto function: BuildSsa(&context, program)->functions) {
+        Analyses analyses(function);
+        analyses.Get<LoopForest>().Dump(output);
+    }
+    return output.str();
+}
+
+std::string DataflowTester::Answer(const std::string &file) {
+    auto stream = std::ifstream(file + ".in");
+    Lexer lexer(stream);
+    CompilationContext context;
+    Parser parser(lexer, context);
+    std::stringstream output;
+    auto program = parser.Program();
+    Semantic semantic(&context);
+    program->Accept(&semantic);
+    for (auto function: BuildSsa(&context, program)->functions) {
+        Analyses analyses(function);
+        DumpDataflow(output, function, analyses);
+    }
+    return output.str();
+}
+
+std::string OptTester::Answer(const std::string &file) {
+    auto stream = std::ifstream(file + ".in");
+    Lexer lexer(stream);
+    CompilationContext context;
+    Parser parser(lexer, context);
+    std::stringstream output;
+    auto program = parser.Program();
+    Semantic semantic(&context);
+    program->Accept(&semantic);
+    Statistics stats;
+    auto module = Optimize(BuildSsa(&context, program), &stats);
+    module->Dump(output);
+    for (auto &error: Verify(module)) {
+        output << "verifier: " << error << "\n";
+    }
+    stats.Print(output);
+    return output.str();
+}
+
+std::string ParallelTester::Answer(const std::string &file) {
+    auto stream = std::ifstream(file + ".in");
+    Lexer lexer(stream);
+    CompilationContext context;
+    Parser parser(lexer, context);
+    auto program = parser.Program();
+    Semantic semantic(&context);
+    program->Accept(&semantic);
+    std::stringstream output;
+    OptimizerOptions options;
+    options.parallelize = true;
+    options.report = &output;
+    auto bytecode = BytecodeCompiler(&context).Compile(Optimize(BuildSsa(&context, program), nullptr, options));
+    std::stringstream input, vm_output, jit_output;
+    VM vm(bytecode, input, vm_output);
+    vm.threads = 4;
+    vm.Run();
+    JIT jit(bytecode, input, jit_output);
+    jit.threads = 4;
+    if (jit.Compile()) {
+        jit.Run();
+        if (jit_output.str() != vm_output.str()) {
+            output << "jit:\n" << jit_output.str();
+        }
+    }
+    output << vm_output.str();
+    return output.str();
+}
+
+std::string LevelTester::Answer(const std::string &file) {
+    std::stringstream output;
+    std::vector<std::string> outputs;
+    for (int level = 0; level <= 2; ++level) {
+        auto stream = std::ifstream(file + ".in");
+        Lexer lexer(stream);
+        CompilationContext context;
+        Parser parser(lexer, context);
+        auto program = parser.Program();
+        Semantic semantic(&context);
+        program->Accept(&semantic);
+        OptimizerOptions options;
+        options.level = level;
+        auto module = Optimize(BuildSsa(&context, program), nullptr, options);
+        size_t insts = 0;
+        for (auto function: module->functions) {
+            for (auto block: function->blocks) {
+                insts += block->insts.size();
+            }
+        }
+        output << "-O" << level << ": " << insts << " instructions\n";
+        for (auto &error: Verify(module)) {
+            output << "verifier: " << error << "\n";
+        }
+        std::stringstream input, vm_output;
+        try {
+            VM(BytecodeCompiler(&context).Compile(module), input, vm_output).Run();
+        } catch (RuntimeException &err) {
+            vm_output << err.what();
+        }
+        outputs.push_back(vm_output.str());
+    }
+    for (int level = 1; level <= 2; ++level) {
+        if (outputs[level] != outputs[0]) {
+            output << "-O" << level << " prints:\n" << outputs[level] << "\n";
+        }
+    }
+    output << outputs[0];
+    return output.str();
+}
+
+bool NativeTester::RunTest(const std::string &file) {
+    auto stream = std::ifstream(file + ".in");
+    Lexer lexer(stream);
+    CompilationContext context;
+    Parser parser(lexer, context);
+    auto program = parser.Program();
+    Semantic semantic(&context);
+    program->Accept(&semantic);
+
+    auto executable = (std::filesystem::temp_directory_path() /
+                       ("native_" + std::filesystem::path(file).filename().string())).string();
+    if (BuildExecutable(BytecodeCompiler(&context).Compile(Optimize(BuildSsa(&context, program))), executable) != 0) {
+        std::cout << "FAILED\nBuild failed\n";
+        return false;
+    }
+    auto command = "'" + executable + "' < /dev/null > '" + executable + ".txt'";
+    auto status = std::system(command.c_str());
+    auto native_answer = ReadFile(executable + ".txt");
+    auto out_file_content = ReadFile(file + ".out");
+    // A run-time error ends the line the message is printed on.
+    if (status != 0) {
+        out_file_content += "\n";
+    }
+    if (native_answer == out_file_content) {
+        std::cout << "OK\n";
+        return true;
+    }
+    std::cout << "FAILED\n";
+    std::cout << "Out file: \n" << out_file_content << "\n";
+    std::cout << "Native: \n" << native_answer << "\n";
+    return false;
+}
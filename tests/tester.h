@@ -2,6 +2,8 @@
 #define COMPILER_TESTER_H
 
 #include <iostream>
+#include <string>
+#include <utility>
 #include <vector>
 
 class TestResult {
@@ -36,6 +38,21 @@ protected:
     std::vector<std::string> FilesToVector();
 };
 
+// Compares what Answer gives for file.in with file.out, and writes it there
+// when there is no file.out yet; label names the answer printed on failure.
+class GoldenTester : public Tester {
+public:
+    GoldenTester(std::string &path, std::string label) : Tester(path), label(std::move(label)) {}
+
+    bool RunTest(const std::string &file) override;
+
+protected:
+    virtual std::string Answer(const std::string &file) = 0;
+
+private:
+    std::string label;
+};
+
 class LexerTester : public Tester {
 public:
     explicit LexerTester(std::string path) : Tester(path) {}
@@ -57,4 +74,87 @@ public:
     bool RunTest(const std::string &file) override;
 };
 
+class IncrementalTester : public GoldenTester {
+public:
+    explicit IncrementalTester(std::string path) : GoldenTester(path, "Incremental") {}
+
+private:
+    std::string Answer(const std::string &file) override;
+};
+
+class RunTester : public Tester {
+public:
+    explicit RunTester(std::string path) : Tester(path) {}
+
+    bool RunTest(const std::string &file) override;
+
+private:
+    enum class Engine {
+        Interpreter,
+        VM,
+        JIT
+    };
+
+    std::string Answer(const std::string &file, Engine engine);
+};
+
+class IrTester : public GoldenTester {
+public:
+    explicit IrTester(std::string path) : GoldenTester(path, "IR") {}
+
+private:
+    std::string Answer(const std::string &file) override;
+};
+
+class LoopTester : public GoldenTester {
+public:
+    explicit LoopTester(std::string path) : GoldenTester(path, "Loops") {}
+
+private:
+    std::string Answer(const std::string &file) override;
+};
+
+class DataflowTester : public GoldenTester {
+public:
+    explicit DataflowTester(std::string path) : GoldenTester(path, "Dataflow") {}
+
+private:
+    std::string Answer(const std::string &file) override;
+};
+
+class OptTester : public GoldenTester {
+public:
+    explicit OptTester(std::string path) : GoldenTester(path, "Optimized") {}
+
+private:
+    std::string Answer(const std::string &file) override;
+};
+
+// Parallelizes the loops it can and runs the program on the vm and the jit
+// with several threads, which have to agree.
+class ParallelTester : public GoldenTester {
+public:
+    explicit ParallelTester(std::string path) : GoldenTester(path, "Parallel") {}
+
+private:
+    std::string Answer(const std::string &file) override;
+};
+
+// Optimizes the program at every level and runs it on the vm, which has to
+// print the same at all of them.
+class LevelTester : public GoldenTester {
+public:
+    explicit LevelTester(std::string path) : GoldenTester(path, "Levels") {}
+
+private:
+    std::string Answer(const std::string &file) override;
+};
+
+class NativeTester : public Tester {
+public:
+    explicit NativeTester(std::string path) : Tester(path) {}
+
+    bool RunTest(const std::string &file) override;
+};
+
 #endif //COMPILER_TESTER_H
@@ -0,0 +1,81 @@
+#include "bytecode.h"
+
+#include <iomanip>
+
+const char *OpcodeName(Opcode op) {
+    static const char *names[] = {
+#define OPCODE_NAME(name) #name,
+            OPCODES(OPCODE_NAME)
+#undef OPCODE_NAME
+    };
+    return names[(int) op];
+}
+
+int Program::AddConstant(Value value) {
+    auto it = numbers.find(value.i);
+    if (it != numbers.end()) {
+        return it->second;
+    }
+    constants.push_back(value);
+    return numbers[value.i] = (int) constants.size() - 1;
+}
+
+int Program::AddString(const std::string &value) {
+    auto it = string_constants.find(value);
+    if (it != string_constants.end()) {
+        return it->second;
+    }
+    strings.push_back(value);
+    Value constant{};
+    constant.s = &strings.back();
+    constants.push_back(constant);
+    return string_constants[value] = (int) constants.size() - 1;
+}
+
+Divisor MakeDivisor(long long divisor) {
+    auto d = divisor < 0 ? 0 - (unsigned long long) divisor : (unsigned long long) divisor;
+    if ((d & (d - 1)) == 0) {
+        return {divisor, 0, __builtin_ctzll(d)};
+    }
+    const unsigned long long two63 = 1ULL << 63;
+    auto anc = two63 - 1 - two63 % d;
+    auto q1 = two63 / anc, r1 = two63 - q1 * anc;
+    auto q2 = two63 / d, r2 = two63 - q2 * d;
+    int p = 63;
+    unsigned long long delta;
+    do {
+        ++p;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            ++q1;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= d) {
+            ++q2;
+            r2 -= d;
+        }
+        delta = d - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    return {divisor, (long long) (q2 + 1), p - 64};
+}
+
+void Program::Dump(std::ostream &os) {
+    for (size_t f = 0; f < functions.size(); ++f) {
+        auto &function = functions[f];
+        auto end = f + 1 < functions.size() ? functions[f + 1].entry : (int) code.size();
+        os << function.name << ": params " << function.params << ", registers " << function.registers
+           << ", memory " << function.memory << "\n";
+        for (auto i = function.entry; i < end; ++i) {
+            auto &instruction = code[i];
+            os << std::setw(6) << std::right << i << "  " << std::setw(9) << std::left << OpcodeName(instruction.op)
+               << instruction.a << " " << instruction.b << " " << instruction.c << " " << instruction.d << "\n";
+        }
+    }
+    for (size_t i = 0; i < kernels.size(); ++i) {
+        os << "kernel " << i << ": " << kernels[i].ToString() << "\n";
+    }
+    os << "globals: " << globals << "\n";
+}
@@ -0,0 +1,136 @@
+#ifndef COMPILER_BYTECODE_H
+#define COMPILER_BYTECODE_H
+
+#include <deque>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "value.h"
+#include "../ir/kernel.h"
+
+// Register bytecode. Operands a, b, c, d are register numbers unless noted:
+//   LOADK a k        a = constants[k]
+//   LOADG a g        a = globals[g]              STOREG g a   globals[g] = a
+//   LOADL a l        a = frame memory[l]         STOREL l a   frame memory[l] = a
+//   ADDRG a g        a = &globals[g]             ADDRL a l    a = &frame memory[l]
+//   LOAD a p k       a = p[k]                    STORE p k a  p[k] = a
+//   ADDP a p k       a = p + k
+//   INDEX a p i k    a = p + (i - low) * stride, checked against arrays[k]
+//   INDEXU a p i k   the same for an index known to be in range
+//   COPY a p k       copies k slots from p to a
+//   ADDKI a b k      a = b + k
+//   DIVKI a b k      a = b div divisors[k]       MODKI a b k  a = b mod divisors[k]
+//   JMP t / JZ a t / JNZ a t                      jump to instruction t
+//   CALL f b         calls functions[f] with its registers starting at b;
+//                    the result is left in b
+//   TAILCALL f b     calls functions[f] with the registers from b as its
+//                    params in place of the running function, which
+//                    returns what it does
+//   VECTOR b k       runs kernels[k] over the registers from b: the count,
+//                    the streams, the params and the initial sum; the sum is
+//                    left in b
+//   RET a            returns register a (-1 for procedures)
+#define OPCODES(X) \
+    X(MOVE) X(LOADK) X(LOADG) X(STOREG) X(LOADL) X(STOREL) X(ADDRG) X(ADDRL) \
+    X(LOAD) X(STORE) X(ADDP) X(INDEX) X(INDEXU) X(COPY) \
+    X(ADDI) X(SUBI) X(MULI) X(DIVI) X(MODI) X(SHLI) X(SHRI) X(ANDI) X(ORI) X(XORI) \
+    X(NEGI) X(NOTI) X(ADDKI) X(DIVKI) X(MODKI) \
+    X(ADDD) X(SUBD) X(MULD) X(DIVD) X(NEGD) X(ITOD) \
+    X(NOTB) X(CONCAT) \
+    X(EQI) X(NEI) X(LTI) X(LEI) X(GTI) X(GEI) \
+    X(EQD) X(NED) X(LTD) X(LED) X(GTD) X(GED) \
+    X(EQS) X(NES) X(LTS) X(LES) X(GTS) X(GES) \
+    X(JMP) X(JZ) X(JNZ) X(CALL) X(TAILCALL) X(VECTOR) X(RET) X(HALT) \
+    X(WRITEI) X(WRITED) X(WRITEB) X(WRITEC) X(WRITES) X(WRITELN) \
+    X(READI) X(READD) X(READC) X(READS)
+
+enum class Opcode {
+#define OPCODE_ENUM(name) name,
+    OPCODES(OPCODE_ENUM)
+#undef OPCODE_ENUM
+};
+
+const char *OpcodeName(Opcode op);
+
+struct Instruction {
+    Opcode op;
+    int a = 0, b = 0, c = 0, d = 0;
+    const void *handler = nullptr;
+};
+
+struct ArrayInfo {
+    long long low;
+    long long count;
+    long long stride;
+};
+
+// A constant divisor, neither 0 nor the minimum integer, with the magic
+// multiplier and shift that divide by it through the high half of a product
+// (Hacker's Delight, 10-4). A power of two has no multiplier and shifts by
+// its exponent.
+struct Divisor {
+    long long divisor;
+    long long multiplier;
+    int shift;
+};
+
+Divisor MakeDivisor(long long divisor);
+
+// x div d, rounded towards zero like a division instruction.
+inline long long Quotient(const Divisor &d, long long x) {
+    auto u = (unsigned long long) x;
+    long long q = x;
+    if (d.multiplier == 0) {
+        if (d.shift != 0) {
+            auto bias = (unsigned long long) (x >> 63) >> (64 - d.shift);
+            q = (long long) (u + bias) >> d.shift;
+        }
+    } else {
+        q = (long long) (((__int128) x * d.multiplier) >> 64);
+        if (d.multiplier < 0) {
+            q = (long long) ((unsigned long long) q + u);
+        }
+        q = (q >> d.shift) + (long long) (u >> 63);
+    }
+    return d.divisor < 0 ? (long long) (0 - (unsigned long long) q) : q;
+}
+
+inline long long Remainder(const Divisor &d, long long x) {
+    return (long long) ((unsigned long long) x - (unsigned long long) Quotient(d, x) * (unsigned long long) d.divisor);
+}
+
+struct Function {
+    std::string name;
+    int entry = 0;
+    int params = 0;
+    int registers = 0;
+    int memory = 0;
+};
+
+class Program {
+public:
+    int AddConstant(Value value);
+
+    int AddString(const std::string &value);
+
+    void Dump(std::ostream &os);
+
+    std::vector<Instruction> code;
+    std::vector<Position> positions;
+    std::vector<Function> functions;
+    std::vector<Value> constants;
+    std::deque<std::string> strings;
+    std::vector<ArrayInfo> arrays;
+    std::vector<Divisor> divisors;
+    std::vector<Kernel> kernels;
+    int globals = 0;
+    int main = 0;
+
+private:
+    std::map<long long, int> numbers;
+    std::map<std::string, int> string_constants;
+};
+
+#endif //COMPILER_BYTECODE_H
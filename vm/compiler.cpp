@@ -0,0 +1,464 @@
+#include "compiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static Opcode CompareOpcode(IrOp op, Pred pred) {
+    static const Opcode integer[] = {Opcode::EQI, Opcode::NEI, Opcode::LTI, Opcode::LEI, Opcode::GTI, Opcode::GEI};
+    static const Opcode real[] = {Opcode::EQD, Opcode::NED, Opcode::LTD, Opcode::LED, Opcode::GTD, Opcode::GED};
+    static const Opcode string[] = {Opcode::EQS, Opcode::NES, Opcode::LTS, Opcode::LES, Opcode::GTS, Opcode::GES};
+    switch (op) {
+        case IrOp::FCmp:
+            return real[(int) pred];
+        case IrOp::SCmp:
+            return string[(int) pred];
+        default:
+            return integer[(int) pred];
+    }
+}
+
+static Opcode Arithmetic(IrOp op) {
+    switch (op) {
+        case IrOp::Add:
+            return Opcode::ADDI;
+        case IrOp::Sub:
+            return Opcode::SUBI;
+        case IrOp::Mul:
+            return Opcode::MULI;
+        case IrOp::Div:
+            return Opcode::DIVI;
+        case IrOp::Mod:
+            return Opcode::MODI;
+        case IrOp::Shl:
+            return Opcode::SHLI;
+        case IrOp::Shr:
+            return Opcode::SHRI;
+        case IrOp::And:
+            return Opcode::ANDI;
+        case IrOp::Or:
+            return Opcode::ORI;
+        case IrOp::Xor:
+            return Opcode::XORI;
+        case IrOp::Neg:
+            return Opcode::NEGI;
+        case IrOp::Not:
+            return Opcode::NOTI;
+        case IrOp::FAdd:
+            return Opcode::ADDD;
+        case IrOp::FSub:
+            return Opcode::SUBD;
+        case IrOp::FMul:
+            return Opcode::MULD;
+        case IrOp::FDiv:
+            return Opcode::DIVD;
+        case IrOp::FNeg:
+            return Opcode::NEGD;
+        case IrOp::IToF:
+            return Opcode::ITOD;
+        case IrOp::LNot:
+            return Opcode::NOTB;
+        default:
+            return Opcode::CONCAT;
+    }
+}
+
+// The constant an add or subtract folds into ADDKI, if any.
+static bool ImmediateOf(Inst *inst, long long &immediate) {
+    if ((inst->op != IrOp::Add && inst->op != IrOp::Sub) || !inst->Operand(1)->IsConstant()) {
+        return false;
+    }
+    immediate = inst->op == IrOp::Sub ? -inst->Operand(1)->imm : inst->Operand(1)->imm;
+    return immediate > INT32_MIN && immediate < INT32_MAX;
+}
+
+// Whether a division or modulo is by a constant DIVKI and MODKI can take.
+static bool IsConstantDivision(Inst *inst) {
+    if ((inst->op != IrOp::Div && inst->op != IrOp::Mod) || !inst->Operand(1)->IsConstant()) {
+        return false;
+    }
+    auto divisor = inst->Operand(1)->imm;
+    return divisor != 0 && divisor != INT64_MIN;
+}
+
+static bool IsAddress(Inst *value) {
+    return value->op == IrOp::Global || value->op == IrOp::Alloca || value->op == IrOp::Offset;
+}
+
+// The phi a value can be computed into directly: the value only feeds the
+// phi, its block only continues to the phi's block and the old value of the
+// phi is not read after it there, as with the step of a loop counter.
+static Inst *CoalescedPhi(Inst *value) {
+    if (value->block == nullptr || value->op == IrOp::Phi || value->op == IrOp::Alloca ||
+        value->users.size() != 1 || value->users[0]->op != IrOp::Phi) {
+        return nullptr;
+    }
+    auto phi = value->users[0];
+    auto block = value->block;
+    if (block->succs.size() != 1 || block->succs[0] != phi->block || phi->block == block) {
+        return nullptr;
+    }
+    auto it = std::find(block->insts.begin(), block->insts.end(), value);
+    for (++it; it != block->insts.end(); ++it) {
+        if (std::find((*it)->operands.begin(), (*it)->operands.end(), phi) != (*it)->operands.end()) {
+            return nullptr;
+        }
+    }
+    return phi;
+}
+
+bool BytecodeCompiler::IsFolded(Inst *value) const {
+    if (!value->IsConstant() && !IsAddress(value)) {
+        return false;
+    }
+    for (auto user: value->users) {
+        for (size_t i = 0; i < user->operands.size(); ++i) {
+            if (user->operands[i] != value) {
+                continue;
+            }
+            long long immediate;
+            bool folded = user->op == IrOp::Call || user->op == IrOp::Vector || user->op == IrOp::Phi ||
+                          (value->IsConstant() && i == 1 &&
+                           (ImmediateOf(user, immediate) || IsConstantDivision(user))) ||
+                          (IsAddress(value) && i == 0 &&
+                           (user->op == IrOp::Load || user->op == IrOp::Store || user->op == IrOp::Offset));
+            if (!folded) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int BytecodeCompiler::Emit(Opcode op, int a, int b, int c, int d, Position pos) {
+    program->code.push_back({op, a, b, c, d});
+    program->positions.push_back(pos);
+    return (int) program->code.size() - 1;
+}
+
+void BytecodeCompiler::Jump(Opcode op, int a, ::Block *target) {
+    fixups.emplace_back(Emit(op, a), target);
+}
+
+int BytecodeCompiler::Reg(Inst *value) {
+    auto it = registers.find(value);
+    if (it == registers.end()) {
+        throw std::logic_error(std::string("no register for ") + IrOpName(value->op));
+    }
+    return it->second;
+}
+
+BytecodeCompiler::Place BytecodeCompiler::PlaceOf(Inst *pointer) {
+    switch (pointer->op) {
+        case IrOp::Global:
+            return {Place::Global, (int) pointer->imm};
+        case IrOp::Alloca:
+            return {Place::Local, slots.at(pointer)};
+        case IrOp::Offset: {
+            auto place = PlaceOf(pointer->Operand(0));
+            if (place.kind == Place::Memory) {
+                place.offset += (int) pointer->imm;
+            } else {
+                place.index += (int) pointer->imm;
+            }
+            return place;
+        }
+        default:
+            return {Place::Memory, Reg(pointer)};
+    }
+}
+
+void BytecodeCompiler::Materialize(Inst *value, int target) {
+    if (value->IsConstant()) {
+        Value constant{};
+        constant.i = value->imm;
+        auto index = value->type == IrType::String ? program->AddString(*value->text) : program->AddConstant(constant);
+        Emit(Opcode::LOADK, target, index);
+        return;
+    }
+    if (!IsAddress(value)) {
+        if (Reg(value) != target) {
+            Emit(Opcode::MOVE, target, Reg(value));
+        }
+        return;
+    }
+    auto place = PlaceOf(value);
+    switch (place.kind) {
+        case Place::Global:
+            Emit(Opcode::ADDRG, target, place.index);
+            break;
+        case Place::Local:
+            Emit(Opcode::ADDRL, target, place.index);
+            break;
+        default:
+            if (place.offset != 0) {
+                Emit(Opcode::ADDP, target, place.index, place.offset);
+            } else if (place.index != target) {
+                Emit(Opcode::MOVE, target, place.index);
+            }
+    }
+}
+
+void BytecodeCompiler::Moves(::Block *from, ::Block *to) {
+    for (size_t i = 0; i < to->preds.size(); ++i) {
+        if (to->preds[i] != from) {
+            continue;
+        }
+        for (auto phi: to->Phis()) {
+            auto in = incoming.find(phi);
+            auto target = in != incoming.end() ? in->second : Reg(phi);
+            if (phi->Operand(i) != phi || in != incoming.end()) {
+                Materialize(phi->Operand(i), target);
+            }
+        }
+        return;
+    }
+}
+
+void BytecodeCompiler::Instruction(Inst *inst) {
+    auto pos = inst->pos;
+    switch (inst->op) {
+        case IrOp::Alloca:
+        case IrOp::Phi:
+            return;
+        case IrOp::Offset:
+            if (registers.count(inst)) {
+                Materialize(inst, Reg(inst));
+            }
+            return;
+        case IrOp::Element:
+            program->arrays.push_back({inst->imm, inst->imm2, inst->imm3});
+            Emit(inst->checked ? Opcode::INDEX : Opcode::INDEXU, Reg(inst), Reg(inst->Operand(0)), Reg(inst->Operand(1)),
+                 (int) program->arrays.size() - 1, pos);
+            return;
+        case IrOp::Load: {
+            auto place = PlaceOf(inst->Operand(0));
+            switch (place.kind) {
+                case Place::Global:
+                    Emit(Opcode::LOADG, Reg(inst), place.index);
+                    break;
+                case Place::Local:
+                    Emit(Opcode::LOADL, Reg(inst), place.index);
+                    break;
+                default:
+                    Emit(Opcode::LOAD, Reg(inst), place.index, place.offset);
+            }
+            return;
+        }
+        case IrOp::Store: {
+            auto place = PlaceOf(inst->Operand(0));
+            auto value = Reg(inst->Operand(1));
+            switch (place.kind) {
+                case Place::Global:
+                    Emit(Opcode::STOREG, place.index, value);
+                    break;
+                case Place::Local:
+                    Emit(Opcode::STOREL, place.index, value);
+                    break;
+                default:
+                    Emit(Opcode::STORE, place.index, place.offset, value);
+            }
+            return;
+        }
+        case IrOp::Copy:
+            Emit(Opcode::COPY, Reg(inst->Operand(0)), Reg(inst->Operand(1)), (int) inst->imm);
+            return;
+        case IrOp::Cmp:
+        case IrOp::FCmp:
+        case IrOp::SCmp:
+            Emit(CompareOpcode(inst->op, inst->pred), Reg(inst), Reg(inst->Operand(0)), Reg(inst->Operand(1)), 0, pos);
+            return;
+        case IrOp::Call:
+            for (size_t i = 0; i < inst->operands.size(); ++i) {
+                Materialize(inst->Operand(i), base + (int) i);
+            }
+            if (inst->tail) {
+                Emit(Opcode::TAILCALL, functions.at(inst->callee), base, 0, 0, pos);
+                return;
+            }
+            Emit(Opcode::CALL, functions.at(inst->callee), base, 0, 0, pos);
+            if (registers.count(inst)) {
+                Emit(Opcode::MOVE, Reg(inst), base);
+            }
+            return;
+        case IrOp::Vector:
+            for (size_t i = 0; i < inst->operands.size(); ++i) {
+                Materialize(inst->Operand(i), base + (int) i);
+            }
+            program->kernels.push_back(*inst->kernel);
+            Emit(Opcode::VECTOR, base, (int) program->kernels.size() - 1, 0, 0, pos);
+            if (registers.count(inst)) {
+                Emit(Opcode::MOVE, Reg(inst), base);
+            }
+            return;
+        case IrOp::Read: {
+            static const Opcode reads[] = {Opcode::READI, Opcode::READD, Opcode::READI, Opcode::READC, Opcode::READS};
+            Emit(reads[(int) inst->kind], Reg(inst));
+            return;
+        }
+        case IrOp::Write: {
+            static const Opcode writes[] = {Opcode::WRITEI, Opcode::WRITED, Opcode::WRITEB, Opcode::WRITEC,
+                                            Opcode::WRITES};
+            Emit(writes[(int) inst->kind], Reg(inst->Operand(0)));
+            return;
+        }
+        case IrOp::WriteLn:
+            Emit(Opcode::WRITELN);
+            return;
+        default:
+            break;
+    }
+    long long immediate;
+    if (ImmediateOf(inst, immediate)) {
+        Emit(Opcode::ADDKI, Reg(inst), Reg(inst->Operand(0)), (int) immediate);
+    } else if (IsConstantDivision(inst)) {
+        program->divisors.push_back(MakeDivisor(inst->Operand(1)->imm));
+        Emit(inst->op == IrOp::Div ? Opcode::DIVKI : Opcode::MODKI, Reg(inst), Reg(inst->Operand(0)),
+             (int) program->divisors.size() - 1, 0, pos);
+    } else if (inst->operands.size() == 1) {
+        Emit(Arithmetic(inst->op), Reg(inst), Reg(inst->Operand(0)), 0, 0, pos);
+    } else {
+        Emit(Arithmetic(inst->op), Reg(inst), Reg(inst->Operand(0)), Reg(inst->Operand(1)), 0, pos);
+    }
+}
+
+void BytecodeCompiler::Block(::Block *block, ::Block *next) {
+    labels[block] = (int) program->code.size();
+    for (auto phi: block->Phis()) {
+        auto in = incoming.find(phi);
+        if (in != incoming.end()) {
+            Emit(Opcode::MOVE, Reg(phi), in->second);
+        }
+    }
+    auto terminator = block->Terminator();
+    for (auto inst: block->insts) {
+        if (inst != terminator) {
+            Instruction(inst);
+        }
+    }
+    for (auto succ: block->succs) {
+        Moves(block, succ);
+    }
+    switch (terminator->op) {
+        case IrOp::Jump:
+            if (block->succs[0] != next) {
+                Jump(Opcode::JMP, 0, block->succs[0]);
+            }
+            break;
+        case IrOp::Branch: {
+            auto then_block = terminator->targets[0];
+            auto else_block = terminator->targets[1];
+            auto condition = Reg(terminator->Operand(0));
+            if (then_block == else_block) {
+                if (then_block != next) {
+                    Jump(Opcode::JMP, 0, then_block);
+                }
+            } else if (then_block == next) {
+                Jump(Opcode::JZ, condition, else_block);
+            } else {
+                Jump(Opcode::JNZ, condition, then_block);
+                if (else_block != next) {
+                    Jump(Opcode::JMP, 0, else_block);
+                }
+            }
+            break;
+        }
+        default:
+            // After a tail call the callee returns in place of the function.
+            if (block->function == block->function->module->main) {
+                Emit(Opcode::HALT);
+            } else if (block->insts.size() < 2 || !block->insts[block->insts.size() - 2]->tail) {
+                Emit(Opcode::RET, terminator->operands.empty() ? -1 : Reg(terminator->Operand(0)));
+            }
+    }
+}
+
+void BytecodeCompiler::Function(IrFunction *ir, int index) {
+    function = &program->functions[index];
+    function->entry = (int) program->code.size();
+    function->params = (int) ir->params.size();
+    registers.clear();
+    incoming.clear();
+    slots.clear();
+    labels.clear();
+    fixups.clear();
+
+    int next = function->params;
+    for (size_t i = 0; i < ir->params.size(); ++i) {
+        registers[ir->params[i]] = (int) i;
+    }
+    std::vector<Inst *> prologue;
+    int window = 1;
+    for (auto block: ir->blocks) {
+        for (auto inst: block->insts) {
+            if (inst->op == IrOp::Alloca) {
+                slots[inst] = function->memory;
+                function->memory += (int) inst->imm;
+            }
+            if (inst->op == IrOp::Call || inst->op == IrOp::Vector) {
+                window = std::max(window, (int) inst->operands.size());
+            }
+            auto phi = CoalescedPhi(inst);
+            if (phi != nullptr && registers.count(phi) && !incoming.count(phi) && !IsFolded(inst)) {
+                registers[inst] = registers.at(phi);
+            } else if (inst->type != IrType::Void && !registers.count(inst) && !IsFolded(inst)) {
+                registers[inst] = next++;
+                if (inst->op == IrOp::Alloca) {
+                    prologue.push_back(inst);
+                }
+            }
+            for (auto operand: inst->operands) {
+                if ((operand->IsConstant() || operand->op == IrOp::Global) && !registers.count(operand) &&
+                    !IsFolded(operand)) {
+                    registers[operand] = next++;
+                    prologue.push_back(operand);
+                }
+            }
+        }
+        auto phis = block->Phis();
+        bool direct = true;
+        for (auto pred: block->preds) {
+            direct &= pred->succs.size() == 1;
+        }
+        for (auto phi: phis) {
+            for (auto operand: phi->operands) {
+                direct &= operand == phi || operand->op != IrOp::Phi || operand->block != block;
+            }
+        }
+        if (!direct) {
+            for (auto phi: phis) {
+                incoming[phi] = next++;
+            }
+        }
+    }
+    base = next;
+    function->registers = base + window;
+
+    for (auto value: prologue) {
+        Materialize(value, Reg(value));
+    }
+    for (size_t i = 0; i < ir->blocks.size(); ++i) {
+        Block(ir->blocks[i], i + 1 < ir->blocks.size() ? ir->blocks[i + 1] : nullptr);
+    }
+    for (auto &[jump, target]: fixups) {
+        auto &instruction = program->code[jump];
+        if (instruction.op == Opcode::JMP) {
+            instruction.a = labels.at(target);
+        } else {
+            instruction.b = labels.at(target);
+        }
+    }
+}
+
+Program *BytecodeCompiler::Compile(Module *module) {
+    program = context->New<Program>();
+    program->globals = module->globals;
+    for (auto ir: module->functions) {
+        functions[ir] = (int) program->functions.size();
+        program->functions.push_back({ir->name});
+    }
+    program->main = functions.at(module->main);
+    for (auto ir: module->functions) {
+        Function(ir, functions.at(ir));
+    }
+    return program;
+}
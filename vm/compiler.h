@@ -0,0 +1,69 @@
+#ifndef COMPILER_BYTECODE_COMPILER_H
+#define COMPILER_BYTECODE_COMPILER_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "../context/context.h"
+#include "../ir/ir.h"
+#include "bytecode.h"
+
+// Lowers SSA IR to register bytecode. Every value gets its own register and
+// allocas left by mem2reg get frame memory. Constants and addresses the code
+// needs in registers are set up once at the start of the routine; loads and
+// stores through globals, allocas and constant offsets fold into the memory
+// forms of LOAD and STORE, and constant divisors into DIVKI and MODKI. A phi
+// is written by its predecessors, through a second register read at the
+// start of the block when an edge is critical or a phi feeds another phi of
+// the same block. A value computed for a phi alone, like the step of a loop
+// counter, goes straight into its register.
+class BytecodeCompiler {
+public:
+    explicit BytecodeCompiler(CompilationContext *context) : context(context) {}
+
+    Program *Compile(Module *module);
+
+private:
+    struct Place {
+        enum Kind {
+            Global,
+            Local,
+            Memory
+        } kind;
+        int index;
+        int offset = 0;
+    };
+
+    void Function(IrFunction *ir, int index);
+
+    void Block(::Block *block, ::Block *next);
+
+    void Instruction(Inst *inst);
+
+    void Moves(::Block *from, ::Block *to);
+
+    int Emit(Opcode op, int a = 0, int b = 0, int c = 0, int d = 0, Position pos = {});
+
+    void Jump(Opcode op, int a, ::Block *target);
+
+    int Reg(Inst *value);
+
+    void Materialize(Inst *value, int target);
+
+    Place PlaceOf(Inst *pointer);
+
+    [[nodiscard]] bool IsFolded(Inst *value) const;
+
+    CompilationContext *context;
+    Program *program = nullptr;
+    ::Function *function = nullptr;
+    std::unordered_map<IrFunction *, int> functions;
+    std::unordered_map<Inst *, int> registers;
+    std::unordered_map<Inst *, int> incoming;
+    std::unordered_map<Inst *, int> slots;
+    std::unordered_map<::Block *, int> labels;
+    std::vector<std::pair<int, ::Block *>> fixups;
+    int base = 0;
+};
+
+#endif //COMPILER_BYTECODE_COMPILER_H
@@ -0,0 +1,23 @@
+#include "slots.h"
+
+ValueKind KindOf(SymbolType *type) {
+    auto resolved = type->Resolve();
+    if (dynamic_cast<SymbolInteger *>(resolved) != nullptr) return ValueKind::Integer;
+    if (dynamic_cast<SymbolDouble *>(resolved) != nullptr) return ValueKind::Double;
+    if (dynamic_cast<SymbolBoolean *>(resolved) != nullptr) return ValueKind::Boolean;
+    if (dynamic_cast<SymbolChar *>(resolved) != nullptr) return ValueKind::Char;
+    if (dynamic_cast<SymbolString *>(resolved) != nullptr) return ValueKind::String;
+    return ValueKind::Aggregate;
+}
+
+bool IsScalar(SymbolType *type) {
+    return KindOf(type) != ValueKind::Aggregate;
+}
+
+int SlotsOf(SymbolType *type) {
+    return (int) LayoutOf(type).size;
+}
+
+int FieldOffset(SymbolRecord *record, const std::string &field) {
+    return (int) LayoutOf(record).Offset(field);
+}
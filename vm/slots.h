@@ -0,0 +1,29 @@
+#ifndef COMPILER_SLOTS_H
+#define COMPILER_SLOTS_H
+
+#include <string>
+
+#include "../symbol/layout.h"
+#include "../symbol/symbol.h"
+
+// Storage model shared by the execution engines: every scalar takes one Value
+// slot, a record is its fields one after another and an array is its
+// elements one after another, as laid out by LayoutOf.
+enum class ValueKind {
+    Integer,
+    Double,
+    Boolean,
+    Char,
+    String,
+    Aggregate
+};
+
+ValueKind KindOf(SymbolType *type);
+
+bool IsScalar(SymbolType *type);
+
+int SlotsOf(SymbolType *type);
+
+int FieldOffset(SymbolRecord *record, const std::string &field);
+
+#endif //COMPILER_SLOTS_H
@@ -0,0 +1,47 @@
+#include "strings.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+size_t StringHeap::Bytes(const std::string &value) {
+    return sizeof(std::string) + value.size();
+}
+
+bool StringHeap::Due() const {
+    return made > std::max(kept, kMinimum);
+}
+
+void StringHeap::Sweep(std::initializer_list<Roots> roots) {
+    std::sort(strings.begin(), strings.end());
+    std::vector<bool> marked(strings.size());
+    for (auto &[begin, end]: roots) {
+        for (auto slot = (const char *) begin; slot + sizeof(Value) <= (const char *) end; slot += sizeof(Value)) {
+            Value value;
+            std::memcpy(&value, slot, sizeof(Value));
+            auto it = std::lower_bound(strings.begin(), strings.end(), value.s,
+                                       [](const std::unique_ptr<std::string> &string, const std::string *s) {
+                                           return std::less<const std::string *>()(string.get(), s);
+                                       });
+            if (it != strings.end() && it->get() == value.s) {
+                marked[it - strings.begin()] = true;
+            }
+        }
+    }
+    size_t live = 0;
+    kept = 0;
+    for (size_t i = 0; i < strings.size(); ++i) {
+        if (marked[i]) {
+            kept += Bytes(*strings[i]);
+            strings[live++] = std::move(strings[i]);
+        }
+    }
+    strings.resize(live);
+    made = 0;
+}
+
+const std::string *StringHeap::Make(std::string value) {
+    made += Bytes(value);
+    strings.push_back(std::make_unique<std::string>(std::move(value)));
+    return strings.back().get();
+}
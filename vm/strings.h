@@ -0,0 +1,44 @@
+#ifndef COMPILER_VM_STRINGS_H
+#define COMPILER_VM_STRINGS_H
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "value.h"
+
+// Owns the strings a program makes while it runs. They are swept rather
+// than counted: once the strings made since the last sweep outgrow those
+// that survived it, the slots that may hold strings are scanned and the
+// strings no slot points to are freed. Slots are untyped, so an integer
+// that happens to equal the address of a string keeps the string alive.
+class StringHeap {
+public:
+    // Slots from begin to end, any of which may point to a string.
+    struct Roots {
+        const void *begin;
+        const void *end;
+    };
+
+    // Whether enough was made since the last sweep for another.
+    [[nodiscard]] bool Due() const;
+
+    void Sweep(std::initializer_list<Roots> roots);
+
+    const std::string *Make(std::string value);
+
+    [[nodiscard]] size_t Count() const { return strings.size(); }
+
+private:
+    // Sweeps wait for at least this many bytes of new strings.
+    static constexpr size_t kMinimum = 1 << 20;
+
+    static size_t Bytes(const std::string &value);
+
+    std::vector<std::unique_ptr<std::string>> strings;
+    size_t made = 0;
+    size_t kept = 0;
+};
+
+#endif //COMPILER_VM_STRINGS_H
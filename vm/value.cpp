@@ -0,0 +1,13 @@
+#include "value.h"
+
+#include <cstdio>
+
+void WriteDouble(std::ostream &os, double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%g", value);
+    os << buffer;
+}
+
+void WriteBoolean(std::ostream &os, long long value) {
+    os << (value != 0 ? "TRUE" : "FALSE");
+}
@@ -0,0 +1,50 @@
+#ifndef COMPILER_VM_VALUE_H
+#define COMPILER_VM_VALUE_H
+
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "../lexer/lexeme.h"
+
+// One slot of run-time storage. Integers, chars and booleans are kept in i,
+// strings are immutable and shared by pointer, owned by the program or by
+// the StringHeap of the run, var parameters and aggregates are passed as
+// pointers to their first slot.
+union Value {
+    long long i;
+    double d;
+    const std::string *s;
+    Value *p;
+};
+
+static_assert(sizeof(Value) == 8);
+
+class RuntimeException : public std::exception {
+    std::string message;
+
+public:
+    [[nodiscard]] const char *what() const noexcept override {
+        return message.c_str();
+    }
+
+    RuntimeException(Position pos, const std::string &message) : std::exception() {
+        this->message = "(" + std::to_string(pos.GetLine()) + ", " +
+                        std::to_string(pos.GetColumn()) + ") " + message;
+    }
+
+    explicit RuntimeException(const std::string &message) : std::exception() {
+        this->message = message;
+    }
+};
+
+void WriteDouble(std::ostream &os, double value);
+
+void WriteBoolean(std::ostream &os, long long value);
+
+inline const std::string &StringOf(Value value) {
+    static const std::string empty;
+    return value.s == nullptr ? empty : *value.s;
+}
+
+#endif //COMPILER_VM_VALUE_H
@@ -0,0 +1,321 @@
+#include "vm.h"
+
+#include <algorithm>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO
+#endif
+
+VM::VM(Program *program, std::istream &in, std::ostream &out, size_t stack_size)
+        : program(program), in(in), out(out), globals(program->globals), stack(stack_size), memory(stack_size) {
+}
+
+// Runs elements begin to end of the kernel a chunk at a time, node by node,
+// as it allows, and returns the reduction of their values.
+static long long RunKernel(const Kernel &kernel, const Value *operands, long long begin, long long end) {
+    const int kChunk = 64;
+    auto count = (unsigned long long) (end - begin);
+    Value streams[Kernel::kStreams];
+    for (int i = 0; i < kernel.streams; ++i) {
+        streams[i].p = operands[1 + i].p + begin;
+    }
+    auto params = operands + 1 + kernel.streams;
+    auto size = kernel.nodes.size();
+    Value values[Kernel::kNodes][kChunk];
+    for (size_t i = 0; i < size; ++i) {
+        if (kernel.nodes[i].op == Kernel::Op::Param) {
+            std::fill(values[i], values[i] + kChunk, params[kernel.nodes[i].a]);
+        }
+    }
+    auto result = Kernel::Identity(kernel.reduce);
+    for (unsigned long long done = 0; done < count; done += kChunk) {
+        auto n = (int) std::min<unsigned long long>(kChunk, count - done);
+        for (size_t i = 0; i < size; ++i) {
+            auto &node = kernel.nodes[i];
+            auto out = values[i], a = values[node.a], b = values[node.b];
+            switch (node.op) {
+                case Kernel::Op::Load:
+                    std::copy(streams[node.a].p + done, streams[node.a].p + done + n, out);
+                    break;
+                case Kernel::Op::Store:
+                    std::copy(b, b + n, streams[node.a].p + done);
+                    break;
+                case Kernel::Op::Param:
+                    break;
+#define KERNEL_LOOP(op, expression) \
+                case Kernel::Op::op: \
+                    for (int j = 0; j < n; ++j) { \
+                        expression; \
+                    } \
+                    break;
+                KERNEL_LOOP(Add, out[j].i = (long long) ((unsigned long long) a[j].i + (unsigned long long) b[j].i))
+                KERNEL_LOOP(Sub, out[j].i = (long long) ((unsigned long long) a[j].i - (unsigned long long) b[j].i))
+                KERNEL_LOOP(Mul, out[j].i = (long long) ((unsigned long long) a[j].i * (unsigned long long) b[j].i))
+                KERNEL_LOOP(And, out[j].i = a[j].i & b[j].i)
+                KERNEL_LOOP(Or, out[j].i = a[j].i | b[j].i)
+                KERNEL_LOOP(Xor, out[j].i = a[j].i ^ b[j].i)
+                KERNEL_LOOP(Neg, out[j].i = (long long) (0 - (unsigned long long) a[j].i))
+                KERNEL_LOOP(FAdd, out[j].d = a[j].d + b[j].d)
+                KERNEL_LOOP(FSub, out[j].d = a[j].d - b[j].d)
+                KERNEL_LOOP(FMul, out[j].d = a[j].d * b[j].d)
+                KERNEL_LOOP(FDiv, out[j].d = a[j].d / b[j].d)
+#undef KERNEL_LOOP
+            }
+        }
+        if (kernel.reduction >= 0) {
+            for (int j = 0; j < n; ++j) {
+                result = Kernel::Combine(kernel.reduce, result, values[kernel.reduction][j].i);
+            }
+        }
+    }
+    return result;
+}
+
+void VM::Run() {
+#ifdef VM_COMPUTED_GOTO
+    static const void *handlers[] = {
+#define OPCODE_LABEL(name) &&L_##name,
+            OPCODES(OPCODE_LABEL)
+#undef OPCODE_LABEL
+    };
+    for (auto &instruction: program->code) {
+        instruction.handler = handlers[(int) instruction.op];
+    }
+#define CASE(name) L_##name:
+#define DISPATCH() goto *pc->handler
+#else
+#define CASE(name) case Opcode::name:
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() ++pc; DISPATCH()
+#define R(x) r[pc->x]
+#define ERROR(message) throw RuntimeException(program->positions[pc - code], message)
+
+    std::fill(globals.begin(), globals.end(), Value{});
+    frames.clear();
+    const Instruction *code = program->code.data();
+    const Function *function = &program->functions[program->main];
+    const Instruction *pc = code + function->entry;
+    Value *r = stack.data();
+    Value *m = memory.data();
+    Value *g = globals.data();
+    const Value *k = program->constants.data();
+    const ArrayInfo *arrays = program->arrays.data();
+    const Divisor *divisors = program->divisors.data();
+    auto stack_end = stack.data() + stack.size();
+    auto memory_end = memory.data() + memory.size();
+    if (r + function->registers > stack_end || m + function->memory > memory_end) {
+        throw RuntimeException("Stack overflow");
+    }
+    std::fill(r, r + function->registers, Value{});
+    std::fill(m, m + function->memory, Value{});
+    // Frames of callers end below the one running, so its end bounds the
+    // slots a sweep has to look at. The operands of the instruction making
+    // the string are not needed by then.
+    auto make = [&](std::string value) {
+        if (strings.Due()) {
+            strings.Sweep({{globals.data(), globals.data() + globals.size()},
+                           {stack.data(), r + function->registers},
+                           {memory.data(), m + function->memory}});
+        }
+        return strings.Make(std::move(value));
+    };
+
+    DISPATCH();
+#ifndef VM_COMPUTED_GOTO
+    dispatch:
+    switch (pc->op) {
+#endif
+    CASE(MOVE) R(a) = R(b); NEXT();
+    CASE(LOADK) R(a) = k[pc->b]; NEXT();
+    CASE(LOADG) R(a) = g[pc->b]; NEXT();
+    CASE(STOREG) g[pc->a] = R(b); NEXT();
+    CASE(LOADL) R(a) = m[pc->b]; NEXT();
+    CASE(STOREL) m[pc->a] = R(b); NEXT();
+    CASE(ADDRG) R(a).p = g + pc->b; NEXT();
+    CASE(ADDRL) R(a).p = m + pc->b; NEXT();
+    CASE(LOAD) R(a) = R(b).p[pc->c]; NEXT();
+    CASE(STORE) R(a).p[pc->b] = R(c); NEXT();
+    CASE(ADDP) R(a).p = R(b).p + pc->c; NEXT();
+    CASE(INDEX) {
+        auto &array = arrays[pc->d];
+        auto index = R(c).i - array.low;
+        if ((unsigned long long) index >= (unsigned long long) array.count) {
+            ERROR("Index out of range");
+        }
+        R(a).p = R(b).p + index * array.stride;
+        NEXT();
+    }
+    CASE(INDEXU) {
+        auto &array = arrays[pc->d];
+        R(a).p = R(b).p + (R(c).i - array.low) * array.stride;
+        NEXT();
+    }
+    CASE(COPY) std::copy(R(b).p, R(b).p + pc->c, R(a).p); NEXT();
+    CASE(ADDI) R(a).i = (long long) ((unsigned long long) R(b).i + (unsigned long long) R(c).i); NEXT();
+    CASE(SUBI) R(a).i = (long long) ((unsigned long long) R(b).i - (unsigned long long) R(c).i); NEXT();
+    CASE(MULI) R(a).i = (long long) ((unsigned long long) R(b).i * (unsigned long long) R(c).i); NEXT();
+    CASE(DIVI) {
+        auto divisor = R(c).i;
+        if (divisor == 0) {
+            ERROR("Division by zero");
+        }
+        R(a).i = divisor == -1 ? (long long) (0 - (unsigned long long) R(b).i) : R(b).i / divisor;
+        NEXT();
+    }
+    CASE(MODI) {
+        auto divisor = R(c).i;
+        if (divisor == 0) {
+            ERROR("Division by zero");
+        }
+        R(a).i = divisor == -1 ? 0 : R(b).i % divisor;
+        NEXT();
+    }
+    CASE(SHLI) R(a).i = (long long) ((unsigned long long) R(b).i << (R(c).i & 63)); NEXT();
+    CASE(SHRI) R(a).i = (long long) ((unsigned long long) R(b).i >> (R(c).i & 63)); NEXT();
+    CASE(ANDI) R(a).i = R(b).i & R(c).i; NEXT();
+    CASE(ORI) R(a).i = R(b).i | R(c).i; NEXT();
+    CASE(XORI) R(a).i = R(b).i ^ R(c).i; NEXT();
+    CASE(NEGI) R(a).i = (long long) (0 - (unsigned long long) R(b).i); NEXT();
+    CASE(NOTI) R(a).i = ~R(b).i; NEXT();
+    CASE(ADDKI) R(a).i = (long long) ((unsigned long long) R(b).i + (unsigned long long) (long long) pc->c); NEXT();
+    CASE(DIVKI) R(a).i = Quotient(divisors[pc->c], R(b).i); NEXT();
+    CASE(MODKI) R(a).i = Remainder(divisors[pc->c], R(b).i); NEXT();
+    CASE(ADDD) R(a).d = R(b).d + R(c).d; NEXT();
+    CASE(SUBD) R(a).d = R(b).d - R(c).d; NEXT();
+    CASE(MULD) R(a).d = R(b).d * R(c).d; NEXT();
+    CASE(DIVD) R(a).d = R(b).d / R(c).d; NEXT();
+    CASE(NEGD) R(a).d = -R(b).d; NEXT();
+    CASE(ITOD) R(a).d = (double) R(b).i; NEXT();
+    CASE(NOTB) R(a).i = R(b).i == 0; NEXT();
+    CASE(CONCAT) {
+        R(a).s = make(StringOf(R(b)) + StringOf(R(c)));
+        NEXT();
+    }
+    CASE(EQI) R(a).i = R(b).i == R(c).i; NEXT();
+    CASE(NEI) R(a).i = R(b).i != R(c).i; NEXT();
+    CASE(LTI) R(a).i = R(b).i < R(c).i; NEXT();
+    CASE(LEI) R(a).i = R(b).i <= R(c).i; NEXT();
+    CASE(GTI) R(a).i = R(b).i > R(c).i; NEXT();
+    CASE(GEI) R(a).i = R(b).i >= R(c).i; NEXT();
+    CASE(EQD) R(a).i = R(b).d == R(c).d; NEXT();
+    CASE(NED) R(a).i = R(b).d != R(c).d; NEXT();
+    CASE(LTD) R(a).i = R(b).d < R(c).d; NEXT();
+    CASE(LED) R(a).i = R(b).d <= R(c).d; NEXT();
+    CASE(GTD) R(a).i = R(b).d > R(c).d; NEXT();
+    CASE(GED) R(a).i = R(b).d >= R(c).d; NEXT();
+    CASE(EQS) R(a).i = StringOf(R(b)) == StringOf(R(c)); NEXT();
+    CASE(NES) R(a).i = StringOf(R(b)) != StringOf(R(c)); NEXT();
+    CASE(LTS) R(a).i = StringOf(R(b)) < StringOf(R(c)); NEXT();
+    CASE(LES) R(a).i = StringOf(R(b)) <= StringOf(R(c)); NEXT();
+    CASE(GTS) R(a).i = StringOf(R(b)) > StringOf(R(c)); NEXT();
+    CASE(GES) R(a).i = StringOf(R(b)) >= StringOf(R(c)); NEXT();
+    CASE(JMP) pc = code + pc->a; DISPATCH();
+    CASE(JZ) pc = R(a).i == 0 ? code + pc->b : pc + 1; DISPATCH();
+    CASE(JNZ) pc = R(a).i != 0 ? code + pc->b : pc + 1; DISPATCH();
+    CASE(CALL) {
+        auto callee = &program->functions[pc->a];
+        auto registers = r + pc->b;
+        auto frame_memory = m + function->memory;
+        if (registers + callee->registers > stack_end || frame_memory + callee->memory > memory_end) {
+            ERROR("Stack overflow");
+        }
+        frames.push_back({pc + 1, r, m, function});
+        std::fill(registers + callee->params, registers + callee->registers, Value{});
+        std::fill(frame_memory, frame_memory + callee->memory, Value{});
+        r = registers;
+        m = frame_memory;
+        function = callee;
+        pc = code + callee->entry;
+        DISPATCH();
+    }
+    CASE(TAILCALL) {
+        auto callee = &program->functions[pc->a];
+        if (r + callee->registers > stack_end || m + callee->memory > memory_end) {
+            ERROR("Stack overflow");
+        }
+        std::copy(r + pc->b, r + pc->b + callee->params, r);
+        std::fill(r + callee->params, r + callee->registers, Value{});
+        std::fill(m, m + callee->memory, Value{});
+        function = callee;
+        pc = code + callee->entry;
+        DISPATCH();
+    }
+    CASE(VECTOR) {
+        auto &kernel = program->kernels[pc->b];
+        auto operands = r + pc->a;
+        auto count = operands[0].i;
+        long long result;
+        if (kernel.parallel && threads > 1 && count > Kernel::kChunk) {
+            if (pool == nullptr) {
+                pool = std::make_unique<ThreadPool>(threads);
+            }
+            std::vector<long long> chunks((count + Kernel::kChunk - 1) / Kernel::kChunk);
+            pool->For(count, Kernel::kChunk, [&](long long chunk, long long begin, long long end) {
+                chunks[chunk] = RunKernel(kernel, operands, begin, end);
+            });
+            result = Kernel::Identity(kernel.reduce);
+            for (auto chunk: chunks) {
+                result = Kernel::Combine(kernel.reduce, result, chunk);
+            }
+        } else {
+            result = RunKernel(kernel, operands, 0, count);
+        }
+        if (kernel.reduction >= 0) {
+            R(a).i = Kernel::Combine(kernel.reduce, operands[1 + kernel.streams + kernel.params].i, result);
+        }
+        NEXT();
+    }
+    CASE(RET) {
+        if (pc->a >= 0) {
+            r[0] = R(a);
+        }
+        auto &frame = frames.back();
+        pc = frame.pc;
+        r = frame.registers;
+        m = frame.memory;
+        function = frame.function;
+        frames.pop_back();
+        DISPATCH();
+    }
+    CASE(HALT) return;
+    CASE(WRITEI) out << R(a).i; NEXT();
+    CASE(WRITED) WriteDouble(out, R(a).d); NEXT();
+    CASE(WRITEB) WriteBoolean(out, R(a).i); NEXT();
+    CASE(WRITEC) out << (char) R(a).i; NEXT();
+    CASE(WRITES) out << StringOf(R(a)); NEXT();
+    CASE(WRITELN) out << "\n"; NEXT();
+    CASE(READI) {
+        long long value = 0;
+        in >> value;
+        R(a).i = value;
+        NEXT();
+    }
+    CASE(READD) {
+        double value = 0;
+        in >> value;
+        R(a).d = value;
+        NEXT();
+    }
+    CASE(READC) {
+        char value = 0;
+        in >> value;
+        R(a).i = value;
+        NEXT();
+    }
+    CASE(READS) {
+        std::string value;
+        in >> value;
+        R(a).s = make(std::move(value));
+        NEXT();
+    }
+#ifndef VM_COMPUTED_GOTO
+    }
+#endif
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef R
+#undef ERROR
+}
@@ -0,0 +1,45 @@
+#ifndef COMPILER_VM_H
+#define COMPILER_VM_H
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../parallel/thread_pool.h"
+#include "bytecode.h"
+#include "strings.h"
+
+// Executes register bytecode. With GCC and Clang every instruction carries
+// the address of its handler and dispatch is a single indirect jump (direct
+// threading through computed goto); other compilers fall back to a switch.
+// Parallel kernels are split between the threads of a pool started the
+// first time one runs.
+class VM {
+public:
+    VM(Program *program, std::istream &in, std::ostream &out, size_t stack_size = 1 << 20);
+
+    void Run();
+
+    // Threads parallel kernels are split between.
+    int threads = ThreadPool::DefaultThreads();
+
+private:
+    struct Frame {
+        const Instruction *pc;
+        Value *registers;
+        Value *memory;
+        const Function *function;
+    };
+
+    Program *program;
+    std::istream &in;
+    std::ostream &out;
+    std::vector<Value> globals;
+    std::vector<Value> stack;
+    std::vector<Value> memory;
+    std::vector<Frame> frames;
+    StringHeap strings;
+    std::unique_ptr<ThreadPool> pool;
+};
+
+#endif //COMPILER_VM_H